@@ -0,0 +1,232 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#endif
+
+#include "BodyDecoder.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+int32_t bodyDecoder_init(BodyDecoder_t *pDecoder, bool chunked, bool gzipped, int64_t contentLength)
+{
+    memset(pDecoder, 0, sizeof(BodyDecoder_t));
+    pDecoder->chunked = chunked;
+    pDecoder->gzipped = gzipped;
+    pDecoder->contentLength = chunked ? INKY_BODYDEC_LENGTH_UNKNOWN : contentLength;
+    pDecoder->rawComplete = (pDecoder->contentLength == 0);
+
+    chunkDecoder_init(&(pDecoder->chunkDecoder));
+
+    if (gzipped)
+    {
+        pDecoder->staging = (char *)malloc(INKY_BODYDEC_STAGING_SIZE);
+
+        if (pDecoder->staging == NULL)
+        {
+            LogSerial_Error("Failed to allocate staging buffer for compressed data");
+            logProblem(INKY_SEVERITY_ERROR);
+            return INKY_BODYDEC_RC_NOMEM;
+        }
+
+        if (gzipDecoder_init(&(pDecoder->gzipDecoder)) != INKY_GZIP_RC_OK)
+        {
+            return INKY_BODYDEC_RC_NOMEM;
+        }
+    }
+    return INKY_BODYDEC_RC_OK;
+}
+
+void bodyDecoder_free(BodyDecoder_t *pDecoder)
+{
+    if (pDecoder->gzipped)
+    {
+        gzipDecoder_free(&(pDecoder->gzipDecoder));
+    }
+    free(pDecoder->staging);
+    pDecoder->staging = NULL;
+}
+
+//Reads data that has arrived into buf and strips the chunk headers
+//returns INKY_BODYDEC_RC_OK or INKY_BODYDEC_RC_BADCHUNK
+static int32_t readAndDechunk(BodyDecoder_t *pDecoder, bodyReadFn_t *readFn, void *readContext,
+                              char *buf, size_t bufSpace, size_t *pLen)
+{
+    if (pDecoder->contentLength != INKY_BODYDEC_LENGTH_UNKNOWN)
+    {
+        //Don't read past the end of the body
+        uint64_t remaining = (uint64_t)pDecoder->contentLength - pDecoder->totalRaw;
+
+        if (remaining < bufSpace)
+        {
+            bufSpace = (size_t)remaining;
+        }
+    }
+    size_t rawLen = (bufSpace > 0) ? readFn(buf, bufSpace, readContext) : 0;
+    pDecoder->totalRaw += rawLen;
+
+    if (   pDecoder->contentLength != INKY_BODYDEC_LENGTH_UNKNOWN
+        && pDecoder->totalRaw == (uint64_t)pDecoder->contentLength)
+    {
+        pDecoder->rawComplete = true;
+    }
+
+    if (pDecoder->chunked && rawLen > 0)
+    {
+        int32_t chunkrc = chunkDecoder_decode(&(pDecoder->chunkDecoder), buf, rawLen, pLen);
+
+        if (chunkrc == INKY_CHUNKDEC_RC_COMPLETE)
+        {
+            pDecoder->rawComplete = true;
+        }
+        else if (chunkrc != INKY_CHUNKDEC_RC_OK)
+        {
+            LogSerial_Error("Failed to decode chunked data (after %" PRIu64 " bytes)", pDecoder->totalRaw);
+            logProblem(INKY_SEVERITY_ERROR);
+            return INKY_BODYDEC_RC_BADCHUNK;
+        }
+    }
+    else
+    {
+        *pLen = rawLen;
+    }
+    return INKY_BODYDEC_RC_OK;
+}
+
+//After the end of the gzip data, reads (and ignores) what has arrived of the rest of the body
+//returns INKY_BODYDEC_RC_COMPLETE once we're at the end of the body, INKY_BODYDEC_RC_OK if there's more to read
+//        or INKY_BODYDEC_RC_BADCHUNK
+static int32_t skipToEndOfBody(BodyDecoder_t *pDecoder, bodyReadFn_t *readFn, void *readContext)
+{
+    int32_t rc = INKY_BODYDEC_RC_OK;
+
+    if (!pDecoder->chunked && pDecoder->contentLength == INKY_BODYDEC_LENGTH_UNKNOWN)
+    {
+        //Only the server closing the connection marks the end - the gzip data is all we want
+        return INKY_BODYDEC_RC_COMPLETE;
+    }
+
+    while (rc == INKY_BODYDEC_RC_OK && !pDecoder->rawComplete)
+    {
+        size_t skipped = 0;
+        uint64_t rawBefore = pDecoder->totalRaw;
+
+        rc = readAndDechunk(pDecoder, readFn, readContext, pDecoder->staging, INKY_BODYDEC_STAGING_SIZE, &skipped);
+
+        if (skipped > 0)
+        {
+            LogSerial_Unusual("Ignoring %zu bytes after the end of the gzip data", skipped);
+        }
+        if (pDecoder->totalRaw == rawBefore)
+        {
+            break; //Wait for the rest to arrive
+        }
+    }
+
+    if (rc == INKY_BODYDEC_RC_OK && pDecoder->rawComplete)
+    {
+        rc = INKY_BODYDEC_RC_COMPLETE;
+    }
+    return rc;
+}
+
+int32_t bodyDecoder_decode(BodyDecoder_t *pDecoder, bodyReadFn_t *readFn, void *readContext,
+                           char *out, size_t outSpace, size_t *pOutLen)
+{
+    int32_t rc = INKY_BODYDEC_RC_OK;
+    size_t outLen = 0;
+
+    if (!pDecoder->gzipped)
+    {
+        //Uncompressed: read (and dechunk) straight into the caller's buffer
+        rc = readAndDechunk(pDecoder, readFn, readContext, out, outSpace, &outLen);
+
+        if (rc == INKY_BODYDEC_RC_OK && pDecoder->rawComplete)
+        {
+            rc = INKY_BODYDEC_RC_COMPLETE;
+        }
+    }
+    else if (pDecoder->gzipComplete)
+    {
+        rc = skipToEndOfBody(pDecoder, readFn, readContext);
+    }
+    else
+    {
+        //The chunked encoding wraps the compressed data so it's dechunked into the staging buffer
+        //then inflated into the caller's buffer until it is full or we run out of data
+        while (rc == INKY_BODYDEC_RC_OK && outLen < outSpace)
+        {
+            if (pDecoder->stagingLen == 0 && !pDecoder->rawComplete)
+            {
+                pDecoder->stagingStart = 0;
+                rc = readAndDechunk(pDecoder, readFn, readContext,
+                                    pDecoder->staging, INKY_BODYDEC_STAGING_SIZE, &(pDecoder->stagingLen));
+                if (rc != INKY_BODYDEC_RC_OK)
+                {
+                    break;
+                }
+            }
+
+            size_t inUsed = 0;
+            size_t produced = 0;
+            int32_t gziprc = gzipDecoder_inflate(&(pDecoder->gzipDecoder),
+                                                 &(pDecoder->staging[pDecoder->stagingStart]), pDecoder->stagingLen, &inUsed,
+                                                 out + outLen, outSpace - outLen, &produced);
+            pDecoder->stagingStart += inUsed;
+            pDecoder->stagingLen   -= inUsed;
+            outLen += produced;
+
+            if (gziprc == INKY_GZIP_RC_COMPLETE)
+            {
+                pDecoder->gzipComplete = true;
+                if (pDecoder->stagingLen > 0)
+                {
+                    LogSerial_Unusual("Ignoring %zu bytes after the end of the gzip data", pDecoder->stagingLen);
+                    pDecoder->stagingLen = 0;
+                }
+                rc = skipToEndOfBody(pDecoder, readFn, readContext);
+                break;
+            }
+            else if (gziprc != INKY_GZIP_RC_OK)
+            {
+                LogSerial_Error("Failed to inflate gzip data (after %" PRIu64 " bytes)", pDecoder->totalRaw);
+                logProblem(INKY_SEVERITY_ERROR);
+                rc = INKY_BODYDEC_RC_BADGZIP;
+            }
+            else if (inUsed == 0 && produced == 0)
+            {
+                if (pDecoder->rawComplete)
+                {
+                    LogSerial_Error("Body ended before the end of the gzip data (after %" PRIu64 " bytes)", pDecoder->totalRaw);
+                    logProblem(INKY_SEVERITY_ERROR);
+                    rc = INKY_BODYDEC_RC_BADGZIP;
+                }
+                //else wait for more data to arrive
+                break;
+            }
+        }
+        pDecoder->outputWasFull = (outLen == outSpace);
+    }
+
+    if (rc == INKY_BODYDEC_RC_COMPLETE)
+    {
+        pDecoder->complete = true;
+    }
+    pDecoder->totalDecoded += outLen;
+    *pOutLen = outLen;
+    return rc;
+}
+
+bool bodyDecoder_hasPending(const BodyDecoder_t *pDecoder)
+{
+    return (pDecoder->stagingLen > 0) || (pDecoder->gzipped && pDecoder->outputWasFull);
+}
@@ -0,0 +1,76 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef BODYDECODER_H
+#define BODYDECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ChunkDecoder.h"
+#include "GzipDecoder.h"
+
+//Turns the http body as received into the data the server meant us to have:
+//strips any Transfer-Encoding: chunked headers then, for Content-Encoding: gzip, inflates it.
+//
+//The whole body is read (e.g. to the end of the chunked encoding after the gzip data ends,
+//or exactly Content-Length bytes) so a kept open connection is ready for the next request.
+//
+//Compressed data is read into a small staging buffer and inflated into the caller's window
+//a piece at a time, so only the window (never the whole decompressed document) is in memory.
+//
+//Doesn't know about HTTPClient so it can be tested on Linux.
+
+#define INKY_BODYDEC_RC_OK          0
+#define INKY_BODYDEC_RC_COMPLETE    1  //Reached (and read all of) the end of the body
+#define INKY_BODYDEC_RC_BADCHUNK   -1  //Transfer-Encoding: chunked data was invalid
+#define INKY_BODYDEC_RC_BADGZIP    -2  //Content-Encoding: gzip data was invalid
+#define INKY_BODYDEC_RC_NOMEM      -3
+
+//Compressed data is read in blocks of this size
+#define INKY_BODYDEC_STAGING_SIZE  4096
+
+//Reads up to maxLen bytes that have already arrived into buf - mustn't wait for more data
+//returns number of bytes read (0 if none available)
+typedef size_t bodyReadFn_t(char *buf, size_t maxLen, void *readContext);
+
+//Content-Length for a body whose end is found another way (chunked, or the server closing the connection)
+#define INKY_BODYDEC_LENGTH_UNKNOWN (-1)
+
+typedef struct {
+    bool chunked;
+    bool gzipped;
+    int64_t contentLength;   //Or INKY_BODYDEC_LENGTH_UNKNOWN
+    bool rawComplete;        //Read the end of the body (as sent)
+    bool gzipComplete;       //Read the end of the gzip data
+    bool complete;           //Returned INKY_BODYDEC_RC_COMPLETE
+    bool outputWasFull;      //Last call filled the caller's space: the inflater may have more output
+    ChunkDecoder_t chunkDecoder;
+    GzipDecoder_t  gzipDecoder;
+    char    *staging;        //Dechunked compressed data waiting to be inflated (only if gzipped)
+    size_t  stagingStart;
+    size_t  stagingLen;
+    uint64_t totalRaw;       //Count of bytes read (as sent by the server)
+    uint64_t totalDecoded;   //Count of bytes given to the caller
+} BodyDecoder_t;
+
+// input: contentLength - ignored if chunked (can be INKY_BODYDEC_LENGTH_UNKNOWN)
+//returns INKY_BODYDEC_RC_OK or INKY_BODYDEC_RC_NOMEM
+int32_t bodyDecoder_init(BodyDecoder_t *pDecoder, bool chunked, bool gzipped, int64_t contentLength);
+void bodyDecoder_free(BodyDecoder_t *pDecoder);
+
+//Reads whatever data has arrived and decodes as much of it as fits in out
+// output: pOutLen - decoded bytes put in out
+// returns INKY_BODYDEC_RC_OK, INKY_BODYDEC_RC_COMPLETE or an error
+int32_t bodyDecoder_decode(BodyDecoder_t *pDecoder, bodyReadFn_t *readFn, void *readContext,
+                           char *out, size_t outSpace, size_t *pOutLen);
+
+//true if the decoder holds data it has read but not yet given to the caller
+//(so there is more to decode even if no more data arrives)
+bool bodyDecoder_hasPending(const BodyDecoder_t *pDecoder);
+
+#endif
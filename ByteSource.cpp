@@ -0,0 +1,69 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#endif
+
+#include "ByteSource.h"
+#include <string.h>
+
+#include "LogSerial.h"
+
+static size_t readFile(char *buf, size_t maxLen, void *sourceContext)
+{
+    ByteSourceFile_t *pFile = (ByteSourceFile_t *)sourceContext;
+    size_t len = 0;
+
+    if (!pFile->atEnd)
+    {
+        len = fread(buf, 1, maxLen, pFile->file);
+
+        if (len < maxLen)
+        {
+            pFile->atEnd = true;
+        }
+    }
+    return len;
+}
+
+static bool fileEnded(void *sourceContext)
+{
+    ByteSourceFile_t *pFile = (ByteSourceFile_t *)sourceContext;
+    return pFile->atEnd;
+}
+
+static void waitForFile(uint32_t maxWaitMs, void *sourceContext)
+{
+    //Everything has already arrived
+}
+
+bool byteSourceFile_open(ByteSourceFile_t *pFile, const char *path, ByteSource_t *pSource)
+{
+    memset(pFile, 0, sizeof(ByteSourceFile_t));
+    pFile->file = fopen(path, "rb");
+
+    if (pFile->file == NULL)
+    {
+        LogSerial_Error("Failed to open %s", path);
+        return false;
+    }
+    pSource->read    = readFile;
+    pSource->ended   = fileEnded;
+    pSource->wait    = waitForFile;
+    pSource->context = pFile;
+    return true;
+}
+
+void byteSourceFile_close(ByteSourceFile_t *pFile)
+{
+    if (pFile->file != NULL)
+    {
+        fclose(pFile->file);
+        pFile->file = NULL;
+    }
+}
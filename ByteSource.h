@@ -0,0 +1,49 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef BYTESOURCE_H
+#define BYTESOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+//Where the bytes of an http response come from. On the InkPlate that is the HTTPClient stream
+//(see Network.cpp) but the same receive/decode/parse code can be run from a file or (in the
+//tests and benchmarks on Linux) a socket.
+
+//Reads up to maxLen bytes that have already arrived into buf - mustn't wait for more data
+//(same as bodyReadFn_t in BodyDecoder.h)
+//returns number of bytes read (0 if none available)
+typedef size_t byteSourceReadFn_t(char *buf, size_t maxLen, void *sourceContext);
+
+//returns true once no more data will arrive and everything that did has been read
+//(e.g. the server closed the connection or we reached the end of the file)
+typedef bool byteSourceEndedFn_t(void *sourceContext);
+
+//Gives more data a chance to arrive: returns when some might have or after (about) maxWaitMs
+typedef void byteSourceWaitFn_t(uint32_t maxWaitMs, void *sourceContext);
+
+typedef struct {
+    byteSourceReadFn_t  *read;
+    byteSourceEndedFn_t *ended;
+    byteSourceWaitFn_t  *wait;
+    void *context;
+} ByteSource_t;
+
+//A file as a byte source: all of the file has already "arrived"
+typedef struct {
+    FILE *file;
+    bool atEnd;
+} ByteSourceFile_t;
+
+//Opens path and sets up pSource to read it through pFile (which must stay in scope whilst pSource is used)
+//returns false if the file couldn't be opened
+bool byteSourceFile_open(ByteSourceFile_t *pFile, const char *path, ByteSource_t *pSource);
+void byteSourceFile_close(ByteSourceFile_t *pFile);
+
+#endif
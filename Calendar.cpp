@@ -15,6 +15,10 @@
 #include "InkyCalInternal.h"
 #include "LogSerial.h"
 #include "EventProcessing.h"
+#include "LineScanner.h"
+#include "RecurRule.h"
+#include "OverrideIndex.h"
+#include "TimeZones.h"
 
 //Stuff from secrets.h (that can only be included in one source file as it declares vars)
 extern Calendar_t Calendars[];
@@ -25,47 +29,526 @@ extern Calendar_t Calendars[];
 #define INKYC_ADDTIME_MONTHS 2
 #define INKYC_ADDTIME_YEARS  3
 
-//Longest line (including continuation lines) in an ICAL calendar we are prepared to read
-#define INKYC_LINEBUF_MAX 500
-
-#define INKYC_LINERC_INCOMPLETE_TOO_LONG 1  //Can't get complete unfolded line, it's too long
-#define INKYC_LINERC_INCOMPLETE_SRC      2  //Can't get complete unfolded line - it's incomplete is the src buffer
-
-typedef struct recurringEventInfo
-{
-    time_t initialStart;
-    time_t initialEnd;
-    time_t repeatUntil;
-    uint32_t durationSecs;
-    uint32_t recurrenceType; //One of the INKYC_ADDTIME_* constants
-    int32_t recurrenceInterval; //count of number of units (unit type defined by recurrenceType)
-    int32_t instancesRemaining; //Including currentInstance => -1 means no limit
-    //bool daysFilter[7];  //Not yet implement - probably also want a flag to see filtering needed? 
-    time_t currentStart;
-    time_t currentEnd;
-    uint32_t currentStartYYYYMMDDInt;   
-    uint32_t currentEndYYYYMMDDInt;  
-} recurringEventInfo_t;
-
-//Hold information about an where in the bufferevernt whilst we parse it
-#define INKYC_EVTPARSE_MAXBYTES_TIME 20
-#define INKYC_EVTPARSE_MAXBYTES_TIMEZONE  128
+//Longest "END:<component name>" line we look for to skip a component in an event
+#define INKYC_MAXBYTES_COMPONENT_END 64
+
+//Longest property name we look up (none we use are longer)
+#define INKYC_MAXBYTES_PROPNAME 32
+
+#define INKYC_LINERC_INCOMPLETE_SRC      2  //Can't get complete (unfolded) line - it's incomplete is the src buffer
+#define INKYC_LINERC_NOT_CONTENT         3  //Line isn't name *(";" param) ":" value
+#define INKYC_LINERC_TIMEZONE            4  //There's a time zone (VTIMEZONE) before the next event
+
+//Part of the receive buffer - e.g. the value of a property. If it was folded over more than one line
+//or has escapes in it, it needs unfolding (spanToString() does that) before it can be used as a string
+typedef struct {
+    char *start;
+    size_t len;
+    bool needsUnfold;
+} span_t;
+
+//Where the details of an event are in the buffer whilst we parse it - they're only copied out
+//when needed (e.g. the summary only for events that are shown)
+#define INKYC_EVTPARSE_MAXBYTES_TIME      20
 #define INKYC_EVTPARSE_MAXBYTES_RECURRULE 128
+#define INKYC_EVTPARSE_MAX_EXDATES        8   //EXDATE lines (each can be a list)
+#define INKYC_EVTPARSE_MAXBYTES_EXDATES   256 //An EXDATE line (after unfolding)
+#define INKYC_EVTPARSE_MAX_EXDATE_VALUES  32  //Dates/times in all of an event's EXDATE lines
+#define INKYC_EVTPARSE_MAXBYTES_UID       256 //Only for UIDs that need unfolding before they're hashed
+
+//An event with a RECURRENCE-ID before the recurring event is remembered if the occurrence it replaces
+//starts no more than this many days before the first day shown (so all day events up to this long)
+#define INKYC_OVERRIDE_MARGIN_DAYS 31
+
+//STATUS of an event
+#define INKYC_EVTSTATUS_UNSET     0
+#define INKYC_EVTSTATUS_TENTATIVE 1
+#define INKYC_EVTSTATUS_CONFIRMED 2
+#define INKYC_EVTSTATUS_CANCELLED 3
+#define INKYC_EVTSTATUS_OTHER     4
+
 typedef struct eventParsingDetails
 {
-    char summary[INKY_ENTRY_MAXBYTES_NAME];
-    char location[INKY_ENTRY_MAXBYTES_LOCATION];
-    char timeStart[INKYC_EVTPARSE_MAXBYTES_TIME];
-    char timeEnd[INKYC_EVTPARSE_MAXBYTES_TIME];
-    char dateStart[INKYC_EVTPARSE_MAXBYTES_TIME];
-    char dateEnd[INKYC_EVTPARSE_MAXBYTES_TIME];
-    char timeZone[INKYC_EVTPARSE_MAXBYTES_TIMEZONE];
-    char recurRule[INKYC_EVTPARSE_MAXBYTES_RECURRULE];
-    char *foldedDescription;   //We don't unfold description - it can be long and we don't display it
-    size_t foldedDescriptionLen;
+    span_t summary;
+    span_t location;
+    span_t description;    //Rules search this as it is - we don't unfold it, it can be long and we don't display it
+    span_t timeStart;
+    span_t timeEnd;
+    span_t dateStart;
+    span_t dateEnd;
+    span_t timeZone;       //TZID= of DTSTART (and RECURRENCE-ID, EXDATE)...
+    span_t timeZoneEnd;    //...and of DTEND
+    span_t recurRule;
+    span_t uid;
+    int32_t sequence;
+    span_t recurrenceId;   //Instance of a recurring event this overrides
+    span_t exDates[INKYC_EVTPARSE_MAX_EXDATES];
+    uint32_t numExDates;
+    uint8_t status;        //One of the INKYC_EVTSTATUS_* constants
 } eventParsingDetails_t;
 
 
+//Occurrences of a recurring event that are excluded (EXDATE) - day numbers (see daysFromCivil()) for
+//all day events or epoch times, sorted so an occurrence can be looked up with a binary search
+typedef struct exDateSet
+{
+    int64_t values[INKYC_EVTPARSE_MAX_EXDATE_VALUES];
+    uint32_t numValues;
+} exDateSet_t;
+
+//What (as well as the days shown) decides which occurrences of a recurring event get entries
+typedef struct occurrenceFilter
+{
+    const exDateSet_t *pExDates;   //NULL if there aren't any
+    overrideIndex_t *pOverrides;   //Occurrences already replaced (and where to record ours) - can be NULL
+    uint32_t uidHash;              //\__ Of the recurring event
+    int32_t sequence;              ///
+} occurrenceFilter_t;
+
+
+//Properties (the name at the start of a content line) we use
+#define INKYC_PROP_OTHER          0
+#define INKYC_PROP_BEGIN          1
+#define INKYC_PROP_END            2
+#define INKYC_PROP_DESCRIPTION    3
+#define INKYC_PROP_DTSTART        4
+#define INKYC_PROP_DTEND          5
+#define INKYC_PROP_LOCATION       6
+#define INKYC_PROP_RRULE          7
+#define INKYC_PROP_SUMMARY        8
+#define INKYC_PROP_UID            9
+#define INKYC_PROP_SEQUENCE      10
+#define INKYC_PROP_RECURRENCEID  11
+#define INKYC_PROP_EXDATE        12
+#define INKYC_PROP_STATUS        13
+#define INKYC_PROP_TZID          14
+#define INKYC_PROP_TZOFFSETFROM  15
+#define INKYC_PROP_TZOFFSETTO    16
+
+typedef struct {
+    const char *name;
+    size_t nameLen;
+    uint32_t id;
+} propertyName_t;
+
+#define INKYC_PROPNAME(name, id) { name, sizeof(name) - 1, id }
+
+static const propertyName_t PropertyNames[] = {
+    INKYC_PROPNAME("BEGIN",         INKYC_PROP_BEGIN),
+    INKYC_PROPNAME("END",           INKYC_PROP_END),
+    INKYC_PROPNAME("DESCRIPTION",   INKYC_PROP_DESCRIPTION),
+    INKYC_PROPNAME("DTSTART",       INKYC_PROP_DTSTART),
+    INKYC_PROPNAME("DTEND",         INKYC_PROP_DTEND),
+    INKYC_PROPNAME("LOCATION",      INKYC_PROP_LOCATION),
+    INKYC_PROPNAME("RRULE",         INKYC_PROP_RRULE),
+    INKYC_PROPNAME("SUMMARY",       INKYC_PROP_SUMMARY),
+    INKYC_PROPNAME("UID",           INKYC_PROP_UID),
+    INKYC_PROPNAME("SEQUENCE",      INKYC_PROP_SEQUENCE),
+    INKYC_PROPNAME("RECURRENCE-ID", INKYC_PROP_RECURRENCEID),
+    INKYC_PROPNAME("EXDATE",        INKYC_PROP_EXDATE),
+    INKYC_PROPNAME("STATUS",        INKYC_PROP_STATUS),
+    INKYC_PROPNAME("TZID",          INKYC_PROP_TZID),
+    INKYC_PROPNAME("TZOFFSETFROM",  INKYC_PROP_TZOFFSETFROM),
+    INKYC_PROPNAME("TZOFFSETTO",    INKYC_PROP_TZOFFSETTO),
+};
+#define INKYC_NUM_PROPNAMES (sizeof(PropertyNames) / sizeof(PropertyNames[0]))
+
+//Hash table of PropertyNames: hashing the length and the first and last chars happens to give
+//the names in events their own slot (when two collide, e.g. the VTIMEZONE ones, the second goes in
+//the next free slot so it still works - just one more compare). Slots hold index+1 so 0 is empty
+#define INKYC_PROPINDEX_SLOTS 32  //Power of 2
+static uint8_t PropertyIndex[INKYC_PROPINDEX_SLOTS];
+static bool PropertyIndexBuilt = false;
+
+static inline uint32_t hashPropertyName(const char *name, size_t nameLen)
+{
+    return ((uint32_t)nameLen * 15 + (uint8_t)name[0] + (uint8_t)name[nameLen - 1]) & (INKYC_PROPINDEX_SLOTS - 1);
+}
+
+static void buildPropertyIndex()
+{
+    memset(PropertyIndex, 0, sizeof(PropertyIndex));
+
+    for (uint32_t i = 0; i < INKYC_NUM_PROPNAMES; i++)
+    {
+        uint32_t slot = hashPropertyName(PropertyNames[i].name, PropertyNames[i].nameLen);
+
+        while (PropertyIndex[slot] != 0)
+        {
+            slot = (slot + 1) & (INKYC_PROPINDEX_SLOTS - 1);
+        }
+        PropertyIndex[slot] = (uint8_t)(i + 1);
+    }
+    PropertyIndexBuilt = true;
+}
+
+//returns one of the INKYC_PROP_* constants
+static uint32_t lookupProperty(const char *name, size_t nameLen)
+{
+    if (!PropertyIndexBuilt)
+    {
+        buildPropertyIndex();
+    }
+    uint32_t slot = hashPropertyName(name, nameLen);
+
+    while (PropertyIndex[slot] != 0)
+    {
+        const propertyName_t *pProp = &PropertyNames[PropertyIndex[slot] - 1];
+
+        if (pProp->nameLen == nameLen && memcmp(pProp->name, name, nameLen) == 0)
+        {
+            return pProp->id;
+        }
+        slot = (slot + 1) & (INKYC_PROPINDEX_SLOTS - 1);
+    }
+    return INKYC_PROP_OTHER;
+}
+
+//Unfolds (removing line endings followed by a space or tab) and unescapes (\\n, \\\\, \\; and \\,) valueLen chars
+//of value into dest - truncating it if needed
+//returns chars put in dest (not including the '\0' added)
+size_t unfoldValue(const char *value, size_t valueLen, char *dest, size_t destSize)
+{
+    const char *src = value;
+    const char *end = value + valueLen;
+    size_t maxNonNullBytes = destSize - 1;
+    size_t destLen = 0;
+
+    while (src < end && destLen < maxNonNullBytes)
+    {
+        //Copy the run up to the next char we need to look at (or as much as fits)
+        const char *special = lineScanner_findSpecial(src);
+        size_t runLen = ((special < end) ? special : end) - src;
+
+        if (runLen > maxNonNullBytes - destLen)
+        {
+            runLen = maxNonNullBytes - destLen;
+        }
+        memcpy(dest + destLen, src, runLen);
+        destLen += runLen;
+        src += runLen;
+
+        if (src >= end || destLen >= maxNonNullBytes)
+        {
+            break;
+        }
+
+        switch(src[0])
+        {
+            case '\\':
+                if (src + 1 < end && src[1] == 'n')
+                {
+                    dest[destLen++] = '\n';
+                    src += 2;
+                }
+                else if (src + 1 < end && (src[1] == '\\' || src[1] == ';' || src[1] == ','))
+                {
+                    //Backslashes seem to escaped to \\ in some ical
+                    //; and , seem to be escaped as well
+                    dest[destLen++] = src[1];
+                    src += 2;
+                }
+                else
+                {
+                    //doesn't look like an escape sequence - treat as literal backslash
+                    dest[destLen++] = src[0];
+                    src++;
+                }
+                break;
+
+            case '\n':
+                //A fold - skip the line ending and the space or tab after it
+                src++;
+                if (src < end && (src[0] == ' ' || src[0] == '\t'))
+                {
+                    src++;
+                }
+                break;
+
+            default:
+                //'\r' - either part of a fold or a weird character we want to omit from diplayed anyway
+                src++;
+                break;
+        }
+    }
+    dest[destLen] = '\0';
+    return destLen;
+}
+
+//Copies span to dest as a string (unfolding it if needed, truncating if it doesn't fit)
+static size_t spanToString(const span_t *pSpan, char *dest, size_t destSize)
+{
+    if (pSpan->needsUnfold)
+    {
+        return unfoldValue(pSpan->start, pSpan->len, dest, destSize);
+    }
+    size_t len = (pSpan->len < destSize - 1) ? pSpan->len : destSize - 1;
+
+    if (len > 0)
+    {
+        memcpy(dest, pSpan->start, len);
+    }
+    dest[len] = '\0';
+    return len;
+}
+
+static bool spanEquals(const span_t *pSpan, const char *str)
+{
+    if (pSpan->needsUnfold)
+    {
+        char unfolded[INKYC_MAXBYTES_COMPONENT_END];
+        return (   spanToString(pSpan, unfolded, sizeof(unfolded)) < sizeof(unfolded) - 1
+                && strcmp(unfolded, str) == 0);
+    }
+    return pSpan->len == strlen(str) && memcmp(pSpan->start, str, pSpan->len) == 0;
+}
+
+//Skips any folds (a line ending then a space or tab) at pos
+static inline char *skipFolds(char *pos)
+{
+    for (;;)
+    {
+        if (pos[0] == '\r' && pos[1] == '\n' && (pos[2] == ' ' || pos[2] == '\t'))
+        {
+            pos += 3;
+        }
+        else if (pos[0] == '\n' && (pos[1] == ' ' || pos[1] == '\t'))
+        {
+            pos += 2;
+        }
+        else
+        {
+            return pos;
+        }
+    }
+}
+
+//Finds the end of the (possibly folded) content line that pos is in
+// output: *ppNext - start of the next line (or if the line isn't complete, where to carry on looking
+//                   for its end when there's more data - everything before that has been looked at)
+// output: *pNeedsUnfold - set if there are folds or escapes between pos and the end
+//returns the end (the line ending) or NULL if the line isn't complete in the buffer
+static char *findContentLineEnd(char *pos, char **ppNext, bool *pNeedsUnfold)
+{
+    for (;;)
+    {
+        char *special = (char *)lineScanner_findSpecial(pos);
+        char *lineEnd = special;
+        char *newline = special;
+
+        //If the line isn't complete, the line ending (or fold) here needs looking at again
+        *ppNext = special;
+
+        switch(special[0])
+        {
+            case '\0':
+                return NULL;
+
+            case '\\':
+                *pNeedsUnfold = true;
+                pos = special + 1;
+                continue;
+
+            case '\r':
+                if (special[1] != '\n')
+                {
+                    if (special[1] == '\0')
+                    {
+                        return NULL; //Might be a line ending
+                    }
+                    *pNeedsUnfold = true;
+                    pos = special + 1;
+                    continue;
+                }
+                newline = special + 1;
+                break;
+
+            default:
+                break;
+        }
+
+        if (newline[1] == '\0')
+        {
+            //D'oh - can't tell whether it would be a continuation line - don't have next char
+            return NULL;
+        }
+        else if (newline[1] == ' ' || newline[1] == '\t')
+        {
+            //Continuation line - keep going
+            *pNeedsUnfold = true;
+            pos = newline + 2;
+        }
+        else
+        {
+            *ppNext = newline + 1;
+            return lineEnd;
+        }
+    }
+}
+
+//A content line (name *(";" param) ":" value) in the receive buffer
+typedef struct {
+    uint32_t id;         //One of the INKYC_PROP_* constants
+    span_t params;       //";PARAM=x;PARAM=y" (len 0 if there are none)
+    span_t value;
+    char *next;          //Start of the next content line
+} contentLine_t;
+
+//Finds the end of the value of a content line (whose name, params and value start have been found)
+//looking from scanFrom - the value start, or where it got to last time if the line wasn't complete
+//returns 0 or INKYC_LINERC_INCOMPLETE_SRC (pLine->next is where to carry on looking from)
+static int32_t findContentLineValueEnd(contentLine_t *pLine, char *scanFrom)
+{
+    char *valueEnd = findContentLineEnd(scanFrom, &pLine->next, &pLine->value.needsUnfold);
+
+    if (valueEnd == NULL)
+    {
+        return INKYC_LINERC_INCOMPLETE_SRC;
+    }
+    pLine->value.len = valueEnd - pLine->value.start;
+    return 0;
+}
+
+//Finds the name, params and value of the content line starting at lineStart and looks up the name,
+//in one pass (without copying it)
+//returns 0, INKYC_LINERC_INCOMPLETE_SRC or INKYC_LINERC_NOT_CONTENT (pLine->next is still set). If the line
+//is incomplete, pLine->next is NULL unless its value can be carried on with (findContentLineValueEnd())
+static int32_t parseContentLine(char *lineStart, contentLine_t *pLine)
+{
+    char name[INKYC_MAXBYTES_PROPNAME];
+    size_t nameLen = 0;
+    char *pos = skipFolds(lineStart);
+
+    //Folds can be anywhere - even in the name
+    while (*pos != ';' && *pos != ':' && *pos != '\r' && *pos != '\n' && *pos != '\0')
+    {
+        if (nameLen < sizeof(name))
+        {
+            name[nameLen] = *pos;
+        }
+        nameLen++;
+        pos = skipFolds(pos + 1);
+    }
+
+    //Parameter values can be quoted - a ':' in quotes doesn't end them
+    bool quoted = false;
+
+    pLine->params.start = pos;
+    pLine->params.needsUnfold = false;
+
+    while ((quoted || *pos != ':') && *pos != '\r' && *pos != '\n' && *pos != '\0')
+    {
+        if (*pos == '"')
+        {
+            quoted = !quoted;
+        }
+        char *next = skipFolds(pos + 1);
+
+        if (next != pos + 1)
+        {
+            pLine->params.needsUnfold = true;
+        }
+        pos = next;
+    }
+    pLine->params.len = pos - pLine->params.start;
+
+    bool isContentLine = (*pos == ':' && nameLen > 0);
+
+    pLine->value.start = isContentLine ? pos + 1 : pos;
+    pLine->value.needsUnfold = false;
+    pLine->id = (isContentLine && nameLen <= sizeof(name)) ? lookupProperty(name, nameLen) : INKYC_PROP_OTHER;
+
+    if (findContentLineValueEnd(pLine, pLine->value.start) != 0)
+    {
+        if (!isContentLine)
+        {
+            pLine->next = NULL;
+        }
+        return INKYC_LINERC_INCOMPLETE_SRC;
+    }
+    return isContentLine ? 0 : INKYC_LINERC_NOT_CONTENT;
+}
+
+//Finds the value of parameter paramName (e.g. "TZID") in pLine (without any quotes around it)
+//returns false if it isn't there
+static bool findParam(const contentLine_t *pLine, const char *paramName, span_t *pValue)
+{
+    char *pos = pLine->params.start;
+    char *paramsEnd = pLine->params.start + pLine->params.len;
+
+    while (pos < paramsEnd)
+    {
+        //pos is at the ';' before a param
+        const char *expected = paramName;
+
+        pos = skipFolds(pos + 1);
+        while (*expected != '\0' && pos < paramsEnd && *pos == *expected)
+        {
+            expected++;
+            pos = skipFolds(pos + 1);
+        }
+        bool matched = (*expected == '\0' && pos < paramsEnd && *pos == '=');
+
+        if (matched)
+        {
+            pos = skipFolds(pos + 1);
+            pValue->start = pos;
+            pValue->needsUnfold = false;
+        }
+
+        //On to the end of the param
+        bool quoted = false;
+
+        while (pos < paramsEnd && (quoted || *pos != ';'))
+        {
+            if (*pos == '"')
+            {
+                quoted = !quoted;
+            }
+            char *next = skipFolds(pos + 1);
+
+            if (next != pos + 1)
+            {
+                pValue->needsUnfold = true;
+            }
+            pos = next;
+        }
+
+        if (matched)
+        {
+            pValue->len = pos - pValue->start;
+
+            if (pValue->len >= 2 && pValue->start[0] == '"' && pValue->start[pValue->len - 1] == '"')
+            {
+                pValue->start++;
+                pValue->len -= 2;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+//DTSTART, DTEND and RECURRENCE-ID are e.g. DTSTART:20181127T193000Z, DTSTART;TZID=Europe/London:20181127T193000
+//or (all day) DTSTART;VALUE=DATE:20181127
+// output: *pTime or *pDate is set to the value (depending on VALUE=) and *pTimeZone (optional) to TZID=
+static void parseDateTimeProperty(const contentLine_t *pLine, span_t *pTime, span_t *pDate, span_t *pTimeZone)
+{
+    span_t paramValue;
+
+    if (findParam(pLine, "VALUE", &paramValue) && spanEquals(&paramValue, "DATE"))
+    {
+        *pDate = pLine->value;
+        return;
+    }
+    *pTime = pLine->value;
+
+    if (pTimeZone != NULL && findParam(pLine, "TZID", &paramValue))
+    {
+        *pTimeZone = paramValue;
+    }
+}
+
 uint64_t allEvents = 0;
 uint64_t allRelevantEvents = 0;
 
@@ -73,6 +556,161 @@ uint64_t allRelevantEvents = 0;
 static time_t CalendarStart; //First day of calendar is day containing this timestamp
 static uint32_t DaysRelevent;
 
+#define INKYC_SECS_PER_DAY 86400
+
+//Start (local midnight) and date of each day shown, and of the day after the last one - so events
+//can be put in a column with a binary search rather than comparing with each day
+#define INKYC_MAX_DAYS_RELEVANT 62
+
+static time_t DayStarts[INKYC_MAX_DAYS_RELEVANT + 1];
+static int DayYYYYMMDDs[INKYC_MAX_DAYS_RELEVANT + 1];
+static int32_t FirstDayNumber;  //Days since 1970 (see daysFromCivil()) of the first day shown
+
+//UTC offset (local time - UTC) around the days shown, so converting times to and from local time
+//doesn't need the C library (on the InkPlate it re-reads the TZ rules each call) for the events we're
+//interested in. Set up (with the C library) in setCalendarRange(). The offsets of the time zones
+//(VTIMEZONE) in a calendar are worked out for the same window
+#define INKYC_LOCALOFFSET_MARGIN_DAYS 31  //Days either side of the days shown
+
+static utcOffsets_t LocalOffsets;
+
+
+//Days since 1970-01-01 of the day containing secs (rounding down for times before 1970)
+static inline int32_t daysFromSecs(int64_t secs)
+{
+    return (int32_t)((secs >= 0 ? secs : secs - (INKYC_SECS_PER_DAY - 1)) / INKYC_SECS_PER_DAY);
+}
+
+//Local time - UTC (in seconds) at utcTime according to the C library
+static int32_t libcUtcOffset(time_t utcTime)
+{
+    struct tm localTm;
+    localtime_r(&utcTime, &localTm);
+
+    int64_t localSecs = (int64_t)daysFromCivil(localTm.tm_year + 1900, localTm.tm_mon + 1, localTm.tm_mday) * INKYC_SECS_PER_DAY
+                       + localTm.tm_hour * 3600 + localTm.tm_min * 60 + localTm.tm_sec;
+
+    return (int32_t)(localSecs - utcTime);
+}
+
+//Works out (with the C library) when the UTC offset changes in the window around the days shown
+static void buildLocalOffsets()
+{
+    utcOffsets_t *pTable = &LocalOffsets;
+
+    pTable->windowStart = CalendarStart - (time_t)INKYC_LOCALOFFSET_MARGIN_DAYS * INKYC_SECS_PER_DAY;
+    pTable->windowEnd   = CalendarStart + (time_t)(DaysRelevent + INKYC_LOCALOFFSET_MARGIN_DAYS) * INKYC_SECS_PER_DAY;
+    pTable->from[0]     = pTable->windowStart;
+    pTable->offsets[0]  = libcUtcOffset(pTable->windowStart);
+    pTable->numOffsets  = 1;
+
+    time_t checked = pTable->windowStart; //Offset is known to be the last in the table up to here
+
+    while (checked < pTable->windowEnd)
+    {
+        time_t next = checked + INKYC_SECS_PER_DAY;
+        int32_t currOffset = pTable->offsets[pTable->numOffsets - 1];
+
+        if (next > pTable->windowEnd)
+        {
+            next = pTable->windowEnd;
+        }
+
+        if (libcUtcOffset(next) == currOffset)
+        {
+            checked = next;
+            continue;
+        }
+
+        //Clocks changed during the day - find the second they changed
+        time_t before = checked;
+        time_t after  = next;
+
+        while (after - before > 1)
+        {
+            time_t mid = before + (after - before) / 2;
+
+            if (libcUtcOffset(mid) == currOffset)
+            {
+                before = mid;
+            }
+            else
+            {
+                after = mid;
+            }
+        }
+
+        if (pTable->numOffsets >= TIMEZONES_MAX_OFFSETS)
+        {
+            //Not seen in any real timezone - the C library will be used after here
+            LogSerial_Unusual("UTC offset changes more than %d times around the days shown", TIMEZONES_MAX_OFFSETS - 1);
+            pTable->windowEnd = after;
+            break;
+        }
+        pTable->from[pTable->numOffsets]    = after;
+        pTable->offsets[pTable->numOffsets] = libcUtcOffset(after);
+        pTable->numOffsets++;
+        checked = after;
+    }
+}
+
+//Local time - UTC (in seconds) at utcTime from the table built by buildLocalOffsets()
+//returns false if utcTime isn't in the window the table covers
+static inline bool localOffsetAt(time_t utcTime, int32_t *pOffset)
+{
+    return utcOffsets_offsetAt(&LocalOffsets, utcTime, pOffset);
+}
+
+//As mktime() with tm_isdst = -1 - converts a local date and time (day/hour etc. can be outside
+//their usual range, as mktime() normalises them) to epoch time
+static time_t localTimeToEpoch(int32_t year, uint32_t month, int32_t day, int32_t hour, int32_t min, int32_t sec)
+{
+    int64_t localSecs = (int64_t)daysFromCivil(year, month, day) * INKYC_SECS_PER_DAY + hour * 3600 + min * 60 + sec;
+    const utcOffsets_t *pTable = &LocalOffsets;
+    time_t epochTime;
+    uint32_t found = utcOffsets_localToUtc(pTable, localSecs, &epochTime);
+
+    //Only trust one answer well inside the window - near the edge another could be just outside it
+    if (   found == UTCOFFSETS_LOCAL_ONE
+        && epochTime >= pTable->windowStart + INKYC_SECS_PER_DAY
+        && epochTime <  pTable->windowEnd   - INKYC_SECS_PER_DAY)
+    {
+        return epochTime;
+    }
+
+    //Outside the window, or the hour that doesn't exist/happens twice when the clocks change -
+    //let the C library decide
+    struct tm ltm = {0};
+    ltm.tm_year  = year - 1900;
+    ltm.tm_mon   = (int)month - 1;
+    ltm.tm_mday  = day;
+    ltm.tm_hour  = hour;
+    ltm.tm_min   = min;
+    ltm.tm_sec   = sec;
+    ltm.tm_isdst = -1; //Figure out whether DST is in operation
+
+    return mktime(&ltm);
+}
+
+//Times in UTC - for TZIDs that mean it that a calendar might not have a VTIMEZONE for. It covers no
+//time, so the offset "at the nearest end" (0) is used for any time
+static const utcOffsets_t UtcOffsets = { 0, 0, 1, {0}, {0} };
+
+//As localTimeToEpoch() for a time in a time zone from a VTIMEZONE (local time if pZone is NULL)
+static time_t zoneTimeToEpoch(const utcOffsets_t *pZone,
+                              int32_t year, uint32_t month, int32_t day, int32_t hour, int32_t min, int32_t sec)
+{
+    if (pZone == NULL)
+    {
+        return localTimeToEpoch(year, month, day, hour, min, sec);
+    }
+    int64_t zoneSecs = (int64_t)daysFromCivil(year, month, day) * INKYC_SECS_PER_DAY + hour * 3600 + min * 60 + sec;
+    time_t epochTime;
+
+    //Outside the window the offset at the nearest end is close enough - no events there are shown
+    utcOffsets_localToUtc(pZone, zoneSecs, &epochTime);
+    return epochTime;
+}
 
 //Sets the time period to find events for
 // input: calendarStart (epoch time) - indicates the first day 
@@ -81,8 +719,81 @@ static uint32_t DaysRelevent;
 // input: numDays - number of days including the first day that events are relevant for
 void setCalendarRange(time_t calendar_start, uint32_t numDays)
 {
+    if (numDays > INKYC_MAX_DAYS_RELEVANT)
+    {
+        LogSerial_Error("setCalendarRange: Can't show %" PRIu32 " days - showing %d", numDays, INKYC_MAX_DAYS_RELEVANT);
+        logProblem(INKY_SEVERITY_ERROR);
+        numDays = INKYC_MAX_DAYS_RELEVANT;
+    }
     CalendarStart = calendar_start;
     DaysRelevent = numDays;
+
+    buildLocalOffsets();
+
+    //mktime() would keep the time of day (so the date) adding days to CalendarStart
+    int32_t firstDay = daysFromSecs((int64_t)CalendarStart + libcUtcOffset(CalendarStart));
+    FirstDayNumber = firstDay;
+
+    for (uint32_t daynum = 0; daynum <= DaysRelevent; daynum++)
+    {
+        int32_t year;
+        uint32_t month, day;
+
+        civilFromDays(firstDay + (int32_t)daynum, &year, &month, &day);
+        DayYYYYMMDDs[daynum] = (int)(year * 10000 + month * 100 + day);
+        DayStarts[daynum]    = localTimeToEpoch(year, month, day, 0, 0, 0);
+    }
+}
+
+//Which day shown (0 for the first) contains time
+//returns -1 if none do
+static int32_t findDayIndex(time_t time)
+{
+    if (time < DayStarts[0] || time >= DayStarts[DaysRelevent])
+    {
+        return -1;
+    }
+
+    //Last day starting at or before time
+    uint32_t low  = 0;
+    uint32_t high = DaysRelevent - 1;
+
+    while (low < high)
+    {
+        uint32_t mid = (low + high + 1) / 2;
+
+        if (DayStarts[mid] <= time)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return (int32_t)low;
+}
+
+//First day shown with a date on or after dayYYYYMMDD (DaysRelevent if none are)
+static uint32_t findFirstDayFrom(int dayYYYYMMDD)
+{
+    uint32_t low  = 0;
+    uint32_t high = DaysRelevent;
+
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
+
+        if (DayYYYYMMDDs[mid] < dayYYYYMMDD)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
 }
 
 // Adds days days, weeks, months or years to a time_t in local timezone
@@ -184,948 +895,1196 @@ uint32_t  getTimeStringNow(char *buffer, size_t maxlen)
     return strftime(buffer, maxlen, "%Y-%m-%d %H:%M", &now_tm);
 }
 
+//Reads numDigits decimal digits from str
+//returns false if they aren't all digits
+static bool parseDigits(const char *str, uint32_t numDigits, int32_t *pValue)
+{
+    int32_t value = 0;
+
+    for (uint32_t i = 0; i < numDigits; i++)
+    {
+        if (str[i] < '0' || str[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (str[i] - '0');
+    }
+    *pValue = value;
+    return true;
+}
+
+//A time ending in Z is UTC, otherwise it's in the time zone pZone (local time if it's NULL)
+//returns -1 if the time can't be parsed
+static time_t convertZonedTimeToEpoch(const char *strYYYYMMDDTHHMMSSZ, const utcOffsets_t *pZone)
+{
+    const char *str = strYYYYMMDDTHHMMSSZ;
+    int32_t year, month, day, hour, min, sec;
+
+    if (   !parseDigits(str, 4, &year) || !parseDigits(str + 4, 2, &month) || !parseDigits(str + 6, 2, &day)
+        || str[8] != 'T'
+        || !parseDigits(str + 9, 2, &hour) || !parseDigits(str + 11, 2, &min) || !parseDigits(str + 13, 2, &sec)
+        || month < 1 || month > 12)
+    {
+        LogSerial_Unusual("Can't parse time: %.20s", str);
+        return (time_t)-1;
+    }
+
+    if (str[15] == 'Z')
+    {
+        return (time_t)((int64_t)daysFromCivil(year, month, day) * INKYC_SECS_PER_DAY + hour * 3600 + min * 60 + sec);
+    }
+    return zoneTimeToEpoch(pZone, year, month, day, hour, min, sec);
+}
+
 //used in getToFrom
+//A time ending in Z is UTC, otherwise it's local time
+//returns -1 if the time can't be parsed
 time_t convertYYYYMMDDTHHMMSSZtoEpochTime(const char *strYYYYMMDDTHHMMSSZ)
 {
-    struct tm ltm = {0};
-    char temp[40];
+    return convertZonedTimeToEpoch(strYYYYMMDDTHHMMSSZ, NULL);
+}
 
-    //Creating in "temp" (a version of time in a form strptime accepts)
-    strncpy(temp, strYYYYMMDDTHHMMSSZ, 16);
-    temp[16] = 0;
-    LogSerial_Verbose5("Parsing from: %s", temp);
+//A date as the start of the day it's on
+//returns the start (local midnight) of the day or -1 if it can't be parsed
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD)
+{
+    int32_t year, month, day;
 
-    // https://github.com/esp8266/Arduino/issues/5141, quickfix
-    memmove(temp + 5, temp + 4, 16);
-    memmove(temp + 8, temp + 7, 16);
-    memmove(temp + 14, temp + 13, 16);
-    memmove(temp + 16, temp + 15, 16);
-    temp[4] = temp[7] = temp[13] = temp[16] = '-';
+    if (   !parseDigits(dayYYYYMMDD, 4, &year) || !parseDigits(dayYYYYMMDD + 4, 2, &month)
+        || !parseDigits(dayYYYYMMDD + 6, 2, &day) || month < 1 || month > 12)
+    {
+        LogSerial_Unusual("Can't parse date: %.10s", dayYYYYMMDD);
+        return (time_t)-1;
+    }
+    return localTimeToEpoch(year, month, day, 0, 0, 0);
+}
 
-    strptime(temp, "%Y-%m-%dT%H-%M-%SZ", &ltm);
-    ltm.tm_isdst = -1; //Figure out whether DST is in operation
+int convertEpochTimeToYYYYMMDD(time_t inputTime)
+{
+    int32_t offset;
+
+    if (!localOffsetAt(inputTime, &offset))
+    {
+        offset = libcUtcOffset(inputTime);
+    }
+
+    int32_t year;
+    uint32_t month, day;
+    civilFromDays(daysFromSecs((int64_t)inputTime + offset), &year, &month, &day);
+
+    return (int)(year * 10000 + month * 100 + day);
+}
+
+//Puts the local time of day of inputTime in timeStr as HH:MM (not '\0' terminated - as asctime() gives it)
+static void formatLocalHHMM(time_t inputTime, char *timeStr)
+{
+    int32_t offset;
+
+    if (!localOffsetAt(inputTime, &offset))
+    {
+        offset = libcUtcOffset(inputTime);
+    }
+    int64_t localSecs = (int64_t)inputTime + offset;
+    uint32_t secsOfDay = (uint32_t)(localSecs - (int64_t)daysFromSecs(localSecs) * INKYC_SECS_PER_DAY);
+    uint32_t hour = secsOfDay / 3600;
+    uint32_t min  = (secsOfDay / 60) % 60;
+
+    timeStr[0] = '0' + hour / 10;
+    timeStr[1] = '0' + hour % 10;
+    timeStr[2] = ':';
+    timeStr[3] = '0' + min / 10;
+    timeStr[4] = '0' + min % 10;
+}
+
+static int getYYYYMMDDInt4FirstDay()
+{
+    return DayYYYYMMDDs[0];
+}
+
+//Day after the last day shown
+static int getYYYYMMDDInt4LastDay()
+{
+    return DayYYYYMMDDs[DaysRelevent];
+}
 
-    time_t epochtime = mktime(&ltm);
+int getCalendarFirstDayYYYYMMDD()
+{
+    return getYYYYMMDDInt4FirstDay();
+}
+
+uint32_t getCalendarNumDays()
+{
+    return DaysRelevent;
+}
 
-    return epochtime;
+// Format event times - converting to timezone offset
+// input: from - start time for event in YYYYMMDDTHHMMSSZ e.g. 19970901T130000Z
+// input: to   - end time for event in YYYYMMDDTHHMMSSZ e.g. 19970901T130000Z
+// output: timestr - time string for event e.g. "14:00-16:00"  (if day is relevant)
+// output: day - which calendar day event matches 0 - for first day -1 for not relevant
+// output: timestamp - event start in epoch time (if day is relevant)
+//
+// 
+//As getTimeString() for times already converted to epoch times (e.g. an occurrence of a recurring event)
+static void getTimeStringEpoch(char *timestr, time_t from_epochtime, time_t to_epochtime, int8_t *day, time_t *timeStamp)
+{
+    //if first day after eventend... can skip
+    if (to_epochtime < DayStarts[0])
+    {
+        LogSerial_Verbose4("Skipping getting timestring as end of event is only %" PRId64, (int64_t)to_epochtime);
+        *day = -1;    // event not in date range we are showing, don't display  
+        return;
+    }
+
+    //Which column (if any) the start is in
+    *day = (int8_t)findDayIndex(from_epochtime);
+
+    if (*day < 0)
+    {
+        LogSerial_Verbose4("Skipping getting timestring as start of event isn't a day shown: %" PRId64, (int64_t)from_epochtime);
+        return;
+    }
+
+    //If we got here - this is a relevant event
+    formatLocalHHMM(from_epochtime, timestr);
+    timestr[5] = '-';
+    formatLocalHHMM(to_epochtime, timestr + 6);
+    timestr[11] = 0;
+
+    *timeStamp = from_epochtime;
+
+    LogSerial_Verbose2("<<< getTimeString Chosen day %" PRId8, *day);
+}
+
+void getTimeString(char *timestr, char *from, char *to, int8_t *day, time_t *timeStamp)
+{
+    LogSerial_Verbose2(">>> getTimeString (will cpy from addresses %ld and %ld)", from, to);
+
+    getTimeStringEpoch(timestr, convertYYYYMMDDTHHMMSSZtoEpochTime(from), convertYYYYMMDDTHHMMSSZtoEpochTime(to),
+                       day, timeStamp);
+}
+
+//On entry to this function 
+//events[*pEventIndex] has details like colour filled in (summary, location etc. are filled in
+//afterwards, for relevant events)
+//if it's on a matching day we update pEventIndex to refer to the next (as yet unused) event.
+//If the event is multiple days long, we will duplicate the event and point pEventIndex
+//to after the last used event
+//
+
+// returns uint32_t: number of days included in entrylist
+uint32_t parseAllDayEventInstance(entry_t *pEvents, int *pEventIndex, int maxEvents, int dateStartInt, int dateEndInt)
+{
+    if (    dateStartInt < 20000101 || dateStartInt > 22000101 
+         || dateEndInt   < 20000101 || dateEndInt   > 22000101  )
+    {
+        LogSerial_Error("parseAllDayEvent: Event has dates out of range: start %d end %d",
+                                dateStartInt, dateEndInt);
+        logProblem(INKY_SEVERITY_ERROR);
+        return 0;
+    }
+
+    //if first day after eventend... can skip
+    if (getYYYYMMDDInt4FirstDay() > dateEndInt)
+    {
+        LogSerial_Verbose4("Skipping instance as end of instamce is only %d", dateEndInt);
+        return 0;
+    }
+    //if last day before eventstart....can skip
+    if (getYYYYMMDDInt4LastDay() < dateStartInt)
+    {
+        LogSerial_Verbose4("Skipping instance as start of instance is (calendar future): %d", dateEndInt);
+        return 0;
+    }
+
+    int relevantDays = 0;
+
+    //Only the days from the start of the event to its end (dateEnd is first date after event)
+    for (uint32_t daynum = findFirstDayFrom(dateStartInt);
+         daynum < DaysRelevent && DayYYYYMMDDs[daynum] < dateEndInt;
+         daynum++)
+    {
+        //We need to show this event in column daynum
+        LogSerial_Verbose3("parseAllDayEventInstance: Event is relevant for day %" PRIu32 " : start %d end %d",
+                          daynum, dateStartInt, dateEndInt);
+        relevantDays++;
+       
+        if (*pEventIndex < maxEvents - 1)
+        {
+            //Copy the partial event we are completing to the next slot (in case we need it for the next day)
+            //and complete the slot that we copied
+            memcpy(&pEvents[(*pEventIndex) + 1], &pEvents[*pEventIndex], sizeof(entry_t));
+            pEvents[(*pEventIndex)].day = daynum;
+            strcpy(pEvents[(*pEventIndex)].time, "");
+            pEvents[(*pEventIndex)].timeStamp = DayStarts[daynum]; //midnight at start of this day
+            
+            *pEventIndex = *pEventIndex + 1;
+        }
+        else
+        {
+            LogSerial_Error("parseAllDayEventInstance: Event (day %" PRIu32 " - start %d end %d) - No space in entry list!",
+                            daynum, dateStartInt, dateEndInt);
+            logProblem(INKY_SEVERITY_ERROR);
+        }
+    }
+
+    if (relevantDays > 0)
+    {
+        LogSerial_Verbose1("parseAllDayEventInstance: Event (start %d end %d) - relevant %d days",
+                                dateStartInt, dateEndInt, relevantDays);
+    }
+    else
+    {
+        LogSerial_Verbose2("parseAllDayEventInstance: Event (start %d end %d) - relevant %d days",
+                                dateStartInt, dateEndInt, relevantDays);
+    }
+
+    return relevantDays;
+}
+
+static int compareExDates(const void *a, const void *b)
+{
+    int64_t valueA = *(const int64_t *)a;
+    int64_t valueB = *(const int64_t *)b;
+
+    return (valueA > valueB) - (valueA < valueB);
+}
+
+//Collects the dates (for all day events) or times in the event's EXDATE lines (each can be a list)
+//(times are in the time zone pZone - local time if NULL - unless they end in Z)
+static void buildExDateSet(const eventParsingDetails_t *pEventDetails, bool allDay, const utcOffsets_t *pZone,
+                           exDateSet_t *pExDates)
+{
+    pExDates->numValues = 0;
+
+    for (uint32_t line = 0; line < pEventDetails->numExDates; line++)
+    {
+        char exDates[INKYC_EVTPARSE_MAXBYTES_EXDATES];
+        size_t exDatesLen = spanToString(&pEventDetails->exDates[line], exDates, sizeof(exDates));
+
+        if (exDatesLen == sizeof(exDates) - 1)
+        {
+            LogSerial_Unusual("EXDATE longer than %d chars - ignoring the rest: %.60s", (int)sizeof(exDates), exDates);
+        }
+
+        for (char *value = exDates; value < exDates + exDatesLen; )
+        {
+            char *valueEnd = strchr(value, ',');
+            if (valueEnd == NULL)
+            {
+                valueEnd = exDates + exDatesLen;
+            }
+            *valueEnd = '\0';
+
+            int32_t year, month, day;
+            bool valid =    parseDigits(value, 4, &year) && parseDigits(value + 4, 2, &month) && parseDigits(value + 6, 2, &day)
+                         && month >= 1 && month <= 12;
+            int64_t exDate = -1;
+
+            if (valid && allDay)
+            {
+                exDate = daysFromCivil(year, (uint32_t)month, day);
+            }
+            else if (valid && valueEnd - value >= 15)
+            {
+                exDate = convertZonedTimeToEpoch(value, pZone);
+            }
+
+            if (exDate == -1)
+            {
+                LogSerial_Unusual("Ignoring EXDATE %s (all day event: %d)", value, allDay);
+            }
+            else if (pExDates->numValues < INKYC_EVTPARSE_MAX_EXDATE_VALUES)
+            {
+                pExDates->values[pExDates->numValues++] = exDate;
+            }
+            else
+            {
+                LogSerial_Unusual("More than %d EXDATEs in an event - ignoring: %s", INKYC_EVTPARSE_MAX_EXDATE_VALUES, value);
+            }
+            value = valueEnd + 1;
+        }
+    }
+    qsort(pExDates->values, pExDates->numValues, sizeof(pExDates->values[0]), compareExDates);
 }
 
-//Used in initialiseRecurringAllDayEvent
-time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD)
+static bool isExDate(const exDateSet_t *pExDates, int64_t value)
 {
-    struct tm ltm = {0};
-    char temp[40];
-
-    //Creating in "temp" (a version of time in a form strptime accepts)
-    strncpy(temp, dayYYYYMMDD, 9);
-    temp[8] = 0;
-    LogSerial_Verbose5("Parsing from: %s", temp);
-
-    // https://github.com/esp8266/Arduino/issues/5141, quickfix
-    memmove(temp + 5, temp + 4, 16);
-    memmove(temp + 8, temp + 7, 16);
-    temp[4] = temp[7] = '-';
-
-    strptime(temp, "%Y-%m-%dT", &ltm);
-    ltm.tm_isdst = -1; //Figure out whether DST is in operation
+    if (pExDates == NULL)
+    {
+        return false;
+    }
+    uint32_t low = 0;
+    uint32_t high = pExDates->numValues;
 
-    time_t epochtime = mktime(&ltm);
+    while (low < high)
+    {
+        uint32_t mid = (low + high) / 2;
 
-    return epochtime;
+        if (pExDates->values[mid] < value)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low < pExDates->numValues && pExDates->values[low] == value;
 }
 
-int convertEpochTimeToYYYYMMDD(time_t inputTime)
+//Whether an occurrence of a recurring event is left out: it's excluded (EXDATE) or an event with its
+//RECURRENCE-ID (that replaces it) has already been parsed
+static bool skipOccurrence(const occurrenceFilter_t *pFilter, int64_t instance)
 {
-    char temp[10];
+    if (pFilter == NULL)
+    {
+        return false;
+    }
 
-    struct tm day_tm;
-    localtime_r(&inputTime, &day_tm);
-    
-    strftime(temp, 9, "%Y%m%d", &day_tm);
-    long day = strtol(temp, NULL, 10);
+    if (isExDate(pFilter->pExDates, instance))
+    {
+        LogSerial_Verbose4("Skipping occurrence %" PRId64 " (EXDATE)", instance);
+        return true;
+    }
 
-    return (int)day;
+    if (   pFilter->pOverrides != NULL
+        && overrideIndex_find(pFilter->pOverrides, pFilter->uidHash, instance) != NULL)
+    {
+        LogSerial_Verbose2("Skipping occurrence %" PRId64 " (already have it or an event replacing it)", instance);
+        return true;
+    }
+    return false;
 }
 
-static int getYYYYMMDDInt4FirstDay()
+//Remembers which entries an occurrence of a recurring event got, so an event with its RECURRENCE-ID
+//later in the calendar can replace them
+static void recordOccurrence(const occurrenceFilter_t *pFilter, int64_t instance, int firstEntry, int numEntries)
 {
-    return convertEpochTimeToYYYYMMDD(CalendarStart);
+    if (pFilter == NULL || pFilter->pOverrides == NULL || numEntries == 0)
+    {
+        return;
+    }
+    overrideRecord_t *pRecord = overrideIndex_add(pFilter->pOverrides, pFilter->uidHash, instance,
+                                                  OVERRIDEINDEX_KIND_GENERATED, pFilter->sequence);
+    if (pRecord != NULL)
+    {
+        pRecord->firstEntry = (int16_t)firstEntry;
+        pRecord->numEntries = (int16_t)numEntries;
+    }
 }
 
-static int getYYYYMMDDInt4LastDay()
+//Last day shown as a day number (see daysFromCivil())
+static inline int32_t getLastDayNumber()
 {
-    struct tm timeinfo;
-    localtime_r(&CalendarStart, &timeinfo);
- 
-    timeinfo.tm_isdst = -1; //dst active is based on tz info
-    timeinfo.tm_mday += DaysRelevent;       
-    
-    time_t lastdayepochtime = mktime(&timeinfo);
-
-    return convertEpochTimeToYYYYMMDD(lastdayepochtime);
+    return FirstDayNumber + (int32_t)DaysRelevent - 1;
 }
 
-bool initialiseRecurringAllDayEvent(recurringEventInfo_t *toinit,
-                                    const char *recurrenceRule,
-                                    const char *dayStartYYYYMMDD,
-                                    const char *dayEndYYYYMMDD)
-{
-    memset(toinit, 0, sizeof(recurringEventInfo_t));
+//pFilter can be NULL (no EXDATEs and occurrences aren't recorded)
+uint32_t parseAllDayEvent(entry_t *pEvents, int *pEventIndex, int maxEvents, char *dateStart, char *dateEnd,
+                          char *recurRule, const occurrenceFilter_t *pFilter)
+{   
+    uint32_t relevantDays = 0;
+    uint32_t eventInstances = 0;
+
+    if (recurRule != NULL && recurRule[0] != '\0')
+    {
+        recurRule_t rule;
+        int32_t startYear, startMonth, startDayOfMonth, endYear, endMonth, endDayOfMonth;
+
+        if (   !compileRecurRule(recurRule, strlen(recurRule), &rule)
+            || !parseDigits(dateStart, 4, &startYear) || !parseDigits(dateStart + 4, 2, &startMonth)
+            || !parseDigits(dateStart + 6, 2, &startDayOfMonth) || startMonth < 1 || startMonth > 12
+            || !parseDigits(dateEnd, 4, &endYear) || !parseDigits(dateEnd + 4, 2, &endMonth)
+            || !parseDigits(dateEnd + 6, 2, &endDayOfMonth) || endMonth < 1 || endMonth > 12)
+        {
+            LogSerial_Error("Failed to parse event (start %.8s end %.8s) with recur rule: %s", dateStart, dateEnd, recurRule);
+            logProblem(INKY_SEVERITY_ERROR);
+            return 0;
+        }
+        int32_t startDay = daysFromCivil(startYear, (uint32_t)startMonth, startDayOfMonth);
+        int32_t durationDays = daysFromCivil(endYear, (uint32_t)endMonth, endDayOfMonth) - startDay;
 
-    toinit->initialStart = convertYYYYMMDDtoEpochTime(dayStartYYYYMMDD);
-    toinit->initialEnd   = convertYYYYMMDDtoEpochTime(dayEndYYYYMMDD);
+        //Only occurrences that are still going on the first day shown (jumping straight to them
+        //rather than stepping through the ones since DTSTART)
+        recurIterator_t iter;
+        int32_t occurrenceDay;
 
-    //Parse recurrence rule. Example rule:
-    //RRULE:FREQ=WEEKLY;WKST=MO;COUNT=26;INTERVAL=2;BYDAY=FR
-    bool freqValid = false;
+        recurIterator_init(&iter, &rule, startDay, FirstDayNumber - durationDays, getLastDayNumber());
 
-    const char *dailyindicator = strstr(recurrenceRule, "FREQ=DAILY");
+        while (recurIterator_next(&iter, &occurrenceDay))
+        {
+            if (skipOccurrence(pFilter, occurrenceDay))
+            {
+                continue;
+            }
+            int32_t year;
+            uint32_t month, day;
 
-    if (dailyindicator != NULL)
-    {
-        toinit->recurrenceType = INKYC_ADDTIME_DAYS;
-        freqValid = true;     
-    }
+            civilFromDays(occurrenceDay, &year, &month, &day);
+            int occurrenceStartInt = year * 10000 + month * 100 + day;
 
-    if (!freqValid)
-    {
-        const char *weeklyindicator = strstr(recurrenceRule, "FREQ=WEEKLY");
+            civilFromDays(occurrenceDay + durationDays, &year, &month, &day);
+            int occurrenceEndInt = year * 10000 + month * 100 + day;
 
-        if (weeklyindicator != NULL)
-        {
-            toinit->recurrenceType = INKYC_ADDTIME_WEEKS;
-            freqValid = true;     
+            int firstEntry = *pEventIndex;
+
+            eventInstances++;
+            relevantDays += parseAllDayEventInstance(pEvents, pEventIndex, maxEvents, 
+                                                     occurrenceStartInt, occurrenceEndInt);
+            recordOccurrence(pFilter, occurrenceDay, firstEntry, *pEventIndex - firstEntry);
         }
     }
-    
-     if (!freqValid)
+    else
     {
-        const char *monthlyindicator = strstr(recurrenceRule, "FREQ=MONTHLY");
+        //convert dateStart/dateEnd to ints 
+        //We could compare as strings - but this is easier to reason about and not performance sensitive
+        char temp[9];
+        strncpy(temp, dateStart, 8);
+        temp[8] = '\0';
+        int dateStartInt = (int)strtol(temp, NULL, 10);
 
-        if (monthlyindicator != NULL)
-        {
-            toinit->recurrenceType = INKYC_ADDTIME_MONTHS;
-            freqValid = true;     
-        }
+        strncpy(temp, dateEnd, 8);
+        temp[8] = '\0';    
+        int dateEndInt   = (int)strtol(dateEnd, NULL, 10);
+
+        eventInstances++;
+        relevantDays = parseAllDayEventInstance(pEvents, pEventIndex, maxEvents, dateStartInt, dateEndInt);
     }
 
-    if (!freqValid)
+    LogSerial_Verbose1("parseAllDayEvent: Event (%" PRIu32 " occurrences near the days shown based on start %.*s rule %s) - relevant %d days",
+                      eventInstances, 8, dateStart, (recurRule != NULL && recurRule[0] != '\0'? recurRule : "unset"), relevantDays);
+
+    return relevantDays;
+}
+
+//Timed events (timeStart/timeEnd as YYYYMMDDTHHMMSS with an optional Z) - an occurrence of a recurring
+//event is at the same time of day (in DTSTART's time zone, or UTC if DTSTART was) on each day the rule gives.
+//pStartZone/pEndZone are the time zones (TZID=) of DTSTART/DTEND - NULL for local time
+//pFilter can be NULL (no EXDATEs and occurrences aren't recorded)
+//returns number of entries (each an occurrence that starts on a day shown) added
+uint32_t parseTimedEvent(entry_t *pEvents, int *pEventIndex, int maxEvents, char *timeStart, char *timeEnd,
+                         const utcOffsets_t *pStartZone, const utcOffsets_t *pEndZone,
+                         char *recurRule, const occurrenceFilter_t *pFilter)
+{
+    uint32_t relevantOccurrences = 0;
+
+    if (recurRule == NULL || recurRule[0] == '\0')
     {
-        const char *yearlyindicator = strstr(recurrenceRule, "FREQ=YEARLY");
+        getTimeStringEpoch(pEvents[*pEventIndex].time,
+                           convertZonedTimeToEpoch(timeStart, pStartZone), convertZonedTimeToEpoch(timeEnd, pEndZone),
+                           &pEvents[*pEventIndex].day, &pEvents[*pEventIndex].timeStamp);
 
-        if (yearlyindicator != NULL)
+        LogSerial_Verbose1("Determined day to be: %" PRId8, pEvents[*pEventIndex].day);
+
+        if (pEvents[*pEventIndex].day >= 0)
         {
-            toinit->recurrenceType = INKYC_ADDTIME_YEARS;
-            freqValid = true;     
+            *pEventIndex = *pEventIndex + 1;
+            relevantOccurrences++;
         }
-    }
-   
-    if (!freqValid)
-    {
-        LogSerial_FatalError("Currently can only parse daily/weekly/monthly/yearly recurring event but got recur rule: %s",  recurrenceRule);
-        logProblem(INKY_SEVERITY_FATAL);        
-        return false; 
+        return relevantOccurrences;
     }
 
-    const char *countindicator = strstr(recurrenceRule, "COUNT=");
+    recurRule_t rule;
+    time_t start = convertZonedTimeToEpoch(timeStart, pStartZone);
+    time_t end = convertZonedTimeToEpoch(timeEnd, pEndZone);
+    int32_t year, month, day, hour, min, sec;
 
-    if (countindicator != NULL)
+    if (   !compileRecurRule(recurRule, strlen(recurRule), &rule) || start == -1 || end == -1
+        || !parseDigits(timeStart, 4, &year) || !parseDigits(timeStart + 4, 2, &month) || !parseDigits(timeStart + 6, 2, &day)
+        || !parseDigits(timeStart + 9, 2, &hour) || !parseDigits(timeStart + 11, 2, &min) || !parseDigits(timeStart + 13, 2, &sec))
+    {
+        LogSerial_Error("Failed to parse event (start %s end %s) with recur rule: %s", timeStart, timeEnd, recurRule);
+        logProblem(INKY_SEVERITY_ERROR);
+        return 0;
+    }
+    bool utc = (timeStart[15] == 'Z');
+    time_t duration = end - start;
+    bool hasUntil = (rule.untilDay != INT32_MAX);
+    time_t until = 0;
+
+    //The rule works in days - so the day of DTSTART (and UNTIL) in UTC or the time zone DTSTART is in.
+    //That can be a day either side of the day in local time (two for zones far from ours)
+    if (hasUntil)
     {
-        const char *countStrStart = countindicator + strlen("COUNT=");
-        const char *countStrEnd = strchr(countStrStart, ';');
-        size_t countStrLen = strlen(countStrStart);
+        int32_t untilYear;
+        uint32_t untilMonth, untilDayOfMonth;
+        int32_t untilSecsOfDay = (rule.untilSecsOfDay >= 0) ? rule.untilSecsOfDay : INKYC_SECS_PER_DAY - 1;
 
-        if (countStrEnd != NULL)
-        {
-            countStrLen = countStrEnd - countStrStart;
-        }
+        civilFromDays(rule.untilDay, &untilYear, &untilMonth, &untilDayOfMonth);
 
-        if (countStrLen > 15)
+        if (rule.untilUtc || (utc && rule.untilSecsOfDay < 0))
         {
-            LogSerial_FatalError("Parse recurring event failed - COUNT= value too large. recur rule: %s",  recurrenceRule);
-            logProblem(INKY_SEVERITY_FATAL);
-            return false; 
+            until = (time_t)rule.untilDay * INKYC_SECS_PER_DAY + untilSecsOfDay;
         }
-        char countTemp[16];
-        memcpy(countTemp, countStrStart, countStrLen);
-        countTemp[countStrLen] = '\0';
-
-        long countLong = strtol(countTemp, NULL, 10);
-
-        if(countLong <= 0 || countLong > 1000000L)
+        else
         {
-            LogSerial_FatalError("Parse recurring event failed - COUNT= value %ld out of range . recur rule: %s",  countLong, recurrenceRule);
-            logProblem(INKY_SEVERITY_FATAL);            
-            return false; 
+            until = zoneTimeToEpoch(pStartZone, untilYear, untilMonth, untilDayOfMonth, untilSecsOfDay / 3600,
+                                    (untilSecsOfDay / 60) % 60, untilSecsOfDay % 60);
         }
-        toinit->instancesRemaining = countLong;        
-    }
-    else
-    {
-      toinit->instancesRemaining = -1;
+        rule.untilDay++;
     }
 
-    const char *untilindicator = strstr(recurrenceRule, "UNTIL=");
+    recurIterator_t iter;
+    int32_t occurrenceDay;
+
+    recurIterator_init(&iter, &rule, daysFromCivil(year, (uint32_t)month, day), FirstDayNumber - 2, getLastDayNumber() + 2);
 
-    if (untilindicator != NULL)
+    while (recurIterator_next(&iter, &occurrenceDay))
     {
-        const char *untilStrStart = untilindicator + strlen("UNTIL=");
-        const char *untilStrEnd = strchr(untilStrStart, ';');
-        size_t untilStrLen = strlen(untilStrStart);
+        int32_t occurrenceYear;
+        uint32_t occurrenceMonth, occurrenceDayOfMonth;
+        time_t occurrenceStart;
 
-        if (untilStrEnd != NULL)
+        if (utc)
         {
-            untilStrLen = untilStrEnd - untilStrStart;
+            occurrenceStart = (time_t)occurrenceDay * INKYC_SECS_PER_DAY + hour * 3600 + min * 60 + sec;
         }
-
-        if (untilStrLen > 15)
+        else
         {
-            LogSerial_FatalError("Parse recurring event failed - UNTIL= value too long. recur rule: %s",  recurrenceRule);
-            logProblem(INKY_SEVERITY_FATAL);
-            return false; 
+            civilFromDays(occurrenceDay, &occurrenceYear, &occurrenceMonth, &occurrenceDayOfMonth);
+            occurrenceStart = zoneTimeToEpoch(pStartZone, occurrenceYear, occurrenceMonth, occurrenceDayOfMonth, hour, min, sec);
         }
-        char untilTemp[16];
-        memcpy(untilTemp, untilStrStart, untilStrLen);
-        untilTemp[untilStrLen] = '\0';
 
-        time_t untilEpoch = convertYYYYMMDDtoEpochTime(untilTemp);
+        if (hasUntil && occurrenceStart > until)
+        {
+            break;
+        }
 
-        if(untilEpoch <= 0)
+        if (skipOccurrence(pFilter, occurrenceStart))
         {
-            LogSerial_FatalError("Parse recurring event failed - UNTIL= value %" PRIu64 " out of range . recur rule: %s",  untilEpoch, recurrenceRule);
-            logProblem(INKY_SEVERITY_FATAL);
-            return false; 
+            continue;
         }
-        toinit->repeatUntil = untilEpoch;
-    }
-   
-    const char *intervalindicator = strstr(recurrenceRule, "INTERVAL=");
+        entry_t *pEvent = &pEvents[*pEventIndex];
 
-    if (intervalindicator != NULL)
-    {
-        const char *intervalStrStart = intervalindicator + strlen("INTERVAL=");
-        const char *intervalStrEnd = strchr(intervalStrStart, ';');
-        size_t intervalStrLen = strlen(intervalStrStart);
+        getTimeStringEpoch(pEvent->time, occurrenceStart, occurrenceStart + duration, &pEvent->day, &pEvent->timeStamp);
 
-        if (intervalStrEnd != NULL)
+        if (pEvent->day < 0)
         {
-            intervalStrLen = intervalStrEnd - intervalStrStart;
+            continue;
         }
+        relevantOccurrences++;
 
-        if (intervalStrLen > 15)
+        if (*pEventIndex < maxEvents - 1)
         {
-            LogSerial_FatalError("Parse recurring event failed - INTERVAL= value too large. recur rule: %s",  recurrenceRule);
-            logProblem(INKY_SEVERITY_FATAL);
-            return false; 
+            //Copy the partial event we are completing to the next slot (in case there's another occurrence)
+            memcpy(&pEvents[(*pEventIndex) + 1], pEvent, sizeof(entry_t));
+            recordOccurrence(pFilter, occurrenceStart, *pEventIndex, 1);
+            *pEventIndex = *pEventIndex + 1;
         }
-        char intervalTemp[16];
-        memcpy(intervalTemp, intervalStrStart, intervalStrLen);
-        intervalTemp[intervalStrLen] = '\0';
-
-        long intervalLong = strtol(intervalTemp, NULL, 10);
-
-        if(intervalLong <= 0 || intervalLong > 1000000L)
+        else
         {
-            LogSerial_FatalError("Parse recurring event failed - INTERVAL= value %ld out of range . recur rule: %s",  intervalLong, recurrenceRule);
-            logProblem(INKY_SEVERITY_FATAL);
-            return false; 
+            LogSerial_Error("parseTimedEvent: Occurrence (day %" PRId8 " start %s) - No space in entry list!",
+                            pEvent->day, timeStart);
+            logProblem(INKY_SEVERITY_ERROR);
+            break;
         }
-        toinit->recurrenceInterval = intervalLong;
-    }
-    else
-    {
-        LogSerial_Verbose4("recurrence rule did not contain INTERVAL= (got recur rule: %s) therefore defaulting to 1",  recurrenceRule);
-        toinit->recurrenceInterval = 1;
     }
 
-    return true;    
+    LogSerial_Verbose1("parseTimedEvent: Event (start %s rule %s) - %" PRIu32 " occurrences on days shown",
+                       timeStart, recurRule, relevantOccurrences);
+    return relevantOccurrences;
 }
 
-bool getNextOccurence(recurringEventInfo_t *recurInfo)
+//Is the (complete) line at lineStart e.g. "BEGIN:VEVENT"?
+static inline bool isLine(const char *lineStart, const char *line)
 {
-    bool foundOccurrence = false;
+    size_t lineLen = strlen(line);
+
+    return strncmp(lineStart, line, lineLen) == 0 && (lineStart[lineLen] == '\r' || lineStart[lineLen] == '\n');
+}
 
-    if (recurInfo->currentStartYYYYMMDDInt == 0)
+//Looks up a STATUS value
+static uint8_t parseEventStatus(const span_t *pValue)
+{
+    if (spanEquals(pValue, "CONFIRMED"))
     {
-        //First event
-        recurInfo->currentStart = recurInfo->initialStart;
-        recurInfo->currentEnd   = recurInfo->initialEnd;
-        foundOccurrence = true;
+        return INKYC_EVTSTATUS_CONFIRMED;
     }
-    else
+    else if (spanEquals(pValue, "TENTATIVE"))
     {
-        if (recurInfo->instancesRemaining != 0)
-        {
-            time_t timedelta = 0;
-
-            recurInfo->currentStart = addTime(recurInfo->currentStart, 
-                                              recurInfo->recurrenceInterval,
-                                              recurInfo->recurrenceType);
-
-            recurInfo->currentEnd   = addTime(recurInfo->currentEnd,
-                                              recurInfo->recurrenceInterval,
-                                              recurInfo->recurrenceType);
-
-            if (recurInfo->instancesRemaining > 0)
-            {
-                recurInfo->instancesRemaining --;
-            }
-
-            if (    recurInfo->repeatUntil == 0 
-                 || recurInfo->currentStart < recurInfo->repeatUntil)
-            {
-                foundOccurrence = true;
-            }
-        }
+        return INKYC_EVTSTATUS_TENTATIVE;
     }
-
-    if (foundOccurrence)
+    else if (spanEquals(pValue, "CANCELLED"))
     {
-        recurInfo->currentStartYYYYMMDDInt = convertEpochTimeToYYYYMMDD(recurInfo->currentStart);
-        recurInfo->currentEndYYYYMMDDInt = convertEpochTimeToYYYYMMDD(recurInfo->currentEnd);
+        return INKYC_EVTSTATUS_CANCELLED;
     }
-
-    return foundOccurrence;
+    return INKYC_EVTSTATUS_OTHER;
 }
 
-// Format event times - converting to timezone offset
-// input: from - start time for event in YYYYMMDDTHHMMSSZ e.g. 19970901T130000Z
-// input: to   - end time for event in YYYYMMDDTHHMMSSZ e.g. 19970901T130000Z
-// output: timestr - time string for event e.g. "14:00-16:00"  (if day is relevant)
-// output: day - which calendar day event matches 0 - for first day -1 for not relevant
-// output: timestamp - event start in epoch time (if day is relevant)
-//
-// 
-void getTimeString(char *timestr, char *from, char *to, int8_t *day, time_t *timeStamp)
+//Where findNextEventDetails() got to in an event that isn't all in the buffer yet, so when there's more
+//data it carries on from there rather than going through the event again. The event is kept in the
+//buffer (from its BEGIN:VEVENT line) so the spans found so far still point at it - but by the next call
+//it may have been moved (e.g. to the start of the buffer), so they're moved with it
+typedef struct eventParserState
 {
-    struct tm ltm = {0};
-    char temp[128];
+    bool inEvent;                 //Past the BEGIN:VEVENT of an event that isn't finished
+    char *eventStart;             //Where the event was in the buffer when we stopped
+    size_t lineOffset;            //Line we stopped at (from the start of the event)
+    bool linePartlyParsed;        //If the line's value was started on...
+    contentLine_t partialLine;    //...its name, params and value so far (next is where to carry on)
+    char componentEnd[INKYC_MAXBYTES_COMPONENT_END]; //e.g. "END:VALARM" whilst skipping a component in the event
+    eventParsingDetails_t details;
+} eventParserState_t;
+
+//The data a span points into has moved from oldStart to newStart
+static inline void moveSpan(span_t *pSpan, const char *oldStart, char *newStart)
+{
+    if (pSpan->start != NULL)
+    {
+        pSpan->start = newStart + (pSpan->start - oldStart);
+    }
+}
 
-    LogSerial_Verbose2(">>> getTimeString (will cpy from addresses %ld and %ld)", from, to);
+//The event pState was part way through is now at newStart
+static void moveParserState(eventParserState_t *pState, char *newStart)
+{
+    const char *oldStart = pState->eventStart;
+    eventParsingDetails_t *pDetails = &pState->details;
+    span_t *spans[] = { &pDetails->summary, &pDetails->location, &pDetails->description, &pDetails->timeStart,
+                        &pDetails->timeEnd, &pDetails->dateStart, &pDetails->dateEnd, &pDetails->timeZone,
+                        &pDetails->timeZoneEnd, &pDetails->recurRule, &pDetails->uid, &pDetails->recurrenceId };
 
-    //if first day after eventend... can skip
-    time_t to_epochtime = convertYYYYMMDDTHHMMSSZtoEpochTime(to);
-    int toDateInt = convertEpochTimeToYYYYMMDD(to_epochtime);
-    if (getYYYYMMDDInt4FirstDay() > toDateInt)
+    for (uint32_t i = 0; i < sizeof(spans) / sizeof(spans[0]); i++)
     {
-        LogSerial_Verbose4("Skipping getting timestring as end of event is only %d", toDateInt);
-        *day = -1;    // event not in date range we are showing, don't display  
-        return;
+        moveSpan(spans[i], oldStart, newStart);
     }
 
-    //if last day before eventstart....can skip
-    time_t from_epochtime = convertYYYYMMDDTHHMMSSZtoEpochTime(from);
-    int fromDateInt = convertEpochTimeToYYYYMMDD(from_epochtime);
-    if (getYYYYMMDDInt4LastDay() < fromDateInt)
+    for (uint32_t i = 0; i < pDetails->numExDates; i++)
     {
-        LogSerial_Verbose4("Skipping getting timestring as start of event is (calendar future): %d", fromDateInt);
-        *day = -1;    // event not in date range we are showing, don't display  
-        return;
+        moveSpan(&pDetails->exDates[i], oldStart, newStart);
     }
 
+    if (pState->linePartlyParsed)
+    {
+        contentLine_t *pLine = &pState->partialLine;
 
-    //If we got here - this looks like a relevant event
-    struct tm from_tm_local;
-    localtime_r(&from_epochtime, &from_tm_local);
-    from_tm_local.tm_isdst = -1;
-
-    strncpy(timestr, asctime(&from_tm_local) + 11, 5);
-
-    timestr[5] = '-';
-
-    
-    struct tm to_tm_local;
-    localtime_r(&to_epochtime, &to_tm_local);
-    to_tm_local.tm_isdst = -1;
-    strncpy(timestr + 6, asctime(&to_tm_local) + 11, 5);
+        moveSpan(&pLine->params, oldStart, newStart);
+        moveSpan(&pLine->value, oldStart, newStart);
+        pLine->next = newStart + (pLine->next - oldStart);
+    }
+    pState->eventStart = newStart;
+}
 
-    timestr[11] = 0;
+//Finds where the details of the next event are in the buffer (nothing is copied - the spans
+//in pState->details point into the buffer so are only valid until more data is read into it)
+//If the event isn't all in the buffer, where it got to is kept in *pState and it carries on from
+//there next time (when *ppUnparsedData must be the event's data, with more after it) - so each
+//line of an event is only looked at once however the calendar arrives
+//returns 0 if found all the details for event (pState->details)
+//returns INKYC_LINERC_INCOMPLETE_SRC if event details are not complete (on return *ppUnparsedData is moved
+//to the start of the event - or if it isn't in an event, the last line: there's nothing before that to parse)
+//returns INKYC_LINERC_TIMEZONE if there's a VTIMEZONE before the next event (*ppUnparsedData is moved to it)
+int32_t findNextEventDetails(char **ppUnparsedData, eventParserState_t *pState)
+{
+    char *currPos;
 
-    *timeStamp = from_epochtime;
+    if (!pState->inEvent)
+    {
+        //Jump straight to the next event (just looking at the start of each line) - the only thing we use
+        //outside them is VTIMEZONE
+        char *lineStart = *ppUnparsedData;
+        char *lineEnd;
 
-    char eventDateString[16];
-    getDateString(eventDateString, &from_tm_local, true);
+        for (;;)
+        {
+            lineEnd = (char *)lineScanner_findLineEnd(lineStart);
 
-    bool matchedDay= false;
+            if (*lineEnd == '\0')
+            {
+                //There's no need to keep any of this data but the last (incomplete) line
+                *ppUnparsedData = lineStart;
+                return INKYC_LINERC_INCOMPLETE_SRC;
+            }
+            else if (isLine(lineStart, "BEGIN:VEVENT"))
+            {
+                break;
+            }
+            else if (isLine(lineStart, "BEGIN:VTIMEZONE"))
+            {
+                *ppUnparsedData = lineStart;
+                return INKYC_LINERC_TIMEZONE;
+            }
+            lineStart = lineEnd + 1;
+        }
+        memset(pState, 0, sizeof(eventParserState_t));
+        pState->inEvent = true;
+        pState->eventStart = lineStart;
+        *ppUnparsedData = lineStart;
 
-    for (int daynum = 0; daynum < DaysRelevent; daynum++)
+        //Move past the BEGIN:VEVENT
+        currPos = lineEnd + 1;
+    }
+    else
     {
-        char dayDateString[16];
-        getDateStringOffsetDays(dayDateString, daynum, true);
-
-        if (strcmp(eventDateString, dayDateString) == 0)
+        if (*ppUnparsedData != pState->eventStart)
         {
-            matchedDay = true;
-            *day = daynum;
+            moveParserState(pState, *ppUnparsedData);
         }
+        currPos = *ppUnparsedData + pState->lineOffset;
     }
+    eventParsingDetails_t *pEventDetails = &pState->details;
+
+    bool foundEventEnd = false;
 
-    if (!matchedDay)
+    while (!foundEventEnd)
     {
-        *day = -1;    // event not in date range we are showing, don't display  
-    }
-    LogSerial_Verbose2("<<< getTimeString Chosen day %" PRId8, *day);
-}
+        if (pState->componentEnd[0] != '\0')
+        {
+            //In a component in the event (e.g. VALARM) - nothing in it is about the event itself
+            //so skip to its END without parsing its lines
+            char *lineEnd = (char *)lineScanner_findLineEnd(currPos);
 
-//On entry to this function 
-//events[*pEventIndex] has details like summary, location filled in
-//if it's on a matching day we update pEventIndex to refer to the next (as yet unused) event.
-//If the event is multiple days long, we will duplicate the event and point pEventIndex
-//to after the last used event
-//
+            if (*lineEnd == '\0')
+            {
+                pState->lineOffset = currPos - *ppUnparsedData;
+                return INKYC_LINERC_INCOMPLETE_SRC;
+            }
 
-// returns uint32_t: number of days included in entrylist
-uint32_t parseAllDayEventInstance(entry_t *pEvents, int *pEventIndex, int maxEvents, int dateStartInt, int dateEndInt)
-{
-    if (    dateStartInt < 20000101 || dateStartInt > 22000101 
-         || dateEndInt   < 20000101 || dateEndInt   > 22000101  )
-    {
-        LogSerial_Error("parseAllDayEvent: Event %s has dates out of range: start %d end %d",
-                                pEvents[*pEventIndex].name, dateStartInt, dateEndInt);
-        logProblem(INKY_SEVERITY_ERROR);
-        return 0;
-    }
+            if (isLine(currPos, pState->componentEnd))
+            {
+                pState->componentEnd[0] = '\0';
+            }
+            currPos = lineEnd + 1;
+            continue;
+        }
 
-    //if first day after eventend... can skip
-    if (getYYYYMMDDInt4FirstDay() > dateEndInt)
-    {
-        LogSerial_Verbose4("Skipping instance as end of instamce is only %d", dateEndInt);
-        return 0;
-    }
-    //if last day before eventstart....can skip
-    if (getYYYYMMDDInt4LastDay() < dateStartInt)
-    {
-        LogSerial_Verbose4("Skipping instance as start of instance is (calendar future): %d", dateEndInt);
-        return 0;
-    }
+        contentLine_t contentLine;
+        int32_t linerc;
 
-    int relevantDays = 0;
-    struct tm timeinfo;
-    
-    localtime_r(&CalendarStart, &timeinfo);
-    timeinfo.tm_isdst = -1; //figure it out based on tz info
+        if (pState->linePartlyParsed)
+        {
+            //Carry on looking for the end of the line we stopped in
+            contentLine = pState->partialLine;
+            pState->linePartlyParsed = false;
 
-    for (int daynum = 0; daynum < DaysRelevent; daynum++)
-    {
-        //Get day in the form YYYYMMDD then convert to int: dayInt
-        time_t dayunixtime = mktime(&timeinfo);
-        int dayInt = convertEpochTimeToYYYYMMDD(dayunixtime);
-      
-        LogSerial_Verbose2("Comparing day %d to event start %d and end %d\n", dayInt, dateStartInt, dateEndInt);        
+            linerc = findContentLineValueEnd(&contentLine, contentLine.next);
+        }
+        else
+        {
+            linerc = parseContentLine(currPos, &contentLine);
+        }
 
-        if (dayInt < dateEndInt) //Check it's not in the past (dateEnd is first date after event)
+        if (linerc == INKYC_LINERC_INCOMPLETE_SRC)
         {
-            if (dayInt >= dateStartInt) //Check it's not in the future
+            //Carry on from here when there's more data
+            pState->lineOffset = currPos - *ppUnparsedData;
+
+            if (contentLine.next != NULL)
             {
-                //We need to show this event in column daynum
-                LogSerial_Verbose3("parseAllDayEventInstance: Event %s is relevant for day %d : start %d end %d",
-                                  pEvents[*pEventIndex].name, daynum, dateStartInt, dateEndInt);
-                relevantDays++;
-               
-                if (*pEventIndex < maxEvents - 1)
-                {
-                    //Copy the partial event we are completing to the next slot (in case we need it for the next day)
-                    //and complete the slot that we copied
-                    memcpy(&pEvents[(*pEventIndex) + 1], &pEvents[*pEventIndex], sizeof(entry_t));
-                    pEvents[(*pEventIndex)].day = daynum;
-                    strcpy(pEvents[(*pEventIndex)].time, "");
-
-                    //Work out timestamp for midnight at start of this day
-                    struct tm midnight_tm;
-                    
-                    localtime_r(&dayunixtime, &midnight_tm);
-
-                    midnight_tm.tm_sec = 0;
-                    midnight_tm.tm_min = 0;
-                    midnight_tm.tm_hour = 0;
-                    midnight_tm.tm_isdst = -1; //figure out if dst is in force
-                    pEvents[(*pEventIndex)].timeStamp = mktime(&midnight_tm);
-
-                    
-                    *pEventIndex = *pEventIndex + 1;
-                }
-                else
+                pState->partialLine = contentLine;
+                pState->linePartlyParsed = true;
+            }
+            return INKYC_LINERC_INCOMPLETE_SRC;
+        }
+        else if (linerc == INKYC_LINERC_NOT_CONTENT)
+        {
+            LogSerial_Verbose4("SkippingDuringParse (not a content line): %.60s", currPos);
+            currPos = contentLine.next;
+            continue;
+        }
+
+        switch(contentLine.id)
+        {
+            case INKYC_PROP_DESCRIPTION:
+                pEventDetails->description = contentLine.value;
+                break;
+
+            case INKYC_PROP_DTSTART:
+                parseDateTimeProperty(&contentLine, &pEventDetails->timeStart, &pEventDetails->dateStart,
+                                      &pEventDetails->timeZone);
+                break;
+
+            case INKYC_PROP_DTEND:
+                parseDateTimeProperty(&contentLine, &pEventDetails->timeEnd, &pEventDetails->dateEnd,
+                                      &pEventDetails->timeZoneEnd);
+                break;
+
+            case INKYC_PROP_BEGIN:
+                //A component in the event (e.g. VALARM) - skip to its END (above)
+                snprintf(pState->componentEnd, sizeof(pState->componentEnd), "END:%.*s",
+                         (int)contentLine.value.len, contentLine.value.start);
+                break;
+
+            case INKYC_PROP_END:
+                if (spanEquals(&contentLine.value, "VEVENT"))
                 {
-                    LogSerial_Error("parseAllDayEventInstance: Event %s (day %d - start %d end %d) - No space in entry list!",
-                                    pEvents[*pEventIndex].name, daynum, dateStartInt, dateEndInt);
-                    logProblem(INKY_SEVERITY_ERROR);
+                    foundEventEnd = true;
                 }
-            }          
-        }
+                break;
+
+            case INKYC_PROP_LOCATION:
+                pEventDetails->location = contentLine.value;
+                break;
 
-        //Now update for the next day
-        timeinfo.tm_mday +=1;
+            case INKYC_PROP_RRULE:
+                pEventDetails->recurRule = contentLine.value;
+                break;
 
-        //Convert from day Jan 32nd back to human dates by going to/from epoch time
-        time_t dayepochtime;
-        dayepochtime = mktime(&timeinfo);
-        localtime_r(&dayepochtime, &timeinfo);
-        timeinfo.tm_isdst = -1; //dst active is based on tz info
-    }
+            case INKYC_PROP_SUMMARY:
+                pEventDetails->summary = contentLine.value;
+                break;
 
-    if (relevantDays > 0)
-    {
-        LogSerial_Verbose1("parseAllDayEventInstance: Event %s (start %d end %d) - relevant %d days",
-                                pEvents[*pEventIndex].name, dateStartInt, dateEndInt, relevantDays);
-    }
-    else
-    {
-        LogSerial_Verbose2("parseAllDayEventInstance: Event %s (start %d end %d) - relevant %d days",
-                                pEvents[*pEventIndex].name, dateStartInt, dateEndInt, relevantDays);
-    }
+            case INKYC_PROP_UID:
+                pEventDetails->uid = contentLine.value;
+                break;
 
-    return relevantDays;
-}
+            case INKYC_PROP_SEQUENCE:
+                {
+                    char sequence[INKYC_EVTPARSE_MAXBYTES_TIME];
+                    spanToString(&contentLine.value, sequence, sizeof(sequence));
+                    pEventDetails->sequence = (int32_t)strtol(sequence, NULL, 10);
+                }
+                break;
 
-uint32_t parseAllDayEvent(entry_t *pEvents, int *pEventIndex, int maxEvents, char *dateStart, char *dateEnd, char *recurRule)
-{   
-    uint32_t relevantDays = 0;
-    uint32_t eventInstances = 0;
+            case INKYC_PROP_RECURRENCEID:
+                //Overrides an instance on a date or at a time - we just need to know which
+                parseDateTimeProperty(&contentLine, &pEventDetails->recurrenceId, &pEventDetails->recurrenceId, NULL);
+                break;
 
-    if (recurRule != NULL && recurRule[0] != '\0')
-    {
-        recurringEventInfo_t recurInfo;
+            case INKYC_PROP_EXDATE:
+                //Can be more than one EXDATE line, each with a list
+                if (pEventDetails->numExDates < INKYC_EVTPARSE_MAX_EXDATES)
+                {
+                    pEventDetails->exDates[pEventDetails->numExDates++] = contentLine.value;
+                }
+                else
+                {
+                    LogSerial_Unusual("More than %d EXDATE lines in an event - ignoring: %.*s", INKYC_EVTPARSE_MAX_EXDATES,
+                                           (int)contentLine.value.len, contentLine.value.start);
+                }
+                break;
 
-        if(!initialiseRecurringAllDayEvent(&recurInfo,
-                                           recurRule,
-                                           dateStart,
-                                           dateEnd))
-        {
-            LogSerial_Error("Failed to parse event with recur rule: %s", recurRule);
-            logProblem(INKY_SEVERITY_ERROR);
-            return 0;
-        }
-        
-        int lastday = getYYYYMMDDInt4LastDay();
-    
-        while( getNextOccurence(&recurInfo) )
-        {
-            if (recurInfo.currentStartYYYYMMDDInt <= lastday)
-            {
-                eventInstances++;
-            
-                relevantDays += parseAllDayEventInstance(pEvents, pEventIndex, maxEvents, 
-                                                      recurInfo.currentStartYYYYMMDDInt,
-                                                      recurInfo.currentEndYYYYMMDDInt);
-            }
-            else
-            {
-                //The start of this occurrence is after the end of the calendar
-                //we don't need to look at this ooccurrence or any future ones
-                LogSerial_Verbose4("Stopping generating occurrences as current start is already %d"
-                                  , recurInfo.currentEndYYYYMMDDInt);
+            case INKYC_PROP_STATUS:
+                pEventDetails->status = parseEventStatus(&contentLine.value);
+                break;
+
+            default:
+                //Lots of fields we don't use
+                LogSerial_Verbose4("SkippingDuringParse: %.60s", currPos);
                 break;
-            }
         }
+        currPos = contentLine.next;
     }
-    else
-    {
-        //convert dateStart/dateEnd to ints 
-        //We could compare as strings - but this is easier to reason about and not performance sensitive
-        char temp[9];
-        strncpy(temp, dateStart, 8);
-        temp[8] = '\0';
-        int dateStartInt = (int)strtol(temp, NULL, 10);
 
-        strncpy(temp, dateEnd, 8);
-        temp[8] = '\0';    
-        int dateEndInt   = (int)strtol(dateEnd, NULL, 10);
+    pState->inEvent = false;
+    *ppUnparsedData = currPos;
+    return 0;
+}
 
-        eventInstances++;
-        relevantDays = parseAllDayEventInstance(pEvents, pEventIndex, maxEvents, dateStartInt, dateEndInt);
-    }
+//Parses a UTC offset e.g. TZOFFSETTO:+0100 or -053000
+//returns false if it can't be parsed
+static bool parseUtcOffset(const span_t *pValue, int32_t *pOffset)
+{
+    char value[INKYC_EVTPARSE_MAXBYTES_TIME];
+    size_t valueLen = spanToString(pValue, value, sizeof(value));
+    int32_t hours, mins, secs = 0;
 
-    if (relevantDays > 0)
-    {
-        LogSerial_Info("parseAllDayEvent: Event %s (recurred %" PRIu32 " times based on start %.*s rule %s) - relevant %d days",
-                      pEvents[*pEventIndex].name, eventInstances, 8, dateStart, (recurRule != NULL && recurRule[0] != '\0'? recurRule : "unset"), relevantDays);
-    }
-    else
+    if (   (valueLen != 5 && valueLen != 7) || (value[0] != '+' && value[0] != '-')
+        || !parseDigits(value + 1, 2, &hours) || !parseDigits(value + 3, 2, &mins)
+        || (valueLen == 7 && !parseDigits(value + 5, 2, &secs)))
     {
-        LogSerial_Verbose1("parseAllDayEvent: Event %s (recurred %" PRIu32 " times based on start %.*s rule %s) - relevant %d days",
-                      pEvents[*pEventIndex].name, eventInstances, 8, dateStart, (recurRule != NULL && recurRule[0] != '\0'? recurRule : "unset"), relevantDays);
+        LogSerial_Unusual("Can't parse UTC offset: %s", value);
+        return false;
     }
-
-    return relevantDays;
+    *pOffset = (value[0] == '-' ? -1 : 1) * (hours * 3600 + mins * 60 + secs);
+    return true;
 }
 
-int32_t getUnfoldedLine(char **ppSrc, char *dest, size_t maxBytes)
-{
-    char *src = *ppSrc;
-    char *destcurpos = dest;
-    
-    char *destendline = NULL;        // \__ If we find we can't include current line, we'll
-    char *srcendline  = NULL;  // /   terminate dest at this point (if set)
-
-    size_t maxNonNullBytes = maxBytes - 1;
+//Parts of an observance (STANDARD/DAYLIGHT) found
+#define INKYC_OBSERVANCE_DTSTART 1
+#define INKYC_OBSERVANCE_FROM    2
+#define INKYC_OBSERVANCE_TO      4
+#define INKYC_OBSERVANCE_ALL     7
 
-    int32_t linerc = 0;
-    bool gotCompleteLine = false;
+//Parses a VTIMEZONE (*ppUnparsedData is its BEGIN line) and works out the UTC offsets of the zone
+//around the days shown
+//returns 0 (with *ppUnparsedData moved past its END) or INKYC_LINERC_INCOMPLETE_SRC if it isn't all in the buffer
+static int32_t parseTimeZone(char **ppUnparsedData, CalendarParsingContext_t *pContext)
+{
+    char *currPos = (char *)lineScanner_findLineEnd(*ppUnparsedData);
 
-    LogSerial_Verbose5("On entry gUL was given %p\n", src);
+    if (*currPos == '\0')
+    {
+        return INKYC_LINERC_INCOMPLETE_SRC;
+    }
+    currPos++;
 
+    char tzid[TIMEZONES_MAXBYTES_TZID] = "";
+    timeZoneObservance_t observances[TIMEZONES_MAX_OBSERVANCES];
+    uint32_t numObservances = 0;
+    timeZoneObservance_t *pObservance = NULL;  //The one we're in
+    uint32_t found = 0;                        //INKYC_OBSERVANCE_* of it
+    bool foundEnd = false;
 
-    while (*src != '\0' && linerc == 0 && !gotCompleteLine)
+    while (!foundEnd)
     {
-        if ((destcurpos - dest) >= maxNonNullBytes)
+        contentLine_t contentLine;
+        int32_t linerc = parseContentLine(currPos, &contentLine);
+
+        if (linerc == INKYC_LINERC_INCOMPLETE_SRC)
         {
-            linerc = INKYC_LINERC_INCOMPLETE_TOO_LONG;
-            break;
+            return INKYC_LINERC_INCOMPLETE_SRC;
         }
-        switch(src[0])
+        else if (linerc == INKYC_LINERC_NOT_CONTENT)
         {
-            case '\\':
-                //See if next is n if so put \n in dest and skip both in src
-                if(src[1] == 'n')
+            currPos = contentLine.next;
+            continue;
+        }
+
+        switch (contentLine.id)
+        {
+            case INKYC_PROP_TZID:
+                if (pObservance == NULL)
+                {
+                    spanToString(&contentLine.value, tzid, sizeof(tzid));
+                }
+                break;
+
+            case INKYC_PROP_BEGIN:
+                if (spanEquals(&contentLine.value, "STANDARD") || spanEquals(&contentLine.value, "DAYLIGHT"))
                 {
-                    *destcurpos = '\n';
-                    destcurpos++;
-                    src +=2;
+                    if (numObservances < TIMEZONES_MAX_OBSERVANCES)
+                    {
+                        pObservance = &observances[numObservances];
+                        memset(pObservance, 0, sizeof(timeZoneObservance_t));
+                        found = 0;
+                    }
+                    else
+                    {
+                        LogSerial_Unusual("More than %d STANDARD/DAYLIGHT in VTIMEZONE %s - ignoring the rest",
+                                          TIMEZONES_MAX_OBSERVANCES, tzid);
+                    }
                 }
-                else if (src[1] == '\\' || src[1] == ';' || src[1] == ',')
+                break;
+
+            case INKYC_PROP_DTSTART:
+                if (pObservance != NULL)
                 {
-                    //Backslashes seem to escaped to \\ in some ical
-                    //; and , seem to be escaped as well
-                    *destcurpos = src[1];
-                    destcurpos++;
-                    src+=2;
+                    char start[INKYC_EVTPARSE_MAXBYTES_TIME];
+                    int32_t year, month, day, hour, min, sec;
+
+                    spanToString(&contentLine.value, start, sizeof(start));
+
+                    if (   parseDigits(start, 4, &year) && parseDigits(start + 4, 2, &month) && parseDigits(start + 6, 2, &day)
+                        && start[8] == 'T' && parseDigits(start + 9, 2, &hour) && parseDigits(start + 11, 2, &min)
+                        && parseDigits(start + 13, 2, &sec) && month >= 1 && month <= 12)
+                    {
+                        pObservance->startDay = daysFromCivil(year, (uint32_t)month, day);
+                        pObservance->startSecsOfDay = hour * 3600 + min * 60 + sec;
+                        found |= INKYC_OBSERVANCE_DTSTART;
+                    }
                 }
-                else
+                break;
+
+            case INKYC_PROP_TZOFFSETFROM:
+                if (pObservance != NULL && parseUtcOffset(&contentLine.value, &pObservance->offsetFrom))
                 {
-                    //doesn't look like an escape sequence - treat as literal backslash
-                    *destcurpos = *src;
-                    destcurpos++;
-                    src++;
+                    found |= INKYC_OBSERVANCE_FROM;
                 }
                 break;
 
-            case '\r':
-                //deliberately skip - it's either part of lineending (which we are removing)
-                // or a weird character we want to omit from diplayed anyway
-                src++;
+            case INKYC_PROP_TZOFFSETTO:
+                if (pObservance != NULL && parseUtcOffset(&contentLine.value, &pObservance->offsetTo))
+                {
+                    found |= INKYC_OBSERVANCE_TO;
+                }
                 break;
-            
-            case '\n':
-                //Line ending
-                destendline = destcurpos;
-                srcendline = &(src[1]); //if we rewind to this line end - start src at being of next line
 
-                if (src[1] == '\0')
+            case INKYC_PROP_RRULE:
+                if (pObservance != NULL)
                 {
-                    //D'oh - can't tell whether it would be a continuation line - don't have next char
-                   linerc = INKYC_LINERC_INCOMPLETE_SRC;
-                   break;
+                    char recurRule[INKYC_EVTPARSE_MAXBYTES_RECURRULE];
+                    size_t recurRuleLen = spanToString(&contentLine.value, recurRule, sizeof(recurRule));
+
+                    pObservance->hasRule = compileRecurRule(recurRule, recurRuleLen, &pObservance->rule);
                 }
-                else if (src[1] == ' ' || src[1] == '\t')
+                break;
+
+            case INKYC_PROP_END:
+                if (spanEquals(&contentLine.value, "VTIMEZONE"))
                 {
-                    //Continuation line, skip over in src and keep scanning
-                    src += 2;
+                    foundEnd = true;
                 }
-                else
+                else if (pObservance != NULL)
                 {
-                    //Found the end of current line
-                    gotCompleteLine = true;
-
-                    *destcurpos = '\0'; //Ensure output buffer null-terminated
-                    *ppSrc = &(src[1]); //Tell caller where next line starts
-                    break;
+                    if (found == INKYC_OBSERVANCE_ALL)
+                    {
+                        numObservances++;
+                    }
+                    else
+                    {
+                        LogSerial_Unusual("Ignoring STANDARD/DAYLIGHT in VTIMEZONE %s without DTSTART/TZOFFSETFROM/TZOFFSETTO", tzid);
+                    }
+                    pObservance = NULL;
                 }
                 break;
-            
+
             default:
-                //By default copy src -> dest
-                *destcurpos = *src;
-                destcurpos++;
-                src++;
+                //e.g. TZNAME, RDATE (changes that aren't in an RRULE - not used for current rules)
                 break;
         }
+        currPos = contentLine.next;
     }
+    *ppUnparsedData = currPos;
 
-    if (!gotCompleteLine)
+    if (tzid[0] == '\0' || numObservances == 0)
     {
-        if (linerc == INKYC_LINERC_INCOMPLETE_TOO_LONG)
-        {
-            if (destendline != NULL && srcendline != NULL)
-            {
-                //We'll rewind scan to last \n as a sensible place to leave the scan and return partial line
-                *destendline = '\0';
-                *ppSrc = srcendline;
-            }
-            else
-            {
-               //Line in src too long to ever scan - move source past it and return partial line 
+        LogSerial_Unusual("Ignoring VTIMEZONE %s with %" PRIu32 " observances", tzid, numObservances);
+        return 0;
+    }
 
-                while(*src != '\0' && *src != '\n')
-                {
-                    src++;
-                }
-                if(*src == '\n')
-                {
-                    *ppSrc =  &(src[1]); //Start scan at begining of next line
-                    *destcurpos = '\0'; //Ensure output buffer null-terminated
-                }
-                else
-                {
-                    //Can't find a line ending to continue scan from... give up and undo scan entirely
-                    linerc = INKYC_LINERC_INCOMPLETE_SRC; 
-                    *dest = '\0';  //Set out buffer to be empty
-                }
-            }
-        }
-        else
-        {
-            //Return empty buffer and don't update ppSrc
-            *dest = '\0'; 
-            linerc = INKYC_LINERC_INCOMPLETE_SRC;
-        }
+    if (pContext->pTimeZones == NULL)
+    {
+        pContext->pTimeZones = timeZoneCache_create();
     }
+    timeZone_t *pZone = (pContext->pTimeZones != NULL) ? timeZoneCache_add(pContext->pTimeZones, tzid) : NULL;
 
-    LogSerial_Verbose5("On exit gUL was sending  %p, %d dest: %s\n", *ppSrc, linerc, dest);
+    if (pZone != NULL)
+    {
+        timeZone_buildOffsets(&pZone->offsets, observances, numObservances, LocalOffsets.windowStart, LocalOffsets.windowEnd);
+        pZone->known = true;
 
-    return linerc;
+        LogSerial_Verbose1("Time zone %s: offset %" PRId32 " at the start of the window, %" PRIu32 " offsets",
+                           tzid, pZone->offsets.offsets[0], pZone->offsets.numOffsets);
+    }
+    return 0;
 }
 
-//returns 0 if found all the details for event
-//returns INKYC_LINERC_INCOMPLETE_SRC if event details are not complete
-int32_t findNextEventDetails(char **ppUnparsedData, eventParsingDetails_t *pEventDetails)
+//The UTC offsets of the time zone TZID= (in *pTzid) - from a VTIMEZONE in the calendar
+//returns NULL if the time is local time (there isn't a TZID= or a VTIMEZONE for it)
+static const utcOffsets_t *findEventTimeZone(CalendarParsingContext_t *pContext, const span_t *pTzid)
 {
-    char *currPos = *ppUnparsedData;
-    bool inEvent       = false;
-    bool foundEventEnd = false;
-    int32_t rc = 0;
+    if (pTzid->len == 0)
+    {
+        return NULL;
+    }
+    char tzid[TIMEZONES_MAXBYTES_TZID];
+    spanToString(pTzid, tzid, sizeof(tzid));
+
+    timeZone_t *pZone = (pContext->pTimeZones != NULL) ? timeZoneCache_find(pContext->pTimeZones, tzid) : NULL;
 
-    while (!foundEventEnd && rc == 0)
+    if (pZone != NULL)
     {
-        bool movedToNextLineYet = false;
+        return pZone->known ? &pZone->offsets : NULL;
+    }
 
-        if(!inEvent)
-        {
-            if(strncmp(currPos, "BEGIN:VEVENT", strlen("BEGIN:VEVENT")) == 0)
-            {
-                inEvent = true;
-            }
-        }
-        else
-        {
-            //Unfold the current line as per rfc5545
-            char linebuf[INKYC_LINEBUF_MAX];
+    if (   strcmp(tzid, "UTC") == 0 || strcmp(tzid, "GMT") == 0
+        || strcmp(tzid, "Etc/UTC") == 0 || strcmp(tzid, "Etc/GMT") == 0)
+    {
+        return &UtcOffsets;
+    }
 
-            char *srcLineStartPos = currPos;
-            int32_t linerc = getUnfoldedLine(&currPos, linebuf, INKYC_LINEBUF_MAX);
+    //Remember we don't know it so it's only logged once
+    LogSerial_Unusual("No VTIMEZONE for TZID %s - taking it to be local time", tzid);
 
-            if (linerc == INKYC_LINERC_INCOMPLETE_SRC)
-            {
-                //giveup the scan
-                rc = INKYC_LINERC_INCOMPLETE_SRC;
-                break;
-            }
-            else
-            {
-                //Unfolding the line will have moved us to the next one
-                movedToNextLineYet = true;
-            }
+    if (pContext->pTimeZones == NULL)
+    {
+        pContext->pTimeZones = timeZoneCache_create();
+    }
 
-            bool usefulField = false;
-            switch(linebuf[0])
-            {
-                case ' ':   //Deliberate fall through to other whitespace case
-                case '\t':
-                    //If we found the start of a description but not the end yet...
-                    if (   pEventDetails->foldedDescription != NULL 
-                        && pEventDetails->foldedDescriptionLen == 0)
-                    {
-                        usefulField = true;
+    if (pContext->pTimeZones != NULL)
+    {
+        timeZoneCache_add(pContext->pTimeZones, tzid);
+    }
+    return NULL;
+}
 
-                        //If we finally found the end of the description:
-                        if (linerc != INKYC_LINERC_INCOMPLETE_TOO_LONG)
-                        {
-                            pEventDetails->foldedDescriptionLen = currPos - pEventDetails->foldedDescription;
-                        }
-                    }
-                    break;
+//Hash of an event's UID (for the override index)
+static uint32_t hashEventUid(const span_t *pUid)
+{
+    if (!pUid->needsUnfold)
+    {
+        return inky_fnv1a(pUid->start, pUid->len);
+    }
+    char uid[INKYC_EVTPARSE_MAXBYTES_UID];
+    size_t uidLen = spanToString(pUid, uid, sizeof(uid));
 
-                case 'D':
-                    //DESCRIPTION or DTSTART or DTEND
+    return inky_fnv1a(uid, uidLen);
+}
 
-                    if (strncmp(linebuf,"DESCRIPTION:", strlen("DESCRIPTION:")) == 0)
-                    {
-                        usefulField = true;
-                        pEventDetails->foldedDescription = srcLineStartPos;
-                        
-                        if (linerc != INKYC_LINERC_INCOMPLETE_TOO_LONG)
-                        {
-                            pEventDetails->foldedDescriptionLen = currPos - pEventDetails->foldedDescription;
-                        }
-                    }
-                    else if(strncmp(linebuf,"DTSTART", strlen("DTSTART")) == 0)
-                    {
-                        usefulField = true;
-                        char *dtStart = linebuf + strlen("DTSTART");
-
-                        if (dtStart[0] == ':')
-                        {
-                            //Just a plain time - phew - timeStart is after colon
-                            snprintf(pEventDetails->timeStart, INKYC_EVTPARSE_MAXBYTES_TIME, dtStart + 1);
-                        }
-                        else
-                        {
-                            char *dtparamsEnd = strchr(dtStart, ':');
-                            size_t dtparamsLen = dtparamsEnd - dtStart;
-
-                            if (dtparamsEnd)
-                            {
-                                //Check for TZINFO of the form:
-                                //DTSTART;TZID=Europe/London:20181127T193000
-                                char *tzidStartSearch = (char *)memmem(dtStart, dtparamsLen,
-                                                                    "TZID=", strlen("TZID="));
-
-                                if (tzidStartSearch)
-                                {
-                                    snprintf(pEventDetails->timeZone, INKYC_EVTPARSE_MAXBYTES_TIMEZONE, tzidStartSearch + strlen("TZID="));
-                                    snprintf(pEventDetails->timeStart, INKYC_EVTPARSE_MAXBYTES_TIME, dtparamsEnd + 1); //+1 to go past ':' dtParamsEnd points at
-                                }
-                                else
-                                {
-                                    //dates are of the form: DTSTART;VALUE=DATE:
-                                    char *dateStartSearch = (char *)memmem(dtStart, dtparamsLen,
-                                                                    "VALUE=DATE", strlen("VALUE=DATE"));
-                    
-                                    if (dateStartSearch)
-                                    {
-                                        snprintf(pEventDetails->dateStart, INKYC_EVTPARSE_MAXBYTES_TIME, dtparamsEnd + 1); //+1 to go past ':' dtParamsEnd points at
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    else if(strncmp(linebuf,"DTEND", strlen("DTEND")) == 0)
-                    {
-                        usefulField = true;
-                        char *dtEnd = linebuf + strlen("DTEND");
-
-                        if (dtEnd[0] == ':')
-                        {
-                            //Just a plain time - phew - timeEnd is after colon
-                            snprintf(pEventDetails->timeEnd, INKYC_EVTPARSE_MAXBYTES_TIME, dtEnd + 1);
-                        }
-                        else
-                        {
-                            char *dtparamsEnd = strchr(dtEnd, ':');
-                            size_t dtparamsLen = dtparamsEnd - dtEnd;
-
-                            if (dtparamsEnd)
-                            {
-                                //Check for TZINFO of the form:
-                                //DTSTART;TZID=Europe/London:20181127T193000
-                                char *tzidSearch = (char *)memmem(dtEnd, dtparamsLen,
-                                                                    "TZID=", strlen("TZID="));
-
-                                if (tzidSearch)
-                                {
-                                    //We don't do anything with a timezone in an end time...
-                                    snprintf(pEventDetails->timeEnd, INKYC_EVTPARSE_MAXBYTES_TIME, dtparamsEnd + 1); //+1 to go past ':' dtParamsEnd points at
-                                }
-                                else
-                                {
-                                    //dates are of the form: DTSTART;VALUE=DATE:
-                                    char *dateEndSearch = (char *)memmem(dtEnd, dtparamsLen,
-                                                                    "VALUE=DATE", strlen("VALUE=DATE"));
-                    
-                                    if (dateEndSearch)
-                                    {
-                                        snprintf(pEventDetails->dateEnd, INKYC_EVTPARSE_MAXBYTES_TIME, dtparamsEnd + 1); //+1 to go past ':' dtParamsEnd points at
-                                    }
-                                }
-                            }
-                        }
-                    }
-                    break;
+//Removes entries of this calendar (that an event with a RECURRENCE-ID replaces) - moving the later ones down
+static void removeEntries(overrideIndex_t *pIndex, int firstEntry, int numEntries)
+{
+    if (firstEntry + numEntries > entriesNum)
+    {
+        LogSerial_Unusual("Can't remove entries %d-%d - only %d entries", firstEntry, firstEntry + numEntries - 1, entriesNum);
+        return;
+    }
+    memmove(&entries[firstEntry], &entries[firstEntry + numEntries], (entriesNum - firstEntry - numEntries) * sizeof(entry_t));
+    entriesNum -= numEntries;
 
-                case 'E':
-                    //END:VEVENT
-                    if (strncmp(linebuf,"END:VEVENT", strlen("END:VEVENT")) == 0)
-                    {
-                        usefulField = true;
-                        foundEventEnd = true; 
-                        break;
-                    }
-                    break;
-                
-                case 'L':
-                    //LOCATION
-                    if (strncmp(linebuf,"LOCATION:", strlen("LOCATION:")) == 0)
-                    {
-                        usefulField = true;
-                        snprintf(pEventDetails->location, INKY_ENTRY_MAXBYTES_LOCATION,
-                                 "%s",linebuf+strlen("LOCATION:"));
-                    }
-                    break;
-                
-                case 'R':
-                    //RRULE
-                    if (strncmp(linebuf,"RRULE:", strlen("RRULE:")) == 0)
-                    {
-                        usefulField = true;
-                        snprintf(pEventDetails->recurRule, INKYC_EVTPARSE_MAXBYTES_RECURRULE,
-                                 "%s",linebuf+strlen("RRULE:"));
-                    }
-                
-                case 'S':
-                    //SUMMARY
-                    if (strncmp(linebuf,"SUMMARY:", strlen("SUMMARY:")) == 0)
-                    {
-                        usefulField = true;
-                        snprintf(pEventDetails->summary, INKY_ENTRY_MAXBYTES_NAME,
-                                 "%s",linebuf+strlen("SUMMARY:"));
-                    }
-                    break;
-                
-                default:
-                    //Lots of fields we don't use
-                    break;
+    overrideIndex_entriesRemoved(pIndex, firstEntry, numEntries);
+}
 
-            }
+//For an event with a RECURRENCE-ID (a modified or cancelled occurrence of a recurring event): removes the
+//entries of the occurrence it replaces if we've already had it, otherwise (if the occurrence could be shown)
+//records it so the recurring event doesn't add it later. Of two versions of the same occurrence, the one
+//with the higher SEQUENCE wins (or the later if they're the same)
+//  input: pZone - time zone of the RECURRENCE-ID (NULL for local time)
+//  output: ppRecord - record for the event's entries (NULL if there isn't one)
+//returns false if the event shouldn't be shown: it's cancelled or older than the version we've had
+static bool applyOverride(overrideIndex_t *pIndex, const eventParsingDetails_t *pEventDetails, uint32_t uidHash,
+                          const utcOffsets_t *pZone, overrideRecord_t **ppRecord)
+{
+    char recurrenceId[INKYC_EVTPARSE_MAXBYTES_TIME];
+    size_t recurrenceIdLen = spanToString(&pEventDetails->recurrenceId, recurrenceId, sizeof(recurrenceId));
+    bool cancelled = (pEventDetails->status == INKYC_EVTSTATUS_CANCELLED);
+    int32_t year, month, day;
+    int64_t instance;
+    int32_t instanceDay;
+
+    *ppRecord = NULL;
+
+    //Occurrences of all day events are known by their day, other events by their start time (as EXDATEs are)
+    if (   recurrenceIdLen == 8 && parseDigits(recurrenceId, 4, &year) && parseDigits(recurrenceId + 4, 2, &month)
+        && parseDigits(recurrenceId + 6, 2, &day) && month >= 1 && month <= 12)
+    {
+        instanceDay = daysFromCivil(year, (uint32_t)month, day);
+        instance = instanceDay;
+    }
+    else
+    {
+        time_t instanceStart = (recurrenceIdLen >= 15) ? convertZonedTimeToEpoch(recurrenceId, pZone) : (time_t)-1;
 
-            if (!usefulField)
-            {
-                LogSerial_Verbose4("SkippingDuringParse: %s", linebuf);
-            }
+        if (instanceStart == -1)
+        {
+            LogSerial_Unusual("Can't find the occurrence RECURRENCE-ID %s replaces - showing it as well", recurrenceId);
+            return !cancelled;
         }
+        instance = instanceStart;
+        instanceDay = daysFromSecs(instanceStart);
+    }
+    overrideRecord_t *pRecord = overrideIndex_find(pIndex, uidHash, instance);
 
-        //Move to next line - if we haven't already
-        if (!movedToNextLineYet)
+    if (pRecord != NULL)
+    {
+        if (pRecord->kind == OVERRIDEINDEX_KIND_OVERRIDE && pRecord->sequence > pEventDetails->sequence)
         {
-            currPos = strchr(currPos, '\n');
+            LogSerial_Verbose1("Ignoring RECURRENCE-ID %s sequence %" PRId32 " - already had sequence %" PRId32,
+                               recurrenceId, pEventDetails->sequence, pRecord->sequence);
+            return false;
+        }
 
-            if (!currPos)
-            {
-                //giveup the scan - haven't got a complete line
-                rc = INKYC_LINERC_INCOMPLETE_SRC;
-            }
-            else
-            {
-               currPos++; //move past '\n'
-            }
+        if (pRecord->numEntries > 0)
+        {
+            LogSerial_Verbose1("RECURRENCE-ID %s replaces %d entries", recurrenceId, pRecord->numEntries);
+            removeEntries(pIndex, pRecord->firstEntry, pRecord->numEntries);
         }
+        pRecord->kind = OVERRIDEINDEX_KIND_OVERRIDE;
+        pRecord->sequence = pEventDetails->sequence;
     }
-
-    //If we found a description but not the end of the dscription we are not complete
-    if (rc == 0)
+    else if (instanceDay >= FirstDayNumber - INKYC_OVERRIDE_MARGIN_DAYS && instanceDay <= getLastDayNumber() + 1)
     {
-       if((pEventDetails->foldedDescriptionLen == 0) != (pEventDetails->foldedDescription == NULL))
-       {
-           //We must have a bug as we shouldn't have found event end etc without first see description end!
-           LogSerial_FatalError("We thought we had finished parse of event but hadn't found descripton end: %s",  (pEventDetails->summary ? pEventDetails->summary : "No summary"));
-           logProblem(INKY_SEVERITY_FATAL);        
-           rc = INKYC_LINERC_INCOMPLETE_SRC;
-       }
+        pRecord = overrideIndex_add(pIndex, uidHash, instance, OVERRIDEINDEX_KIND_OVERRIDE, pEventDetails->sequence);
     }
+    *ppRecord = pRecord;
 
-    if (rc == 0)
+    if (cancelled)
     {
-        *ppUnparsedData = currPos;
+        LogSerial_Verbose1("Occurrence RECURRENCE-ID %s is cancelled", recurrenceId);
     }
-    return rc;
+    return !cancelled;
 }
 
 char *parsePartialDataForEvents(char *rawData,  void *context)
@@ -1139,93 +2098,185 @@ char *parsePartialDataForEvents(char *rawData,  void *context)
     char *unparseddata = rawData; 
     
     int evtrc = 0;
+
+    if (calContext->pOverrides == NULL)
+    {
+        calContext->pOverrides = overrideIndex_create();
+
+        if (calContext->pOverrides == NULL)
+        {
+            LogSerial_Error("No memory for override index - modified occurrences of recurring events may be shown twice");
+            logProblem(INKY_SEVERITY_ERROR);
+        }
+    }
+
+    //Without it, an event that isn't all in the buffer is gone through again from the start next time
+    eventParserState_t unkeptParserState = {};
+    eventParserState_t *pParserState = &unkeptParserState;
+
+    if (calContext->pParserState == NULL)
+    {
+        calContext->pParserState = (eventParserState_t *)calloc(1, sizeof(eventParserState_t));
+    }
+
+    if (calContext->pParserState != NULL)
+    {
+        pParserState = calContext->pParserState;
+    }
     
     // Search raw data for events
     while (evtrc == 0)
     {
         bool eventRelevant = false;
-        eventParsingDetails_t eventDetails = {0};
 
-        evtrc = findNextEventDetails(&unparseddata, &eventDetails);
+        evtrc = findNextEventDetails(&unparseddata, pParserState);
+
+        if (evtrc == INKYC_LINERC_TIMEZONE)
+        {
+            evtrc = parseTimeZone(&unparseddata, calContext);
+            continue;
+        }
 
         if (evtrc == 0)
         {
+            const eventParsingDetails_t *pEventDetails = &pParserState->details;
+
             LogSerial_Verbose2("Finished finding fields for event %d (so far: relevant % " PRIu64 ", total %" PRIu64 ")",
                                                  entriesNum, allRelevantEvents, allEvents);
 
+            LogSerial_Verbose2("UID: %.*s Sequence: %" PRId32 " Recurrence-ID: %.*s Status: %u ExDates: %" PRIu32,
+                                 (int)pEventDetails->uid.len, pEventDetails->uid.start, pEventDetails->sequence,
+                                 (int)pEventDetails->recurrenceId.len, pEventDetails->recurrenceId.start,
+                                 (unsigned)pEventDetails->status, pEventDetails->numExDates);
+
+            //The date code needs strings - these are short so copy them out
+            char timeStart[INKYC_EVTPARSE_MAXBYTES_TIME];
+            char timeEnd[INKYC_EVTPARSE_MAXBYTES_TIME];
+            char dateStart[INKYC_EVTPARSE_MAXBYTES_TIME];
+            char dateEnd[INKYC_EVTPARSE_MAXBYTES_TIME];
+            char recurRule[INKYC_EVTPARSE_MAXBYTES_RECURRULE];
+
+            spanToString(&pEventDetails->timeStart, timeStart, sizeof(timeStart));
+            spanToString(&pEventDetails->timeEnd,   timeEnd,   sizeof(timeEnd));
+            spanToString(&pEventDetails->dateStart, dateStart, sizeof(dateStart));
+            spanToString(&pEventDetails->dateEnd,   dateEnd,   sizeof(dateEnd));
+            spanToString(&pEventDetails->recurRule, recurRule, sizeof(recurRule));
+
+            //A modified occurrence of a recurring event replaces the one the recurring event gives
+            overrideIndex_t *pOverrides = calContext->pOverrides;
+            overrideRecord_t *pOverrideRecord = NULL;
+            uint32_t uidHash = 0;
+
+            if (pOverrides != NULL && (recurRule[0] != '\0' || pEventDetails->recurrenceId.len > 0))
+            {
+                uidHash = hashEventUid(&pEventDetails->uid);
+            }
+
+            //Times (that don't end in Z) are in the time zone given by TZID= (or local time)
+            const utcOffsets_t *pStartZone = findEventTimeZone(calContext, &pEventDetails->timeZone);
+            const utcOffsets_t *pEndZone = (pEventDetails->timeZoneEnd.len > 0) ? findEventTimeZone(calContext, &pEventDetails->timeZoneEnd)
+                                                                                : pStartZone;
+
+            if (   pOverrides != NULL && pEventDetails->recurrenceId.len > 0
+                && !applyOverride(pOverrides, pEventDetails, uidHash, pStartZone, &pOverrideRecord))
+            {
+                ++batchEvents;
+                continue;
+            }
+
+            //First work out whether (and on which days) the event is shown - most aren't, so only then
+            //do we copy its summary etc. and run the rules on it
+            int firstEntry = entriesNum;
+
             entry_SetColour(&entries[entriesNum], pCal->eventColour);
             entries[entriesNum].sortTieBreak =  pCal->sortTieBreak;
-        
-            if (eventDetails.summary[0] != '\0')
+            entries[entriesNum].name[0] = '\0';
+            entries[entriesNum].location[0] = '\0';
+
+            //Only recurring events have their EXDATEs looked at (and their occurrences recorded - unless
+            //they're an override themselves, e.g. RANGE=THISANDFUTURE, which we don't otherwise handle)
+            exDateSet_t exDates;
+            occurrenceFilter_t filter = { NULL, (pEventDetails->recurrenceId.len > 0) ? NULL : pOverrides,
+                                          uidHash, pEventDetails->sequence };
+            bool timed = (timeStart[0] != '\0' && timeEnd[0] != '\0');
+
+            if (recurRule[0] != '\0' && pEventDetails->numExDates > 0)
             {
-                LogSerial_Verbose1("Summary: %s", eventDetails.summary);
-                strcpy(entries[entriesNum].name, eventDetails.summary);
+                buildExDateSet(pEventDetails, !timed, pStartZone, &exDates);
+                filter.pExDates = &exDates;
             }
-            else
+
+            if (timed)
             {
-                LogSerial_Unusual("Event with no summary. Description: %.*s", eventDetails.foldedDescriptionLen,  eventDetails.foldedDescription);
-                entries[entriesNum].name[0] = '\0';
+                parseTimedEvent(entries, &entriesNum, MAX_ENTRIES,
+                                timeStart, timeEnd, pStartZone, pEndZone, recurRule, &filter);
             }
-
-            if (eventDetails.location[0] != '\0')
+            else if (   dateStart[0] != '\0' && dateEnd[0] != '\0'
+                     && strnlen(dateStart, 8) >= 8 && strnlen(dateEnd, 8) >= 8)
             {
-                LogSerial_Verbose1("Location: %s", eventDetails.location);
-                strcpy(entries[entriesNum].location, eventDetails.location);
+                //Assume date in format YYYYMMDD
+                parseAllDayEvent(entries, &entriesNum, MAX_ENTRIES, 
+                                 dateStart, dateEnd, recurRule, &filter);
             }
             else
             {
-                entries[entriesNum].location[0] = '\0';
+                LogSerial_Unusual("Event with no valid date info! Event UID: %.*s TimeStart %s TimeEnd %s DateStart: %s DateEnd %s",
+                                      (int)pEventDetails->uid.len, pEventDetails->uid.start, timeStart, timeEnd, dateStart, dateEnd);
             }
 
-            uint32_t matchresult = INKYR_RESULT_NOOP;
-            if (pCal->EventRules)
+            if (entriesNum > firstEntry)
             {
-                matchresult = runEventMatchRules(pCal->EventRules, &entries[entriesNum],  
-                                                 eventDetails.foldedDescription, eventDetails.foldedDescriptionLen,
-                                                 eventDetails.recurRule);
-            }
+                entry_t *pEntry = &entries[firstEntry];
 
-            if (matchresult != INKYR_RESULT_DISCARD)
-            {
-                if (eventDetails.timeStart[0] != '\0' && eventDetails.timeEnd[0] != '\0')
+                spanToString(&pEventDetails->summary,  pEntry->name,     INKY_ENTRY_MAXBYTES_NAME);
+                spanToString(&pEventDetails->location, pEntry->location, INKY_ENTRY_MAXBYTES_LOCATION);
+
+                if (pEntry->name[0] != '\0')
                 {
-                    getTimeString(entries[entriesNum].time,
-                                  eventDetails.timeStart, eventDetails.timeEnd, 
-                                  &entries[entriesNum].day, &entries[entriesNum].timeStamp);
+                    LogSerial_Verbose1("Summary: %s", pEntry->name);
+                }
+                else
+                {
+                    LogSerial_Unusual("Event with no summary. Description: %.*s",
+                                          (int)pEventDetails->description.len, pEventDetails->description.start);
+                }
 
-                    LogSerial_Verbose1("Determined day to be: %" PRId8, entries[entriesNum].day);
-            
-                    if (entries[entriesNum].day >= 0)
+                uint32_t matchresult = INKYR_RESULT_NOOP;
+                if (pCal->EventRules)
+                {
+                    matchresult = runEventMatchRules(pCal->EventRules, pEntry,  
+                                                     pEventDetails->description.start, pEventDetails->description.len,
+                                                     recurRule);
+                }
+
+                if (matchresult == INKYR_RESULT_DISCARD)
+                {
+                    LogSerial_Verbose1("Discarded event %s", pEntry->name);
+
+                    if (pOverrides != NULL)
                     {
-                        eventRelevant = true;
-                        ++entriesNum;
+                        overrideIndex_entriesRemoved(pOverrides, firstEntry, entriesNum - firstEntry);
                     }
+                    entriesNum = firstEntry;
                 }
                 else
                 {
-                    if (eventDetails.dateStart[0] != '\0' && eventDetails.dateEnd[0] != '\0')
-                    {   
-                        //Assume date in format YYYYMMDD
-                        if (strnlen(eventDetails.dateStart, 8) >= 8 && strnlen(eventDetails.dateEnd, 8) >= 8)
-                        {
-                            if(parseAllDayEvent(entries, &entriesNum, MAX_ENTRIES, 
-                                                eventDetails.dateStart, eventDetails.dateEnd, 
-                                                eventDetails.recurRule) > 0)
-                            {
-                                eventRelevant = true;
-                            }
-                        }
-                        else
-                        {
-                            LogSerial_Unusual("Event with no valid date info! Event Summary: %s TimeStart %s TimeEnd %s DateStart: %s DateEnd %s",
-                                                  eventDetails.summary, eventDetails.timeStart, eventDetails.timeEnd, eventDetails.dateStart, eventDetails.dateEnd);
-                              
-                        }
+                    //An all day event can be shown on more than one day
+                    for (int i = firstEntry + 1; i < entriesNum; i++)
+                    {
+                        strcpy(entries[i].name, pEntry->name);
+                        strcpy(entries[i].location, pEntry->location);
+                        entries[i].bgColour     = pEntry->bgColour;
+                        entries[i].fgColour     = pEntry->fgColour;
+                        entries[i].sortTieBreak = pEntry->sortTieBreak;
                     }
-                    else
+                    LogSerial_Info("Event %s shown on %d day(s)", pEntry->name, entriesNum - firstEntry);
+                    eventRelevant = true;
+
+                    if (pOverrideRecord != NULL)
                     {
-                            LogSerial_Unusual("Event with no valid date info! Event Summary: %s TimeStart %s TimeEnd %s DateStart: %s DateEnd %s",
-                                                  eventDetails.summary, eventDetails.timeStart, eventDetails.timeEnd, eventDetails.dateStart, eventDetails.dateEnd);
+                        pOverrideRecord->firstEntry = (int16_t)firstEntry;
+                        pOverrideRecord->numEntries = (int16_t)(entriesNum - firstEntry);
                     }
                 }
             }
@@ -1248,6 +2299,18 @@ char *parsePartialDataForEvents(char *rawData,  void *context)
     return unparseddata;
 }
 
+void finishCalendarParsing(CalendarParsingContext_t *pContext)
+{
+    overrideIndex_destroy(pContext->pOverrides);
+    pContext->pOverrides = NULL;
+
+    timeZoneCache_destroy(pContext->pTimeZones);
+    pContext->pTimeZones = NULL;
+
+    free(pContext->pParserState);
+    pContext->pParserState = NULL;
+}
+
 //count of events relevant to calendar display
 uint64_t getRelevantEventCount()
 {
@@ -1265,3 +2328,15 @@ void resetEventStats()
     allRelevantEvents = 0;
     allEvents = 0;
 }
+
+void addToEventStats(uint64_t relevantEvents, uint64_t totalEvents)
+{
+    allRelevantEvents += relevantEvents;
+    allEvents += totalEvents;
+}
+
+void removeFromEventStats(uint64_t relevantEvents, uint64_t totalEvents)
+{
+    allRelevantEvents -= relevantEvents;
+    allEvents -= totalEvents;
+}
@@ -8,6 +8,7 @@
 #ifndef CALENDAR_H
 #define CALENDAR_H
 
+#include <stddef.h>
 #include "EventProcessing.h"
 
 typedef struct {
@@ -15,12 +16,21 @@ typedef struct {
     const ProcessingRule_t *EventRules;
     int8_t eventColour;
     int8_t sortTieBreak; //higher number, higher up display
+    uint32_t firstByteTimeoutMs; //Wait this long for the server to start replying (0 for the default)
+    uint32_t stallTimeoutMs;     //Wait this long for more data once it has (0 for the default)
 } Calendar_t;
 
+struct overrideIndex;
+struct timeZoneCache;
+struct eventParserState;
+
 typedef struct {
     Calendar_t *pCal;
     uint64_t calEvents = 0;
     uint64_t calRelevantEvents = 0;
+    struct overrideIndex *pOverrides = NULL; //Occurrences of recurring events so far (allocated by parsePartialDataForEvents)
+    struct timeZoneCache *pTimeZones = NULL; //UTC offsets of the calendar's time zones (VTIMEZONE) by TZID
+    struct eventParserState *pParserState = NULL; //Where parsing got to in an event not all received yet
 } CalendarParsingContext_t;
 
 //Sets the time period to find events for
@@ -30,6 +40,10 @@ typedef struct {
 // input: numDays - number of days including the first day that events are relevant for
 void setCalendarRange(time_t calendarStart, uint32_t numDays);
 
+//First day of the range set by setCalendarRange() as an int e.g. 20231027 and number of days in range
+int getCalendarFirstDayYYYYMMDD();
+uint32_t getCalendarNumDays();
+
 //returns 0 on error or number of chars (not including \0 added to buffer)
 uint32_t  getTimeStringNow(char *buffer, size_t maxlen);
 
@@ -37,11 +51,20 @@ uint32_t  getTimeStringNow(char *buffer, size_t maxlen);
 void getDateStringOffsetDays(char* timeStr, int32_t offsetDays, bool inclYear);
 
 //context will get cast to a CalendarParsingContext_t *
-//returns pointer to first unparsed data (or NULL on error)
+//returns pointer to first unparsed data (or NULL on error) - the next call's data must start with it (it
+//can be moved) as an event cut off at the end of the data is carried on with rather than parsed again
 char *parsePartialDataForEvents(char *rawData,  void *context);
 
+//After the whole calendar has been parsed (or given up on) with the context: frees what
+//parsePartialDataForEvents kept between calls. Call it before parsing the calendar again with the context
+void finishCalendarParsing(CalendarParsingContext_t *pContext);
+
 uint64_t getRelevantEventCount(); //count of events relevant to calendar display
 uint64_t getTotalEventCount();  //count of all events parsed
 void resetEventStats();
+//For events we didn't parse this time (e.g. restored from cache)
+void addToEventStats(uint64_t relevantEvents, uint64_t totalEvents);
+//For events we parsed but are throwing away (e.g. from a download that failed part way through)
+void removeFromEventStats(uint64_t relevantEvents, uint64_t totalEvents);
 
 #endif
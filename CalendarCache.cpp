@@ -0,0 +1,186 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "Arduino.h"
+
+#include "CalendarCache.h"
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+#include "entry.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+//RTC memory is small (8KB shared with anything else that needs to survive deep sleep)
+//so we only keep a few entries per calendar and shorten their strings. The display only
+//draws the first 64 chars of a name and the location is cut to the column width,
+//so the shortened versions draw the same.
+#define INKY_CACHE_MAX_CALENDARS          4
+#define INKY_CACHE_MAX_ENTRIES_PER_CAL    8
+#define INKY_CACHE_MAXBYTES_NAME         64
+#define INKY_CACHE_MAXBYTES_LOCATION     32
+#define INKY_CACHE_MAXBYTES_TIME         12  //e.g. "14:00-16:00"
+
+typedef struct {
+    char name[INKY_CACHE_MAXBYTES_NAME];
+    char location[INKY_CACHE_MAXBYTES_LOCATION];
+    char time[INKY_CACHE_MAXBYTES_TIME];
+    time_t timeStamp;
+    int8_t day;
+    int8_t sortTieBreak;
+    int8_t bgColour;
+    int8_t fgColour;
+} cachedEntry_t;
+
+typedef struct {
+    bool valid;
+    uint32_t urlHash;
+    int firstDayYYYYMMDD; //\__ Calendar range the entries were parsed for
+    uint32_t numDays;     ///
+    NetworkValidators_t validators;
+    uint64_t calEvents;
+    uint64_t calRelevantEvents;
+    uint32_t numEntries;
+    cachedEntry_t entries[INKY_CACHE_MAX_ENTRIES_PER_CAL];
+} calendarCacheSlot_t;
+
+RTC_DATA_ATTR static calendarCacheSlot_t CacheSlots[INKY_CACHE_MAX_CALENDARS];
+
+//returns slot for calIndex if it's valid for url and current calendar range, otherwise NULL
+static calendarCacheSlot_t *getValidSlot(uint32_t calIndex, const char *url)
+{
+    if (calIndex >= INKY_CACHE_MAX_CALENDARS)
+    {
+        return NULL;
+    }
+    calendarCacheSlot_t *pSlot = &CacheSlots[calIndex];
+
+    if (   !pSlot->valid
+        || pSlot->urlHash != inky_fnv1a(url, strlen(url))
+        || pSlot->firstDayYYYYMMDD != getCalendarFirstDayYYYYMMDD()
+        || pSlot->numDays != getCalendarNumDays())
+    {
+        return NULL;
+    }
+    return pSlot;
+}
+
+bool calendarCache_getValidators(uint32_t calIndex, const char *url, NetworkValidators_t *pValidators)
+{
+    calendarCacheSlot_t *pSlot = getValidSlot(calIndex, url);
+
+    if (pSlot == NULL)
+    {
+        pValidators->etag[0] = '\0';
+        pValidators->lastModified[0] = '\0';
+        return false;
+    }
+
+    memcpy(pValidators, &(pSlot->validators), sizeof(NetworkValidators_t));
+    return true;
+}
+
+bool calendarCache_restoreEntries(uint32_t calIndex, CalendarParsingContext_t *pContext)
+{
+    calendarCacheSlot_t *pSlot = getValidSlot(calIndex, pContext->pCal->url);
+
+    if (pSlot == NULL)
+    {
+        LogSerial_Error("No cached entries for calendar %" PRIu32, calIndex);
+        logProblem(INKY_SEVERITY_ERROR);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < pSlot->numEntries; i++)
+    {
+        if (entriesNum >= MAX_ENTRIES)
+        {
+            LogSerial_Error("No space in entry list for cached entries of calendar %" PRIu32, calIndex);
+            logProblem(INKY_SEVERITY_ERROR);
+            break;
+        }
+        cachedEntry_t *pCached = &(pSlot->entries[i]);
+        entry_t *pEntry = &entries[entriesNum];
+
+        strcpy(pEntry->name, pCached->name);
+        strcpy(pEntry->location, pCached->location);
+        strcpy(pEntry->time, pCached->time);
+        pEntry->timeStamp    = pCached->timeStamp;
+        pEntry->day          = pCached->day;
+        pEntry->sortTieBreak = pCached->sortTieBreak;
+        pEntry->bgColour     = pCached->bgColour;
+        pEntry->fgColour     = pCached->fgColour;
+        entriesNum++;
+    }
+
+    pContext->calEvents         += pSlot->calEvents;
+    pContext->calRelevantEvents += pSlot->calRelevantEvents;
+    addToEventStats(pSlot->calRelevantEvents, pSlot->calEvents);
+
+    LogSerial_Info("Restored %" PRIu32 " cached entries for calendar %" PRIu32 " (%" PRIu64 " relevant out of %" PRIu64 ")",
+                      pSlot->numEntries, calIndex, pSlot->calRelevantEvents, pSlot->calEvents);
+    return true;
+}
+
+void calendarCache_store(uint32_t calIndex, const char *url, const NetworkValidators_t *pValidators,
+                         int firstEntry, const CalendarParsingContext_t *pContext)
+{
+    if (calIndex >= INKY_CACHE_MAX_CALENDARS)
+    {
+        return;
+    }
+    calendarCacheSlot_t *pSlot = &CacheSlots[calIndex];
+    uint32_t numEntries = entriesNum - firstEntry;
+
+    pSlot->valid = false;
+
+    if (pValidators->etag[0] == '\0' && pValidators->lastModified[0] == '\0')
+    {
+        LogSerial_Verbose1("Not caching calendar %" PRIu32 " - server sent no validators", calIndex);
+        return;
+    }
+
+    if (numEntries > INKY_CACHE_MAX_ENTRIES_PER_CAL)
+    {
+        LogSerial_Info("Not caching calendar %" PRIu32 " - %" PRIu32 " entries is too many to cache", calIndex, numEntries);
+        return;
+    }
+
+    for (uint32_t i = 0; i < numEntries; i++)
+    {
+        cachedEntry_t *pCached = &(pSlot->entries[i]);
+        entry_t *pEntry = &entries[firstEntry + i];
+
+        snprintf(pCached->name,     INKY_CACHE_MAXBYTES_NAME,     "%s", pEntry->name);
+        snprintf(pCached->location, INKY_CACHE_MAXBYTES_LOCATION, "%s", pEntry->location);
+        snprintf(pCached->time,     INKY_CACHE_MAXBYTES_TIME,     "%s", pEntry->time);
+        pCached->timeStamp    = pEntry->timeStamp;
+        pCached->day          = pEntry->day;
+        pCached->sortTieBreak = pEntry->sortTieBreak;
+        pCached->bgColour     = pEntry->bgColour;
+        pCached->fgColour     = pEntry->fgColour;
+    }
+
+    pSlot->urlHash           = inky_fnv1a(url, strlen(url));
+    pSlot->firstDayYYYYMMDD  = getCalendarFirstDayYYYYMMDD();
+    pSlot->numDays           = getCalendarNumDays();
+    memcpy(&(pSlot->validators), pValidators, sizeof(NetworkValidators_t));
+    pSlot->calEvents         = pContext->calEvents;
+    pSlot->calRelevantEvents = pContext->calRelevantEvents;
+    pSlot->numEntries        = numEntries;
+    pSlot->valid             = true;
+
+    LogSerial_Verbose1("Cached %" PRIu32 " entries for calendar %" PRIu32, numEntries, calIndex);
+}
+
+void calendarCache_invalidate(uint32_t calIndex)
+{
+    if (calIndex < INKY_CACHE_MAX_CALENDARS)
+    {
+        CacheSlots[calIndex].valid = false;
+    }
+}
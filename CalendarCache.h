@@ -0,0 +1,42 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+//Remembers (in RTC memory, which survives deep sleep) the validators (ETag/Last-Modified)
+//of the last download of each calendar along with the entries we found in it.
+//If the server says the calendar hasn't changed we can reuse the entries without
+//downloading or parsing the calendar again.
+//
+//Entries are only valid for the calendar range they were parsed for, so we only send
+//validators when the calendar range is the same as last time.
+
+#ifndef CALENDARCACHE_H
+#define CALENDARCACHE_H
+
+#include <stdint.h>
+
+#include "Calendar.h"
+#include "Network.h"
+
+//Fills in pValidators from the cache for calendar number calIndex
+//(sets them to "" if we don't have entries for this url and the current calendar range)
+//returns true if validators from the cache were found
+bool calendarCache_getValidators(uint32_t calIndex, const char *url, NetworkValidators_t *pValidators);
+
+//After the server said the calendar is unchanged: adds the cached entries to entries[]
+//and their counts to the context/event stats
+//returns false if we no longer have the entries
+bool calendarCache_restoreEntries(uint32_t calIndex, CalendarParsingContext_t *pContext);
+
+//After a complete download and parse: remember the validators and the entries
+//entries[firstEntry] ... entries[entriesNum - 1] that came from this calendar
+void calendarCache_store(uint32_t calIndex, const char *url, const NetworkValidators_t *pValidators,
+                         int firstEntry, const CalendarParsingContext_t *pContext);
+
+//Forget anything cached for calendar number calIndex
+void calendarCache_invalidate(uint32_t calIndex);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "ChunkDecoder.h"
+#include <string.h>
+#include <inttypes.h>
+
+#include "LogSerial.h"
+
+//Hex digits in a chunk length - more than this won't fit in a uint64_t
+#define INKY_CHUNKDEC_MAX_HDR_DIGITS 15
+
+void chunkDecoder_init(ChunkDecoder_t *pDecoder)
+{
+    memset(pDecoder, 0, sizeof(ChunkDecoder_t));
+    pDecoder->state = INKY_CHUNKDEC_STATE_HDR_SIZE;
+}
+
+//returns value of hex digit or -1 if c isn't one
+static int32_t hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+//Called when we reach the '\n' at the end of a chunk header
+static void chunkHeaderComplete(ChunkDecoder_t *pDecoder)
+{
+    LogSerial_Verbose1("Found a chunk of length %" PRIu64 " (payload so far %" PRIu64 ")",
+                          pDecoder->chunkLength, pDecoder->totalPayload);
+    pDecoder->chunks++;
+
+    if (pDecoder->chunkLength > 0)
+    {
+        pDecoder->state = INKY_CHUNKDEC_STATE_DATA;
+        pDecoder->bytesRemainingInChunk = pDecoder->chunkLength;
+    }
+    else
+    {
+        pDecoder->state = INKY_CHUNKDEC_STATE_TRAILER;
+        pDecoder->trailerLineLen = 0;
+    }
+    pDecoder->chunkLength = 0;
+    pDecoder->hdrDigits = 0;
+}
+
+int32_t chunkDecoder_decode(ChunkDecoder_t *pDecoder, char *buf, size_t len, size_t *pPayloadLen)
+{
+    size_t inPos  = 0; //Next byte to decode
+    size_t outPos = 0; //End of payload decoded so far
+    int32_t rc = INKY_CHUNKDEC_RC_OK;
+
+    while (inPos < len && rc == INKY_CHUNKDEC_RC_OK)
+    {
+        switch (pDecoder->state)
+        {
+            case INKY_CHUNKDEC_STATE_DATA:
+            {
+                //Move as much chunk data as we have down over any headers we've removed in one go
+                size_t available = len - inPos;
+                size_t spanLen = (pDecoder->bytesRemainingInChunk < available) ? (size_t)pDecoder->bytesRemainingInChunk : available;
+
+                if (outPos != inPos)
+                {
+                    memmove(buf + outPos, buf + inPos, spanLen);
+                }
+                inPos  += spanLen;
+                outPos += spanLen;
+                pDecoder->bytesRemainingInChunk -= spanLen;
+                pDecoder->totalPayload += spanLen;
+
+                if (pDecoder->bytesRemainingInChunk == 0)
+                {
+                    //CRLF after the data is skipped whilst looking for the next length
+                    pDecoder->state = INKY_CHUNKDEC_STATE_HDR_SIZE;
+                }
+                break;
+            }
+
+            case INKY_CHUNKDEC_STATE_HDR_SIZE:
+            {
+                char c = buf[inPos++];
+                int32_t digit = hexDigitValue(c);
+
+                if (digit >= 0)
+                {
+                    if (pDecoder->hdrDigits >= INKY_CHUNKDEC_MAX_HDR_DIGITS)
+                    {
+                        LogSerial_Error("Chunk length has too many digits (%" PRIu32 ")", pDecoder->hdrDigits + 1);
+                        pDecoder->state = INKY_CHUNKDEC_STATE_FAILED;
+                        rc = INKY_CHUNKDEC_RC_BADHEADER;
+                    }
+                    else
+                    {
+                        pDecoder->chunkLength = (pDecoder->chunkLength << 4) | (uint64_t)digit;
+                        pDecoder->hdrDigits++;
+                    }
+                }
+                else if (pDecoder->hdrDigits == 0)
+                {
+                    if (c != '\r' && c != '\n')
+                    {
+                        LogSerial_Error("Expected chunk length but got char 0x%02x (payload so far %" PRIu64 ")",
+                                               (uint32_t)(uint8_t)c, pDecoder->totalPayload);
+                        pDecoder->state = INKY_CHUNKDEC_STATE_FAILED;
+                        rc = INKY_CHUNKDEC_RC_BADHEADER;
+                    }
+                    //else skipping the CRLF at the end of the previous chunk
+                }
+                else if (c == '\n')
+                {
+                    chunkHeaderComplete(pDecoder);
+                }
+                else
+                {
+                    //End of the length: CR or the ;name=value chunk extensions we ignore
+                    pDecoder->state = INKY_CHUNKDEC_STATE_HDR_EXT;
+                }
+                break;
+            }
+
+            case INKY_CHUNKDEC_STATE_HDR_EXT:
+            {
+                char *hdrEnd = (char *)memchr(buf + inPos, '\n', len - inPos);
+
+                if (hdrEnd != NULL)
+                {
+                    inPos = (hdrEnd - buf) + 1;
+                    chunkHeaderComplete(pDecoder);
+                }
+                else
+                {
+                    inPos = len;
+                }
+                break;
+            }
+
+            case INKY_CHUNKDEC_STATE_TRAILER:
+            {
+                //After the last chunk are (optional) trailer headers - we ignore them
+                //but need to find the empty line that ends them
+                char c = buf[inPos++];
+
+                if (c == '\n')
+                {
+                    if (pDecoder->trailerLineLen == 0)
+                    {
+                        pDecoder->state = INKY_CHUNKDEC_STATE_COMPLETE;
+                    }
+                    pDecoder->trailerLineLen = 0;
+                }
+                else if (c != '\r')
+                {
+                    pDecoder->trailerLineLen++;
+                }
+                break;
+            }
+
+            case INKY_CHUNKDEC_STATE_COMPLETE:
+                //Nothing should follow the body
+                LogSerial_Unusual("Ignoring %zu bytes after the end of the chunked body", len - inPos);
+                inPos = len;
+                break;
+
+            default:
+                rc = INKY_CHUNKDEC_RC_BADHEADER;
+                break;
+        }
+    }
+
+    if (rc == INKY_CHUNKDEC_RC_OK && pDecoder->state == INKY_CHUNKDEC_STATE_COMPLETE)
+    {
+        rc = INKY_CHUNKDEC_RC_COMPLETE;
+    }
+
+    *pPayloadLen = outPos;
+    return rc;
+}
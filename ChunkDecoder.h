@@ -0,0 +1,51 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef CHUNKDECODER_H
+#define CHUNKDECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Decodes an http body sent with "Transfer-Encoding: chunked". Each chunk is the length of the chunk in hex
+//(optionally followed by ;extensions), CRLF, the chunk data then CRLF. A zero length chunk ends the body.
+//    https://en.wikipedia.org/wiki/Chunked_transfer_encoding
+//
+//The body can be fed to the decoder in fragments of any size, split at any point.
+//It isn't complete until the line ending the trailer is read, so nothing of the body is left
+//unread on a connection that is kept open for another request.
+
+#define INKY_CHUNKDEC_RC_OK         0
+#define INKY_CHUNKDEC_RC_COMPLETE   1  //Read the zero length chunk and the (empty) line that end the body
+#define INKY_CHUNKDEC_RC_BADHEADER -1  //Chunk header wasn't a hex length
+
+#define INKY_CHUNKDEC_STATE_HDR_SIZE   0 //Reading hex digits of chunk length (skipping CRLF at end of previous chunk)
+#define INKY_CHUNKDEC_STATE_HDR_EXT    1 //Read the length, skipping to the '\n' at end of header
+#define INKY_CHUNKDEC_STATE_DATA       2 //In chunk data
+#define INKY_CHUNKDEC_STATE_TRAILER    3 //Read the final (zero length) chunk header, skipping trailer headers to an empty line
+#define INKY_CHUNKDEC_STATE_COMPLETE   4 //Read the whole body
+#define INKY_CHUNKDEC_STATE_FAILED     5
+
+typedef struct {
+    uint32_t state;                 //One of the INKY_CHUNKDEC_STATE_* constants
+    uint32_t hdrDigits;             //Number of hex digits of the current chunk length read so far
+    uint32_t trailerLineLen;        //Chars (other than CR) on the current trailer line so far
+    uint64_t chunkLength;           //Length of the chunk whose header we are reading
+    uint64_t bytesRemainingInChunk;
+    uint64_t totalPayload;          //Count of (decoded) bytes of chunk data so far
+    uint64_t chunks;                //Count of chunk headers read so far
+} ChunkDecoder_t;
+
+void chunkDecoder_init(ChunkDecoder_t *pDecoder);
+
+//Decodes a fragment of the body in place
+// input/output: buf - on entry contains len bytes as received,
+//                     on exit contains *pPayloadLen bytes of chunk data (with the chunk headers removed)
+// returns INKY_CHUNKDEC_RC_OK, INKY_CHUNKDEC_RC_COMPLETE or INKY_CHUNKDEC_RC_BADHEADER
+int32_t chunkDecoder_decode(ChunkDecoder_t *pDecoder, char *buf, size_t len, size_t *pPayloadLen);
+
+#endif
@@ -0,0 +1,293 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "Arduino.h"
+
+#include "ConnectionManager.h"
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+#include "NetworkCache.h"
+
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+
+#include <string.h>
+#include <inttypes.h>
+
+//Most people's calendars are on one or two hosts
+#define INKY_CONNMGR_MAX_HOSTS         3
+#define INKY_CONNMGR_MAXBYTES_HOST   128
+
+typedef struct {
+    char host[INKY_CONNMGR_MAXBYTES_HOST]; //"" if slot unused
+    uint16_t port;
+    bool secure;
+    WiFiClient *pClient;                   //WiFiClientSecure for https
+    HTTPClient *pHttp;                     //Kept with the client: deleting an HTTPClient closes its connection
+    uint32_t requests;                     //Made on the current connection
+    unsigned long lastUsed;
+} managedConnection_t;
+
+static managedConnection_t Connections[INKY_CONNMGR_MAX_HOSTS];
+
+//Finds the host, port and whether to use TLS from a url like https://host[:port][/path]
+//returns false if the url isn't one we can handle
+static bool parseUrl(const char *url, char *host, size_t hostSize, uint16_t *pPort, bool *pSecure)
+{
+    const char *hostStart = NULL;
+
+    if (strncasecmp(url, "https://", 8) == 0)
+    {
+        *pSecure = true;
+        *pPort = 443;
+        hostStart = url + 8;
+    }
+    else if (strncasecmp(url, "http://", 7) == 0)
+    {
+        *pSecure = false;
+        *pPort = 80;
+        hostStart = url + 7;
+    }
+    else
+    {
+        return false;
+    }
+
+    size_t authorityLen = strcspn(hostStart, "/?#");
+    const char *at = (const char *)memchr(hostStart, '@', authorityLen);
+
+    if (at != NULL)
+    {
+        //Skip user:password@
+        authorityLen -= (at + 1) - hostStart;
+        hostStart = at + 1;
+    }
+
+    const char *colon = (const char *)memchr(hostStart, ':', authorityLen);
+    size_t hostLen = (colon != NULL) ? (size_t)(colon - hostStart) : authorityLen;
+
+    if (colon != NULL)
+    {
+        *pPort = (uint16_t)strtoul(colon + 1, NULL, 10);
+    }
+
+    if (hostLen == 0 || hostLen >= hostSize || *pPort == 0)
+    {
+        return false;
+    }
+    memcpy(host, hostStart, hostLen);
+    host[hostLen] = '\0';
+    return true;
+}
+
+static void closeConnection(managedConnection_t *pConn)
+{
+    if (pConn->pClient != NULL && pConn->pClient->connected())
+    {
+        LogSerial_Verbose1("Closing connection to %s:%u after %" PRIu32 " requests",
+                              pConn->host, (unsigned)pConn->port, pConn->requests);
+        pConn->pClient->stop();
+    }
+    pConn->requests = 0;
+}
+
+//Finds the slot for host:port or (if there isn't one) a free slot - or the least recently used
+static managedConnection_t *findSlot(const char *host, uint16_t port, bool secure)
+{
+    managedConnection_t *pFree = NULL;
+    managedConnection_t *pOldest = &Connections[0];
+
+    for (uint32_t i = 0; i < INKY_CONNMGR_MAX_HOSTS; i++)
+    {
+        managedConnection_t *pConn = &Connections[i];
+
+        if (pConn->host[0] == '\0')
+        {
+            if (pFree == NULL)
+            {
+                pFree = pConn;
+            }
+        }
+        else if (strcasecmp(pConn->host, host) == 0 && pConn->port == port && pConn->secure == secure)
+        {
+            return pConn;
+        }
+        else if (pConn->lastUsed < pOldest->lastUsed)
+        {
+            pOldest = pConn;
+        }
+    }
+
+    managedConnection_t *pConn = (pFree != NULL) ? pFree : pOldest;
+
+    if (pConn->host[0] != '\0')
+    {
+        closeConnection(pConn);
+    }
+    if (pConn->pClient != NULL && pConn->secure != secure)
+    {
+        //Wrong type of client for this host
+        delete pConn->pHttp;
+        delete pConn->pClient;
+        pConn->pHttp = NULL;
+        pConn->pClient = NULL;
+    }
+    strcpy(pConn->host, host);
+    pConn->port = port;
+    pConn->secure = secure;
+    return pConn;
+}
+
+static bool connectToAddress(managedConnection_t *pConn, const IPAddress &ip)
+{
+    if (pConn->secure)
+    {
+        //host is still needed for SNI (and we don't check certs - see setInsecure() below)
+        return ((WiFiClientSecure *)pConn->pClient)->connect(ip, pConn->port, pConn->host, NULL, NULL, NULL);
+    }
+    return pConn->pClient->connect(ip, pConn->port);
+}
+
+//Connects to the address the host had last time (skipping the DNS lookup) or, if we don't
+//have one or it doesn't work, looks the address up
+// output: pDnsMillis - time spent on the DNS lookup (0 if the cached address worked)
+static bool connectToHost(managedConnection_t *pConn, unsigned long *pDnsMillis)
+{
+    IPAddress ip;
+    *pDnsMillis = 0;
+
+    if (networkCache_getHost(pConn->host, &ip))
+    {
+        if (connectToAddress(pConn, ip))
+        {
+            LogSerial_Verbose1("Connected to cached address %s for %s", ip.toString().c_str(), pConn->host);
+            return true;
+        }
+        LogSerial_Unusual("Couldn't connect to cached address %s for %s - looking it up again",
+                              ip.toString().c_str(), pConn->host);
+        networkCache_invalidateHost(pConn->host);
+    }
+
+    unsigned long dnsStart = millis();
+    bool resolved = WiFi.hostByName(pConn->host, ip);
+    *pDnsMillis = millis() - dnsStart;
+
+    if (!resolved)
+    {
+        LogSerial_Error("DNS lookup of %s failed (after %lu ms)", pConn->host, *pDnsMillis);
+        return false;
+    }
+    LogSerial_Info("DNS lookup of %s took %lu ms", pConn->host, *pDnsMillis);
+
+    if (!connectToAddress(pConn, ip))
+    {
+        return false;
+    }
+    networkCache_storeHost(pConn->host, ip);
+    return true;
+}
+
+HTTPClient *connectionManager_acquire(const char *url, ConnectionInfo_t *pInfo)
+{
+    char host[INKY_CONNMGR_MAXBYTES_HOST];
+    uint16_t port = 0;
+    bool secure = false;
+
+    memset(pInfo, 0, sizeof(ConnectionInfo_t));
+
+    if (!parseUrl(url, host, sizeof(host), &port, &secure))
+    {
+        LogSerial_Error("Can't find the host to connect to in %s", url);
+        logProblem(INKY_SEVERITY_ERROR);
+        return NULL;
+    }
+
+    managedConnection_t *pConn = findSlot(host, port, secure);
+
+    if (pConn->pClient == NULL)
+    {
+        if (secure)
+        {
+            WiFiClientSecure *pSecureClient = new WiFiClientSecure;
+            //As HTTPClient does when not given a CA cert
+            pSecureClient->setInsecure();
+            pConn->pClient = pSecureClient;
+        }
+        else
+        {
+            pConn->pClient = new WiFiClient;
+        }
+        pConn->pHttp = new HTTPClient;
+        pConn->pHttp->setReuse(true);
+    }
+
+    if (pConn->pClient->connected())
+    {
+        pInfo->reused = true;
+        LogSerial_Info("Reusing connection to %s:%u", host, (unsigned)port);
+    }
+    else
+    {
+        //Connect ourselves (rather than leaving it to HTTPClient) so we can time it
+        pConn->requests = 0;
+        unsigned long connectStart = millis();
+        bool connected = connectToHost(pConn, &(pInfo->dnsMillis));
+        pInfo->connectMillis = millis() - connectStart;
+
+        if (!connected)
+        {
+            LogSerial_Error("Failed to connect to %s:%u (after %lu ms)", host, (unsigned)port, pInfo->connectMillis);
+            logProblem(INKY_SEVERITY_ERROR);
+            pConn->host[0] = '\0';
+            return NULL;
+        }
+        LogSerial_Info("Connected to %s:%u in %lu ms (DNS lookup: %lu ms%s)", host, (unsigned)port,
+                             pInfo->connectMillis, pInfo->dnsMillis, secure ? ", rest is TCP connect and TLS handshake" : "");
+    }
+
+    pConn->requests++;
+    pConn->lastUsed = millis();
+    pInfo->requests = pConn->requests;
+
+    pConn->pHttp->begin(*(pConn->pClient), String(url));
+    return pConn->pHttp;
+}
+
+void connectionManager_release(HTTPClient *pHttp, bool keepOpen)
+{
+    for (uint32_t i = 0; i < INKY_CONNMGR_MAX_HOSTS; i++)
+    {
+        managedConnection_t *pConn = &Connections[i];
+
+        if (pConn->pHttp == pHttp)
+        {
+            if (!keepOpen)
+            {
+                closeConnection(pConn);
+            }
+            //Keeps the connection open unless the server said it would close it
+            pHttp->end();
+            break;
+        }
+    }
+}
+
+void connectionManager_closeAll(void)
+{
+    for (uint32_t i = 0; i < INKY_CONNMGR_MAX_HOSTS; i++)
+    {
+        managedConnection_t *pConn = &Connections[i];
+
+        closeConnection(pConn);
+        delete pConn->pHttp;
+        delete pConn->pClient;
+        pConn->pHttp = NULL;
+        pConn->pClient = NULL;
+        pConn->host[0] = '\0';
+    }
+}
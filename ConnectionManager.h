@@ -0,0 +1,42 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+//Keeps one connection per host open for the whole wake so calendars on the same host
+//(e.g. several on calendar.google.com) reuse it rather than each doing a TCP connect
+//and full TLS handshake.
+//
+//The address each host resolved to is cached (see NetworkCache.h) so later wakes skip the DNS lookup.
+//The TLS session isn't kept between wakes: WiFiClientSecure does the handshake inside
+//connect() and gives us no way to save or resume the session.
+
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <stdint.h>
+
+#include <HTTPClient.h>
+
+typedef struct {
+    bool reused;                 //Connection was already open from an earlier request
+    unsigned long connectMillis; //Time to connect (any DNS lookup, TCP connect and TLS handshake) - 0 if reused
+    unsigned long dnsMillis;     //...of which the DNS lookup (0 if the cached address was used)
+    uint32_t requests;           //Requests made on this connection (including this one)
+} ConnectionInfo_t;
+
+//Gets an HTTPClient connected to the host in url, with begin() already called for url
+//(so headers can be added then GET() called). Must be given back with connectionManager_release()
+//returns NULL if the url couldn't be parsed or the connection failed
+HTTPClient *connectionManager_acquire(const char *url, ConnectionInfo_t *pInfo);
+
+//Ends the request made with pHttp. Only keep the connection open if the whole
+//response was read - anything left unread would be taken as the next response
+void connectionManager_release(HTTPClient *pHttp, bool keepOpen);
+
+//Closes all the connections (at the end of the wake)
+void connectionManager_closeAll(void);
+
+#endif
@@ -0,0 +1,258 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#include <LittleFS.h>
+#endif
+
+#include "DownloadCache.h"
+#include "ByteSource.h"
+#include "HttpResponse.h"
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+
+#define INKY_DOWNLOADCACHE_MAXBYTES_PATH   64
+//Paths are the base path then "/", the url's hash as 8 hex digits and a suffix - this leaves room for those
+#define INKY_DOWNLOADCACHE_MAXBYTES_BASEPATH  (INKY_DOWNLOADCACHE_MAXBYTES_PATH - 16)
+//Longest url/validator we'll read back from a metadata file
+#define INKY_DOWNLOADCACHE_MAXBYTES_LINE  512
+
+//Metadata file (next to the saved calendar) is lines of:
+//  url, time saved, ETag, Last-Modified
+#define INKY_DOWNLOADCACHE_SUFFIX_DATA  ".ics"
+#define INKY_DOWNLOADCACHE_SUFFIX_META  ".val"
+#define INKY_DOWNLOADCACHE_SUFFIX_TEMP  ".tmp"
+
+static char BasePath[INKY_DOWNLOADCACHE_MAXBYTES_BASEPATH] = "";
+
+//Files are named after a hash of the url
+static void filePath(char *path, const char *url, const char *suffix)
+{
+    snprintf(path, INKY_DOWNLOADCACHE_MAXBYTES_PATH, "%s/%08" PRIx32 "%s", BasePath, inky_fnv1a(url, strlen(url)), suffix);
+}
+
+bool downloadCache_begin(const char *basePath)
+{
+    if (strlen(basePath) >= INKY_DOWNLOADCACHE_MAXBYTES_BASEPATH)
+    {
+        LogSerial_Error("Download cache path too long: %s", basePath);
+        return false;
+    }
+#ifdef ARDUINO
+    //Formats the partition if it can't be mounted (e.g. the first time)
+    if (!LittleFS.begin(true, basePath))
+    {
+        LogSerial_Error("Failed to mount LittleFS - not using download cache");
+        logProblem(INKY_SEVERITY_WARNING);
+        return false;
+    }
+    LogSerial_Info("LittleFS mounted: %u of %u bytes used", (unsigned)LittleFS.usedBytes(), (unsigned)LittleFS.totalBytes());
+#endif
+    strcpy(BasePath, basePath);
+    return true;
+}
+
+//Reads a line (without the \n) - returns false if there wasn't one
+static bool readLine(FILE *file, char *line, size_t lineSize)
+{
+    if (fgets(line, lineSize, file) == NULL)
+    {
+        return false;
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    return true;
+}
+
+//Reads the metadata for url
+//returns false if there's no (complete) saved copy of url
+static bool readMeta(const char *url, time_t *pSavedAt, char *etag, size_t etagSize,
+                     char *lastModified, size_t lastModifiedSize)
+{
+    char path[INKY_DOWNLOADCACHE_MAXBYTES_PATH];
+    char line[INKY_DOWNLOADCACHE_MAXBYTES_LINE];
+    bool found = false;
+
+    filePath(path, url, INKY_DOWNLOADCACHE_SUFFIX_META);
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    //A different url with the same hash isn't ours
+    if (readLine(file, line, sizeof(line)) && strcmp(line, url) == 0)
+    {
+        char savedAt[24];
+
+        found = readLine(file, savedAt, sizeof(savedAt))
+                  && readLine(file, etag, etagSize)
+                  && readLine(file, lastModified, lastModifiedSize);
+        *pSavedAt = (time_t)strtoll(savedAt, NULL, 10);
+    }
+    fclose(file);
+    return found;
+}
+
+bool downloadCache_getValidators(const char *url, char *etag, size_t etagSize,
+                                 char *lastModified, size_t lastModifiedSize)
+{
+    time_t savedAt = 0;
+
+    if (BasePath[0] == '\0' || !readMeta(url, &savedAt, etag, etagSize, lastModified, lastModifiedSize))
+    {
+        etag[0] = '\0';
+        lastModified[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
+FILE *downloadCache_startSave(const char *url)
+{
+    if (BasePath[0] == '\0')
+    {
+        return NULL;
+    }
+    char path[INKY_DOWNLOADCACHE_MAXBYTES_PATH];
+    filePath(path, url, INKY_DOWNLOADCACHE_SUFFIX_TEMP);
+
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL)
+    {
+        LogSerial_Warning("Couldn't create %s - not saving %s", path, url);
+    }
+    return file;
+}
+
+void downloadCache_finishSave(const char *url, FILE *file, bool succeeded,
+                              const char *etag, const char *lastModified)
+{
+    if (file == NULL)
+    {
+        return;
+    }
+    char tempPath[INKY_DOWNLOADCACHE_MAXBYTES_PATH];
+    char dataPath[INKY_DOWNLOADCACHE_MAXBYTES_PATH];
+    char metaPath[INKY_DOWNLOADCACHE_MAXBYTES_PATH];
+
+    filePath(tempPath, url, INKY_DOWNLOADCACHE_SUFFIX_TEMP);
+    filePath(dataPath, url, INKY_DOWNLOADCACHE_SUFFIX_DATA);
+    filePath(metaPath, url, INKY_DOWNLOADCACHE_SUFFIX_META);
+
+    bool written = (ferror(file) == 0);
+    long savedBytes = ftell(file);
+
+    if (fclose(file) != 0)
+    {
+        written = false;
+    }
+
+    if (!succeeded || !written)
+    {
+        if (succeeded)
+        {
+            LogSerial_Warning("Failed to save %s (flash full?) - keeping previous copy", url);
+        }
+        remove(tempPath);
+        return;
+    }
+
+    //No metadata means no saved copy - so if we stop part way we don't use a mismatched pair
+    remove(metaPath);
+    remove(dataPath);
+
+    if (rename(tempPath, dataPath) != 0)
+    {
+        LogSerial_Warning("Failed to rename %s to %s", tempPath, dataPath);
+        remove(tempPath);
+        return;
+    }
+
+    FILE *meta = fopen(metaPath, "w");
+
+    if (meta == NULL)
+    {
+        LogSerial_Warning("Couldn't create %s", metaPath);
+        return;
+    }
+    fprintf(meta, "%s\n%" PRId64 "\n%s\n%s\n", url, (int64_t)time(nullptr), etag, lastModified);
+
+    if (fclose(meta) != 0)
+    {
+        remove(metaPath);
+        return;
+    }
+    LogSerial_Info("Saved %ld bytes of %s to %s", savedBytes, url, dataPath);
+}
+
+int32_t downloadCache_parse(const char *url, pipelineParsingFn_t *parser, void *parsingContext, size_t windowSize,
+                            HttpBodyStats_t *pStats)
+{
+    char etag[INKY_DOWNLOADCACHE_MAXBYTES_LINE];
+    char lastModified[INKY_DOWNLOADCACHE_MAXBYTES_LINE];
+    char dataPath[INKY_DOWNLOADCACHE_MAXBYTES_PATH];
+    time_t savedAt = 0;
+
+    //So the caller can always use them, even if we don't get as far as reading the file
+    if (pStats != NULL)
+    {
+        memset(pStats, 0, sizeof(HttpBodyStats_t));
+    }
+
+    if (BasePath[0] == '\0' || !readMeta(url, &savedAt, etag, sizeof(etag), lastModified, sizeof(lastModified)))
+    {
+        return INKY_DOWNLOADCACHE_RC_NOTSAVED;
+    }
+    filePath(dataPath, url, INKY_DOWNLOADCACHE_SUFFIX_DATA);
+
+    ByteSourceFile_t file;
+    ByteSource_t source;
+
+    if (!byteSourceFile_open(&file, dataPath, &source))
+    {
+        return INKY_DOWNLOADCACHE_RC_NOTSAVED;
+    }
+    LogSerial_Info("Parsing copy of %s saved %" PRId64 " secs ago", url, (int64_t)(time(nullptr) - savedAt));
+
+    char *window = (char *)INKY_MALLOC_LARGE(windowSize);
+    int32_t rc = INKY_HTTPRESP_RC_NOMEM;
+
+    if (window != NULL)
+    {
+        //Saved after dechunking and inflating, so it's just the calendar
+        HttpResponseInfo_t info = { 200, false, false, INKY_BODYDEC_LENGTH_UNKNOWN, "", "" };
+        HttpBodyConfig_t config = {};
+        HttpBodyStats_t stats;
+
+        config.parser             = parser;
+        config.parsingContext     = parsingContext;
+        config.window             = window;
+        config.windowSize         = windowSize;
+        config.threaded           = false;   //Reading flash doesn't wait on anything
+        config.firstByteTimeoutMs = 1000;
+        config.stallTimeoutMs     = 1000;
+        config.url                = dataPath;
+
+        rc = httpResponse_receiveBody(&source, &info, &config, &stats);
+        free(window);
+
+        if (pStats != NULL)
+        {
+            memcpy(pStats, &stats, sizeof(HttpBodyStats_t));
+        }
+    }
+    byteSourceFile_close(&file);
+    return rc;
+}
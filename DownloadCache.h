@@ -0,0 +1,58 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+//Saves each calendar as downloaded (after dechunking and inflating) to flash (LittleFS) along
+//with its validators, so it can be parsed again without the network: when downloading fails,
+//or when the server says it hasn't changed but the entries in CalendarCache can't be used
+//(e.g. the calendar range has moved on a day).
+//
+//Each download is written to a temporary file that only replaces the saved copy if the
+//download succeeds. Files are named after a hash of the url.
+
+#ifndef DOWNLOADCACHE_H
+#define DOWNLOADCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "HttpResponse.h"
+
+//Where LittleFS is mounted on the InkPlate
+#define INKY_DOWNLOADCACHE_LITTLEFS_PATH "/littlefs"
+
+#define INKY_DOWNLOADCACHE_RC_NOTSAVED  -20  //No saved copy of the url
+
+//Starts using the cache: files are kept in basePath (on the InkPlate LittleFS is mounted
+//there first, formatting it if needed). Until this is called (or if it fails) the other
+//functions do nothing
+//returns false if the cache can't be used
+bool downloadCache_begin(const char *basePath);
+
+//Gets the validators of the saved copy of url
+//returns false (setting them to "") if there isn't one
+bool downloadCache_getValidators(const char *url, char *etag, size_t etagSize,
+                                 char *lastModified, size_t lastModifiedSize);
+
+//Opens a temporary file to save the download of url into
+//returns NULL if the cache isn't in use or the file couldn't be created
+FILE *downloadCache_startSave(const char *url);
+
+//Closes file (from downloadCache_startSave) - if the download succeeded (we received the whole
+//body and all of it was written) it replaces the saved copy of url, otherwise it is discarded
+//and the saved copy and its validators are left as they were
+void downloadCache_finishSave(const char *url, FILE *file, bool succeeded,
+                              const char *etag, const char *lastModified);
+
+//Parses the saved copy of url with parser (as getData would have parsed the download),
+//using a window of windowSize bytes
+// output: pStats (optional) - how reading and parsing it went (all 0 if we didn't get as far as reading it)
+//returns 0 (INKY_HTTPRESP_RC_OK) on success, INKY_DOWNLOADCACHE_RC_NOTSAVED or an INKY_HTTPRESP_RC_* error
+int32_t downloadCache_parse(const char *url, pipelineParsingFn_t *parser, void *parsingContext, size_t windowSize,
+                            HttpBodyStats_t *pStats);
+
+#endif
@@ -0,0 +1,415 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#if __has_include("esp32/rom/miniz.h")
+#include "esp32/rom/miniz.h"
+#else
+#include "rom/miniz.h"
+#endif
+#if __has_include("esp32/rom/crc.h")
+#include "esp32/rom/crc.h"
+#else
+#include "rom/crc.h"
+#endif
+#else
+#include <zlib.h>
+#endif
+
+#include "GzipDecoder.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+//Flags in the FLG byte of the gzip header
+#define INKY_GZIP_FLG_FHCRC     0x02
+#define INKY_GZIP_FLG_FEXTRA    0x04
+#define INKY_GZIP_FLG_FNAME     0x08
+#define INKY_GZIP_FLG_FCOMMENT  0x10
+
+#ifdef ARDUINO
+//tinfl writes into a 32KB circular dictionary - we copy from there into the caller's buffer
+typedef struct {
+    tinfl_decompressor decomp;
+    size_t dictOfs;       //Where in dict tinfl will write next
+    size_t pendingStart;  //\__ Output in dict not yet copied to the caller
+    size_t pendingLen;    ///
+    bool   streamEnd;
+    uint8_t dict[TINFL_LZ_DICT_SIZE];
+} inflater_t;
+
+static void *inflaterCreate(void)
+{
+    inflater_t *pInflater = (inflater_t *)INKY_MALLOC_LARGE(sizeof(inflater_t));
+
+    if (pInflater != NULL)
+    {
+        tinfl_init(&(pInflater->decomp));
+        pInflater->dictOfs = 0;
+        pInflater->pendingStart = 0;
+        pInflater->pendingLen = 0;
+        pInflater->streamEnd = false;
+    }
+    return pInflater;
+}
+
+static void inflaterDestroy(void *pState)
+{
+    free(pState);
+}
+
+//Inflates raw deflate data
+//returns false if data was corrupt, sets *pStreamEnd once all output for the deflate stream has been produced
+static bool inflaterStep(void *pState, const uint8_t *in, size_t inLen, size_t *pInUsed,
+                         uint8_t *out, size_t outSpace, size_t *pOutLen, bool *pStreamEnd)
+{
+    inflater_t *pInflater = (inflater_t *)pState;
+    size_t inUsed = 0;
+    size_t outLen = 0;
+
+    while (outLen < outSpace)
+    {
+        if (pInflater->pendingLen > 0)
+        {
+            size_t copyLen = outSpace - outLen;
+
+            if (copyLen > pInflater->pendingLen)
+            {
+                copyLen = pInflater->pendingLen;
+            }
+            memcpy(out + outLen, &(pInflater->dict[pInflater->pendingStart]), copyLen);
+            outLen += copyLen;
+            pInflater->pendingStart += copyLen;
+            pInflater->pendingLen   -= copyLen;
+            continue;
+        }
+
+        if (pInflater->streamEnd)
+        {
+            break;
+        }
+
+        size_t inBytes  = inLen - inUsed;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - pInflater->dictOfs;
+
+        tinfl_status status = tinfl_decompress(&(pInflater->decomp),
+                                               in + inUsed, &inBytes,
+                                               pInflater->dict, &(pInflater->dict[pInflater->dictOfs]), &outBytes,
+                                               TINFL_FLAG_HAS_MORE_INPUT);
+        inUsed += inBytes;
+        pInflater->pendingStart = pInflater->dictOfs;
+        pInflater->pendingLen   = outBytes;
+        pInflater->dictOfs      = (pInflater->dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status < TINFL_STATUS_DONE)
+        {
+            LogSerial_Error("tinfl_decompress failed: %d", (int)status);
+            return false;
+        }
+        else if (status == TINFL_STATUS_DONE)
+        {
+            pInflater->streamEnd = true;
+        }
+        else if (inBytes == 0 && outBytes == 0)
+        {
+            //Needs more input
+            break;
+        }
+    }
+
+    *pInUsed = inUsed;
+    *pOutLen = outLen;
+    *pStreamEnd = (pInflater->streamEnd && pInflater->pendingLen == 0);
+    return true;
+}
+
+//Same CRC32 as zlib's (and the gzip trailer's), from the ESP32 ROM
+static uint32_t updateCrc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    return crc32_le(crc, data, (uint32_t)len);
+}
+#else
+static void *inflaterCreate(void)
+{
+    z_stream *pStream = (z_stream *)calloc(1, sizeof(z_stream));
+
+    //Negative window bits: raw deflate data (we parse the gzip header/trailer ourselves)
+    if (pStream != NULL && inflateInit2(pStream, -MAX_WBITS) != Z_OK)
+    {
+        free(pStream);
+        pStream = NULL;
+    }
+    return pStream;
+}
+
+static void inflaterDestroy(void *pState)
+{
+    inflateEnd((z_stream *)pState);
+    free(pState);
+}
+
+static bool inflaterStep(void *pState, const uint8_t *in, size_t inLen, size_t *pInUsed,
+                         uint8_t *out, size_t outSpace, size_t *pOutLen, bool *pStreamEnd)
+{
+    z_stream *pStream = (z_stream *)pState;
+
+    pStream->next_in   = (Bytef *)in;
+    pStream->avail_in  = (uInt)inLen;
+    pStream->next_out  = (Bytef *)out;
+    pStream->avail_out = (uInt)outSpace;
+
+    int zrc = inflate(pStream, Z_NO_FLUSH);
+
+    *pInUsed = inLen - pStream->avail_in;
+    *pOutLen = outSpace - pStream->avail_out;
+    *pStreamEnd = (zrc == Z_STREAM_END);
+
+    if (zrc != Z_OK && zrc != Z_STREAM_END && zrc != Z_BUF_ERROR)
+    {
+        LogSerial_Error("inflate failed: %d", zrc);
+        return false;
+    }
+    return true;
+}
+
+static uint32_t updateCrc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    return crc32(crc, data, (uInt)len);
+}
+#endif
+
+int32_t gzipDecoder_init(GzipDecoder_t *pDecoder)
+{
+    memset(pDecoder, 0, sizeof(GzipDecoder_t));
+    pDecoder->state = INKY_GZIP_STATE_HDR_FIXED;
+    pDecoder->pInflater = inflaterCreate();
+
+    if (pDecoder->pInflater == NULL)
+    {
+        LogSerial_Error("Failed to allocate gzip decompressor");
+        logProblem(INKY_SEVERITY_ERROR);
+        pDecoder->state = INKY_GZIP_STATE_FAILED;
+        return INKY_GZIP_RC_NOMEM;
+    }
+    return INKY_GZIP_RC_OK;
+}
+
+void gzipDecoder_free(GzipDecoder_t *pDecoder)
+{
+    if (pDecoder->pInflater != NULL)
+    {
+        inflaterDestroy(pDecoder->pInflater);
+        pDecoder->pInflater = NULL;
+    }
+}
+
+//Move to the next optional header field that the FLG byte says is present
+static void nextHeaderField(GzipDecoder_t *pDecoder)
+{
+    uint32_t state = pDecoder->state;
+    pDecoder->fieldBytes = 0;
+
+    if (state < INKY_GZIP_STATE_HDR_XLEN && (pDecoder->flags & INKY_GZIP_FLG_FEXTRA))
+    {
+        pDecoder->state = INKY_GZIP_STATE_HDR_XLEN;
+    }
+    else if (state < INKY_GZIP_STATE_HDR_NAME && (pDecoder->flags & INKY_GZIP_FLG_FNAME))
+    {
+        pDecoder->state = INKY_GZIP_STATE_HDR_NAME;
+    }
+    else if (state < INKY_GZIP_STATE_HDR_COMMENT && (pDecoder->flags & INKY_GZIP_FLG_FCOMMENT))
+    {
+        pDecoder->state = INKY_GZIP_STATE_HDR_COMMENT;
+    }
+    else if (state < INKY_GZIP_STATE_HDR_CRC && (pDecoder->flags & INKY_GZIP_FLG_FHCRC))
+    {
+        pDecoder->state = INKY_GZIP_STATE_HDR_CRC;
+    }
+    else
+    {
+        pDecoder->state = INKY_GZIP_STATE_DEFLATE;
+    }
+}
+
+int32_t gzipDecoder_inflate(GzipDecoder_t *pDecoder, const char *in, size_t inLen, size_t *pInUsed,
+                            char *out, size_t outSpace, size_t *pOutLen)
+{
+    size_t inPos  = 0;
+    size_t outLen = 0;
+    int32_t rc = INKY_GZIP_RC_OK;
+    bool needMore = false; //Need more input or more output space
+
+    while (rc == INKY_GZIP_RC_OK && !needMore)
+    {
+        if (   pDecoder->state != INKY_GZIP_STATE_DEFLATE
+            && pDecoder->state != INKY_GZIP_STATE_COMPLETE
+            && pDecoder->state != INKY_GZIP_STATE_FAILED
+            && inPos == inLen)
+        {
+            break;
+        }
+
+        switch (pDecoder->state)
+        {
+            case INKY_GZIP_STATE_HDR_FIXED:
+                pDecoder->fieldBuf[pDecoder->fieldBytes++] = (uint8_t)in[inPos++];
+
+                if (pDecoder->fieldBytes == INKY_GZIP_HDR_FIXED_BYTES)
+                {
+                    //ID1, ID2 then CM (8 = deflate)
+                    if (   pDecoder->fieldBuf[0] != 0x1f || pDecoder->fieldBuf[1] != 0x8b
+                        || pDecoder->fieldBuf[2] != 8)
+                    {
+                        LogSerial_Error("Data is not gzip (starts 0x%02x 0x%02x 0x%02x)",
+                                   pDecoder->fieldBuf[0], pDecoder->fieldBuf[1], pDecoder->fieldBuf[2]);
+                        pDecoder->state = INKY_GZIP_STATE_FAILED;
+                    }
+                    else
+                    {
+                        pDecoder->flags = pDecoder->fieldBuf[3];
+                        nextHeaderField(pDecoder);
+                    }
+                }
+                break;
+
+            case INKY_GZIP_STATE_HDR_XLEN:
+                pDecoder->fieldBuf[pDecoder->fieldBytes++] = (uint8_t)in[inPos++];
+
+                if (pDecoder->fieldBytes == 2)
+                {
+                    pDecoder->extraRemaining = pDecoder->fieldBuf[0] | ((uint32_t)pDecoder->fieldBuf[1] << 8);
+                    pDecoder->state = INKY_GZIP_STATE_HDR_EXTRA;
+                }
+                break;
+
+            case INKY_GZIP_STATE_HDR_EXTRA:
+            {
+                size_t skip = inLen - inPos;
+
+                if (skip > pDecoder->extraRemaining)
+                {
+                    skip = pDecoder->extraRemaining;
+                }
+                inPos += skip;
+                pDecoder->extraRemaining -= skip;
+
+                if (pDecoder->extraRemaining == 0)
+                {
+                    nextHeaderField(pDecoder);
+                }
+                break;
+            }
+
+            case INKY_GZIP_STATE_HDR_NAME:
+            case INKY_GZIP_STATE_HDR_COMMENT:
+            {
+                const char *fieldEnd = (const char *)memchr(in + inPos, '\0', inLen - inPos);
+
+                if (fieldEnd != NULL)
+                {
+                    inPos = (fieldEnd - in) + 1;
+                    nextHeaderField(pDecoder);
+                }
+                else
+                {
+                    inPos = inLen;
+                }
+                break;
+            }
+
+            case INKY_GZIP_STATE_HDR_CRC:
+                inPos++;
+                pDecoder->fieldBytes++;
+
+                if (pDecoder->fieldBytes == 2)
+                {
+                    nextHeaderField(pDecoder);
+                }
+                break;
+
+            case INKY_GZIP_STATE_DEFLATE:
+            {
+                size_t stepIn = 0;
+                size_t stepOut = 0;
+                bool streamEnd = false;
+
+                if (!inflaterStep(pDecoder->pInflater, (const uint8_t *)in + inPos, inLen - inPos, &stepIn,
+                                  (uint8_t *)out + outLen, outSpace - outLen, &stepOut, &streamEnd))
+                {
+                    pDecoder->state = INKY_GZIP_STATE_FAILED;
+                    break;
+                }
+                pDecoder->crc = updateCrc32(pDecoder->crc, (const uint8_t *)out + outLen, stepOut);
+                inPos  += stepIn;
+                outLen += stepOut;
+                pDecoder->totalOut += stepOut;
+
+                if (streamEnd)
+                {
+                    pDecoder->fieldBytes = 0;
+                    pDecoder->state = INKY_GZIP_STATE_TRAILER;
+                }
+                else if (stepIn == 0 && stepOut == 0)
+                {
+                    needMore = true;
+                }
+                break;
+            }
+
+            case INKY_GZIP_STATE_TRAILER:
+                pDecoder->fieldBuf[pDecoder->fieldBytes++] = (uint8_t)in[inPos++];
+
+                if (pDecoder->fieldBytes == INKY_GZIP_TRAILER_BYTES)
+                {
+                    //CRC32 of the uncompressed data then ISIZE: its length mod 2^32 (both little endian)
+                    uint32_t crc   =         pDecoder->fieldBuf[0]        | ((uint32_t)pDecoder->fieldBuf[1] << 8)
+                                     | ((uint32_t)pDecoder->fieldBuf[2] << 16) | ((uint32_t)pDecoder->fieldBuf[3] << 24);
+                    uint32_t isize =         pDecoder->fieldBuf[4]        | ((uint32_t)pDecoder->fieldBuf[5] << 8)
+                                     | ((uint32_t)pDecoder->fieldBuf[6] << 16) | ((uint32_t)pDecoder->fieldBuf[7] << 24);
+
+                    if (crc != pDecoder->crc)
+                    {
+                        LogSerial_Error("gzip CRC mismatch: trailer says 0x%08" PRIx32 " but inflated data has 0x%08" PRIx32,
+                                             crc, pDecoder->crc);
+                        pDecoder->state = INKY_GZIP_STATE_FAILED;
+                    }
+                    else if (isize != (uint32_t)pDecoder->totalOut)
+                    {
+                        LogSerial_Error("gzip length mismatch: trailer says %" PRIu32 " but inflated %" PRIu64,
+                                             isize, pDecoder->totalOut);
+                        pDecoder->state = INKY_GZIP_STATE_FAILED;
+                    }
+                    else
+                    {
+                        LogSerial_Info("gzip data complete: inflated %" PRIu64 " bytes to %" PRIu64,
+                                           pDecoder->totalIn + inPos, pDecoder->totalOut);
+                        pDecoder->state = INKY_GZIP_STATE_COMPLETE;
+                    }
+                }
+                break;
+
+            case INKY_GZIP_STATE_COMPLETE:
+                //Ignore anything after the end of the gzip data
+                inPos = inLen;
+                rc = INKY_GZIP_RC_COMPLETE;
+                break;
+
+            default:
+                rc = INKY_GZIP_RC_BADDATA;
+                break;
+        }
+    }
+
+    pDecoder->totalIn += inPos;
+    *pInUsed = inPos;
+    *pOutLen = outLen;
+    return rc;
+}
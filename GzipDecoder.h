@@ -0,0 +1,66 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef GZIPDECODER_H
+#define GZIPDECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Inflates an http body sent with "Content-Encoding: gzip" (RFC 1952: header, deflate data, CRC32 + length)
+//The compressed data can be fed in fragments of any size and the output is produced into
+//whatever space the caller has - so the whole decompressed document never needs to be in memory.
+//
+//On the InkPlate the inflating is done by the miniz (tinfl) in the ESP32 ROM, on Linux (for the unit
+//tests) by zlib
+
+#define INKY_GZIP_RC_OK         0
+#define INKY_GZIP_RC_COMPLETE   1  //Reached the end of the gzip data
+#define INKY_GZIP_RC_BADDATA   -1  //Not gzip data or it's corrupt
+#define INKY_GZIP_RC_NOMEM     -2
+
+#define INKY_GZIP_STATE_HDR_FIXED    0 //Reading fixed 10 bytes at start of header
+#define INKY_GZIP_STATE_HDR_XLEN     1 //Reading 2 byte length of extra field
+#define INKY_GZIP_STATE_HDR_EXTRA    2 //Skipping extra field
+#define INKY_GZIP_STATE_HDR_NAME     3 //Skipping \0 terminated original filename
+#define INKY_GZIP_STATE_HDR_COMMENT  4 //Skipping \0 terminated comment
+#define INKY_GZIP_STATE_HDR_CRC      5 //Skipping 2 byte header CRC
+#define INKY_GZIP_STATE_DEFLATE      6 //Inflating the compressed data
+#define INKY_GZIP_STATE_TRAILER      7 //Reading 8 byte trailer
+#define INKY_GZIP_STATE_COMPLETE     8
+#define INKY_GZIP_STATE_FAILED       9
+
+#define INKY_GZIP_HDR_FIXED_BYTES   10
+#define INKY_GZIP_TRAILER_BYTES      8
+
+typedef struct {
+    uint32_t state;          //One of the INKY_GZIP_STATE_* constants
+    uint8_t  flags;          //FLG byte from the header
+    uint32_t fieldBytes;     //Bytes of the current header field/trailer read so far
+    uint32_t extraRemaining; //Bytes of the extra header field still to skip
+    uint8_t  fieldBuf[INKY_GZIP_HDR_FIXED_BYTES];
+    uint64_t totalIn;        //Count of compressed bytes consumed
+    uint64_t totalOut;       //Count of decompressed bytes produced
+    uint32_t crc;            //CRC32 of the decompressed bytes so far (checked against the trailer)
+    void     *pInflater;     //Decompressor state (including its 32KB window)
+} GzipDecoder_t;
+
+//Allocates the decompressor state - returns INKY_GZIP_RC_OK or INKY_GZIP_RC_NOMEM
+int32_t gzipDecoder_init(GzipDecoder_t *pDecoder);
+void gzipDecoder_free(GzipDecoder_t *pDecoder);
+
+//Inflates compressed data from in into out
+// input: in/inLen         - compressed data
+// output: pInUsed         - bytes of in consumed. If less than inLen, out is full: call again with more space
+// output: out/outSpace    - where to put decompressed data
+// output: pOutLen         - bytes put in out. If it is outSpace there may be more output even
+//                           if all input is consumed: call again (inLen can be 0)
+// returns INKY_GZIP_RC_OK, INKY_GZIP_RC_COMPLETE or INKY_GZIP_RC_BADDATA
+int32_t gzipDecoder_inflate(GzipDecoder_t *pDecoder, const char *in, size_t inLen, size_t *pInUsed,
+                            char *out, size_t outSpace, size_t *pOutLen);
+
+#endif
@@ -0,0 +1,440 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#else
+#include <chrono>
+#endif
+
+#include "HttpResponse.h"
+#include "BodyDecoder.h"
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <inttypes.h>
+
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+//Try to parse data only when we have at least this many bytes
+#define INKY_HTTPRESP_MINIMUM_PARSE_SIZE 50000
+
+//Data is passed from the receiving task to the parser in blocks of this size
+#define INKY_HTTPRESP_BLOCK_SIZE  8192
+#define INKY_HTTPRESP_NUM_BLOCKS  4
+
+//Longest header line we look at (longer ones are skipped)
+#define INKY_HTTPRESP_MAXBYTES_HEADER_LINE 256
+
+#ifdef ARDUINO
+static uint64_t nowMillis(void)
+{
+    return millis();
+}
+#else
+static uint64_t nowMillis(void)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+void httpResponse_setEncodings(HttpResponseInfo_t *pInfo, const char *transferEncoding, const char *contentEncoding)
+{
+    pInfo->chunked = false;
+    pInfo->gzipped = false;
+
+    if(transferEncoding[0] != '\0' && strcasecmp(transferEncoding, "chunked") == 0)
+    {
+        LogSerial_Info("Found the Transfer-Encoding: chunked header");
+        pInfo->chunked = true;
+    }
+    else
+    {
+        if (transferEncoding[0] != '\0')
+        {
+            LogSerial_Info("Found unexpected transfer encoding header: '%s'", transferEncoding);
+            LogSerial_Warning("Assuming chunked");
+            pInfo->chunked = true;
+        }
+        else
+        {
+          LogSerial_Info("Did not find the transfer encoding header");
+        }
+    }
+
+    if (contentEncoding[0] != '\0')
+    {
+        if (strcasecmp(contentEncoding, "gzip") == 0 || strcasecmp(contentEncoding, "x-gzip") == 0)
+        {
+            LogSerial_Info("Found the Content-Encoding: gzip header");
+            pInfo->gzipped = true;
+        }
+        else if (strcasecmp(contentEncoding, "identity") != 0)
+        {
+            LogSerial_Warning("Found unexpected content encoding header: '%s' - assuming not compressed", contentEncoding);
+        }
+    }
+}
+
+//A truncated validator would never match, so we store "" rather than a truncated one
+static void copyValidator(char *dest, size_t destSize, const char *value)
+{
+    size_t valueLen = strlen(value);
+
+    if (valueLen < destSize)
+    {
+        memcpy(dest, value, valueLen + 1);
+    }
+    else
+    {
+        LogSerial_Unusual("Ignoring validator that is too long (%zu chars): %s", valueLen, value);
+        dest[0] = '\0';
+    }
+}
+
+void httpResponse_setValidators(HttpResponseInfo_t *pInfo, const char *etag, const char *lastModified)
+{
+    copyValidator(pInfo->etag, sizeof(pInfo->etag), etag);
+    copyValidator(pInfo->lastModified, sizeof(pInfo->lastModified), lastModified);
+}
+
+//Reads one line (without the CRLF) - a byte at a time so we don't read into the body
+//returns false if the source ended or timed out first
+static bool readHeaderLine(ByteSource_t *pSource, uint32_t timeoutMs, char *line, size_t lineSize)
+{
+    size_t lineLen = 0;
+    uint64_t timeoutStart = nowMillis();
+
+    while (1)
+    {
+        char c;
+
+        if (pSource->read(&c, 1, pSource->context) == 0)
+        {
+            uint64_t waited = nowMillis() - timeoutStart;
+
+            if (pSource->ended(pSource->context) || waited >= timeoutMs)
+            {
+                return false;
+            }
+            pSource->wait((uint32_t)(timeoutMs - waited), pSource->context);
+            continue;
+        }
+        timeoutStart = nowMillis();
+
+        if (c == '\n')
+        {
+            break;
+        }
+        if (c != '\r' && lineLen < lineSize - 1)
+        {
+            line[lineLen++] = c;
+        }
+    }
+    line[lineLen] = '\0';
+    return true;
+}
+
+int32_t httpResponse_readHeaders(ByteSource_t *pSource, uint32_t timeoutMs, HttpResponseInfo_t *pInfo)
+{
+    char line[INKY_HTTPRESP_MAXBYTES_HEADER_LINE];
+    char transferEncoding[INKY_HTTPRESP_MAXBYTES_HEADER_LINE] = "";
+    char contentEncoding[INKY_HTTPRESP_MAXBYTES_HEADER_LINE] = "";
+
+    memset(pInfo, 0, sizeof(HttpResponseInfo_t));
+    pInfo->contentLength = INKY_BODYDEC_LENGTH_UNKNOWN;
+
+    //e.g. HTTP/1.1 200 OK
+    if (   !readHeaderLine(pSource, timeoutMs, line, sizeof(line))
+        || strncmp(line, "HTTP/", 5) != 0 || strchr(line, ' ') == NULL)
+    {
+        LogSerial_Error("Didn't find an http status line");
+        return INKY_HTTPRESP_RC_BADHEADERS;
+    }
+    pInfo->status = atoi(strchr(line, ' ') + 1);
+
+    while (1)
+    {
+        if (!readHeaderLine(pSource, timeoutMs, line, sizeof(line)))
+        {
+            LogSerial_Error("Response ended in the headers");
+            return INKY_HTTPRESP_RC_BADHEADERS;
+        }
+        if (line[0] == '\0')
+        {
+            break; //Empty line ends the headers
+        }
+
+        char *colon = strchr(line, ':');
+
+        if (colon == NULL)
+        {
+            LogSerial_Unusual("Ignoring header line without a colon: %s", line);
+            continue;
+        }
+        *colon = '\0';
+        char *value = colon + 1;
+
+        while (*value == ' ' || *value == '\t')
+        {
+            value++;
+        }
+
+        if (strcasecmp(line, "Transfer-Encoding") == 0)
+        {
+            strcpy(transferEncoding, value);
+        }
+        else if (strcasecmp(line, "Content-Encoding") == 0)
+        {
+            strcpy(contentEncoding, value);
+        }
+        else if (strcasecmp(line, "Content-Length") == 0)
+        {
+            pInfo->contentLength = strtoll(value, NULL, 10);
+        }
+        else if (strcasecmp(line, "ETag") == 0)
+        {
+            copyValidator(pInfo->etag, sizeof(pInfo->etag), value);
+        }
+        else if (strcasecmp(line, "Last-Modified") == 0)
+        {
+            copyValidator(pInfo->lastModified, sizeof(pInfo->lastModified), value);
+        }
+    }
+
+    LogSerial_Info("Response status: %d", pInfo->status);
+    httpResponse_setEncodings(pInfo, transferEncoding, contentEncoding);
+
+    if (pInfo->chunked)
+    {
+        pInfo->contentLength = INKY_BODYDEC_LENGTH_UNKNOWN;
+    }
+    return INKY_HTTPRESP_RC_OK;
+}
+
+typedef struct {
+    ByteSource_t *pSource;
+    BodyDecoder_t *pBodyDecoder;
+    const HttpBodyConfig_t *pConfig;
+    HttpBodyStats_t *pStats;
+    uint64_t receiveStart;
+    bool bodyStarted;
+    uint64_t lastprogressreport;
+} bodyProducerContext_t;
+
+//Records how long we waited for data that has just arrived
+static void noteArrival(bodyProducerContext_t *pContext, uint64_t waitedMillis, uint64_t now)
+{
+    HttpBodyStats_t *pStats = pContext->pStats;
+
+    if (!pContext->bodyStarted)
+    {
+        pContext->bodyStarted = true;
+        pStats->firstByteMillis = now - pContext->receiveStart;
+        return;
+    }
+    if (waitedMillis > pStats->longestStallMillis)
+    {
+        pStats->longestStallMillis = waitedMillis;
+    }
+    if (waitedMillis >= INKY_HTTPRESP_STALL_MILLIS)
+    {
+        pStats->stalls++;
+        pStats->stallMillis += waitedMillis;
+    }
+}
+
+//pipelineProducerFn_t that fills a block with the decoded body as it arrives
+//(filling whole blocks so the parser can fall a long way behind before we stop reading)
+static int32_t fillBlockFromSource(char *block, size_t blockSize, size_t *pLen, void *producerContext)
+{
+    bodyProducerContext_t *pContext = (bodyProducerContext_t *)producerContext;
+    ByteSource_t *pSource = pContext->pSource;
+    BodyDecoder_t *pBodyDecoder = pContext->pBodyDecoder;
+    int32_t rc = INKY_PIPELINE_RC_OK;
+    size_t len = 0;
+    //Only counts time waiting in here: not whilst the pipeline waited for the parser
+    uint64_t waitStart = nowMillis();
+
+    while (len < blockSize && rc == INKY_PIPELINE_RC_OK)
+    {
+        if (pSource->ended(pSource->context) && !bodyDecoder_hasPending(pBodyDecoder))
+        {
+            if (   !pBodyDecoder->chunked && !pBodyDecoder->gzipped
+                && pBodyDecoder->contentLength == INKY_BODYDEC_LENGTH_UNKNOWN)
+            {
+                //Server closed the connection: that's the end of a body without a length
+                rc = INKY_PIPELINE_RC_COMPLETE;
+            }
+            else
+            {
+                //...but anything else would have told the decoder it had reached the end
+                LogSerial_Error("Connection closed before the end of the body from %s (after %" PRIu64 " bytes)",
+                                   pContext->pConfig->url, pBodyDecoder->totalRaw);
+                rc = INKY_HTTPRESP_RC_INCOMPLETE;
+            }
+            break;
+        }
+
+        //Reads what has arrived, strips chunk headers and inflates into the block
+        size_t decodedLen = 0;
+        uint64_t rawBefore = pBodyDecoder->totalRaw;
+        int32_t bodyrc = bodyDecoder_decode(pBodyDecoder, pSource->read, pSource->context,
+                                            &(block[len]), blockSize - len, &decodedLen);
+        if (decodedLen > 0 && pContext->pConfig->saveFile != NULL)
+        {
+            //Errors are picked up (with ferror) by whoever opened it
+            fwrite(&(block[len]), 1, decodedLen, pContext->pConfig->saveFile);
+        }
+        len += decodedLen;
+
+        if (bodyrc == INKY_BODYDEC_RC_COMPLETE)
+        {
+            rc = INKY_PIPELINE_RC_COMPLETE;
+        }
+        else if (bodyrc == INKY_BODYDEC_RC_BADCHUNK)
+        {
+            LogSerial_Error("Failed to decode chunked data from %s", pContext->pConfig->url);
+            rc = INKY_HTTPRESP_RC_BADCHUNK;
+        }
+        else if (bodyrc != INKY_BODYDEC_RC_OK)
+        {
+            LogSerial_Error("Failed to decode compressed data from %s", pContext->pConfig->url);
+            rc = INKY_HTTPRESP_RC_BADCONTENT;
+        }
+
+        uint64_t now = nowMillis();
+
+        if (pBodyDecoder->totalRaw != rawBefore || decodedLen > 0)
+        {
+            noteArrival(pContext, now - waitStart, now);
+            waitStart = now;
+        }
+        else
+        {
+            uint32_t timeoutMs = pContext->bodyStarted ? pContext->pConfig->stallTimeoutMs
+                                                       : pContext->pConfig->firstByteTimeoutMs;
+            uint64_t waited = now - waitStart;
+
+            if (waited >= timeoutMs)
+            {
+                LogSerial_Warning("No data received for %" PRIu64 " ms from %s (%s)", waited, pContext->pConfig->url,
+                                     pContext->bodyStarted ? "stalled" : "body never started");
+                pContext->pStats->timedOut = true;
+                rc = INKY_HTTPRESP_RC_TIMEDOUT;
+            }
+            else if (rc == INKY_PIPELINE_RC_OK)
+            {
+                //Returns as soon as data arrives (or we'd time out)
+                pSource->wait((uint32_t)(timeoutMs - waited), pSource->context);
+            }
+        }
+
+        if (now - pContext->lastprogressreport > 2 * 1000)
+        {
+            LogSerial_Info("So far, received bytes of data: %" PRIu64 " (decoded: %" PRIu64 ", chunks: %" PRIu64 ")",
+                            pBodyDecoder->totalRaw, pBodyDecoder->totalDecoded, pBodyDecoder->chunkDecoder.chunks);
+            pContext->lastprogressreport = now;
+        }
+    }
+
+    *pLen = len;
+    return rc;
+}
+
+int32_t httpResponse_receiveBody(ByteSource_t *pSource, const HttpResponseInfo_t *pInfo,
+                                 const HttpBodyConfig_t *pConfig, HttpBodyStats_t *pStats)
+{
+    int32_t rc = INKY_HTTPRESP_RC_OK;
+    BodyDecoder_t bodyDecoder;
+
+    memset(pStats, 0, sizeof(HttpBodyStats_t));
+
+    if (bodyDecoder_init(&bodyDecoder, pInfo->chunked, pInfo->gzipped, pInfo->contentLength) != INKY_BODYDEC_RC_OK)
+    {
+        bodyDecoder_free(&bodyDecoder);
+        return INKY_HTTPRESP_RC_NOMEM;
+    }
+    LogSerial_Info("http size (according to Content-Length)  is: %" PRId64, pInfo->contentLength);
+
+    uint64_t receiveStart = nowMillis();
+    bodyProducerContext_t producerContext = { pSource, &bodyDecoder, pConfig, pStats, receiveStart, false, receiveStart };
+    ReceivePipelineConfig_t pipelineConfig = {};
+
+    pipelineConfig.producer        = fillBlockFromSource;
+    pipelineConfig.producerContext = &producerContext;
+    pipelineConfig.parser          = pConfig->parser;
+    pipelineConfig.parsingContext  = pConfig->parsingContext;
+    pipelineConfig.window          = pConfig->window;
+    pipelineConfig.windowSize      = pConfig->windowSize;
+    pipelineConfig.blockSize       = INKY_HTTPRESP_BLOCK_SIZE;
+    pipelineConfig.numBlocks       = INKY_HTTPRESP_NUM_BLOCKS;
+    pipelineConfig.minParseBytes   = INKY_HTTPRESP_MINIMUM_PARSE_SIZE;
+    pipelineConfig.threaded        = pConfig->threaded;
+
+    int32_t pipelinerc = receivePipeline_run(&pipelineConfig, &(pStats->pipeline));
+    pStats->receiveMillis = nowMillis() - receiveStart;
+
+    if (pipelinerc == INKY_PIPELINE_RC_BUFFULL)
+    {
+        LogSerial_Error("Receive buffer (%zu bytes) full of unparsed data from %s", pConfig->windowSize, pConfig->url);
+        logProblem(INKY_SEVERITY_ERROR);
+        rc = INKY_HTTPRESP_RC_BUFFULL;
+    }
+    else if (pipelinerc == INKY_PIPELINE_RC_PARSEFAIL)
+    {
+        LogSerial_FatalError("Failed to parse %s", pConfig->url);
+        logProblem(INKY_SEVERITY_FATAL);
+        rc = INKY_HTTPRESP_RC_PARSEFAIL;
+    }
+    else if (pipelinerc == INKY_PIPELINE_RC_PRODUCERFAIL)
+    {
+        logProblem(INKY_SEVERITY_ERROR);
+        rc = pStats->pipeline.producerRc;
+    }
+    else if (pipelinerc != INKY_PIPELINE_RC_OK)
+    {
+        rc = INKY_HTTPRESP_RC_NOMEM;
+    }
+
+    pStats->totalRaw     = bodyDecoder.totalRaw;
+    pStats->totalDecoded = bodyDecoder.totalDecoded;
+    pStats->chunks       = bodyDecoder.chunkDecoder.chunks;
+    pStats->complete     = (rc == INKY_HTTPRESP_RC_OK && bodyDecoder.complete);
+
+    LogSerial_Info("In total, received bytes of data: %" PRIu64 " in %" PRIu64 " ms (%" PRIu64 " bytes/sec)",
+                      pStats->totalRaw, pStats->receiveMillis,
+                      (pStats->receiveMillis > 0 ? (pStats->totalRaw * 1000) / pStats->receiveMillis : pStats->totalRaw));
+    if (pInfo->gzipped)
+    {
+        LogSerial_Info("In total, decompressed bytes of data: %" PRIu64, pStats->totalDecoded);
+    }
+    LogSerial_Info("In total, moved bytes of unparsed data: %" PRIu64, pStats->pipeline.totalMoved);
+    LogSerial_Info("In total, parsed bytes of data: %" PRIu64 " (%" PRIu64 " blocks, %" PRIu64 " parses)",
+                      pStats->pipeline.totalParsed, pStats->pipeline.blocks, pStats->pipeline.parses);
+    LogSerial_Info("Body started after %" PRIu64 " ms, longest stall %" PRIu64 " ms (%" PRIu64 " stalls of %d+ ms, totalling %" PRIu64 " ms)%s",
+                      pStats->firstByteMillis, pStats->longestStallMillis, pStats->stalls, INKY_HTTPRESP_STALL_MILLIS,
+                      pStats->stallMillis, pStats->timedOut ? " - timed out" : "");
+    LogSerial_Info("Receiving waited for parser %" PRIu64 " ms, parser waited for data %" PRIu64 " ms",
+                      pStats->pipeline.producerWaitMicros / 1000, pStats->pipeline.parserWaitMicros / 1000);
+
+    bodyDecoder_free(&bodyDecoder);
+    return rc;
+}
+
+bool httpResponse_getValidators(const HttpResponseInfo_t *pInfo, int32_t rc, char *etag, char *lastModified)
+{
+    if (pInfo->status != 200 || rc != INKY_HTTPRESP_RC_OK)
+    {
+        return false;
+    }
+    strcpy(etag, pInfo->etag);
+    strcpy(lastModified, pInfo->lastModified);
+    return true;
+}
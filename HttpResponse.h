@@ -0,0 +1,104 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef HTTPRESPONSE_H
+#define HTTPRESPONSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "ByteSource.h"
+#include "BodyDecoder.h"
+#include "ReceivePipeline.h"
+
+//Receives an http response body from a ByteSource: decodes it (BodyDecoder) and feeds it to
+//a parser through the receive pipeline. This is what Network::getData does once HTTPClient
+//has read the response headers - it doesn't know about HTTPClient so the whole
+//receive/decode/parse path can be tested and benchmarked on Linux.
+//
+//For sources that also hold the headers (e.g. a response captured with openssl s_client)
+//httpResponse_readHeaders() reads them first.
+
+//Same values as the equivalent NETWORK_RC_* in Network.h
+#define INKY_HTTPRESP_RC_OK           0
+#define INKY_HTTPRESP_RC_BUFFULL     -1  //Unparsed data filled the receive window
+#define INKY_HTTPRESP_RC_PARSEFAIL   -2
+#define INKY_HTTPRESP_RC_BADCHUNK    -3  //Transfer-Encoding: chunked data was invalid
+#define INKY_HTTPRESP_RC_BADCONTENT  -4  //Content-Encoding: gzip data was invalid
+#define INKY_HTTPRESP_RC_NOMEM       -5
+#define INKY_HTTPRESP_RC_BADHEADERS  -7  //Couldn't read the status line and headers
+#define INKY_HTTPRESP_RC_TIMEDOUT    -8  //Gave up waiting for the body to start or continue
+#define INKY_HTTPRESP_RC_INCOMPLETE  -9  //Connection closed before the end of the chunked encoding, Content-Length or gzip data
+
+//Waits for data at least this long are counted as stalls (see HttpBodyStats_t)
+#define INKY_HTTPRESP_STALL_MILLIS  200
+
+//Same sizes as NETWORK_MAXBYTES_* in Network.h
+#define INKY_HTTPRESP_MAXBYTES_ETAG          72
+#define INKY_HTTPRESP_MAXBYTES_LASTMODIFIED  32
+
+typedef struct {
+    int status;              //e.g. 200
+    bool chunked;            //Transfer-Encoding: chunked
+    bool gzipped;            //Content-Encoding: gzip
+    int64_t contentLength;   //INKY_BODYDEC_LENGTH_UNKNOWN if not sent
+    char etag[INKY_HTTPRESP_MAXBYTES_ETAG];                  //"" if not sent (or too long to use)
+    char lastModified[INKY_HTTPRESP_MAXBYTES_LASTMODIFIED];  //"" if not sent (or too long to use)
+} HttpResponseInfo_t;
+
+typedef struct {
+    pipelineParsingFn_t *parser;
+    void *parsingContext;
+    char *window;              //Receive window the parser is given data in
+    size_t windowSize;
+    bool threaded;             //Receive on its own task whilst parsing (see ReceivePipeline.h)
+    uint32_t firstByteTimeoutMs; //Give up if the body hasn't started after this long...
+    uint32_t stallTimeoutMs;     //...or (once it has) no more arrives for this long (with INKY_HTTPRESP_RC_TIMEDOUT)
+    const char *url;           //For log messages
+    FILE *saveFile;            //If not NULL, the decoded body is also written here (see DownloadCache.h)
+} HttpBodyConfig_t;
+
+typedef struct {
+    uint64_t totalRaw;         //Bytes of body as sent
+    uint64_t totalDecoded;     //Bytes after dechunking and inflating
+    uint64_t chunks;
+    uint64_t receiveMillis;
+    uint64_t firstByteMillis;    //Time until the first byte of body arrived
+    uint64_t longestStallMillis; //Longest wait for more data once the body had started
+    uint64_t stalls;             //Waits of at least INKY_HTTPRESP_STALL_MILLIS...
+    uint64_t stallMillis;        //...and how long they added up to
+    bool timedOut;             //Gave up waiting for data
+    bool complete;             //Read to the end of the body (rather than it stopping or failing)
+    ReceivePipelineStats_t pipeline;
+} HttpBodyStats_t;
+
+//Sets the chunked/gzipped flags in pInfo from the values of the Transfer-Encoding and
+//Content-Encoding headers ("" if the header wasn't sent)
+void httpResponse_setEncodings(HttpResponseInfo_t *pInfo, const char *transferEncoding, const char *contentEncoding);
+
+//Sets the etag/lastModified in pInfo from the values of the ETag and Last-Modified headers ("" if the
+//header wasn't sent)
+void httpResponse_setValidators(HttpResponseInfo_t *pInfo, const char *etag, const char *lastModified);
+
+//Reads the status line and headers (and nothing of the body) from pSource
+//returns INKY_HTTPRESP_RC_OK or INKY_HTTPRESP_RC_BADHEADERS
+int32_t httpResponse_readHeaders(ByteSource_t *pSource, uint32_t timeoutMs, HttpResponseInfo_t *pInfo);
+
+//Receives, decodes and parses the body from pSource
+//returns INKY_HTTPRESP_RC_OK or an error (e.g. INKY_HTTPRESP_RC_INCOMPLETE or INKY_HTTPRESP_RC_TIMEDOUT
+//if we only got part of it)
+int32_t httpResponse_receiveBody(ByteSource_t *pSource, const HttpResponseInfo_t *pInfo,
+                                 const HttpBodyConfig_t *pConfig, HttpBodyStats_t *pStats);
+
+//Copies the response's validators into etag and lastModified (INKY_HTTPRESP_MAXBYTES_* bytes) - but only
+//for a 200 whose body we received in full (rc from httpResponse_receiveBody), so part of a calendar is never
+//stored as the version the server has. Otherwise leaves them unchanged
+//returns true if they were copied
+bool httpResponse_getValidators(const HttpResponseInfo_t *pInfo, int32_t rc, char *etag, char *lastModified);
+
+#endif
@@ -45,6 +45,9 @@
 #include "Network.h"
 #include "entry.h"
 #include "Calendar.h"
+#include "CalendarCache.h"
+#include "DownloadCache.h"
+#include "WakeStats.h"
 #include "secrets.h"
 #include "LogSerial.h"
 
@@ -80,6 +83,10 @@ char *data;
 //#define DATA_BUFFER_SIZE 2000000LL
 #define DATA_BUFFER_SIZE 100000LL
 
+//Save each calendar to flash (LittleFS) so it can be parsed again without downloading it
+//e.g. if downloading fails (see DownloadCache.h)
+#define USE_DOWNLOAD_CACHE true
+
 //If we are asked for random colours for entries we cycle through 
 //the colours (skipping black and white)
 int8_t currentColor = INKY_EVENT_COLOUR_GREEN;
@@ -97,7 +104,8 @@ uint32_t numCalendars = 0;
 
 
 // All our functions declared below setup and loop
-bool parseAllCalendars();
+bool parseAllCalendars(bool online);
+bool parseSavedCalendar(Calendar_t *pCal, CalendarParsingContext_t *pContext, CalendarStats_t *pCalStats);
 void drawInfo();
 void drawGrid();
 bool drawEvent(entry_t *event, int day, int beginY, int maxHeigth, int *heigthNeeded);
@@ -115,7 +123,8 @@ void setup()
     display.setTextWrap(false);
     display.setTextColor(0, 7);
 
-    network.begin(timezoneString);
+    //If wifi doesn't connect we can still show the calendars as we last downloaded them
+    int networkrc = network.begin(timezoneString);
 
     resetEntries();
 
@@ -130,7 +139,25 @@ void setup()
 
     setCalendarRange(calendarStart, 3);
 
-    if ( parseAllCalendars() ) // Try getting data
+    if (USE_DOWNLOAD_CACHE)
+    {
+        downloadCache_begin(INKY_DOWNLOADCACHE_LITTLEFS_PATH);
+    }
+
+    bool gotCalendars = false;
+
+    if (networkrc == NETWORK_RC_NOTIME)
+    {
+        LogSerial_FatalError("No WiFi and the time isn't known - can't show any calendars");
+        logProblem(INKY_SEVERITY_FATAL);
+    }
+    else
+    {
+        gotCalendars = parseAllCalendars(networkrc == NETWORK_RC_OK); // Try getting data
+    }
+    network.end();
+
+    if ( gotCalendars )
     {
         LogSerial_Info("About to start sorting");
         SortEntries();
@@ -145,6 +172,17 @@ void setup()
         display.display();
     }
 
+    //One line of JSON saying how this wake went (see WakeStats.h) - too long for LogSerial
+    char *statsJson = (char *)malloc(INKY_WAKESTATS_MAXBYTES_JSON);
+
+    if (statsJson != NULL
+          && wakeStats_toJson(statsJson, INKY_WAKESTATS_MAXBYTES_JSON, millis(),
+                              loggedWarnings, loggedErrors, loggedFatals) > 0)
+    {
+        Serial.println(statsJson);
+    }
+    free(statsJson);
+
     // Enable wakeup from deep sleep on gpio 36 (wake button)
     esp_sleep_enable_ext0_wakeup(GPIO_NUM_36, 0);
 
@@ -158,7 +196,29 @@ void loop()
     // Never here
 }
 
-bool parseAllCalendars()
+//Parses the copy of the calendar saved by the download cache
+//returns false if there isn't one or it couldn't be parsed
+bool parseSavedCalendar(Calendar_t *pCal, CalendarParsingContext_t *pContext, CalendarStats_t *pCalStats)
+{
+    HttpBodyStats_t bodyStats = {};
+    int32_t rc = downloadCache_parse(pCal->url, parsePartialDataForEvents, pContext, DATA_BUFFER_SIZE, &bodyStats);
+    finishCalendarParsing(pContext);
+
+    if (rc != INKY_DOWNLOADCACHE_RC_NOTSAVED && pCalStats != NULL)
+    {
+        wakeStats_addBody(pCalStats, &bodyStats);
+    }
+
+    if (rc != 0)
+    {
+        LogSerial_Error("Failed (rc=%d) to parse saved copy of %s", (int)rc, pCal->url);
+        return false;
+    }
+    return true;
+}
+
+//If we're not online each calendar is parsed from the copy saved by the download cache
+bool parseAllCalendars(bool online)
 {
     bool allok = true;
     Calendar_t *pCal = &Calendars[0];
@@ -170,17 +230,124 @@ bool parseAllCalendars()
         context.calRelevantEvents = 0;
         context.calEvents = 0;
 
+        uint32_t calIndex = numCalendars;
         numCalendars++;        
 
-        int networkrc =  network.getData(pCal->url, DATA_BUFFER_SIZE, 
-                              parsePartialDataForEvents, &context);
+        CalendarStats_t *pCalStats = wakeStats_addCalendar(calIndex);
+        uint8_t result = INKY_WAKESTATS_RESULT_FAILED;
+
+        //If we have the entries from last time, the server can tell us the calendar is unchanged.
+        //If not (e.g. they were for a different calendar range) but we have a saved copy of it, the
+        //server can tell us that is still current
+        NetworkValidators_t validators;
+        bool haveCachedEntries = calendarCache_getValidators(calIndex, pCal->url, &validators);
+
+        if (!haveCachedEntries)
+        {
+            downloadCache_getValidators(pCal->url, validators.etag, NETWORK_MAXBYTES_ETAG,
+                                        validators.lastModified, NETWORK_MAXBYTES_LASTMODIFIED);
+        }
+        int firstEntry = entriesNum;
+
+        int networkrc = NETWORK_RC_CONNECTFAIL;
+
+        if (online)
+        {
+            NetworkTimeouts_t timeouts = { pCal->firstByteTimeoutMs, pCal->stallTimeoutMs };
+            FILE *saveFile = downloadCache_startSave(pCal->url);
+
+            networkrc =  network.getData(pCal->url, DATA_BUFFER_SIZE, 
+                                  parsePartialDataForEvents, &context, &validators, &timeouts, saveFile,
+                                  pCalStats);
+
+            //Only a body received in full replaces the saved copy and its validators: getData doesn't
+            //return NETWORK_RC_OK if it timed out or the connection closed part way through
+            bool bodyComplete = (networkrc == NETWORK_RC_OK);
+
+            downloadCache_finishSave(pCal->url, saveFile, bodyComplete,
+                                     validators.etag, validators.lastModified);
+            finishCalendarParsing(&context);
+        }
+
+        if (networkrc == NETWORK_RC_NOTMODIFIED && haveCachedEntries)
+        {
+            if (calendarCache_restoreEntries(calIndex, &context))
+            {
+                result = INKY_WAKESTATS_RESULT_CACHED;
+            }
+            else
+            {
+                allok = false;
+            }
+        }
+        else if (networkrc == NETWORK_RC_NOTMODIFIED)
+        {
+            //Our saved copy is current
+            if (parseSavedCalendar(pCal, &context, pCalStats))
+            {
+                calendarCache_store(calIndex, pCal->url, &validators, firstEntry, &context);
+                result = INKY_WAKESTATS_RESULT_SAVED;
+            }
+            else
+            {
+                logProblem(INKY_SEVERITY_FATAL);
+                allok = false;
+            }
+        }
+        else if (networkrc == NETWORK_RC_OK)
+        {
+            calendarCache_store(calIndex, pCal->url, &validators, firstEntry, &context);
+            result = INKY_WAKESTATS_RESULT_DOWNLOADED;
+        }
+        else if (!online)
+        {
+            //The entries cached from last time are still what the server has, but may be for a different
+            //range of days - the saved copy always gives the right ones
+            if (parseSavedCalendar(pCal, &context, pCalStats))
+            {
+                result = INKY_WAKESTATS_RESULT_SAVED;
+                LogSerial_Warning("No WiFi - used saved copy of %s", pCal->url);
+            }
+            else
+            {
+                LogSerial_FatalError("No WiFi and no saved copy of %s", pCal->url);
+                logProblem(INKY_SEVERITY_FATAL);
+                allok = false;
+            }
+        }
+        else
+        {
+            calendarCache_invalidate(calIndex);
+
+            //Drop any entries from what we did get and show the calendar as it was when we last downloaded it
+            //(parsing it counted its events in the totals drawInfo() shows, as parsing the saved copy will)
+            entriesNum = firstEntry;
+            removeFromEventStats(context.calRelevantEvents, context.calEvents);
+            context.calRelevantEvents = 0;
+            context.calEvents = 0;
+
+            if (parseSavedCalendar(pCal, &context, pCalStats))
+            {
+                result = INKY_WAKESTATS_RESULT_SAVED;
+                LogSerial_Error("Failed (rc=%d) in network read of %s - used saved copy",
+                      networkrc, pCal->url);
+                logProblem(INKY_SEVERITY_ERROR);
+            }
+            else
+            {
+                LogSerial_FatalError("Failed (rc=%d) in network read of %s",
+                      networkrc, pCal->url);
+                logProblem(INKY_SEVERITY_FATAL);
+                allok = false;
+            }
+        }
 
-        if (networkrc != NETWORK_RC_OK)
+        if (pCalStats != NULL)
         {
-            LogSerial_FatalError("Failed (rc=%d) in network read of %s",
-                  networkrc, pCal->url);
-            logProblem(INKY_SEVERITY_FATAL);
-            allok = false;
+            pCalStats->result         = result;
+            pCalStats->rc             = networkrc;
+            pCalStats->eventsSeen     = context.calEvents;
+            pCalStats->eventsRelevant = context.calRelevantEvents;
         }
         pCal++;
     }
@@ -12,6 +12,7 @@
 #define INKYCALINTERNAL_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define INKY_SEVERITY_WARNING 10
 #define INKY_SEVERITY_ERROR   20
@@ -20,4 +21,26 @@
  //At end of processing we record number of errors
 void logProblem(uint32_t severity);//Currently in InkyCal.ino
 
+//Large buffers go in the "psram" (separate external memory) on the InkPlate
+//(files using this need to include Arduino.h when building for the InkPlate)
+#ifdef ARDUINO
+#define INKY_MALLOC_LARGE(size) ps_malloc(size)
+#else
+#define INKY_MALLOC_LARGE(size) malloc(size)
+#endif
+
+//FNV-1a hash of len bytes of data (e.g. a url, to notice when a different one is configured,
+//or a key in a hash table) - never 0, so 0 can mark an empty slot
+static inline uint32_t inky_fnv1a(const char *data, size_t len)
+{
+    uint32_t hash = 2166136261UL;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619UL;
+    }
+    return (hash != 0) ? hash : 1;
+}
+
 #endif
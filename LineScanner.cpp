@@ -0,0 +1,153 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "LineScanner.h"
+#include <string.h>
+
+#if defined(__SSE2__) && !defined(ARDUINO)
+#include <emmintrin.h>
+#define INKY_LINESCAN_SSE2 1
+#endif
+
+#define INKY_LINESCAN_ONES  0x01010101UL
+#define INKY_LINESCAN_HIGHS 0x80808080UL
+
+//Every byte of a word set to c
+#define INKY_LINESCAN_REPEAT(c) (INKY_LINESCAN_ONES * (uint8_t)(c))
+
+static inline bool isSpecial(char c)
+{
+    return c == '\0' || c == '\n' || c == '\r' || c == '\\';
+}
+
+//Non-zero if any byte of word is zero. The lowest flagged byte is always a real zero byte (the
+//borrows that can flag others only go up), but we find it by checking bytes rather than
+//counting bits, so it doesn't matter whether the word is little or big endian
+static inline uint32_t hasZeroByte(uint32_t word)
+{
+    return (word - INKY_LINESCAN_ONES) & ~word & INKY_LINESCAN_HIGHS;
+}
+
+static inline uint32_t hasSpecialByte(uint32_t word)
+{
+    return hasZeroByte(word)
+         | hasZeroByte(word ^ INKY_LINESCAN_REPEAT('\n'))
+         | hasZeroByte(word ^ INKY_LINESCAN_REPEAT('\r'))
+         | hasZeroByte(word ^ INKY_LINESCAN_REPEAT('\\'));
+}
+
+static inline uint32_t hasLineEndByte(uint32_t word)
+{
+    return hasZeroByte(word) | hasZeroByte(word ^ INKY_LINESCAN_REPEAT('\n'));
+}
+
+const char *lineScanner_findSpecialSwar(const char *src)
+{
+    //A byte at a time until aligned (aligned reads never cross into a page src doesn't use)
+    while (((uintptr_t)src & (sizeof(uint32_t) - 1)) != 0)
+    {
+        if (isSpecial(*src))
+        {
+            return src;
+        }
+        src++;
+    }
+
+    for (;;)
+    {
+        uint32_t word;
+        memcpy(&word, src, sizeof(word));  //aligned - compiles to a single load
+
+        if (hasSpecialByte(word))
+        {
+            break;
+        }
+        src += sizeof(word);
+    }
+
+    while (!isSpecial(*src))
+    {
+        src++;
+    }
+    return src;
+}
+
+#ifdef INKY_LINESCAN_SSE2
+const char *lineScanner_findSpecial(const char *src)
+{
+    const __m128i zeros        = _mm_setzero_si128();
+    const __m128i newlines     = _mm_set1_epi8('\n');
+    const __m128i returns      = _mm_set1_epi8('\r');
+    const __m128i backslashes  = _mm_set1_epi8('\\');
+
+    while (((uintptr_t)src & 15) != 0)
+    {
+        if (isSpecial(*src))
+        {
+            return src;
+        }
+        src++;
+    }
+
+    for (;;)
+    {
+        __m128i block = _mm_load_si128((const __m128i *)src);
+        __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, zeros),
+                                                  _mm_cmpeq_epi8(block, newlines)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(block, returns),
+                                                  _mm_cmpeq_epi8(block, backslashes)));
+        int mask = _mm_movemask_epi8(found);
+
+        if (mask != 0)
+        {
+            return src + __builtin_ctz(mask);
+        }
+        src += 16;
+    }
+}
+#else
+const char *lineScanner_findSpecial(const char *src)
+{
+    return lineScanner_findSpecialSwar(src);
+}
+#endif
+
+const char *lineScanner_findLineEnd(const char *src)
+{
+#ifdef INKY_LINESCAN_SSE2
+    //The C library's strchr is already vectorised
+    const char *lineEnd = strchr(src, '\n');
+    return (lineEnd != NULL) ? lineEnd : src + strlen(src);
+#else
+    while (((uintptr_t)src & (sizeof(uint32_t) - 1)) != 0)
+    {
+        if (*src == '\n' || *src == '\0')
+        {
+            return src;
+        }
+        src++;
+    }
+
+    for (;;)
+    {
+        uint32_t word;
+        memcpy(&word, src, sizeof(word));
+
+        if (hasLineEndByte(word))
+        {
+            break;
+        }
+        src += sizeof(word);
+    }
+
+    while (*src != '\n' && *src != '\0')
+    {
+        src++;
+    }
+    return src;
+#endif
+}
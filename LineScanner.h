@@ -0,0 +1,32 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef LINESCANNER_H
+#define LINESCANNER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Finds the bytes the calendar parser has to look at (line endings and escapes) several bytes
+//at a time rather than testing each one, so the runs of ordinary text between them can be
+//copied with memcpy. Uses SSE2 (16 bytes at a time) where the compiler has it and otherwise
+//tests a 32 bit word at a time with integer arithmetic ("SWAR" - on the InkPlate's Xtensa).
+//
+//src must be '\0' terminated. Scanning only reads whole aligned words/blocks, so it can read
+//a few bytes beyond the terminator but never into a page the string doesn't touch.
+
+//Next '\\', '\r', '\n' or the terminating '\0' in src
+const char *lineScanner_findSpecial(const char *src);
+
+//As lineScanner_findSpecial() but always word at a time - as used on the InkPlate (exposed so
+//it can be tested and benchmarked on machines with SSE2)
+const char *lineScanner_findSpecialSwar(const char *src);
+
+//Next '\n' or the terminating '\0' in src
+const char *lineScanner_findLineEnd(const char *src);
+
+#endif
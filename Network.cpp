@@ -8,377 +8,404 @@
 #include "InkyCalInternal.h"
 #include "Network.h"
 #include "LogSerial.h"
+#include "BodyDecoder.h"
+#include "ByteSource.h"
+#include "HttpResponse.h"
+#include "ConnectionManager.h"
+#include "NetworkCache.h"
+#include "TimeSource.h"
+#include "WakeStats.h"
 
 #include <HTTPClient.h>
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
+#include <lwip/sockets.h>
 
-//Try to parse data only when we have at least this many bytes
-#define INKY_NETWORK_MINIMUM_CHUNK_SIZE 50000
+//Receive on one core whilst parsing on the other
+#ifndef INKY_NETWORK_PIPELINED
+#define INKY_NETWORK_PIPELINED true
+#endif
 
-void Network::begin(const char *timeZoneString)
+//Unless a calendar sets its own (see NetworkTimeouts_t): give up if the response hasn't
+//started after this long or, once it has, no more data arrives for this long
+#define INKY_NETWORK_FIRSTBYTE_TIMEOUT_MS (10*1000)
+#define INKY_NETWORK_STALL_TIMEOUT_MS     (10*1000)
+
+//Connecting to the AP we used last wake, on its channel and with the address it gave us:
+//if that hasn't worked after this long, do a full connect (scan and DHCP)
+#define INKY_NETWORK_FAST_CONNECT_TIMEOUT_MS 3000
+
+//Full connect: ask wifi to reconnect if we're not connected after this long...
+#define INKY_NETWORK_CONNECT_RETRY_MS (6*1000)
+//...and give up (using saved copies of the calendars) if we still can't connect after this many tries
+#define INKY_NETWORK_CONNECT_ATTEMPTS 10
+
+int Network::begin(const char *timeZoneString)
 {
-    // Initiating wifi, like in BasicHttpClient example
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(ssid, pass);
+    unsigned long wifiStart = millis();
+    bool usedCachedWifi = false;
+    bool online = connectWifi(&usedCachedWifi);
+    wakeStats.wifiMillis = millis() - wifiStart;
+    wakeStats.wifiFast = usedCachedWifi;
 
-    int cnt = 0;
-    Serial.print(F("Waiting for WiFi to connect..."));
-    while ((WiFi.status() != WL_CONNECTED))
-    {
-        Serial.print(F("."));
-        delay(1000);
-        ++cnt;
+    // Find internet time
+    unsigned long timeStart = millis();
+    bool timeKnown = setTime(timeZoneString, online);
+    wakeStats.timeMillis = millis() - timeStart;
 
-        WiFi.reconnect();
-        delay(5000);
+    if (!online)
+    {
+        return timeKnown ? NETWORK_RC_OFFLINE : NETWORK_RC_NOTIME;
+    }
 
-        if (cnt == 10)
-        {
-            Serial.println("Can't connect to WIFI, restarting");
-            delay(100);
-            ESP.restart();
-        }
+    //The cached details are timestamped so only store them once we know the time
+    if (!usedCachedWifi)
+    {
+        rememberWifi();
     }
-    Serial.println(F(" connected"));
+    return NETWORK_RC_OK;
+}
 
-    // Find internet time
-    setTime(timeZoneString);
+void Network::end()
+{
+    connectionManager_closeAll();
+    timeSource_end();
 }
 
-static void dumpDataBufSerial(int logLevel, char *databuf, uint64_t buffOffsetFromStart)
+//Waits until wifi connects or timeoutMs passes
+//returns true if connected
+static bool waitForWifi(unsigned long timeoutMs)
 {
-    uint32_t charsPerLine = 100;
-    char line[2*charsPerLine+1]; //space to print \r as \+r etc. Extra char for null
-    uint32_t linepos = 0;
-    uint32_t linechars = 0;
-    uint64_t databufpos = 0;
-    uint64_t lineStartOffset = buffOffsetFromStart;
-    bool keepgoing = true;
-    bool lineend = false;
-
-    while (keepgoing) {
-        linepos = 0;
-        lineend = false;
-        linechars = 0;
-
-        while ((linepos < charsPerLine) && keepgoing  && !lineend) {
-            if (databuf[databufpos] != '\0') {
-                if (databuf[databufpos] == '\r') {
-                    line[linepos++] = '\\';
-                    line[linepos++] = 'r';
-                    linechars++;
-                    databufpos++;
-                } else if (databuf[databufpos] == '\n') {
-                    line[linepos++] = '\\';
-                    line[linepos++] = 'n';
-                    lineend = true;
-                    linechars++;
-                    databufpos++;
-                } else {
-                    line[linepos++] = databuf[databufpos++];
-                    linechars++;
-                }
-            } else {
-                keepgoing = false;
-            }
+    unsigned long waitStart = millis();
+
+    while (WiFi.status() != WL_CONNECTED)
+    {
+        if (millis() - waitStart >= timeoutMs)
+        {
+            return false;
         }
-        line[linepos++] = '\0';
-        LogSerial_LogImpl(logLevel, " %" PRIu64 " %s", lineStartOffset, line);
-        lineStartOffset += linechars;
+        delay(20);
     }
+    return true;
 }
 
-// Function to get all data from web
-//
-// Currently restarts device on network errors e.g. no WIFI(!)
+// Connects to wifi
 //
-// returns NETWORK_RC_OK (0) on sucess
-//         NETWORK_RC_BUFFULL if buffer was too small
-//         Positive integer: HTTP status code
-//
-int Network::getData(const char *url, size_t maxbufsize,  dataParsingFn_t parser, void *parsingContext)
+// output: pUsedCache - true if we connected using the details cached from last wake
+// returns false if we couldn't connect
+bool Network::connectWifi(bool *pUsedCache)
 {
-    // Variable to store fail
-    int rc = NETWORK_RC_OK;
-    String urlstr(url);
+    unsigned long connectStart = millis();
+    NetworkCacheWifi_t cached;
+    bool usedCache = false;
 
-    // If not connected to wifi reconnect wifi
-    if (WiFi.status() != WL_CONNECTED)
+    //Don't write the credentials to flash every time we connect
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+
+    if (networkCache_getWifi(ssid, &cached))
     {
-        WiFi.reconnect();
+        //No scan and no DHCP
+        WiFi.config(cached.ip, cached.gateway, cached.subnet, cached.dns1, cached.dns2);
+        WiFi.begin(ssid, pass, cached.channel, cached.bssid);
+        usedCache = waitForWifi(INKY_NETWORK_FAST_CONNECT_TIMEOUT_MS);
+
+        if (!usedCache)
+        {
+            LogSerial_Unusual("Couldn't connect to cached AP (channel %" PRId32 ") in %lu ms, doing full connect",
+                                  cached.channel, millis() - connectStart);
+            networkCache_invalidateWifi();
+            WiFi.disconnect();
+            //Back to DHCP
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+        }
+    }
 
-        delay(5000);
+    if (!usedCache)
+    {
+        WiFi.begin(ssid, pass);
 
         int cnt = 0;
-        Serial.println(F("Waiting for WiFi to reconnect..."));
-        while ((WiFi.status() != WL_CONNECTED))
+        Serial.print(F("Waiting for WiFi to connect..."));
+        while (!waitForWifi(INKY_NETWORK_CONNECT_RETRY_MS))
         {
-            // Prints a dot every second that wifi isn't connected
             Serial.print(F("."));
-            delay(1000);
             ++cnt;
 
-            WiFi.reconnect();
-            delay(5000);
-
-            if (cnt == 10)
+            if (cnt == INKY_NETWORK_CONNECT_ATTEMPTS)
             {
-                Serial.println("Can't connect to WIFI, restart initiated.");
-                delay(100);
-                ESP.restart();
+                Serial.println();
+                LogSerial_Error("Can't connect to WiFi after %lu ms", millis() - connectStart);
+                logProblem(INKY_SEVERITY_ERROR);
+                WiFi.disconnect();
+                *pUsedCache = false;
+                return false;
             }
+            WiFi.reconnect();
         }
+        Serial.println(F(" connected"));
     }
-    LogSerial_Info("Preparing to make http request to %s... wifi is connected", url);
 
-    // Http object used to make get request
-    HTTPClient http;
+    LogSerial_Info("WiFi connected in %lu ms (%s)", millis() - connectStart,
+                      usedCache ? "fast: cached AP and address" : "full: scan and DHCP");
+    *pUsedCache = usedCache;
+    return true;
+}
 
-    http.getStream().setTimeout(10);
-    http.getStream().flush();
+//Caches how we're connected for a fast connect next wake
+void Network::rememberWifi()
+{
+    NetworkCacheWifi_t details;
+
+    memcpy(details.bssid, WiFi.BSSID(), sizeof(details.bssid));
+    details.channel = WiFi.channel();
+    details.ip      = WiFi.localIP();
+    details.gateway = WiFi.gatewayIP();
+    details.subnet  = WiFi.subnetMask();
+    details.dns1    = WiFi.dnsIP(0);
+    details.dns2    = WiFi.dnsIP(1);
+
+    LogSerial_Verbose1("Caching wifi details: channel %" PRId32 " address %s",
+                           details.channel, details.ip.toString().c_str());
+    networkCache_storeWifi(ssid, &details);
+}
 
-    // Begin http by passing url to it
-    http.begin(urlstr);
+//The http stream as a ByteSource (see ByteSource.h) - the context is the HTTPClient
 
-    delay(300);
+static size_t readHttpStream(char *buf, size_t maxLen, void *sourceContext)
+{
+    WiFiClient *pStream = &(((HTTPClient *)sourceContext)->getStream());
+    int charsAvailable = pStream->available();
 
-    const char *headerKeys[] = {"Transfer-Encoding"};
-    const size_t headerKeysCount = sizeof(headerKeys) / sizeof(headerKeys[0]);
-    http.collectHeaders(headerKeys, headerKeysCount);
+    if (charsAvailable <= 0)
+    {
+        return 0;
+    }
+    size_t charsToRead = ((size_t)charsAvailable < maxLen) ? (size_t)charsAvailable : maxLen;
 
-    // Actually do request
-    int httpCode = http.GET();
+    return pStream->readBytes(buf, charsToRead);
+}
 
-    if (httpCode == 200)
+static bool httpStreamEnded(void *sourceContext)
+{
+    HTTPClient *pHttp = (HTTPClient *)sourceContext;
+    return !pHttp->connected() && !pHttp->getStream().available();
+}
+
+//Blocks on the socket until data (or the server closing it) arrives rather than polling
+static void waitForHttpStream(uint32_t maxWaitMs, void *sourceContext)
+{
+    int fd = ((HTTPClient *)sourceContext)->getStream().fd();
+
+    if (fd < 0)
     {
-        const char *transferEncoding = http.header("Transfer-Encoding").c_str();
-        bool chunked = false;
+        //No socket to wait on: just let other tasks (e.g. the one receiving into the stream) run
+        delay(maxWaitMs < 10 ? maxWaitMs : 10);
+        return;
+    }
+
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fd, &readable);
 
-        if(transferEncoding != NULL && strcasecmp(transferEncoding, "chunked") == 0)
+    struct timeval timeout;
+    timeout.tv_sec  = maxWaitMs / 1000;
+    timeout.tv_usec = (maxWaitMs % 1000) * 1000;
+
+    select(fd + 1, &readable, NULL, NULL, &timeout);
+}
+
+//Adds our headers to the request begun on pHttp and sends it
+//returns the HTTP status code or a (negative) HTTPClient error
+static int sendRequest(HTTPClient *pHttp, const NetworkValidators_t *pValidators, uint32_t firstByteTimeoutMs)
+{
+    //How long GET() waits for the response headers
+    pHttp->setTimeout((uint16_t)(firstByteTimeoutMs < UINT16_MAX ? firstByteTimeoutMs : UINT16_MAX));
+
+    //ICS compresses well so ask for it gzipped (it's inflated as it arrives)
+    pHttp->addHeader("Accept-Encoding", "gzip");
+
+    const char *headerKeys[] = {"Transfer-Encoding", "Content-Encoding", "ETag", "Last-Modified"};
+    const size_t headerKeysCount = sizeof(headerKeys) / sizeof(headerKeys[0]);
+    pHttp->collectHeaders(headerKeys, headerKeysCount);
+
+    if (pValidators != NULL)
+    {
+        //Ask the server to only send the data if it has changed since we last downloaded it
+        if (pValidators->etag[0] != '\0')
         {
-            LogSerial_Info("Found the Transfer-Encoding: chunked header");
-            chunked = true;
+            LogSerial_Info("Sending If-None-Match: %s", pValidators->etag);
+            pHttp->addHeader("If-None-Match", pValidators->etag);
         }
-        else
+        if (pValidators->lastModified[0] != '\0')
         {
-            if (transferEncoding != NULL)
-            {
-                LogSerial_Info("Found unexpected transfer encoding header: '%s'", transferEncoding);
-                LogSerial_Warning("Assuming chunked");
-                chunked = true;
-            }
-            else
-            {
-              LogSerial_Info("Did not find the transfer encoding header");
-            }
+            LogSerial_Info("Sending If-Modified-Since: %s", pValidators->lastModified);
+            pHttp->addHeader("If-Modified-Since", pValidators->lastModified);
         }
-        uint64_t n = 0;
-        //ps_malloc allocs special "psram" - separate external memory
-        char *databuf = (char *)ps_malloc(maxbufsize);
-        uint64_t totalReceived            = 0;
-        uint64_t totalParsed              = 0;
-        bool     inChunk                  = false;
-        bool     skipChunkEndControlChars = false;
-        char     *chunkHdrStart           = databuf;
-        uint64_t bytesRemainingInChunk    = 0;
-        uint64_t buffOffsetFromStart      = 0;
-
-        LogSerial_Info("http size (according to Content-Length)  is: %d", http.getSize());
-
-        unsigned long timeoutStart = millis();
-        unsigned long now = timeoutStart;
-        unsigned long lastprogressreport = now;
-        
-        while (    (http.connected() || http.getStream().available())
-                && (rc == NETWORK_RC_OK) 
-                && (now - timeoutStart < 10*1000))
+    }
+
+    return pHttp->GET();
+}
+
+// Function to get all data from web
+//
+// Reconnects wifi first if it has dropped
+//
+// returns NETWORK_RC_OK (0) on sucess
+//         NETWORK_RC_BUFFULL if buffer was too small
+//         NETWORK_RC_BADCHUNK if the chunked transfer-encoding was invalid
+//         NETWORK_RC_BADCONTENT if the (gzip) content-encoding was invalid
+//         NETWORK_RC_NOMEM if we couldn't allocate memory to decompress the data
+//         NETWORK_RC_CONNECTFAIL if we couldn't connect to wifi or the server
+//         NETWORK_RC_TIMEDOUT if the body didn't start or stalled for longer than the timeouts
+//         NETWORK_RC_INCOMPLETE if the connection closed before the end of the body
+//         NETWORK_RC_NOTMODIFIED if pValidators was supplied and the server says the data
+//                                is unchanged (nothing is passed to parser)
+//         Positive integer: HTTP status code
+//
+// input/output: pValidators (optional) - on entry: validators from a previous download of url ("" if none),
+//                                        only if we received all of a 200 response (NETWORK_RC_OK) are they
+//                                        replaced with the validators for the data we just downloaded
+// input: pTimeouts (optional) - how long to wait for data (default for any that are 0)
+// input: saveBody (optional) - the calendar (dechunked and inflated) is also written to this file
+// output: pStats (optional) - the connection and transfer stats are added to this
+//
+int Network::getData(const char *url, size_t maxbufsize,  dataParsingFn_t parser, void *parsingContext,
+                     NetworkValidators_t *pValidators, const NetworkTimeouts_t *pTimeouts, FILE *saveBody,
+                     CalendarStats_t *pStats)
+{
+    // Variable to store fail
+    int rc = NETWORK_RC_OK;
+    unsigned long getDataStart = millis();
+    uint32_t firstByteTimeoutMs = INKY_NETWORK_FIRSTBYTE_TIMEOUT_MS;
+    uint32_t stallTimeoutMs = INKY_NETWORK_STALL_TIMEOUT_MS;
+
+    if (pTimeouts != NULL)
+    {
+        if (pTimeouts->firstByteMs > 0)
         {
-            long charsInBatch = 0;
+            firstByteTimeoutMs = pTimeouts->firstByteMs;
+        }
+        if (pTimeouts->stallMs > 0)
+        {
+            stallTimeoutMs = pTimeouts->stallMs;
+        }
+    }
 
-            while (    http.getStream().available()
-                    && (rc == NETWORK_RC_OK) 
-                    && (charsInBatch < 500))
-            {
-                if (n < maxbufsize -1 )
-                {
-                    char nextChar = http.getStream().read();
-                    
-                    databuf[n++] = nextChar;
-                    charsInBatch++;
-                    
-                    if (chunked)
-                    {
-                        if (!inChunk) 
-                        {
-                            if (skipChunkEndControlChars)
-                            {
-                                if (nextChar != '\r' && nextChar != '\n')
-                                {
-                                    skipChunkEndControlChars = false;
-                                    chunkHdrStart = &(databuf[n-1]); // -1 as we moved n when we put nextChar in
-                                
-                                    LogSerial_Info("Chunk Hdr start (post skipping control chars) is at: (n is %" PRIu64 " and buffOffsetFromStart is %" PRIu64, 
-                                                     n, buffOffsetFromStart);
-                                }
-                            }
-                            else if (nextChar == '\n') {
-                                //We've got the complete chunk size in hex - parse it
-                                char *endpos = NULL;
-                                uint64_t chunkLength = strtoull(chunkHdrStart, &endpos, 16);
-
-                                if (endpos != NULL && endpos != chunkHdrStart)
-                                {
-                                    //We read a valid hex length
-                                    LogSerial_Info("We've found a chunk of length % " PRIu64 " (n is %" PRIu64 " and buffOffsetFromStart is %" PRIu64, 
-                                               chunkLength, n, buffOffsetFromStart);
-
-                                    if (chunkLength > 0)
-                                    {
-                                        inChunk = true;
-                                        bytesRemainingInChunk = chunkLength;
-                                        chunkHdrStart = NULL;
-                                    }
-                                    else
-                                    {
-                                        chunkHdrStart = NULL;
-                                        rc = NETWORK_RC_DATACOMPLETE;
-                                    }
-                                }
-                            }
-                        }
-                        else //in chunk
-                        {
-                            if (bytesRemainingInChunk > 0)
-                            {
-                                bytesRemainingInChunk--;
-                            }
-                            if (bytesRemainingInChunk == 0)
-                            {
-                                inChunk = false;
-
-                                chunkHdrStart = &(databuf[n]);
-
-                                skipChunkEndControlChars = true;
-                                
-                                LogSerial_Info("Got to end of Chunk! Chunk Hdr start (pre skipping control chars) is at: (n is %" PRIu64 " and buffOffsetFromStart is %" PRIu64, 
-                                                     n, buffOffsetFromStart);
-                                
-                                LogSerial_Verbose4("Dumping buffer at chunk end");
-                                databuf[n] = '\0';
-                                dumpDataBufSerial(LOGSERIAL_LEVEL_VERBOSE4, databuf, buffOffsetFromStart);
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                    rc = NETWORK_RC_BUFFULL;
-                }
-            }
+    // If not connected to wifi reconnect wifi
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        Serial.println(F("Waiting for WiFi to reconnect..."));
+        bool usedCachedWifi = false;
 
-            now = millis();
+        if (!connectWifi(&usedCachedWifi))
+        {
+            return NETWORK_RC_CONNECTFAIL;
+        }
+        if (!usedCachedWifi)
+        {
+            rememberWifi();
+        }
+    }
+    LogSerial_Info("Preparing to make http request to %s... wifi is connected", url);
 
-            if (charsInBatch > 0)
-            {
-                totalReceived += charsInBatch;
-                timeoutStart = now;
-            }
+    //Calendars on the same host share a connection: if the server closed the one we're
+    //reusing whilst it was idle the request fails, so try once more on a new connection
+    ConnectionInfo_t connInfo;
+    HTTPClient *pHttp = NULL;
+    int httpCode = 0;
+    unsigned long firstByteMillis = 0;
 
-            if (now - lastprogressreport > 2 * 1000)
-            {
-                if (chunked)
-                {
-                    LogSerial_Info("So far, received bytes of data: %" PRIu64 " (inchunk: %s, chunkBytesRemaining: %" PRIu64 ")",
-                                    totalReceived, (inChunk? "True": "False"), bytesRemainingInChunk);
-                }
-                else
-                {
-                    LogSerial_Info("So far, received bytes of data: %" PRIu64, totalReceived);
-                }
-                lastprogressreport = now;
-            }
+    for (uint32_t attempt = 0; attempt < 2; attempt++)
+    {
+        pHttp = connectionManager_acquire(url, &connInfo);
 
-            if (  rc == NETWORK_RC_BUFFULL || rc == NETWORK_RC_DATACOMPLETE
-                ||( n > INKY_NETWORK_MINIMUM_CHUNK_SIZE && rc == NETWORK_RC_OK))
-            {   
-                databuf[n] = 0;
-
-                LogSerial_Verbose3("Dumping buffer before parsing");
-                dumpDataBufSerial(LOGSERIAL_LEVEL_VERBOSE3, databuf, buffOffsetFromStart);
-
-                char *unparseddata = parser(databuf, parsingContext);
-
-                if (unparseddata == NULL)
-                {
-                    LogSerial_FatalError("Failed to parse %s", url);
-                    logProblem(INKY_SEVERITY_FATAL);
-                    rc = NETWORK_RC_PARSEFAIL;                  
-                }
-                else if (unparseddata != databuf)
-                {
-                    uint64_t justparsed = (unparseddata - databuf);
-                    totalParsed += justparsed;
-                    n -= justparsed;
-                    LogSerial_Verbose1("Moving %" PRIu64 " bytes of unparsed data", n);
-                    memmove(databuf, unparseddata, n);
-                    buffOffsetFromStart += justparsed;
-
-                    if (chunked)
-                    {
-                        if (chunkHdrStart != NULL)
-                        {
-                            //We are are moving the buffer when we have a pointer to the start of a chunk which is now been shifted
-                            //This shouldn't happen
-                            LogSerial_Error("Moving buffer when have pointer to chunk Start in the buffer - bug!");
-                            chunkHdrStart = NULL;
-                        }
-                    }
-
-                    if (rc != NETWORK_RC_DATACOMPLETE)
-                    {
-                        rc = NETWORK_RC_OK;
-                    }
-                }
-            }
+        if (pHttp == NULL)
+        {
+            return NETWORK_RC_CONNECTFAIL;
         }
-        LogSerial_Info("In total, received bytes of data: %" PRIu64, totalReceived);
-        databuf[n++] = 0;
-        LogSerial_Verbose3("Remaining data before last parse:\n%s", databuf);
+        unsigned long requestStart = millis();
+        httpCode = sendRequest(pHttp, pValidators, firstByteTimeoutMs);
+        //GET() returns once it has read the response headers
+        firstByteMillis = millis() - requestStart;
 
-        if ( n > 100)
+        if (httpCode > 0 || !connInfo.reused)
         {
-            LogSerial_Verbose3("Last 100 bytes of data:\n%s", databuf + (n-100));
+            break;
         }
+        LogSerial_Info("Request on reused connection failed (%d), reconnecting", httpCode);
+        connectionManager_release(pHttp, false);
+    }
+    HTTPClient &http = *pHttp;
+    bool keepOpen = false;
+
+    if (httpCode == 200)
+    {
+        //Keep the Strings alive whilst we use their c_str()
+        //(header() gives us an empty string if the header was not sent)
+        String transferEncodingHdr = http.header("Transfer-Encoding");
+        String contentEncodingHdr = http.header("Content-Encoding");
+        String etagHdr = http.header("ETag");
+        String lastModifiedHdr = http.header("Last-Modified");
+        HttpResponseInfo_t responseInfo;
+
+        responseInfo.status = httpCode;
+        httpResponse_setEncodings(&responseInfo, transferEncodingHdr.c_str(), contentEncodingHdr.c_str());
+        httpResponse_setValidators(&responseInfo, etagHdr.c_str(), lastModifiedHdr.c_str());
+        responseInfo.contentLength = (!responseInfo.chunked && http.getSize() >= 0) ? http.getSize()
+                                                                                    : INKY_BODYDEC_LENGTH_UNKNOWN;
 
-        LogSerial_Info("Complete buffer at end\n%s", databuf);
+        //ps_malloc allocs special "psram" - separate external memory
+        char *databuf = (char *)ps_malloc(maxbufsize);
 
-        if (n > 1 && rc == NETWORK_RC_OK)
+        if (databuf == NULL)
         {
-            LogSerial_Verbose3("Dumping buffer before final parse");
-            dumpDataBufSerial(LOGSERIAL_LEVEL_VERBOSE3, databuf, buffOffsetFromStart);
-            //Parse last data
-            char *unparseddata = parser(databuf, parsingContext);
-
-            if (unparseddata == NULL)
+            LogSerial_Error("Failed to allocate buffer to receive %s", url);
+            logProblem(INKY_SEVERITY_ERROR);
+            rc = NETWORK_RC_NOMEM;
+        }
+        else
+        {
+            ByteSource_t httpSource = { readHttpStream, httpStreamEnded, waitForHttpStream, &http };
+            HttpBodyConfig_t bodyConfig = {};
+            HttpBodyStats_t bodyStats;
+
+            bodyConfig.parser             = parser;
+            bodyConfig.parsingContext     = parsingContext;
+            bodyConfig.window             = databuf;
+            bodyConfig.windowSize         = maxbufsize;
+            bodyConfig.threaded           = INKY_NETWORK_PIPELINED;
+            bodyConfig.firstByteTimeoutMs = firstByteTimeoutMs;
+            bodyConfig.stallTimeoutMs     = stallTimeoutMs;
+            bodyConfig.url                = url;
+            bodyConfig.saveFile           = saveBody;
+
+            //INKY_HTTPRESP_RC_* values are the same as NETWORK_RC_*
+            rc = httpResponse_receiveBody(&httpSource, &responseInfo, &bodyConfig, &bodyStats);
+
+            //Only if we read to the end of the body is the connection ready for the next request
+            keepOpen = bodyStats.complete;
+
+            if (pStats != NULL)
             {
-                LogSerial_FatalError("Failed to do final parse of %s", url);
-                logProblem(INKY_SEVERITY_FATAL);
-                rc = NETWORK_RC_PARSEFAIL;                  
+                wakeStats_addBody(pStats, &bodyStats);
             }
-            else if (unparseddata != databuf)
-            { 
-                uint64_t justparsed = (unparseddata - databuf);
-                totalParsed += justparsed;
-                n -= justparsed;
-                memmove(databuf, unparseddata, n);
-                buffOffsetFromStart += justparsed;
-                LogSerial_Verbose1("Left over %" PRIu64 " bytes of data after final parse: %s", n, databuf); 
+
+            if (   pValidators != NULL
+                && httpResponse_getValidators(&responseInfo, rc, pValidators->etag, pValidators->lastModified))
+            {
+                LogSerial_Verbose1("Response validators: ETag: '%s' Last-Modified: '%s'",
+                                       pValidators->etag, pValidators->lastModified);
             }
         }
-        LogSerial_Info("In total, parsed bytes of data: %" PRIu64, totalParsed);
         free(databuf);
     }
+    else if (httpCode == 304 && pValidators != NULL)
+    {
+        LogSerial_Info("Calendar not modified since last download: %s", url);
+        rc = NETWORK_RC_NOTMODIFIED;
+        keepOpen = true; //A 304 has no body
+    }
     else
     {
         LogSerial_Error("Received HTTP Code %d", httpCode);
@@ -386,33 +413,49 @@ int Network::getData(const char *url, size_t maxbufsize,  dataParsingFn_t parser
         rc = httpCode;
     }
 
-    // end http
-    http.end();
+    connectionManager_release(pHttp, keepOpen);
+    LogSerial_Info("Response headers arrived %lu ms after sending request to %s", firstByteMillis, url);
 
-    if (rc == NETWORK_RC_DATACOMPLETE)
+    if (pStats != NULL)
     {
-        rc = NETWORK_RC_OK;
+        pStats->reusedConnection = connInfo.reused;
+        pStats->dnsMillis        = connInfo.dnsMillis;
+        pStats->connectMillis    = connInfo.connectMillis;
+        pStats->ttfbMillis       = firstByteMillis;
+        pStats->totalMillis      = millis() - getDataStart;
+    }
+
+    if (connInfo.reused)
+    {
+        LogSerial_Info("Time for calendar %s: %lu ms (reused connection, request %" PRIu32 " on it)",
+                          url, millis() - getDataStart, connInfo.requests);
+    }
+    else
+    {
+        LogSerial_Info("Time for calendar %s: %lu ms (of which connecting: %lu ms)",
+                          url, millis() - getDataStart, connInfo.connectMillis);
     }
 
     return rc;
 }
 
-void Network::setTime(const char *timeZoneString)
+// returns false if we don't know the time (we're offline and it hasn't been set since power on)
+bool Network::setTime(const char *timeZoneString, bool online)
 {
-    // Used for setting correct time
-    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+    //Only uses NTP if the clock might have drifted too far (see TimeSource.h)
+    unsigned long timeStart = millis();
 
-    Serial.print(F("Waiting for NTP time sync: "));
-    time_t nowSecs = time(nullptr);
-    while (nowSecs < 8 * 3600 * 2)
+    if (online)
+    {
+        timeSource_begin();
+    }
+    else if (!timeSource_beginOffline())
     {
-        delay(500);
-        Serial.print(F("."));
-        yield();
-        nowSecs = time(nullptr);
+        return false;
     }
+    LogSerial_Info("Time ready in %lu ms", millis() - timeStart);
 
-    Serial.println();
+    time_t nowSecs = time(nullptr);
 
     //Set the Timezone
     //Timezone handling based on:
@@ -432,4 +475,5 @@ void Network::setTime(const char *timeZoneString)
 
     Serial.print(F("Current local time: "));
     Serial.print(asctime_r(&timeinfo, temp));
+    return true;
 }
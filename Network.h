@@ -11,6 +11,8 @@
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 
+#include "WakeStats.h"
+
 // Wifi ssid and password
 extern char ssid[];
 extern char pass[];
@@ -21,7 +23,31 @@ extern char pass[];
 #define NETWORK_RC_OK           0
 #define NETWORK_RC_BUFFULL      -1
 #define NETWORK_RC_PARSEFAIL    -2 //function parsing the streamed data failed
-#define NETWORK_RC_DATACOMPLETE 1
+#define NETWORK_RC_BADCHUNK     -3 //Transfer-Encoding: chunked data was invalid
+#define NETWORK_RC_BADCONTENT   -4 //Content-Encoding: gzip data was invalid
+#define NETWORK_RC_NOMEM        -5
+#define NETWORK_RC_CONNECTFAIL  -6 //Couldn't connect to the server
+#define NETWORK_RC_TIMEDOUT     -8 //Gave up waiting for the body to start or continue
+#define NETWORK_RC_INCOMPLETE   -9 //Connection closed before the end of the body
+#define NETWORK_RC_OFFLINE     -10 //begin(): couldn't connect to wifi (but the clock can be used)
+#define NETWORK_RC_NOTIME      -11 //begin(): couldn't connect to wifi and we don't know the time
+#define NETWORK_RC_NOTMODIFIED  2  //Server sent 304: data unchanged since the validators we sent
+
+//Identify the version of a calendar we have already downloaded, so the server can tell
+//us (with a 304 Not Modified) that it hasn't changed rather than sending it again
+//(same sizes as INKY_HTTPRESP_MAXBYTES_* in HttpResponse.h)
+#define NETWORK_MAXBYTES_ETAG          72
+#define NETWORK_MAXBYTES_LASTMODIFIED  32
+typedef struct {
+    char etag[NETWORK_MAXBYTES_ETAG];                  //"" if we don't have one
+    char lastModified[NETWORK_MAXBYTES_LASTMODIFIED];  //"" if we don't have one
+} NetworkValidators_t;
+
+//How long getData waits for data (0 for the default)
+typedef struct {
+    uint32_t firstByteMs;  //For the response to start after sending the request
+    uint32_t stallMs;      //For more data once the response has started
+} NetworkTimeouts_t;
 
 //As we download data we send it in chunks to the the following function:
 //First arg: data to parse
@@ -36,12 +62,20 @@ class Network
 {
   public:
     // Functions we can access in main file
-    void begin(const char *timeZoneString);
-    int getData(const char *url, size_t maxbufsize, dataParsingFn_t parser, void *parsingContext);
+    //Connects to wifi and sets the clock
+    //returns NETWORK_RC_OK, NETWORK_RC_OFFLINE or NETWORK_RC_NOTIME
+    int begin(const char *timeZoneString);
+    int getData(const char *url, size_t maxbufsize, dataParsingFn_t parser, void *parsingContext,
+                NetworkValidators_t *pValidators = NULL, const NetworkTimeouts_t *pTimeouts = NULL,
+                FILE *saveBody = NULL, CalendarStats_t *pStats = NULL);
+    //Closes connections kept open between calls to getData and records any background NTP sync
+    void end();
 
   private:
     // Functions called from within our class
-    void setTime(const char *timeZoneString);
+    bool setTime(const char *timeZoneString, bool online);
+    bool connectWifi(bool *pUsedCache);
+    void rememberWifi();
 };
 
 #endif
@@ -0,0 +1,167 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "Arduino.h"
+
+#include "NetworkCache.h"
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+//DHCP leases are typically a day or more: don't reuse one for longer than this.
+//(The system time carries on across deep sleep so it can tell how old the entries are)
+#define INKY_NETCACHE_MAX_AGE_SECS     (12 * 60 * 60)
+
+#define INKY_NETCACHE_MAX_HOSTS        4
+#define INKY_NETCACHE_MAXBYTES_HOST   64
+
+//Addresses are stored as uint32_t: an IPAddress has a constructor which would
+//reset it on every boot (including waking from deep sleep)
+typedef struct {
+    bool valid;
+    uint32_t ssidHash;
+    time_t storedAt;
+    uint8_t bssid[6];
+    int32_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns1;
+    uint32_t dns2;
+} wifiCacheSlot_t;
+
+typedef struct {
+    bool valid;
+    time_t storedAt;
+    char host[INKY_NETCACHE_MAXBYTES_HOST];
+    uint32_t ip;
+} hostCacheSlot_t;
+
+RTC_DATA_ATTR static wifiCacheSlot_t WifiSlot;
+RTC_DATA_ATTR static hostCacheSlot_t HostSlots[INKY_NETCACHE_MAX_HOSTS];
+
+static bool isRecent(time_t storedAt)
+{
+    time_t now = time(nullptr);
+    return (now >= storedAt && now - storedAt <= INKY_NETCACHE_MAX_AGE_SECS);
+}
+
+bool networkCache_getWifi(const char *ssid, NetworkCacheWifi_t *pWifi)
+{
+    if (!WifiSlot.valid || WifiSlot.ssidHash != inky_fnv1a(ssid, strlen(ssid)))
+    {
+        return false;
+    }
+    if (!isRecent(WifiSlot.storedAt))
+    {
+        LogSerial_Info("Cached wifi details are too old to use");
+        WifiSlot.valid = false;
+        return false;
+    }
+
+    memcpy(pWifi->bssid, WifiSlot.bssid, sizeof(pWifi->bssid));
+    pWifi->channel = WifiSlot.channel;
+    pWifi->ip      = IPAddress(WifiSlot.ip);
+    pWifi->gateway = IPAddress(WifiSlot.gateway);
+    pWifi->subnet  = IPAddress(WifiSlot.subnet);
+    pWifi->dns1    = IPAddress(WifiSlot.dns1);
+    pWifi->dns2    = IPAddress(WifiSlot.dns2);
+    return true;
+}
+
+void networkCache_storeWifi(const char *ssid, const NetworkCacheWifi_t *pWifi)
+{
+    WifiSlot.ssidHash = inky_fnv1a(ssid, strlen(ssid));
+    WifiSlot.storedAt = time(nullptr);
+    memcpy(WifiSlot.bssid, pWifi->bssid, sizeof(WifiSlot.bssid));
+    WifiSlot.channel  = pWifi->channel;
+    WifiSlot.ip       = (uint32_t)pWifi->ip;
+    WifiSlot.gateway  = (uint32_t)pWifi->gateway;
+    WifiSlot.subnet   = (uint32_t)pWifi->subnet;
+    WifiSlot.dns1     = (uint32_t)pWifi->dns1;
+    WifiSlot.dns2     = (uint32_t)pWifi->dns2;
+    WifiSlot.valid    = (WifiSlot.ip != 0 && WifiSlot.channel > 0);
+}
+
+void networkCache_invalidateWifi(void)
+{
+    WifiSlot.valid = false;
+}
+
+static hostCacheSlot_t *findHost(const char *host)
+{
+    for (uint32_t i = 0; i < INKY_NETCACHE_MAX_HOSTS; i++)
+    {
+        if (HostSlots[i].valid && strcmp(HostSlots[i].host, host) == 0)
+        {
+            return &HostSlots[i];
+        }
+    }
+    return NULL;
+}
+
+bool networkCache_getHost(const char *host, IPAddress *pIp)
+{
+    hostCacheSlot_t *pSlot = findHost(host);
+
+    if (pSlot == NULL)
+    {
+        return false;
+    }
+    if (!isRecent(pSlot->storedAt))
+    {
+        pSlot->valid = false;
+        return false;
+    }
+    *pIp = IPAddress(pSlot->ip);
+    return true;
+}
+
+void networkCache_storeHost(const char *host, const IPAddress &ip)
+{
+    if (strlen(host) >= INKY_NETCACHE_MAXBYTES_HOST)
+    {
+        return;
+    }
+    hostCacheSlot_t *pSlot = findHost(host);
+
+    if (pSlot == NULL)
+    {
+        //Use a free slot or replace the oldest
+        pSlot = &HostSlots[0];
+
+        for (uint32_t i = 0; i < INKY_NETCACHE_MAX_HOSTS; i++)
+        {
+            if (!HostSlots[i].valid)
+            {
+                pSlot = &HostSlots[i];
+                break;
+            }
+            if (HostSlots[i].storedAt < pSlot->storedAt)
+            {
+                pSlot = &HostSlots[i];
+            }
+        }
+    }
+    strcpy(pSlot->host, host);
+    pSlot->ip = (uint32_t)ip;
+    pSlot->storedAt = time(nullptr);
+    pSlot->valid = true;
+}
+
+void networkCache_invalidateHost(const char *host)
+{
+    hostCacheSlot_t *pSlot = findHost(host);
+
+    if (pSlot != NULL)
+    {
+        pSlot->valid = false;
+    }
+}
@@ -0,0 +1,54 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+//Remembers (in RTC memory, which survives deep sleep) what it took to get on the network last
+//wake: the access point's BSSID and channel, the address DHCP gave us (with gateway, netmask and DNS
+//servers) and the addresses the calendar hosts resolved to. Next wake we can connect straight to
+//that AP on that channel (no scan), skip DHCP and skip the DNS lookups.
+//
+//Anything cached is dropped after INKY_NETCACHE_MAX_AGE_SECS (so we don't hold on to a DHCP lease
+//that may have expired) or if using it fails - the caller then takes the slow path and stores
+//the new results.
+
+#ifndef NETWORKCACHE_H
+#define NETWORKCACHE_H
+
+#include <stdint.h>
+
+#include <IPAddress.h>
+
+typedef struct {
+    uint8_t bssid[6];
+    int32_t channel;
+    IPAddress ip;
+    IPAddress gateway;
+    IPAddress subnet;
+    IPAddress dns1;
+    IPAddress dns2;
+} NetworkCacheWifi_t;
+
+//Fills in pWifi with how we connected to ssid last time
+//returns false if we don't have (recent enough) details for ssid
+bool networkCache_getWifi(const char *ssid, NetworkCacheWifi_t *pWifi);
+
+//Remember how we connected to ssid this time
+void networkCache_storeWifi(const char *ssid, const NetworkCacheWifi_t *pWifi);
+
+//Forget the wifi details (e.g. because connecting with them failed)
+void networkCache_invalidateWifi(void);
+
+//Finds the address host resolved to last time
+//returns false if we don't have a (recent enough) one
+bool networkCache_getHost(const char *host, IPAddress *pIp);
+
+//Remember the address of host (replacing the oldest if the cache is full)
+void networkCache_storeHost(const char *host, const IPAddress &ip);
+
+//Forget the address of host (e.g. because connecting to it failed)
+void networkCache_invalidateHost(const char *host);
+
+#endif
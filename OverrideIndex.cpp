@@ -0,0 +1,115 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#endif
+
+#include "OverrideIndex.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+overrideIndex_t *overrideIndex_create()
+{
+    overrideIndex_t *pIndex = (overrideIndex_t *)INKY_MALLOC_LARGE(sizeof(overrideIndex_t));
+
+    if (pIndex != NULL)
+    {
+        memset(pIndex, 0, sizeof(overrideIndex_t));
+    }
+    return pIndex;
+}
+
+void overrideIndex_destroy(overrideIndex_t *pIndex)
+{
+    free(pIndex);
+}
+
+//Slot to start looking in for an occurrence (the hash of a UID is spread over its occurrences
+//so a daily event doesn't fill a run of slots)
+static inline uint32_t firstSlot(uint32_t uidHash, int64_t instance)
+{
+    uint64_t mixed = ((uint64_t)uidHash ^ (uint64_t)instance) * 0x9E3779B97F4A7C15ull;
+
+    return (uint32_t)(mixed >> 32) & (OVERRIDEINDEX_SLOTS - 1);
+}
+
+overrideRecord_t *overrideIndex_find(overrideIndex_t *pIndex, uint32_t uidHash, int64_t instance)
+{
+    //Linear probing: the occurrence is before the first empty slot (records are never removed)
+    for (uint32_t slot = firstSlot(uidHash, instance); ; slot = (slot + 1) & (OVERRIDEINDEX_SLOTS - 1))
+    {
+        overrideRecord_t *pRecord = &pIndex->slots[slot];
+
+        if (pRecord->uidHash == 0)
+        {
+            return NULL;
+        }
+        if (pRecord->uidHash == uidHash && pRecord->instance == instance)
+        {
+            return pRecord;
+        }
+    }
+}
+
+overrideRecord_t *overrideIndex_add(overrideIndex_t *pIndex, uint32_t uidHash, int64_t instance,
+                                    uint8_t kind, int32_t sequence)
+{
+    if (pIndex->numRecords >= OVERRIDEINDEX_MAX_RECORDS)
+    {
+        if (!pIndex->fullLogged)
+        {
+            LogSerial_Unusual("More than %d occurrences of recurring events near the days shown - not recording any more",
+                              OVERRIDEINDEX_MAX_RECORDS);
+            pIndex->fullLogged = true;
+        }
+        return NULL;
+    }
+    uint32_t slot = firstSlot(uidHash, instance);
+
+    while (pIndex->slots[slot].uidHash != 0)
+    {
+        slot = (slot + 1) & (OVERRIDEINDEX_SLOTS - 1);
+    }
+    overrideRecord_t *pRecord = &pIndex->slots[slot];
+
+    pRecord->instance = instance;
+    pRecord->uidHash = uidHash;
+    pRecord->sequence = sequence;
+    pRecord->firstEntry = 0;
+    pRecord->numEntries = 0;
+    pRecord->kind = kind;
+    pIndex->numRecords++;
+
+    return pRecord;
+}
+
+void overrideIndex_entriesRemoved(overrideIndex_t *pIndex, int firstEntry, int numEntries)
+{
+    for (uint32_t slot = 0; slot < OVERRIDEINDEX_SLOTS; slot++)
+    {
+        overrideRecord_t *pRecord = &pIndex->slots[slot];
+
+        if (pRecord->uidHash == 0 || pRecord->numEntries == 0 || pRecord->firstEntry < firstEntry)
+        {
+            continue;
+        }
+
+        if (pRecord->firstEntry < firstEntry + numEntries)
+        {
+            pRecord->numEntries = 0;
+        }
+        else
+        {
+            pRecord->firstEntry = (int16_t)(pRecord->firstEntry - numEntries);
+        }
+    }
+}
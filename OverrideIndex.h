@@ -0,0 +1,63 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef OVERRIDEINDEX_H
+#define OVERRIDEINDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Occurrences of recurring events (keyed by UID and which occurrence) found whilst parsing a calendar,
+//so an event with a RECURRENCE-ID (a modified or cancelled occurrence) can replace the occurrence the
+//recurring event generated - whichever comes first in the calendar. A calendar can be bigger than
+//memory and is parsed as it arrives, so this is all that's kept of the events already parsed.
+//
+//Only occurrences near the days shown are recorded, in a fixed size hash table (the UID is kept as
+//a 32 bit hash - long UIDs aren't copied). If it fills up, later occurrences aren't recorded
+//(and a modified occurrence may be shown as well as the original).
+
+#define OVERRIDEINDEX_SLOTS       512  //Power of 2
+#define OVERRIDEINDEX_MAX_RECORDS 384  //Keep some slots empty so lookups stay short
+
+//What a record is for
+#define OVERRIDEINDEX_KIND_GENERATED 0  //Occurrence of a recurring event (from its RRULE)
+#define OVERRIDEINDEX_KIND_OVERRIDE  1  //Event with a RECURRENCE-ID (maybe cancelled - no entries)
+
+typedef struct overrideRecord
+{
+    int64_t instance;     //Which occurrence: day number (see daysFromCivil()) for all day events or epoch time
+    uint32_t uidHash;     //inky_fnv1a() of the UID - 0 if the slot is empty
+    int32_t sequence;     //SEQUENCE of the event the record is for
+    int16_t firstEntry;   //\__ Entries (in entries[]) of the occurrence
+    int16_t numEntries;   ///
+    uint8_t kind;         //One of the OVERRIDEINDEX_KIND_* constants
+} overrideRecord_t;
+
+typedef struct overrideIndex
+{
+    uint32_t numRecords;
+    bool fullLogged;
+    overrideRecord_t slots[OVERRIDEINDEX_SLOTS];
+} overrideIndex_t;
+
+//Allocates an empty index (in PSRAM on the InkPlate) - returns NULL if there's no memory
+overrideIndex_t *overrideIndex_create();
+void overrideIndex_destroy(overrideIndex_t *pIndex);
+
+//returns the record for an occurrence or NULL if there isn't one
+overrideRecord_t *overrideIndex_find(overrideIndex_t *pIndex, uint32_t uidHash, int64_t instance);
+
+//Adds a record (with no entries) for an occurrence that isn't in the index
+//returns NULL (having logged it the first time) if the index is full
+overrideRecord_t *overrideIndex_add(overrideIndex_t *pIndex, uint32_t uidHash, int64_t instance,
+                                    uint8_t kind, int32_t sequence);
+
+//After entries[firstEntry] ... entries[firstEntry + numEntries - 1] have been removed (and the ones after
+//moved down to fill the gap): records of the removed entries are left with none, later ones are moved down
+void overrideIndex_entriesRemoved(overrideIndex_t *pIndex, int firstEntry, int numEntries);
+
+#endif
@@ -0,0 +1,486 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#endif
+
+#include "ReceivePipeline.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <atomic>
+
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+#ifdef ARDUINO
+//mbedtls reads (on the producer task) need plenty of stack
+#define INKY_PIPELINE_PRODUCER_STACK 16384
+
+typedef QueueHandle_t blockQueue_t;
+
+static bool queueInit(blockQueue_t *pQueue, uint32_t capacity)
+{
+    *pQueue = xQueueCreate(capacity, sizeof(uint32_t));
+    return (*pQueue != NULL);
+}
+
+static void queueDestroy(blockQueue_t *pQueue)
+{
+    if (*pQueue != NULL)
+    {
+        vQueueDelete(*pQueue);
+        *pQueue = NULL;
+    }
+}
+
+static void queuePut(blockQueue_t *pQueue, uint32_t blockNum)
+{
+    xQueueSend(*pQueue, &blockNum, portMAX_DELAY);
+}
+
+static uint32_t queueTake(blockQueue_t *pQueue)
+{
+    uint32_t blockNum = 0;
+    xQueueReceive(*pQueue, &blockNum, portMAX_DELAY);
+    return blockNum;
+}
+
+static uint64_t nowMicros(void)
+{
+    return (uint64_t)esp_timer_get_time();
+}
+#else
+typedef struct {
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<uint32_t> blockNums;
+} blockQueue_t;
+
+static bool queueInit(blockQueue_t *pQueue, uint32_t capacity)
+{
+    return true;
+}
+
+static void queueDestroy(blockQueue_t *pQueue)
+{
+}
+
+static void queuePut(blockQueue_t *pQueue, uint32_t blockNum)
+{
+    std::lock_guard<std::mutex> guard(pQueue->lock);
+    pQueue->blockNums.push_back(blockNum);
+    pQueue->cond.notify_one();
+}
+
+static uint32_t queueTake(blockQueue_t *pQueue)
+{
+    std::unique_lock<std::mutex> guard(pQueue->lock);
+    pQueue->cond.wait(guard, [pQueue]{ return !pQueue->blockNums.empty(); });
+
+    uint32_t blockNum = pQueue->blockNums.front();
+    pQueue->blockNums.pop_front();
+    return blockNum;
+}
+
+static uint64_t nowMicros(void)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+typedef struct {
+    char *data;
+    size_t len;
+    int32_t rc;  //What the producer returned when it filled this block
+} pipelineBlock_t;
+
+typedef struct {
+    const ReceivePipelineConfig_t *pConfig;
+    ReceivePipelineStats_t *pStats;
+    pipelineBlock_t *blocks;
+    blockQueue_t freeQueue;    //Blocks the producer can fill
+    blockQueue_t filledQueue;  //Blocks waiting for the parser
+    std::atomic<bool> stop;    //Parser has failed: producer shouldn't fetch any more data
+#ifdef ARDUINO
+    SemaphoreHandle_t producerDone;
+#else
+    std::thread producerThread;
+#endif
+    //The receive window is window[parseStart] ... window[n-1]
+    size_t n;
+    size_t parseStart;
+    size_t sinceParse;         //Bytes added to the window since we last parsed
+    uint64_t buffOffsetFromStart;
+} pipelineState_t;
+
+static void dumpDataBufSerial(int logLevel, char *databuf, uint64_t buffOffsetFromStart)
+{
+    uint32_t charsPerLine = 100;
+    char line[2*charsPerLine+1]; //space to print \r as \+r etc. Extra char for null
+    uint32_t linepos = 0;
+    uint32_t linechars = 0;
+    uint64_t databufpos = 0;
+    uint64_t lineStartOffset = buffOffsetFromStart;
+    bool keepgoing = true;
+    bool lineend = false;
+
+    while (keepgoing) {
+        linepos = 0;
+        lineend = false;
+        linechars = 0;
+
+        while ((linepos < charsPerLine) && keepgoing  && !lineend) {
+            if (databuf[databufpos] != '\0') {
+                if (databuf[databufpos] == '\r') {
+                    line[linepos++] = '\\';
+                    line[linepos++] = 'r';
+                    linechars++;
+                    databufpos++;
+                } else if (databuf[databufpos] == '\n') {
+                    line[linepos++] = '\\';
+                    line[linepos++] = 'n';
+                    lineend = true;
+                    linechars++;
+                    databufpos++;
+                } else {
+                    line[linepos++] = databuf[databufpos++];
+                    linechars++;
+                }
+            } else {
+                keepgoing = false;
+            }
+        }
+        line[linepos++] = '\0';
+        LogSerial_LogImpl(logLevel, " %" PRIu64 " %s", lineStartOffset, line);
+        lineStartOffset += linechars;
+    }
+}
+
+//Called when the receive window has reached the end of the buffer: moves the unparsed data
+//back to the start of the buffer
+static void compactReceiveWindow(pipelineState_t *pState)
+{
+    size_t unparsedLen = pState->n - pState->parseStart;
+
+    LogSerial_Verbose1("Moving %zu bytes of unparsed data to start of buffer", unparsedLen);
+    memmove(pState->pConfig->window, &(pState->pConfig->window[pState->parseStart]), unparsedLen);
+
+    pState->pStats->totalMoved += unparsedLen;
+    pState->parseStart = 0;
+    pState->n = unparsedLen;
+}
+
+//returns INKY_PIPELINE_RC_OK or INKY_PIPELINE_RC_PARSEFAIL
+static int32_t parseWindow(pipelineState_t *pState)
+{
+    char *parseFrom = &(pState->pConfig->window[pState->parseStart]);
+    pState->pConfig->window[pState->n] = '\0';
+    pState->sinceParse = 0;
+    pState->pStats->parses++;
+
+    if (pState->n - pState->parseStart > pState->pStats->peakUnparsed)
+    {
+        pState->pStats->peakUnparsed = pState->n - pState->parseStart;
+    }
+
+    LogSerial_Verbose3("Dumping buffer before parsing");
+    dumpDataBufSerial(LOGSERIAL_LEVEL_VERBOSE3, parseFrom, pState->buffOffsetFromStart);
+
+    char *unparseddata = pState->pConfig->parser(parseFrom, pState->pConfig->parsingContext);
+
+    if (unparseddata == NULL)
+    {
+        return INKY_PIPELINE_RC_PARSEFAIL;
+    }
+    size_t justparsed = (unparseddata - parseFrom);
+    pState->pStats->totalParsed += justparsed;
+    pState->parseStart += justparsed;
+    pState->buffOffsetFromStart += justparsed;
+    LogSerial_Verbose1("Parsed %zu bytes, %zu bytes of unparsed data remain", justparsed, pState->n - pState->parseStart);
+
+    return INKY_PIPELINE_RC_OK;
+}
+
+//Adds the data in a filled block to the receive window, parsing when we have enough
+//returns INKY_PIPELINE_RC_OK, INKY_PIPELINE_RC_COMPLETE after the last block or an error
+static int32_t consumeBlock(pipelineState_t *pState, pipelineBlock_t *pBlock)
+{
+    const ReceivePipelineConfig_t *pConfig = pState->pConfig;
+    int32_t rc = INKY_PIPELINE_RC_OK;
+    size_t blockPos = 0;
+
+    if (pBlock->rc < 0)
+    {
+        return INKY_PIPELINE_RC_PRODUCERFAIL;
+    }
+
+    while (rc == INKY_PIPELINE_RC_OK && blockPos < pBlock->len)
+    {
+        //-1 to leave space for the \0 we add before parsing
+        size_t spaceInWindow = (pConfig->windowSize - 1) - pState->n;
+
+        if (spaceInWindow == 0 && pState->parseStart > 0)
+        {
+            compactReceiveWindow(pState);
+            spaceInWindow = (pConfig->windowSize - 1) - pState->n;
+        }
+
+        if (spaceInWindow == 0)
+        {
+            rc = INKY_PIPELINE_RC_BUFFULL;
+            break;
+        }
+        size_t copyLen = pBlock->len - blockPos;
+
+        if (copyLen > spaceInWindow)
+        {
+            copyLen = spaceInWindow;
+        }
+        memcpy(&(pConfig->window[pState->n]), &(pBlock->data[blockPos]), copyLen);
+        blockPos += copyLen;
+        pState->n += copyLen;
+        pState->sinceParse += copyLen;
+
+        if (pState->n == pConfig->windowSize - 1 || pState->sinceParse >= pConfig->minParseBytes)
+        {
+            rc = parseWindow(pState);
+        }
+    }
+
+    if (rc == INKY_PIPELINE_RC_OK && pBlock->rc == INKY_PIPELINE_RC_COMPLETE)
+    {
+        if (pState->sinceParse > 0)
+        {
+            //Parse last data
+            rc = parseWindow(pState);
+        }
+        if (rc == INKY_PIPELINE_RC_OK)
+        {
+            rc = INKY_PIPELINE_RC_COMPLETE;
+        }
+    }
+    return rc;
+}
+
+//returns what the producer returned
+static int32_t produceBlock(pipelineState_t *pState, pipelineBlock_t *pBlock)
+{
+    pBlock->len = 0;
+
+    if (pState->stop)
+    {
+        pBlock->rc = INKY_PIPELINE_RC_COMPLETE;
+    }
+    else
+    {
+        pBlock->rc = pState->pConfig->producer(pBlock->data, pState->pConfig->blockSize, &(pBlock->len),
+                                               pState->pConfig->producerContext);
+        pState->pStats->totalProduced += pBlock->len;
+        pState->pStats->producerRc = pBlock->rc;
+    }
+    return pBlock->rc;
+}
+
+//Fills blocks until the producer says it has finished (or fails)
+static void runProducer(pipelineState_t *pState)
+{
+    int32_t rc = INKY_PIPELINE_RC_OK;
+
+    while (rc == INKY_PIPELINE_RC_OK)
+    {
+        uint64_t waitStart = nowMicros();
+        uint32_t blockNum = queueTake(&(pState->freeQueue));
+        pState->pStats->producerWaitMicros += nowMicros() - waitStart;
+
+        rc = produceBlock(pState, &(pState->blocks[blockNum]));
+        queuePut(&(pState->filledQueue), blockNum);
+    }
+}
+
+#ifdef ARDUINO
+static void producerTask(void *arg)
+{
+    pipelineState_t *pState = (pipelineState_t *)arg;
+
+    runProducer(pState);
+    xSemaphoreGive(pState->producerDone);
+    vTaskDelete(NULL);
+}
+
+//returns true if we started the producer task
+static bool startProducer(pipelineState_t *pState)
+{
+    pState->producerDone = xSemaphoreCreateBinary();
+
+    if (pState->producerDone == NULL)
+    {
+        return false;
+    }
+
+    //Put the producer on the other core from us (the parser)
+    BaseType_t producerCore = (xPortGetCoreID() == 0) ? 1 : 0;
+
+    if (xTaskCreatePinnedToCore(producerTask, "InkyReceive", INKY_PIPELINE_PRODUCER_STACK, pState,
+                                uxTaskPriorityGet(NULL), NULL, producerCore) != pdPASS)
+    {
+        vSemaphoreDelete(pState->producerDone);
+        return false;
+    }
+    return true;
+}
+
+static void waitForProducer(pipelineState_t *pState)
+{
+    xSemaphoreTake(pState->producerDone, portMAX_DELAY);
+    vSemaphoreDelete(pState->producerDone);
+}
+#else
+static bool startProducer(pipelineState_t *pState)
+{
+    pState->producerThread = std::thread(runProducer, pState);
+    return true;
+}
+
+static void waitForProducer(pipelineState_t *pState)
+{
+    pState->producerThread.join();
+}
+#endif
+
+//Parses blocks as the producer task fills them
+static int32_t runThreaded(pipelineState_t *pState)
+{
+    int32_t rc = INKY_PIPELINE_RC_OK;
+    bool producerFinished = false;
+
+    for (uint32_t i = 0; i < pState->pConfig->numBlocks; i++)
+    {
+        queuePut(&(pState->freeQueue), i);
+    }
+
+    if (!startProducer(pState))
+    {
+        LogSerial_Error("Failed to start receive task");
+        logProblem(INKY_SEVERITY_ERROR);
+        return INKY_PIPELINE_RC_NOMEM;
+    }
+
+    while (!producerFinished)
+    {
+        uint64_t waitStart = nowMicros();
+        uint32_t blockNum = queueTake(&(pState->filledQueue));
+        pState->pStats->parserWaitMicros += nowMicros() - waitStart;
+
+        pipelineBlock_t *pBlock = &(pState->blocks[blockNum]);
+        producerFinished = (pBlock->rc != INKY_PIPELINE_RC_OK);
+        pState->pStats->blocks++;
+
+        if (rc == INKY_PIPELINE_RC_OK)
+        {
+            rc = consumeBlock(pState, pBlock);
+
+            if (rc != INKY_PIPELINE_RC_OK)
+            {
+                //Keep taking blocks (without parsing them) until the producer notices
+                pState->stop = true;
+            }
+        }
+        queuePut(&(pState->freeQueue), blockNum);
+    }
+    waitForProducer(pState);
+
+    return rc;
+}
+
+//Producer and parser take turns
+static int32_t runSerial(pipelineState_t *pState)
+{
+    int32_t rc = INKY_PIPELINE_RC_OK;
+
+    while (rc == INKY_PIPELINE_RC_OK)
+    {
+        produceBlock(pState, &(pState->blocks[0]));
+        pState->pStats->blocks++;
+        rc = consumeBlock(pState, &(pState->blocks[0]));
+    }
+    return rc;
+}
+
+int32_t receivePipeline_run(const ReceivePipelineConfig_t *pConfig, ReceivePipelineStats_t *pStats)
+{
+    pipelineState_t state;
+    int32_t rc = INKY_PIPELINE_RC_OK;
+    uint32_t numBlocks = pConfig->threaded ? pConfig->numBlocks : 1;
+
+    memset(pStats, 0, sizeof(ReceivePipelineStats_t));
+    state.pConfig = pConfig;
+    state.pStats = pStats;
+    state.stop = false;
+    state.n = 0;
+    state.parseStart = 0;
+    state.sinceParse = 0;
+    state.buffOffsetFromStart = 0;
+
+    state.blocks = (pipelineBlock_t *)calloc(numBlocks, sizeof(pipelineBlock_t));
+    char *blockData = (char *)INKY_MALLOC_LARGE(numBlocks * pConfig->blockSize);
+
+    if (state.blocks == NULL || blockData == NULL)
+    {
+        LogSerial_Error("Failed to allocate %" PRIu32 " receive blocks", numBlocks);
+        logProblem(INKY_SEVERITY_ERROR);
+        rc = INKY_PIPELINE_RC_NOMEM;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < numBlocks; i++)
+        {
+            state.blocks[i].data = &(blockData[i * pConfig->blockSize]);
+        }
+
+        if (pConfig->threaded)
+        {
+            bool queuesCreated = queueInit(&(state.freeQueue), numBlocks);
+            queuesCreated = queueInit(&(state.filledQueue), numBlocks) && queuesCreated;
+
+            if (queuesCreated)
+            {
+                rc = runThreaded(&state);
+            }
+            else
+            {
+                LogSerial_Error("Failed to create receive queues");
+                logProblem(INKY_SEVERITY_ERROR);
+                rc = INKY_PIPELINE_RC_NOMEM;
+            }
+            queueDestroy(&(state.freeQueue));
+            queueDestroy(&(state.filledQueue));
+        }
+        else
+        {
+            rc = runSerial(&state);
+        }
+    }
+
+    if (rc == INKY_PIPELINE_RC_COMPLETE)
+    {
+        rc = INKY_PIPELINE_RC_OK;
+    }
+    free(blockData);
+    free(state.blocks);
+    return rc;
+}
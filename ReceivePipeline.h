@@ -0,0 +1,73 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef RECEIVEPIPELINE_H
+#define RECEIVEPIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Feeds data (e.g. a calendar being downloaded) to a parser through a receive window:
+//data is added to the end of the window and the parser consumes it from the start.
+//
+//A "producer" fills fixed size blocks with data which are handed to the parser through a queue.
+//In threaded mode the producer runs in its own task (on the InkPlate: pinned to the other core
+//from the parser) so we keep reading from the network whilst the parser is busy - otherwise
+//the tcp window fills up and the server stops sending whilst we parse.
+//Without threaded mode, the producer and parser take turns on the calling task.
+//
+//Doesn't know about HTTPClient so it can be tested/benchmarked on Linux (with std::thread).
+
+#define INKY_PIPELINE_RC_OK            0
+#define INKY_PIPELINE_RC_COMPLETE      1  //Producer: this block has the last of the data
+#define INKY_PIPELINE_RC_BUFFULL      -1  //Unparsed data filled the receive window
+#define INKY_PIPELINE_RC_PARSEFAIL    -2
+#define INKY_PIPELINE_RC_NOMEM        -3
+#define INKY_PIPELINE_RC_PRODUCERFAIL -4  //The producer returned an error (see producerRc in the stats)
+
+//Fills block with up to blockSize bytes. Returning with the block full (rather than as soon
+//as some data arrives) means the parser can fall further behind before the producer stops
+// output: pLen - number of bytes put in the block
+// returns INKY_PIPELINE_RC_OK if there is more data to come,
+//         INKY_PIPELINE_RC_COMPLETE if that is all the data
+//         or a (negative) error of the producer's choosing
+typedef int32_t pipelineProducerFn_t(char *block, size_t blockSize, size_t *pLen, void *producerContext);
+
+//Same as dataParsingFn_t in Network.h:
+//returns: pointer to start of unparsed data or NULL for error
+typedef char *pipelineParsingFn_t(char *, void *);
+
+typedef struct {
+    pipelineProducerFn_t *producer;
+    void *producerContext;
+    pipelineParsingFn_t *parser;
+    void *parsingContext;
+    char *window;            //Receive window buffer (data passed to the parser is \0 terminated in here)
+    size_t windowSize;
+    size_t blockSize;
+    uint32_t numBlocks;      //Blocks the producer can fill ahead of the parser
+    size_t minParseBytes;    //Only parse once at least this many new bytes are in the window
+    bool threaded;           //Run the producer on its own task
+} ReceivePipelineConfig_t;
+
+typedef struct {
+    uint64_t totalProduced;      //Bytes the producer put in blocks
+    uint64_t totalParsed;
+    uint64_t totalMoved;         //Bytes of unparsed data moved to the start of the window
+    uint64_t peakUnparsed;       //Most unparsed data in the window at once (BUFFULL when it reaches the window size)
+    uint64_t blocks;
+    uint64_t parses;
+    uint64_t producerWaitMicros; //Time the producer waited for a free block (parser was slower)
+    uint64_t parserWaitMicros;   //Time the parser waited for a filled block (producer was slower)
+    int32_t  producerRc;         //Last return code from the producer
+} ReceivePipelineStats_t;
+
+//Runs until the producer returns INKY_PIPELINE_RC_COMPLETE (and the data is parsed) or something fails
+// returns INKY_PIPELINE_RC_OK or an error
+int32_t receivePipeline_run(const ReceivePipelineConfig_t *pConfig, ReceivePipelineStats_t *pStats);
+
+#endif
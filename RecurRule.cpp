@@ -0,0 +1,773 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "RecurRule.h"
+#include <string.h>
+#include <inttypes.h>
+
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+#define RECURRULE_MAX_COUNT    1000000L
+#define RECURRULE_MAX_INTERVAL 1000000L
+
+static const char *const WeekdayNames[7] = { "MO", "TU", "WE", "TH", "FR", "SA", "SU" };
+
+
+//Days since 1970-01-01 of a date in the (proleptic) Gregorian calendar - month 1-12, day can be
+//outside 1-31 (as mktime() normalises it). See http://howardhinnant.github.io/date_algorithms.html
+int32_t daysFromCivil(int32_t year, uint32_t month, int32_t day)
+{
+    year -= (month <= 2);
+
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yearOfEra = (uint32_t)(year - era * 400);                            // [0, 399]
+    uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5;     // [0, 365] (from 1st March)
+    uint32_t dayOfEra  = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + (int32_t)dayOfEra - 719468 + (day - 1);
+}
+
+//Inverse of daysFromCivil()
+void civilFromDays(int32_t days, int32_t *pYear, uint32_t *pMonth, uint32_t *pDay)
+{
+    days += 719468;
+
+    int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t dayOfEra  = (uint32_t)(days - era * 146097);                                         // [0, 146096]
+    uint32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365; // [0, 399]
+    uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);           // [0, 365]
+    uint32_t monthFromMar = (5 * dayOfYear + 2) / 153;                                              // [0, 11]
+
+    *pDay   = dayOfYear - (153 * monthFromMar + 2) / 5 + 1;
+    *pMonth = (monthFromMar < 10) ? monthFromMar + 3 : monthFromMar - 9;
+    *pYear  = (int32_t)yearOfEra + era * 400 + (*pMonth <= 2);
+}
+
+static inline bool isLeapYear(int32_t year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+uint32_t daysInMonth(int32_t year, uint32_t month)
+{
+    static const uint8_t monthDays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    return (month == 2 && isLeapYear(year)) ? 29 : monthDays[month - 1];
+}
+
+//RECURRULE_MONDAY ... RECURRULE_SUNDAY (1970-01-01 was a Thursday)
+static inline uint8_t weekdayOfDay(int32_t day)
+{
+    int32_t weekday = (day + 3) % 7;
+    return (uint8_t)(weekday < 0 ? weekday + 7 : weekday);
+}
+
+//An optionally signed decimal number (all len chars of str)
+static bool parseSignedInt(const char *str, size_t len, int32_t *pValue)
+{
+    bool negative = false;
+    int32_t value = 0;
+
+    if (len > 0 && (str[0] == '+' || str[0] == '-'))
+    {
+        negative = (str[0] == '-');
+        str++;
+        len--;
+    }
+
+    if (len == 0 || len > 9)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (str[i] < '0' || str[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (str[i] - '0');
+    }
+    *pValue = negative ? -value : value;
+    return true;
+}
+
+//RECURRULE_MONDAY ... RECURRULE_SUNDAY or -1 if name (2 chars) isn't a day
+static int32_t parseWeekday(const char *name)
+{
+    for (int32_t i = 0; i < 7; i++)
+    {
+        if (name[0] == WeekdayNames[i][0] && name[1] == WeekdayNames[i][1])
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//One item in the list that's the value of BYDAY= e.g. "MO", "2TU", "-1FR"
+static bool compileByDay(const char *item, size_t itemLen, recurRule_t *pRule)
+{
+    if (itemLen < 2)
+    {
+        return false;
+    }
+    int32_t weekday = parseWeekday(item + itemLen - 2);
+
+    if (weekday < 0)
+    {
+        return false;
+    }
+
+    if (itemLen == 2)
+    {
+        pRule->byDay |= (uint8_t)(1 << weekday);
+        return true;
+    }
+    int32_t ordinal;
+
+    if (   !parseSignedInt(item, itemLen - 2, &ordinal) || ordinal == 0 || ordinal > 53 || ordinal < -53
+        || pRule->numByDayOrdinals >= RECURRULE_MAX_BYDAY_ORDINALS)
+    {
+        return false;
+    }
+    pRule->byDayOrdinal[pRule->numByDayOrdinals]        = (int8_t)ordinal;
+    pRule->byDayOrdinalWeekday[pRule->numByDayOrdinals] = (uint8_t)weekday;
+    pRule->numByDayOrdinals++;
+    return true;
+}
+
+//One item in the value of BYMONTHDAY=, BYMONTH= or BYSETPOS= (whichever name is)
+static bool compileListItem(const char *name, const char *item, size_t itemLen, recurRule_t *pRule)
+{
+    int32_t value;
+
+    if (!parseSignedInt(item, itemLen, &value))
+    {
+        return false;
+    }
+
+    if (strcmp(name, "BYMONTHDAY") == 0)
+    {
+        if (value >= 1 && value <= 31)
+        {
+            pRule->byMonthDay |= (uint32_t)1 << value;
+        }
+        else if (value <= -1 && value >= -31)
+        {
+            pRule->byMonthDayFromEnd |= (uint32_t)1 << -value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (strcmp(name, "BYMONTH") == 0)
+    {
+        if (value < 1 || value > 12)
+        {
+            return false;
+        }
+        pRule->byMonth |= (uint16_t)(1 << value);
+    }
+    else //BYSETPOS
+    {
+        if (value == 0 || value > 366 || value < -366 || pRule->numBySetPos >= RECURRULE_MAX_BYSETPOS)
+        {
+            return false;
+        }
+        pRule->bySetPos[pRule->numBySetPos++] = (int16_t)value;
+    }
+    return true;
+}
+
+//UNTIL= value: YYYYMMDD or YYYYMMDDTHHMMSS with an optional Z
+static bool compileUntil(const char *value, size_t valueLen, recurRule_t *pRule)
+{
+    int32_t year, month, day;
+
+    if (   valueLen < 8 || !parseSignedInt(value, 4, &year) || !parseSignedInt(value + 4, 2, &month)
+        || !parseSignedInt(value + 6, 2, &day) || month < 1 || month > 12 || day < 1 || day > 31)
+    {
+        return false;
+    }
+    pRule->untilDay = daysFromCivil(year, (uint32_t)month, day);
+    pRule->untilSecsOfDay = -1;
+
+    if (valueLen > 8)
+    {
+        int32_t hour, minute, second;
+
+        if (   valueLen < 15 || value[8] != 'T' || !parseSignedInt(value + 9, 2, &hour)
+            || !parseSignedInt(value + 11, 2, &minute) || !parseSignedInt(value + 13, 2, &second))
+        {
+            return false;
+        }
+        pRule->untilSecsOfDay = hour * 3600 + minute * 60 + second;
+        pRule->untilUtc = (valueLen > 15 && value[15] == 'Z');
+    }
+    return true;
+}
+
+bool compileRecurRule(const char *rule, size_t ruleLen, recurRule_t *pRule)
+{
+    memset(pRule, 0, sizeof(recurRule_t));
+    pRule->interval = 1;
+    pRule->untilDay = INT32_MAX;
+    pRule->untilSecsOfDay = -1;
+    pRule->weekStart = RECURRULE_MONDAY;
+
+    bool freqValid = false;
+    const char *rulePos = rule;
+    const char *ruleEnd = rule + ruleLen;
+
+    //Rule is parts like NAME=VALUE separated by ';', VALUE can be a list separated by ','
+    while (rulePos < ruleEnd)
+    {
+        const char *partEnd = (const char *)memchr(rulePos, ';', ruleEnd - rulePos);
+        if (partEnd == NULL)
+        {
+            partEnd = ruleEnd;
+        }
+        const char *equals = (const char *)memchr(rulePos, '=', partEnd - rulePos);
+        char name[16];
+        size_t nameLen = (equals != NULL) ? (size_t)(equals - rulePos) : 0;
+
+        if (equals == NULL || nameLen == 0 || nameLen >= sizeof(name))
+        {
+            LogSerial_FatalError("Recurrence rule has a part that isn't NAME=VALUE: %.*s", (int)ruleLen, rule);
+            logProblem(INKY_SEVERITY_FATAL);
+            return false;
+        }
+        memcpy(name, rulePos, nameLen);
+        name[nameLen] = '\0';
+
+        const char *value = equals + 1;
+        size_t valueLen = partEnd - value;
+        bool valueValid = true;
+
+        if (strcmp(name, "FREQ") == 0)
+        {
+            static const char *const freqNames[] = { "DAILY", "WEEKLY", "MONTHLY", "YEARLY" };
+
+            for (uint8_t i = 0; i < sizeof(freqNames)/sizeof(freqNames[0]); i++)
+            {
+                if (valueLen == strlen(freqNames[i]) && memcmp(value, freqNames[i], valueLen) == 0)
+                {
+                    pRule->freq = i;
+                    freqValid = true;
+                }
+            }
+            valueValid = freqValid;
+        }
+        else if (strcmp(name, "INTERVAL") == 0 || strcmp(name, "COUNT") == 0)
+        {
+            int32_t number;
+
+            valueValid = parseSignedInt(value, valueLen, &number) && number > 0
+                           && number <= (name[0] == 'C' ? RECURRULE_MAX_COUNT : RECURRULE_MAX_INTERVAL);
+            if (valueValid)
+            {
+                *(name[0] == 'C' ? &pRule->count : &pRule->interval) = number;
+            }
+        }
+        else if (strcmp(name, "UNTIL") == 0)
+        {
+            valueValid = compileUntil(value, valueLen, pRule);
+        }
+        else if (strcmp(name, "WKST") == 0)
+        {
+            int32_t weekday = (valueLen == 2) ? parseWeekday(value) : -1;
+
+            valueValid = (weekday >= 0);
+            pRule->weekStart = (uint8_t)weekday;
+        }
+        else if (   strcmp(name, "BYDAY") == 0 || strcmp(name, "BYMONTHDAY") == 0
+                 || strcmp(name, "BYMONTH") == 0 || strcmp(name, "BYSETPOS") == 0)
+        {
+            const char *item = value;
+
+            while (valueValid && item <= partEnd)
+            {
+                const char *itemEnd = (const char *)memchr(item, ',', partEnd - item);
+                if (itemEnd == NULL)
+                {
+                    itemEnd = partEnd;
+                }
+
+                if (name[2] == 'D')
+                {
+                    valueValid = compileByDay(item, itemEnd - item, pRule);
+                }
+                else
+                {
+                    valueValid = compileListItem(name, item, itemEnd - item, pRule);
+                }
+                item = itemEnd + 1;
+            }
+        }
+        else
+        {
+            //e.g. BYYEARDAY, BYWEEKNO, BYHOUR - we show an occurrence for every day the rest of the rule gives
+            LogSerial_Unusual("Ignoring unsupported %s in recurrence rule: %.*s", name, (int)ruleLen, rule);
+        }
+
+        if (!valueValid)
+        {
+            LogSerial_FatalError("Can't parse %s in recurrence rule: %.*s", name, (int)ruleLen, rule);
+            logProblem(INKY_SEVERITY_FATAL);
+            return false;
+        }
+        rulePos = partEnd + 1;
+    }
+
+    if (!freqValid)
+    {
+        LogSerial_FatalError("Currently can only parse daily/weekly/monthly/yearly recurring event but got recur rule: %.*s",
+                             (int)ruleLen, rule);
+        logProblem(INKY_SEVERITY_FATAL);
+        return false;
+    }
+    return true;
+}
+
+static inline void setPeriodDay(recurIterator_t *pIter, int32_t day)
+{
+    int32_t bit = day - pIter->periodStart;
+    pIter->periodDays[bit >> 5] |= (uint32_t)1 << (bit & 31);
+}
+
+static inline bool isPeriodDaySet(const recurIterator_t *pIter, uint32_t bit)
+{
+    return (pIter->periodDays[bit >> 5] >> (bit & 31)) & 1;
+}
+
+//Weekdays any BYDAY= (with or without an ordinal) gives
+static uint8_t allByDayWeekdays(const recurRule_t *pRule)
+{
+    uint8_t weekdays = pRule->byDay;
+
+    for (uint32_t i = 0; i < pRule->numByDayOrdinals; i++)
+    {
+        weekdays |= (uint8_t)(1 << pRule->byDayOrdinalWeekday[i]);
+    }
+    return weekdays;
+}
+
+//BYDAY= days in spanLen days from spanStart (a month or a year) - ordinals (e.g. 2TU) count from its start/end
+static void setByDayInSpan(recurIterator_t *pIter, int32_t spanStart, int32_t spanLen)
+{
+    const recurRule_t *pRule = pIter->pRule;
+    int32_t spanLast = spanStart + spanLen - 1;
+
+    if (pRule->byDay != 0)
+    {
+        uint8_t weekday = weekdayOfDay(spanStart);
+
+        for (int32_t day = spanStart; day <= spanLast; day++)
+        {
+            if (pRule->byDay & (1 << weekday))
+            {
+                setPeriodDay(pIter, day);
+            }
+            weekday = (weekday == RECURRULE_SUNDAY) ? RECURRULE_MONDAY : weekday + 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < pRule->numByDayOrdinals; i++)
+    {
+        int32_t ordinal = pRule->byDayOrdinal[i];
+        int32_t weekday = pRule->byDayOrdinalWeekday[i];
+        int32_t day;
+
+        if (ordinal > 0)
+        {
+            day = spanStart + (weekday - weekdayOfDay(spanStart) + 7) % 7 + 7 * (ordinal - 1);
+        }
+        else
+        {
+            day = spanLast - (weekdayOfDay(spanLast) - weekday + 7) % 7 + 7 * (ordinal + 1);
+        }
+
+        if (day >= spanStart && day <= spanLast)
+        {
+            setPeriodDay(pIter, day);
+        }
+    }
+}
+
+//BYMONTHDAY= days of a month - just those on a BYDAY= weekday if there is one
+static void setByMonthDayInMonth(recurIterator_t *pIter, int32_t year, uint32_t month)
+{
+    const recurRule_t *pRule = pIter->pRule;
+    uint32_t monthDays = daysInMonth(year, month);
+    int32_t monthStart = daysFromCivil(year, month, 1);
+    uint8_t weekdays = allByDayWeekdays(pRule);
+
+    for (uint32_t dayOfMonth = 1; dayOfMonth <= monthDays; dayOfMonth++)
+    {
+        if (   ((pRule->byMonthDay >> dayOfMonth) & 1)
+            || ((pRule->byMonthDayFromEnd >> (monthDays - dayOfMonth + 1)) & 1))
+        {
+            int32_t day = monthStart + (int32_t)dayOfMonth - 1;
+
+            if (weekdays == 0 || (weekdays & (1 << weekdayOfDay(day))))
+            {
+                setPeriodDay(pIter, day);
+            }
+        }
+    }
+}
+
+//Days of a month the rule gives (for MONTHLY, or YEARLY with BYMONTH=)
+static void setDaysInMonth(recurIterator_t *pIter, int32_t year, uint32_t month)
+{
+    const recurRule_t *pRule = pIter->pRule;
+
+    if (pRule->byMonthDay != 0 || pRule->byMonthDayFromEnd != 0)
+    {
+        setByMonthDayInMonth(pIter, year, month);
+    }
+    else if (pRule->byDay != 0 || pRule->numByDayOrdinals != 0)
+    {
+        setByDayInSpan(pIter, daysFromCivil(year, month, 1), (int32_t)daysInMonth(year, month));
+    }
+    else if (pIter->startDayOfMonth <= daysInMonth(year, month))
+    {
+        //Otherwise DTSTART's day of the month - RFC 5545 says months without it (e.g. the 31st) are skipped
+        setPeriodDay(pIter, daysFromCivil(year, month, (int32_t)pIter->startDayOfMonth));
+    }
+}
+
+//Only keep the days BYSETPOS= picks (e.g. -1 for the last) out of those in the period
+static void applyBySetPos(recurIterator_t *pIter, uint32_t periodLen)
+{
+    const recurRule_t *pRule = pIter->pRule;
+    uint32_t numDays = 0;
+    uint32_t selected[RECURRULE_PERIOD_WORDS] = {};
+
+    for (uint32_t w = 0; w < RECURRULE_PERIOD_WORDS; w++)
+    {
+        numDays += (uint32_t)__builtin_popcount(pIter->periodDays[w]);
+    }
+
+    for (uint32_t i = 0; i < pRule->numBySetPos; i++)
+    {
+        int32_t pos = pRule->bySetPos[i];
+        int32_t wanted = (pos > 0) ? pos - 1 : (int32_t)numDays + pos; //0 for the first day in the period
+
+        if (wanted < 0 || wanted >= (int32_t)numDays)
+        {
+            continue;
+        }
+
+        for (uint32_t bit = 0; bit < periodLen; bit++)
+        {
+            if (isPeriodDaySet(pIter, bit) && wanted-- == 0)
+            {
+                selected[bit >> 5] |= (uint32_t)1 << (bit & 31);
+                break;
+            }
+        }
+    }
+    memcpy(pIter->periodDays, selected, sizeof(selected));
+}
+
+//Fills in the days of period number periodIndex (counting in INTERVALs from the one DTSTART is in)
+//returns how many days long the period is
+static uint32_t expandPeriod(recurIterator_t *pIter, int32_t periodIndex)
+{
+    const recurRule_t *pRule = pIter->pRule;
+    int32_t steps = periodIndex * pRule->interval;
+    uint32_t periodLen = 0;
+
+    memset(pIter->periodDays, 0, sizeof(pIter->periodDays));
+    pIter->periodIndex = periodIndex;
+
+    switch (pRule->freq)
+    {
+        case RECURRULE_FREQ_DAILY:
+            {
+                int32_t day = pIter->startDay + steps;
+                int32_t year;
+                uint32_t month, dayOfMonth;
+
+                pIter->periodStart = day;
+                periodLen = 1;
+                civilFromDays(day, &year, &month, &dayOfMonth);
+
+                uint32_t monthDays = daysInMonth(year, month);
+                uint8_t weekdays = allByDayWeekdays(pRule);
+
+                if (   (pRule->byMonth == 0 || ((pRule->byMonth >> month) & 1))
+                    && (   (pRule->byMonthDay == 0 && pRule->byMonthDayFromEnd == 0)
+                        || ((pRule->byMonthDay >> dayOfMonth) & 1)
+                        || ((pRule->byMonthDayFromEnd >> (monthDays - dayOfMonth + 1)) & 1))
+                    && (weekdays == 0 || (weekdays & (1 << weekdayOfDay(day)))))
+                {
+                    setPeriodDay(pIter, day);
+                }
+            }
+            break;
+
+        case RECURRULE_FREQ_WEEKLY:
+            {
+                uint8_t weekdays = allByDayWeekdays(pRule);
+
+                if (weekdays == 0)
+                {
+                    weekdays = (uint8_t)(1 << pIter->startWeekday);
+                }
+                pIter->periodStart = pIter->startDay - (pIter->startWeekday - pRule->weekStart + 7) % 7 + 7 * steps;
+                periodLen = 7;
+
+                for (int32_t day = pIter->periodStart; day < pIter->periodStart + 7; day++)
+                {
+                    if (weekdays & (1 << weekdayOfDay(day)))
+                    {
+                        if (pRule->byMonth != 0)
+                        {
+                            int32_t year;
+                            uint32_t month, dayOfMonth;
+
+                            civilFromDays(day, &year, &month, &dayOfMonth);
+                            if (((pRule->byMonth >> month) & 1) == 0)
+                            {
+                                continue;
+                            }
+                        }
+                        setPeriodDay(pIter, day);
+                    }
+                }
+            }
+            break;
+
+        case RECURRULE_FREQ_MONTHLY:
+            {
+                int32_t months = pIter->startYear * 12 + (int32_t)pIter->startMonth - 1 + steps;
+                int32_t year = months / 12;
+                uint32_t month = (uint32_t)(months % 12) + 1;
+
+                pIter->periodStart = daysFromCivil(year, month, 1);
+                periodLen = daysInMonth(year, month);
+
+                if (pRule->byMonth == 0 || ((pRule->byMonth >> month) & 1))
+                {
+                    setDaysInMonth(pIter, year, month);
+                }
+            }
+            break;
+
+        case RECURRULE_FREQ_YEARLY:
+            {
+                int32_t year = pIter->startYear + steps;
+
+                pIter->periodStart = daysFromCivil(year, 1, 1);
+                periodLen = isLeapYear(year) ? 366 : 365;
+
+                if (   pRule->byMonth == 0 && pRule->byMonthDay == 0 && pRule->byMonthDayFromEnd == 0
+                    && (pRule->byDay != 0 || pRule->numByDayOrdinals != 0))
+                {
+                    //e.g. BYDAY=20MO - the 20th Monday of the year
+                    setByDayInSpan(pIter, pIter->periodStart, (int32_t)periodLen);
+                }
+                else
+                {
+                    //The BYMONTH= months, every month for BYMONTHDAY= on its own, otherwise DTSTART's month
+                    uint16_t months = pRule->byMonth;
+
+                    if (months == 0)
+                    {
+                        months = (pRule->byMonthDay != 0 || pRule->byMonthDayFromEnd != 0) ? 0x1FFE
+                                                                                           : (uint16_t)(1 << pIter->startMonth);
+                    }
+
+                    for (uint32_t month = 1; month <= 12; month++)
+                    {
+                        if ((months >> month) & 1)
+                        {
+                            setDaysInMonth(pIter, year, month);
+                        }
+                    }
+                }
+            }
+            break;
+    }
+
+    if (pRule->numBySetPos > 0)
+    {
+        applyBySetPos(pIter, periodLen);
+    }
+
+    //Nothing before DTSTART (in the period it's in)
+    for (int32_t day = pIter->periodStart; day < pIter->startDay && day < pIter->periodStart + (int32_t)periodLen; day++)
+    {
+        uint32_t bit = (uint32_t)(day - pIter->periodStart);
+        pIter->periodDays[bit >> 5] &= ~((uint32_t)1 << (bit & 31));
+    }
+    pIter->nextBit = 0;
+    return periodLen;
+}
+
+static uint32_t countPeriodDays(const recurIterator_t *pIter)
+{
+    uint32_t numDays = 0;
+
+    for (uint32_t w = 0; w < RECURRULE_PERIOD_WORDS; w++)
+    {
+        numDays += (uint32_t)__builtin_popcount(pIter->periodDays[w]);
+    }
+    return numDays;
+}
+
+//Occurrences in every period (after the first) if it's the same in each - otherwise 0
+static uint32_t occurrencesPerPeriod(const recurIterator_t *pIter)
+{
+    const recurRule_t *pRule = pIter->pRule;
+    bool byNothing =    pRule->byDay == 0 && pRule->numByDayOrdinals == 0 && pRule->byMonth == 0
+                     && pRule->byMonthDay == 0 && pRule->byMonthDayFromEnd == 0 && pRule->numBySetPos == 0;
+
+    switch (pRule->freq)
+    {
+        case RECURRULE_FREQ_DAILY:
+            return byNothing ? 1 : 0;
+
+        case RECURRULE_FREQ_WEEKLY:
+            if (pRule->byMonth == 0 && pRule->numBySetPos == 0)
+            {
+                uint8_t weekdays = allByDayWeekdays(pRule);
+                return (weekdays == 0) ? 1 : (uint32_t)__builtin_popcount(weekdays);
+            }
+            return 0;
+
+        //Only a day that not every month (or year) has can be skipped
+        case RECURRULE_FREQ_MONTHLY:
+            return (byNothing && pIter->startDayOfMonth <= 28) ? 1 : 0;
+
+        case RECURRULE_FREQ_YEARLY:
+            return (byNothing && !(pIter->startMonth == 2 && pIter->startDayOfMonth == 29)) ? 1 : 0;
+    }
+    return 0;
+}
+
+//A period at or before the first one that could have an occurrence on or after firstDay
+static int32_t firstRelevantPeriod(const recurIterator_t *pIter, int32_t firstDay)
+{
+    int32_t daysBefore = firstDay - pIter->startDay;
+    int32_t unitsBefore = 0;
+
+    if (daysBefore <= 0)
+    {
+        return 0;
+    }
+
+    //Round down (allowing for the first week/month/year starting before DTSTART) - we'll step
+    //through the few periods before the first relevant one
+    switch (pIter->pRule->freq)
+    {
+        case RECURRULE_FREQ_DAILY:
+            unitsBefore = daysBefore;
+            break;
+
+        case RECURRULE_FREQ_WEEKLY:
+            unitsBefore = daysBefore / 7 - 1;
+            break;
+
+        case RECURRULE_FREQ_MONTHLY:
+            unitsBefore = daysBefore / 31 - 1;
+            break;
+
+        case RECURRULE_FREQ_YEARLY:
+            unitsBefore = daysBefore / 366 - 1;
+            break;
+    }
+    return (unitsBefore > 0) ? unitsBefore / pIter->pRule->interval : 0;
+}
+
+void recurIterator_init(recurIterator_t *pIter, const recurRule_t *pRule, int32_t startDay, int32_t firstDay, int32_t lastDay)
+{
+    memset(pIter, 0, sizeof(recurIterator_t));
+    pIter->pRule = pRule;
+    pIter->startDay = startDay;
+    pIter->startWeekday = weekdayOfDay(startDay);
+    civilFromDays(startDay, &pIter->startYear, &pIter->startMonth, &pIter->startDayOfMonth);
+    pIter->remaining = (pRule->count > 0) ? pRule->count : -1;
+    pIter->lastDay = (pRule->untilDay < lastDay) ? pRule->untilDay : lastDay;
+
+    int32_t firstPeriod = firstRelevantPeriod(pIter, firstDay);
+
+    if (pIter->remaining > 0 && firstPeriod > 0)
+    {
+        //COUNT= includes the occurrences we're skipping - the first period can have fewer (those
+        //before DTSTART don't count)
+        int32_t skipped = 0;
+        uint32_t perPeriod = occurrencesPerPeriod(pIter);
+
+        expandPeriod(pIter, 0);
+        skipped = (int32_t)countPeriodDays(pIter);
+
+        if (perPeriod != 0)
+        {
+            skipped += (firstPeriod - 1) * (int32_t)perPeriod;
+        }
+        else
+        {
+            for (int32_t period = 1; period < firstPeriod && skipped < pIter->remaining; period++)
+            {
+                expandPeriod(pIter, period);
+                skipped += (int32_t)countPeriodDays(pIter);
+            }
+        }
+        pIter->remaining = (skipped >= pIter->remaining) ? 0 : pIter->remaining - skipped;
+    }
+    expandPeriod(pIter, firstPeriod);
+}
+
+bool recurIterator_next(recurIterator_t *pIter, int32_t *pDay)
+{
+    uint32_t periodLen = (uint32_t)(RECURRULE_PERIOD_WORDS * 32);
+
+    while (pIter->remaining != 0)
+    {
+        //Next day set in this period
+        while (pIter->nextBit < periodLen && (pIter->periodDays[pIter->nextBit >> 5] >> (pIter->nextBit & 31)) == 0)
+        {
+            pIter->nextBit = (pIter->nextBit | 31) + 1; //Nothing more in this word
+        }
+
+        if (pIter->nextBit < periodLen)
+        {
+            uint32_t bits = pIter->periodDays[pIter->nextBit >> 5] >> (pIter->nextBit & 31);
+            uint32_t bit = pIter->nextBit + (uint32_t)__builtin_ctz(bits);
+            int32_t day = pIter->periodStart + (int32_t)bit;
+
+            pIter->nextBit = bit + 1;
+
+            if (day > pIter->lastDay)
+            {
+                pIter->remaining = 0;
+                return false;
+            }
+
+            if (pIter->remaining > 0)
+            {
+                pIter->remaining--;
+            }
+            *pDay = day;
+            return true;
+        }
+
+        if (pIter->periodStart > pIter->lastDay)
+        {
+            pIter->remaining = 0;
+            return false;
+        }
+        expandPeriod(pIter, pIter->periodIndex + 1);
+    }
+    return false;
+}
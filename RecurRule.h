@@ -0,0 +1,92 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef RECURRULE_H
+#define RECURRULE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Recurrence rules (RRULE - RFC 5545 3.3.10) of events. The rule text is compiled once per event into
+//a recurRule_t and an iterator walks the days the event occurs on - a period (day/week/month/year)
+//at a time, starting at the first period that can reach the days we're interested in. Days are
+//"day numbers" (days since 1970-01-01, see daysFromCivil()) so nothing here knows about timezones -
+//the caller works out which day (and time) DTSTART is on.
+//
+//Supports FREQ=DAILY/WEEKLY/MONTHLY/YEARLY with INTERVAL, COUNT, UNTIL, WKST, BYMONTH, BYMONTHDAY,
+//BYDAY (with ordinals e.g. 2TU, -1FR for MONTHLY/YEARLY) and BYSETPOS. BYYEARDAY/BYWEEKNO/BYHOUR etc.
+//are ignored (compileRecurRule() logs them).
+
+#define RECURRULE_FREQ_DAILY   0
+#define RECURRULE_FREQ_WEEKLY  1
+#define RECURRULE_FREQ_MONTHLY 2
+#define RECURRULE_FREQ_YEARLY  3
+
+#define RECURRULE_MAX_BYDAY_ORDINALS 8
+#define RECURRULE_MAX_BYSETPOS       8
+
+//Weekdays - as in BYDAY= bits and WKST=
+#define RECURRULE_MONDAY 0
+#define RECURRULE_SUNDAY 6
+
+typedef struct recurRule
+{
+    uint8_t freq;                 //One of the RECURRULE_FREQ_* constants
+    uint8_t weekStart;            //WKST= (RECURRULE_MONDAY ... RECURRULE_SUNDAY)
+    uint8_t byDay;                //BYDAY= weekdays without an ordinal - bit 0 is Monday
+    uint8_t numByDayOrdinals;
+    int8_t  byDayOrdinal[RECURRULE_MAX_BYDAY_ORDINALS];        //e.g. 2 for 2TU, -1 for -1FR...
+    uint8_t byDayOrdinalWeekday[RECURRULE_MAX_BYDAY_ORDINALS]; //...and the weekday
+    uint16_t byMonth;             //bit n is month n (1-12)
+    uint32_t byMonthDay;          //bit n is day n of the month (1-31)
+    uint32_t byMonthDayFromEnd;   //bit n is n days from the end (BYMONTHDAY=-1 is the last day)
+    uint8_t numBySetPos;
+    int16_t bySetPos[RECURRULE_MAX_BYSETPOS];
+    int32_t interval;
+    int32_t count;                //0 if there's no COUNT=
+    int32_t untilDay;             //Date of UNTIL= (INT32_MAX if there isn't one)...
+    int32_t untilSecsOfDay;       //...and its time (-1 if it's just a date)...
+    bool untilUtc;                //...which is UTC if it ended in Z
+} recurRule_t;
+
+//Days in a period are kept as bits - a year is the longest
+#define RECURRULE_PERIOD_WORDS ((366 + 31) / 32)
+
+typedef struct recurIterator
+{
+    const recurRule_t *pRule;
+    int32_t startDay;             //DTSTART...
+    int32_t startYear;            //...and its date (for the BY* parts it gives defaults for)
+    uint32_t startMonth;
+    uint32_t startDayOfMonth;
+    uint8_t startWeekday;
+    int32_t remaining;            //Occurrences COUNT= leaves (-1 for no limit)
+    int32_t lastDay;              //No occurrences after this (or UNTIL=)
+    int32_t periodIndex;          //Period (0 for the one DTSTART is in, 1 for the next INTERVAL on...) in periodDays
+    int32_t periodStart;          //Day number of bit 0 of periodDays
+    uint32_t periodDays[RECURRULE_PERIOD_WORDS];
+    uint32_t nextBit;             //Next bit in periodDays to look at
+} recurIterator_t;
+
+//Compiles the value of an RRULE (e.g. "FREQ=WEEKLY;WKST=MO;COUNT=26;INTERVAL=2;BYDAY=FR") - ruleLen chars
+//returns false (having logged why) if the rule can't be used
+bool compileRecurRule(const char *rule, size_t ruleLen, recurRule_t *pRule);
+
+//Starts iterating the occurrences of pRule for an event starting on startDay that are on or before lastDay
+//Periods that end before firstDay are skipped (with day arithmetic) so the cost doesn't depend on how
+//old the event is - but occurrences a little before firstDay may still be returned
+void recurIterator_init(recurIterator_t *pIter, const recurRule_t *pRule, int32_t startDay, int32_t firstDay, int32_t lastDay);
+
+//Day of the next occurrence (in order) - returns false when there are no more up to lastDay
+bool recurIterator_next(recurIterator_t *pIter, int32_t *pDay);
+
+//Day numbers (days since 1970-01-01) of dates in the (proleptic) Gregorian calendar
+int32_t daysFromCivil(int32_t year, uint32_t month, int32_t day);
+void civilFromDays(int32_t days, int32_t *pYear, uint32_t *pMonth, uint32_t *pDay);
+uint32_t daysInMonth(int32_t year, uint32_t month);
+
+#endif
@@ -0,0 +1,235 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "Arduino.h"
+#include "esp_sntp.h"
+#include "esp_timer.h"
+
+#include "TimeSource.h"
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+#include <sys/time.h>
+#include <inttypes.h>
+
+//Sync once the clock could be this far out (the display shows minutes)...
+#define INKY_TIME_MAX_ERROR_SECS           30
+//...and wait for NTP rather than use a clock this far out
+#define INKY_TIME_MUST_SYNC_ERROR_SECS    300
+//Sync at least this often anyway, so the drift is kept measured
+#define INKY_TIME_MAX_SYNC_INTERVAL_SECS  (24 * 60 * 60)
+
+//How far out we assume the RTC is until we've measured its drift...
+#define INKY_TIME_UNKNOWN_DRIFT_PPM      2000
+//...and how far out the measured drift might be
+#define INKY_TIME_DRIFT_UNCERTAINTY_PPM   200
+//Error in the clock there'd be even with no drift (setting it, NTP itself)
+#define INKY_TIME_BASE_ERROR_SECS           1
+
+//Don't measure drift over less time than this: NTP's own error would swamp it
+#define INKY_TIME_MIN_MEASURE_SECS        (30 * 60)
+#define INKY_TIME_MAX_DRIFT_PPM         50000
+
+typedef struct {
+    bool synced;           //NTP has set the clock since power on
+    time_t lastSync;       //When NTP last set the clock
+    time_t lastCorrected;  //When we last corrected the clock for drift (or NTP set it)
+    bool driftKnown;
+    int32_t driftPpm;      //How fast the RTC runs (+ve: gains time)
+    uint32_t syncs;
+} timeSourceState_t;
+
+RTC_DATA_ATTR static timeSourceState_t TimeState;
+
+//NTP this wake
+static bool NtpStarted = false;
+static int64_t NtpStartClockMicros;           //The clock when we started NTP...
+static int64_t NtpStartTimerMicros;           //...and esp_timer at the same moment (it's accurate whilst we're awake)
+static volatile bool NtpDone = false;
+static volatile int64_t NtpOffsetMicros = 0;  //How far NTP moved the clock
+
+static int64_t clockMicros(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+//Called (on the lwIP task) when NTP sets the clock
+static void ntpSynced(struct timeval *tv)
+{
+    int64_t clockWouldBe = NtpStartClockMicros + (esp_timer_get_time() - NtpStartTimerMicros);
+
+    NtpOffsetMicros = ((int64_t)tv->tv_sec * 1000000 + tv->tv_usec) - clockWouldBe;
+    NtpDone = true;
+}
+
+static void startNtp(void)
+{
+    NtpDone = false;
+    NtpStartClockMicros = clockMicros();
+    NtpStartTimerMicros = esp_timer_get_time();
+
+    sntp_set_time_sync_notification_cb(ntpSynced);
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+    NtpStarted = true;
+}
+
+static void stopNtp(void)
+{
+    sntp_stop();
+    NtpStarted = false;
+}
+
+//After NTP has set the clock: the offset it found (over the time since the last sync) is
+//the error in our drift estimate
+static void recordSync(void)
+{
+    time_t syncStart = (time_t)(NtpStartClockMicros / 1000000);
+
+    LogSerial_Info("NTP moved the clock by %" PRId64 " ms", NtpOffsetMicros / 1000);
+
+    if (TimeState.synced && syncStart - TimeState.lastSync >= INKY_TIME_MIN_MEASURE_SECS)
+    {
+        int64_t sinceSync = syncStart - TimeState.lastSync;
+        //Offset in us over sinceSync seconds is parts per million - the clock was slow if it moved forward
+        int64_t driftPpm = TimeState.driftPpm - (NtpOffsetMicros / sinceSync);
+
+        if (driftPpm > INKY_TIME_MAX_DRIFT_PPM || driftPpm < -INKY_TIME_MAX_DRIFT_PPM)
+        {
+            LogSerial_Unusual("Ignoring implausible RTC drift: %" PRId64 " ppm", driftPpm);
+        }
+        else
+        {
+            LogSerial_Info("RTC drift %" PRId64 " ppm (measured over %" PRId64 " secs, was %" PRId32 " ppm)",
+                              driftPpm, sinceSync, TimeState.driftPpm);
+            TimeState.driftPpm = (int32_t)driftPpm;
+            TimeState.driftKnown = true;
+        }
+    }
+
+    TimeState.synced = true;
+    TimeState.lastSync = time(nullptr);
+    TimeState.lastCorrected = TimeState.lastSync;
+    TimeState.syncs++;
+}
+
+//Moves the clock by the drift we expect since we last corrected it
+static void correctForDrift(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    int64_t sinceCorrected = tv.tv_sec - TimeState.lastCorrected;
+    int64_t correctionMicros = sinceCorrected * TimeState.driftPpm;
+
+    if (correctionMicros != 0)
+    {
+        int64_t correctedMicros = ((int64_t)tv.tv_sec * 1000000 + tv.tv_usec) - correctionMicros;
+
+        tv.tv_sec  = (time_t)(correctedMicros / 1000000);
+        tv.tv_usec = (suseconds_t)(correctedMicros % 1000000);
+        settimeofday(&tv, NULL);
+
+        LogSerial_Verbose1("Corrected clock by %" PRId64 " ms for drift over %" PRId64 " secs",
+                              -correctionMicros / 1000, sinceCorrected);
+    }
+    TimeState.lastCorrected = tv.tv_sec;
+}
+
+static void waitForNtp(void)
+{
+    unsigned long waitStart = millis();
+
+    Serial.print(F("Waiting for NTP time sync: "));
+    while (!NtpDone)
+    {
+        delay(50);
+        if ((millis() - waitStart) % 500 < 50)
+        {
+            Serial.print(F("."));
+        }
+    }
+    Serial.println();
+
+    LogSerial_Info("Waited %lu ms for NTP", millis() - waitStart);
+    recordSync();
+    stopNtp();
+}
+
+void timeSource_begin(void)
+{
+    time_t now = time(nullptr);
+
+    if (!TimeState.synced || now < TimeState.lastSync)
+    {
+        LogSerial_Info("Clock hasn't been set since power on");
+        startNtp();
+        waitForNtp();
+        return;
+    }
+
+    correctForDrift();
+    now = time(nullptr);
+
+    int64_t sinceSync = now - TimeState.lastSync;
+    uint32_t uncertaintyPpm = TimeState.driftKnown ? INKY_TIME_DRIFT_UNCERTAINTY_PPM : INKY_TIME_UNKNOWN_DRIFT_PPM;
+    int64_t expectedErrorSecs = INKY_TIME_BASE_ERROR_SECS + (sinceSync * uncertaintyPpm) / 1000000;
+
+    if (expectedErrorSecs >= INKY_TIME_MUST_SYNC_ERROR_SECS)
+    {
+        LogSerial_Info("Clock could be %" PRId64 " secs out (last NTP sync %" PRId64 " secs ago)",
+                          expectedErrorSecs, sinceSync);
+        startNtp();
+        waitForNtp();
+    }
+    else if (expectedErrorSecs >= INKY_TIME_MAX_ERROR_SECS || sinceSync >= INKY_TIME_MAX_SYNC_INTERVAL_SECS)
+    {
+        LogSerial_Info("NTP sync due (clock could be %" PRId64 " secs out, last sync %" PRId64 " secs ago) - "
+                       "syncing whilst we carry on", expectedErrorSecs, sinceSync);
+        startNtp();
+    }
+    else
+    {
+        LogSerial_Info("Skipping NTP: clock should be within %" PRId64 " secs (last sync %" PRId64 " secs ago, drift %" PRId32 " ppm%s)",
+                          expectedErrorSecs, sinceSync, TimeState.driftPpm, TimeState.driftKnown ? "" : " - not yet measured");
+    }
+}
+
+bool timeSource_beginOffline(void)
+{
+    time_t now = time(nullptr);
+
+    if (!TimeState.synced || now < TimeState.lastSync)
+    {
+        LogSerial_Error("Clock hasn't been set since power on and we can't reach NTP");
+        return false;
+    }
+
+    correctForDrift();
+    LogSerial_Warning("Can't reach NTP: using the clock corrected for drift (last NTP sync %" PRId64 " secs ago)",
+                         (int64_t)(time(nullptr) - TimeState.lastSync));
+    return true;
+}
+
+void timeSource_end(void)
+{
+    if (!NtpStarted)
+    {
+        return;
+    }
+
+    if (NtpDone)
+    {
+        recordSync();
+    }
+    else
+    {
+        LogSerial_Info("NTP didn't complete this wake - will try again next wake");
+    }
+    stopNtp();
+}
@@ -0,0 +1,34 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+//Decides whether we need NTP this wake. The ESP32's RTC keeps the time through deep sleep
+//but drifts, so we remember (in RTC memory) when NTP last set the clock and how fast the RTC
+//has been found to drift. Each wake the clock is corrected for the expected drift and NTP
+//is only used if the error we can't account for could have grown too big.
+//
+//When a sync is due but the clock is still good enough to use, NTP runs in the background
+//(whilst we fetch calendars) and timeSource_end() records the result. Only when we don't know
+//the time (e.g. after power on) do we wait for NTP.
+
+#ifndef TIMESOURCE_H
+#define TIMESOURCE_H
+
+#include <stdint.h>
+#include <time.h>
+
+//Corrects the clock for drift then, if needed, starts NTP - waiting for it if the clock isn't usable
+//Wifi must be connected
+void timeSource_begin(void);
+
+//When wifi couldn't connect: just corrects the clock for drift (however long since the last NTP sync)
+//returns false if the clock hasn't been set since power on, so can't be used
+bool timeSource_beginOffline(void);
+
+//At the end of the wake: if NTP set the clock, records the drift it found (otherwise stops NTP)
+void timeSource_end(void);
+
+#endif
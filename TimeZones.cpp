@@ -0,0 +1,307 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifdef ARDUINO
+#include "Arduino.h"
+#endif
+
+#include "TimeZones.h"
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "InkyCalInternal.h"
+#include "LogSerial.h"
+
+#define TIMEZONES_SECS_PER_DAY 86400
+
+//Changes of offset we look at in a window (before dropping the ones with the same offset as the last)
+#define TIMEZONES_MAX_CHANGES 32
+
+//Days since 1970-01-01 of the day containing secs (rounding down for times before 1970)
+static inline int32_t daysFromSecs(int64_t secs)
+{
+    return (int32_t)((secs >= 0 ? secs : secs - (TIMEZONES_SECS_PER_DAY - 1)) / TIMEZONES_SECS_PER_DAY);
+}
+
+bool utcOffsets_offsetAt(const utcOffsets_t *pTable, time_t utcTime, int32_t *pOffset)
+{
+    if (utcTime < pTable->windowStart || utcTime >= pTable->windowEnd || pTable->numOffsets == 0)
+    {
+        return false;
+    }
+    uint32_t low = 0;
+    uint32_t high = pTable->numOffsets - 1;
+
+    //Last offset that applies from at or before utcTime
+    while (low < high)
+    {
+        uint32_t mid = (low + high + 1) / 2;
+
+        if (pTable->from[mid] <= utcTime)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    *pOffset = pTable->offsets[low];
+    return true;
+}
+
+uint32_t utcOffsets_localToUtc(const utcOffsets_t *pTable, int64_t localSecs, time_t *pUtcTime)
+{
+    uint32_t matches = 0;
+    time_t earliest = 0;
+
+    //Which offsets give a UTC time when that offset applies?
+    for (uint32_t i = 0; i < pTable->numOffsets; i++)
+    {
+        time_t candidate = (time_t)(localSecs - pTable->offsets[i]);
+        int32_t offset;
+
+        if (utcOffsets_offsetAt(pTable, candidate, &offset) && offset == pTable->offsets[i])
+        {
+            if (matches == 0)
+            {
+                earliest = candidate;
+                matches = 1;
+            }
+            else if (candidate != earliest)
+            {
+                //Clocks went back - the first time it happened is before the change
+                earliest = (candidate < earliest) ? candidate : earliest;
+                matches = 2;
+            }
+        }
+    }
+
+    if (matches > 0)
+    {
+        *pUtcTime = earliest;
+        return (matches == 1) ? UTCOFFSETS_LOCAL_ONE : UTCOFFSETS_LOCAL_TWICE;
+    }
+
+    //Skipped when the clocks went forward at from[i]?
+    for (uint32_t i = 1; i < pTable->numOffsets; i++)
+    {
+        if (   localSecs >= pTable->from[i] + pTable->offsets[i - 1]
+            && localSecs <  pTable->from[i] + pTable->offsets[i])
+        {
+            *pUtcTime = (time_t)(localSecs - pTable->offsets[i - 1]);
+            return UTCOFFSETS_LOCAL_NONE;
+        }
+    }
+
+    int32_t nearestOffset = 0;
+
+    if (pTable->numOffsets > 0)
+    {
+        nearestOffset = (localSecs - pTable->offsets[0] < pTable->windowStart) ? pTable->offsets[0]
+                                                                              : pTable->offsets[pTable->numOffsets - 1];
+    }
+    *pUtcTime = (time_t)(localSecs - nearestOffset);
+    return UTCOFFSETS_LOCAL_OUTSIDE;
+}
+
+//When observances start, as they're found
+typedef struct offsetChanges {
+    time_t windowStart;
+    time_t windowEnd;
+    uint32_t numChanges;
+    time_t at[TIMEZONES_MAX_CHANGES];          //In the window (in the order found)
+    int32_t offsets[TIMEZONES_MAX_CHANGES];
+    bool haveBefore;
+    time_t lastBefore;                         //Last change at or before windowStart...
+    int32_t offsetBefore;                      //...and the offset from it
+    time_t earliest;                           //Earliest change found...
+    int32_t offsetBeforeEarliest;              //...and the offset before it (if there's nothing before the window)
+} offsetChanges_t;
+
+static void addOnset(offsetChanges_t *pChanges, const timeZoneObservance_t *pObservance, int32_t day)
+{
+    time_t onset = (time_t)day * TIMEZONES_SECS_PER_DAY + pObservance->startSecsOfDay - pObservance->offsetFrom;
+
+    if (onset < pChanges->earliest)
+    {
+        pChanges->earliest = onset;
+        pChanges->offsetBeforeEarliest = pObservance->offsetFrom;
+    }
+
+    if (onset <= pChanges->windowStart)
+    {
+        if (!pChanges->haveBefore || onset > pChanges->lastBefore)
+        {
+            pChanges->haveBefore = true;
+            pChanges->lastBefore = onset;
+            pChanges->offsetBefore = pObservance->offsetTo;
+        }
+    }
+    else if (onset < pChanges->windowEnd)
+    {
+        if (pChanges->numChanges < TIMEZONES_MAX_CHANGES)
+        {
+            pChanges->at[pChanges->numChanges] = onset;
+            pChanges->offsets[pChanges->numChanges] = pObservance->offsetTo;
+            pChanges->numChanges++;
+        }
+        else
+        {
+            LogSerial_Unusual("Time zone changes offset more than %d times around the days shown", TIMEZONES_MAX_CHANGES);
+        }
+    }
+}
+
+void timeZone_buildOffsets(utcOffsets_t *pTable, const timeZoneObservance_t *pObservances, uint32_t numObservances,
+                           time_t windowStart, time_t windowEnd)
+{
+    offsetChanges_t changes;
+
+    changes.windowStart = windowStart;
+    changes.windowEnd = windowEnd;
+    changes.numChanges = 0;
+    changes.haveBefore = false;
+    changes.lastBefore = 0;
+    changes.offsetBefore = 0;
+    changes.earliest = windowEnd;
+    changes.offsetBeforeEarliest = (numObservances > 0) ? pObservances[0].offsetFrom : 0;
+
+    //Back far enough for the last change of a yearly rule before the window
+    int32_t firstDay = daysFromSecs(windowStart) - 367;
+    int32_t lastDay = daysFromSecs(windowEnd) + 1;
+
+    for (uint32_t i = 0; i < numObservances; i++)
+    {
+        const timeZoneObservance_t *pObservance = &pObservances[i];
+
+        if (pObservance->hasRule)
+        {
+            recurIterator_t iter;
+            int32_t day;
+
+            recurIterator_init(&iter, &pObservance->rule, pObservance->startDay, firstDay, lastDay);
+
+            while (recurIterator_next(&iter, &day))
+            {
+                addOnset(&changes, pObservance, day);
+            }
+        }
+        else if (pObservance->startDay <= lastDay)
+        {
+            addOnset(&changes, pObservance, pObservance->startDay);
+        }
+    }
+
+    //Into time order (there are only a few)
+    for (uint32_t i = 1; i < changes.numChanges; i++)
+    {
+        time_t at = changes.at[i];
+        int32_t offset = changes.offsets[i];
+        uint32_t j = i;
+
+        while (j > 0 && changes.at[j - 1] > at)
+        {
+            changes.at[j] = changes.at[j - 1];
+            changes.offsets[j] = changes.offsets[j - 1];
+            j--;
+        }
+        changes.at[j] = at;
+        changes.offsets[j] = offset;
+    }
+
+    pTable->windowStart = windowStart;
+    pTable->windowEnd   = windowEnd;
+    pTable->from[0]     = windowStart;
+    pTable->offsets[0]  = changes.haveBefore ? changes.offsetBefore : changes.offsetBeforeEarliest;
+    pTable->numOffsets  = 1;
+
+    for (uint32_t i = 0; i < changes.numChanges; i++)
+    {
+        if (changes.offsets[i] == pTable->offsets[pTable->numOffsets - 1])
+        {
+            continue;
+        }
+
+        if (pTable->numOffsets >= TIMEZONES_MAX_OFFSETS)
+        {
+            LogSerial_Unusual("Time zone changes offset more than %d times around the days shown", TIMEZONES_MAX_OFFSETS - 1);
+            pTable->windowEnd = changes.at[i];
+            break;
+        }
+        pTable->from[pTable->numOffsets]    = changes.at[i];
+        pTable->offsets[pTable->numOffsets] = changes.offsets[i];
+        pTable->numOffsets++;
+    }
+}
+
+timeZoneCache_t *timeZoneCache_create()
+{
+    timeZoneCache_t *pCache = (timeZoneCache_t *)INKY_MALLOC_LARGE(sizeof(timeZoneCache_t));
+
+    if (pCache != NULL)
+    {
+        memset(pCache, 0, sizeof(timeZoneCache_t));
+    }
+    return pCache;
+}
+
+void timeZoneCache_destroy(timeZoneCache_t *pCache)
+{
+    free(pCache);
+}
+
+//Slot the zone is in or the empty one it would go in (there's always an empty slot)
+static timeZone_t *findSlot(timeZoneCache_t *pCache, const char *tzid, uint32_t hash)
+{
+    for (uint32_t slot = hash & (TIMEZONES_SLOTS - 1); ; slot = (slot + 1) & (TIMEZONES_SLOTS - 1))
+    {
+        timeZone_t *pZone = &pCache->slots[slot];
+
+        if (pZone->hash == 0 || (pZone->hash == hash && strcmp(pZone->tzid, tzid) == 0))
+        {
+            return pZone;
+        }
+    }
+}
+
+timeZone_t *timeZoneCache_find(timeZoneCache_t *pCache, const char *tzid)
+{
+    timeZone_t *pZone = findSlot(pCache, tzid, inky_fnv1a(tzid, strlen(tzid)));
+
+    return (pZone->hash != 0) ? pZone : NULL;
+}
+
+timeZone_t *timeZoneCache_add(timeZoneCache_t *pCache, const char *tzid)
+{
+    uint32_t hash = inky_fnv1a(tzid, strlen(tzid));
+    timeZone_t *pZone = findSlot(pCache, tzid, hash);
+
+    if (pZone->hash != 0)
+    {
+        return pZone;
+    }
+
+    if (pCache->numZones >= TIMEZONES_MAX_ZONES)
+    {
+        if (!pCache->fullLogged)
+        {
+            LogSerial_Unusual("More than %d time zones in a calendar - using local time for %s", TIMEZONES_MAX_ZONES, tzid);
+            pCache->fullLogged = true;
+        }
+        return NULL;
+    }
+    pZone->hash = hash;
+    strncpy(pZone->tzid, tzid, sizeof(pZone->tzid) - 1);
+    pZone->tzid[sizeof(pZone->tzid) - 1] = '\0';
+    pZone->known = false;
+    pZone->offsets.numOffsets = 0;
+    pCache->numZones++;
+
+    return pZone;
+}
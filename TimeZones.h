@@ -0,0 +1,92 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#ifndef TIMEZONES_H
+#define TIMEZONES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "RecurRule.h"
+
+//UTC offsets around the days shown - for local time (worked out with the C library by Calendar.cpp)
+//and for the time zones (VTIMEZONE) of a calendar, so an event's time in its zone (DTSTART;TZID=...)
+//converts to epoch time with a binary search of when the offset changes.
+//
+//A VTIMEZONE is a list of observances (STANDARD/DAYLIGHT) each with the local time it starts
+//(DTSTART), the offsets before and after (TZOFFSETFROM/TZOFFSETTO) and when it starts again (RRULE).
+//Only the changes in the window around the days shown are worked out (with RecurRule.cpp). The tables
+//are kept by TZID in a small hash table for the calendar being parsed.
+
+#define TIMEZONES_MAX_OFFSETS    8    //Offsets (so one less change of offset) in a window
+#define TIMEZONES_MAX_OBSERVANCES 8   //STANDARD/DAYLIGHT in a VTIMEZONE we look at
+#define TIMEZONES_MAXBYTES_TZID  64
+#define TIMEZONES_SLOTS          16   //Power of 2
+#define TIMEZONES_MAX_ZONES      12   //Keep some slots empty so lookups stay short
+
+typedef struct utcOffsets {
+    time_t windowStart;                      //\__ UTC times covered: windowStart <= t < windowEnd
+    time_t windowEnd;                        ///
+    uint32_t numOffsets;
+    time_t from[TIMEZONES_MAX_OFFSETS];      //offsets[i] applies from from[i] (from[0] is windowStart)
+    int32_t offsets[TIMEZONES_MAX_OFFSETS];  //Local time - UTC in seconds
+} utcOffsets_t;
+
+//What utcOffsets_localToUtc() found
+#define UTCOFFSETS_LOCAL_ONE     0  //The local time happens once
+#define UTCOFFSETS_LOCAL_NONE    1  //It's skipped when the clocks go forward
+#define UTCOFFSETS_LOCAL_TWICE   2  //It happens twice when the clocks go back
+#define UTCOFFSETS_LOCAL_OUTSIDE 3  //Not in the window (the offset at the nearest end was used)
+
+//Local time - UTC (in seconds) at utcTime - returns false if utcTime isn't in the window the table covers
+bool utcOffsets_offsetAt(const utcOffsets_t *pTable, time_t utcTime, int32_t *pOffset);
+
+//Converts a local time (seconds since 1970-01-01 00:00 local time) to epoch time. A time that's skipped
+//or happens twice uses the offset before the change (as RFC 5545 3.3.5 says)
+//returns one of the UTCOFFSETS_LOCAL_* constants
+uint32_t utcOffsets_localToUtc(const utcOffsets_t *pTable, int64_t localSecs, time_t *pUtcTime);
+
+//A STANDARD or DAYLIGHT in a VTIMEZONE
+typedef struct timeZoneObservance {
+    int32_t startDay;         //\__ DTSTART (local time - in the offset before)
+    int32_t startSecsOfDay;   ///
+    int32_t offsetFrom;       //TZOFFSETFROM in seconds
+    int32_t offsetTo;         //TZOFFSETTO in seconds
+    bool hasRule;
+    recurRule_t rule;         //RRULE (if hasRule)
+} timeZoneObservance_t;
+
+//Works out the offsets (between windowStart and windowEnd) of a VTIMEZONE's observances
+void timeZone_buildOffsets(utcOffsets_t *pTable, const timeZoneObservance_t *pObservances, uint32_t numObservances,
+                           time_t windowStart, time_t windowEnd);
+
+typedef struct timeZone {
+    uint32_t hash;                           //0 if the slot is empty
+    char tzid[TIMEZONES_MAXBYTES_TZID];
+    bool known;                              //false if there's no VTIMEZONE for it (yet) - it's local time
+    utcOffsets_t offsets;
+} timeZone_t;
+
+typedef struct timeZoneCache {
+    uint32_t numZones;
+    bool fullLogged;
+    timeZone_t slots[TIMEZONES_SLOTS];
+} timeZoneCache_t;
+
+//Allocates an empty cache (in PSRAM on the InkPlate) - returns NULL if there's no memory
+timeZoneCache_t *timeZoneCache_create();
+void timeZoneCache_destroy(timeZoneCache_t *pCache);
+
+//returns the zone called tzid or NULL if there isn't one
+timeZone_t *timeZoneCache_find(timeZoneCache_t *pCache, const char *tzid);
+
+//Finds or adds (not known, with no offsets) the zone called tzid
+//returns NULL (having logged it the first time) if the cache is full
+timeZone_t *timeZoneCache_add(timeZoneCache_t *pCache, const char *tzid);
+
+#endif
@@ -0,0 +1,130 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+#include "WakeStats.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+
+WakeStats_t wakeStats;
+
+static const char *ResultNames[] = { "failed", "downloaded", "cached", "saved" };
+
+void wakeStats_reset(void)
+{
+    memset(&wakeStats, 0, sizeof(wakeStats));
+}
+
+CalendarStats_t *wakeStats_addCalendar(uint32_t index)
+{
+    if (wakeStats.numCalendars >= INKY_WAKESTATS_MAX_CALENDARS)
+    {
+        wakeStats.calendarsNotRecorded++;
+        return NULL;
+    }
+    CalendarStats_t *pCalStats = &(wakeStats.calendars[wakeStats.numCalendars++]);
+
+    memset(pCalStats, 0, sizeof(CalendarStats_t));
+    pCalStats->index = index;
+    return pCalStats;
+}
+
+void wakeStats_addBody(CalendarStats_t *pCalStats, const HttpBodyStats_t *pBodyStats)
+{
+    pCalStats->transferMillis    += pBodyStats->receiveMillis;
+    pCalStats->bytesReceived     += pBodyStats->totalRaw;
+    pCalStats->bytesDecoded      += pBodyStats->totalDecoded;
+    pCalStats->bytesParsed       += pBodyStats->pipeline.totalParsed;
+    pCalStats->parses            += pBodyStats->pipeline.parses;
+    pCalStats->bytesMoved        += pBodyStats->pipeline.totalMoved;
+
+    if (pBodyStats->pipeline.peakUnparsed > pCalStats->peakUnparsed)
+    {
+        pCalStats->peakUnparsed = pBodyStats->pipeline.peakUnparsed;
+    }
+    if (pBodyStats->longestStallMillis > pCalStats->longestStallMillis)
+    {
+        pCalStats->longestStallMillis = pBodyStats->longestStallMillis;
+    }
+}
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool full;
+} jsonWriter_t;
+
+static void append(jsonWriter_t *pWriter, const char *format, ...)
+{
+    if (pWriter->full)
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(pWriter->buf + pWriter->len, pWriter->size - pWriter->len, format, args);
+    va_end(args);
+
+    if (written < 0 || (size_t)written >= pWriter->size - pWriter->len)
+    {
+        pWriter->full = true;
+        return;
+    }
+    pWriter->len += written;
+}
+
+static void appendCalendar(jsonWriter_t *pWriter, const CalendarStats_t *pCal)
+{
+    const char *result = (pCal->result < sizeof(ResultNames) / sizeof(ResultNames[0])) ? ResultNames[pCal->result] : "?";
+
+    append(pWriter, "{\"index\":%" PRIu32 ",\"result\":\"%s\",\"rc\":%" PRId32 ",\"reused\":%s,",
+                    pCal->index, result, pCal->rc, pCal->reusedConnection ? "true" : "false");
+    append(pWriter, "\"dnsMs\":%" PRIu32 ",\"connectMs\":%" PRIu32 ",\"ttfbMs\":%" PRIu32
+                    ",\"transferMs\":%" PRIu32 ",\"totalMs\":%" PRIu32 ",",
+                    pCal->dnsMillis, pCal->connectMillis, pCal->ttfbMillis, pCal->transferMillis, pCal->totalMillis);
+    append(pWriter, "\"bytesReceived\":%" PRIu64 ",\"bytesDecoded\":%" PRIu64 ",\"bytesParsed\":%" PRIu64
+                    ",\"parses\":%" PRIu64 ",\"bytesMoved\":%" PRIu64 ",\"peakUnparsed\":%" PRIu64 ",",
+                    pCal->bytesReceived, pCal->bytesDecoded, pCal->bytesParsed,
+                    pCal->parses, pCal->bytesMoved, pCal->peakUnparsed);
+    append(pWriter, "\"longestStallMs\":%" PRIu64 ",\"eventsSeen\":%" PRIu64 ",\"eventsRelevant\":%" PRIu64 "}",
+                    pCal->longestStallMillis, pCal->eventsSeen, pCal->eventsRelevant);
+}
+
+size_t wakeStats_toJson(char *buf, size_t bufSize, uint32_t wakeMillis,
+                        uint64_t warnings, uint64_t errors, uint64_t fatals)
+{
+    jsonWriter_t writer = { buf, bufSize, 0, (bufSize == 0) };
+
+    append(&writer, "{\"wakeStats\":{\"wakeMs\":%" PRIu32 ",\"wifiMs\":%" PRIu32 ",\"wifiFast\":%s,\"timeMs\":%" PRIu32 ",",
+                    wakeMillis, wakeStats.wifiMillis, wakeStats.wifiFast ? "true" : "false", wakeStats.timeMillis);
+    append(&writer, "\"warnings\":%" PRIu64 ",\"errors\":%" PRIu64 ",\"fatals\":%" PRIu64 ",\"calendarsNotRecorded\":%" PRIu32 ",",
+                    warnings, errors, fatals, wakeStats.calendarsNotRecorded);
+    append(&writer, "\"calendars\":[");
+
+    for (uint32_t i = 0; i < wakeStats.numCalendars; i++)
+    {
+        if (i > 0)
+        {
+            append(&writer, ",");
+        }
+        appendCalendar(&writer, &(wakeStats.calendars[i]));
+    }
+    append(&writer, "]}}");
+
+    if (writer.full)
+    {
+        if (bufSize > 0)
+        {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+    return writer.len;
+}
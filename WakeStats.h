@@ -0,0 +1,78 @@
+/*
+   This program is free software: you can redistribute it and/or modify it under
+   the terms of the GNU General Public License as published by the Free Software
+   Foundation, either version 3 of the License, or (at your option) any later
+   version.
+*/
+
+//What happened this wake (how long connecting and downloading took, how much data was
+//received and parsed...) for each calendar, collected as we go and written at the end of
+//the wake as one line of JSON so it can be picked out of the serial output and tracked
+//over time. Urls aren't included (they are often secret): calendars are identified by
+//their index in Calendars[].
+
+#ifndef WAKESTATS_H
+#define WAKESTATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "HttpResponse.h"
+
+#define INKY_WAKESTATS_MAX_CALENDARS  8
+
+//Enough for wakeStats_toJson() with all INKY_WAKESTATS_MAX_CALENDARS used
+#define INKY_WAKESTATS_MAXBYTES_JSON  6144
+
+//How we got a calendar's events
+#define INKY_WAKESTATS_RESULT_FAILED       0
+#define INKY_WAKESTATS_RESULT_DOWNLOADED   1  //Downloaded and parsed
+#define INKY_WAKESTATS_RESULT_CACHED       2  //Not modified: entries restored from CalendarCache
+#define INKY_WAKESTATS_RESULT_SAVED        3  //Parsed the copy saved by DownloadCache
+
+typedef struct {
+    uint32_t index;             //In Calendars[]
+    uint8_t result;             //INKY_WAKESTATS_RESULT_*
+    int32_t rc;                 //From getData
+    bool reusedConnection;
+    uint32_t dnsMillis;
+    uint32_t connectMillis;     //TCP connect and TLS handshake (including dnsMillis)
+    uint32_t ttfbMillis;        //From sending the request to the response headers arriving
+    uint32_t transferMillis;    //Receiving (and parsing) the body
+    uint32_t totalMillis;       //All of getData
+    uint64_t bytesReceived;     //Body as sent (chunked/gzipped)
+    uint64_t bytesDecoded;
+    uint64_t bytesParsed;
+    uint64_t parses;
+    uint64_t bytesMoved;        //Unparsed data moved to the start of the receive window
+    uint64_t peakUnparsed;      //Most unparsed data in the receive window at once
+    uint64_t longestStallMillis;
+    uint64_t eventsSeen;
+    uint64_t eventsRelevant;
+} CalendarStats_t;
+
+typedef struct {
+    uint32_t wifiMillis;
+    bool wifiFast;              //Reconnected using last wake's AP and address
+    uint32_t timeMillis;        //Getting the time (only long if we had to wait for NTP)
+    uint32_t numCalendars;      //Entries used in calendars[]
+    uint32_t calendarsNotRecorded;
+    CalendarStats_t calendars[INKY_WAKESTATS_MAX_CALENDARS];
+} WakeStats_t;
+
+extern WakeStats_t wakeStats;
+
+void wakeStats_reset(void);
+
+//Next calendar's stats (zeroed) - NULL if we've no space left to record it
+CalendarStats_t *wakeStats_addCalendar(uint32_t index);
+
+//Adds the body stats from HttpResponse to pCalStats
+void wakeStats_addBody(CalendarStats_t *pCalStats, const HttpBodyStats_t *pBodyStats);
+
+//Writes wakeStats as one line of JSON (without a newline) plus the given wake-level values
+//returns chars written (not including the \0) or 0 if buf wasn't big enough
+size_t wakeStats_toJson(char *buf, size_t bufSize, uint32_t wakeMillis,
+                        uint64_t warnings, uint64_t errors, uint64_t fatals);
+
+#endif
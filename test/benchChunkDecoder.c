@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "utils/test_utils.h"
+#include "utils/test_utils_bench.h"
+#include "ChunkDecoder.h"
+
+//Compares the chunk decoder with the byte at a time approach getData used to use
+//on a multi-MB body fed in fragments the size of a TCP segment and of a TLS record
+
+#define BENCH_PAYLOAD_BYTES (8 * 1024 * 1024)
+#define BENCH_CHUNK_BYTES   8192   //Typical of what we see from calendar.google.com
+#define BENCH_REPEATS       10
+
+//Byte at a time decoding - for comparison only
+typedef struct {
+    bool inChunk;
+    uint64_t remaining;
+    uint64_t length;
+} byteDecoder_t;
+
+static size_t byteAtATimeDecode(byteDecoder_t *pDec, char *buf, size_t len)
+{
+    size_t out = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = buf[i];
+
+        if (pDec->inChunk)
+        {
+            buf[out++] = c;
+            if (--pDec->remaining == 0)
+            {
+                pDec->inChunk = false;
+            }
+        }
+        else if (c == '\n')
+        {
+            if (pDec->length > 0)
+            {
+                pDec->inChunk = true;
+                pDec->remaining = pDec->length;
+                pDec->length = 0;
+            }
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            pDec->length = pDec->length * 16 + (c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            pDec->length = pDec->length * 16 + (c - 'a' + 10);
+        }
+    }
+    return out;
+}
+
+int main(void)
+{
+    char *payload = (char *)malloc(BENCH_PAYLOAD_BYTES);
+    char *encoded = (char *)malloc(BENCH_PAYLOAD_BYTES + BENCH_PAYLOAD_BYTES / 100 + 100);
+    char *work    = (char *)malloc(BENCH_PAYLOAD_BYTES + BENCH_PAYLOAD_BYTES / 100 + 100);
+
+    //Text that looks a little like an ical file
+    for (size_t i = 0; i < BENCH_PAYLOAD_BYTES; i++)
+    {
+        payload[i] = (i % 75 == 74) ? '\n' : (char)('A' + (i % 26));
+    }
+
+    size_t encodedLen = 0;
+    for (size_t pos = 0; pos < BENCH_PAYLOAD_BYTES; pos += BENCH_CHUNK_BYTES)
+    {
+        size_t len = BENCH_PAYLOAD_BYTES - pos < BENCH_CHUNK_BYTES ? BENCH_PAYLOAD_BYTES - pos : BENCH_CHUNK_BYTES;
+        encodedLen += sprintf(encoded + encodedLen, "%zx\r\n", len);
+        memcpy(encoded + encodedLen, payload + pos, len);
+        encodedLen += len;
+        encodedLen += sprintf(encoded + encodedLen, "\r\n");
+    }
+    encodedLen += sprintf(encoded + encodedLen, "0\r\n\r\n");
+
+    size_t fragSizes[] = {1460, 16384};
+
+    for (uint32_t f = 0; f < sizeof(fragSizes)/sizeof(fragSizes[0]); f++)
+    {
+        size_t fragSize = fragSizes[f];
+        char desc[80];
+
+        double start = test_utils_nowSecs();
+        uint64_t totalOut = 0;
+        for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+        {
+            memcpy(work, encoded, encodedLen);
+            byteDecoder_t dec = {};
+            for (size_t pos = 0; pos < encodedLen; pos += fragSize)
+            {
+                size_t len = encodedLen - pos < fragSize ? encodedLen - pos : fragSize;
+                totalOut += byteAtATimeDecode(&dec, work + pos, len);
+            }
+        }
+        double secs = test_utils_nowSecs() - start;
+        TEST_ASSERT(totalOut == (uint64_t)BENCH_PAYLOAD_BYTES * BENCH_REPEATS, "decoded %" PRIu64, totalOut);
+        snprintf(desc, sizeof(desc), "Byte at a time, %zu byte fragments", fragSize);
+        test_utils_reportThroughput(desc, (uint64_t)encodedLen * BENCH_REPEATS, secs);
+
+        start = test_utils_nowSecs();
+        totalOut = 0;
+        for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+        {
+            memcpy(work, encoded, encodedLen);
+            ChunkDecoder_t decoder;
+            chunkDecoder_init(&decoder);
+            for (size_t pos = 0; pos < encodedLen; pos += fragSize)
+            {
+                size_t len = encodedLen - pos < fragSize ? encodedLen - pos : fragSize;
+                size_t payloadLen = 0;
+                chunkDecoder_decode(&decoder, work + pos, len, &payloadLen);
+                totalOut += payloadLen;
+            }
+        }
+        secs = test_utils_nowSecs() - start;
+        TEST_ASSERT(totalOut == (uint64_t)BENCH_PAYLOAD_BYTES * BENCH_REPEATS, "decoded %" PRIu64, totalOut);
+        snprintf(desc, sizeof(desc), "ChunkDecoder, %zu byte fragments", fragSize);
+        test_utils_reportThroughput(desc, (uint64_t)encodedLen * BENCH_REPEATS, secs);
+    }
+
+    free(payload);
+    free(encoded);
+    free(work);
+    return 0;
+}
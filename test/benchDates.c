@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <stddef.h>
+
+#include "utils/test_utils.h"
+#include "utils/test_utils_bench.h"
+#include "Calendar.h"
+
+//Compares converting event times to epoch times and back to dates (as every event's times are)
+//with the C library (strptime/mktime/localtime_r as Calendar.cpp used to) and with the
+//day arithmetic and UTC offset table now used - for times in the days shown (or near them) and
+//for times spread over years (which mostly fall back to the C library to get the offset). And
+//putting events in the columns of the days shown by comparing their dates with each day's (as
+//getTimeString used to) and by a binary search of when each day starts - with 3 days and a month shown.
+//And expanding all day events that have been recurring for 10 years by stepping through every occurrence
+//from DTSTART (as getNextOccurence used to) and by jumping to the first one that could be on the days shown
+
+#define BENCH_NUM_TIMES 200000
+#define BENCH_REPEATS        5
+#define BENCH_RECUR_REPEATS  200
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+time_t convertYYYYMMDDTHHMMSSZtoEpochTime(const char *strYYYYMMDDTHHMMSSZ);
+int convertEpochTimeToYYYYMMDD(time_t inputTime);
+void getDateString(char *timeStr, struct tm *pTimeinfo, bool inclYear);
+void getTimeString(char *timestr, char *from, char *to, int8_t *day, time_t *timeStamp);
+uint32_t parseAllDayEvent(entry_t *pEvents, int *pEventIndex, int maxEvents, char *dateStart, char *dateEnd,
+                          char *recurRule, const struct occurrenceFilter *pFilter);
+uint32_t parseAllDayEventInstance(entry_t *pEvents, int *pEventIndex, int maxEvents, int dateStartInt, int dateEndInt);
+
+//As the converters were - for comparison only
+static time_t libcTimeToEpoch(const char *strYYYYMMDDTHHMMSSZ)
+{
+    struct tm ltm = {0};
+    char temp[40];
+
+    strncpy(temp, strYYYYMMDDTHHMMSSZ, 16);
+    temp[16] = 0;
+    memmove(temp + 5, temp + 4, 16);
+    memmove(temp + 8, temp + 7, 16);
+    memmove(temp + 14, temp + 13, 16);
+    memmove(temp + 16, temp + 15, 16);
+    temp[4] = temp[7] = temp[13] = temp[16] = '-';
+
+    strptime(temp, "%Y-%m-%dT%H-%M-%SZ", &ltm);
+    ltm.tm_isdst = -1;
+    return mktime(&ltm);
+}
+
+static time_t libcDayToEpoch(const char *dayYYYYMMDD)
+{
+    struct tm ltm = {0};
+    char temp[40];
+
+    strncpy(temp, dayYYYYMMDD, 9);
+    temp[8] = 0;
+    memmove(temp + 5, temp + 4, 16);
+    memmove(temp + 8, temp + 7, 16);
+    temp[4] = temp[7] = '-';
+
+    strptime(temp, "%Y-%m-%dT", &ltm);
+    ltm.tm_isdst = -1;
+    return mktime(&ltm);
+}
+
+static int libcEpochToYYYYMMDD(time_t inputTime)
+{
+    char temp[10];
+    struct tm day_tm;
+    localtime_r(&inputTime, &day_tm);
+
+    strftime(temp, 9, "%Y%m%d", &day_tm);
+    return (int)strtol(temp, NULL, 10);
+}
+
+//getTimeString as it was (less the logging) - comparing the event's date with each day shown's
+static int LibcFirstDayYYYYMMDD;
+static int LibcLastDayYYYYMMDD;
+
+static void libcGetTimeString(char *timestr, char *from, char *to, int8_t *day, time_t *timeStamp)
+{
+    time_t to_epochtime = libcTimeToEpoch(to);
+    if (LibcFirstDayYYYYMMDD > libcEpochToYYYYMMDD(to_epochtime))
+    {
+        *day = -1;
+        return;
+    }
+    time_t from_epochtime = libcTimeToEpoch(from);
+    if (LibcLastDayYYYYMMDD < libcEpochToYYYYMMDD(from_epochtime))
+    {
+        *day = -1;
+        return;
+    }
+
+    struct tm from_tm_local;
+    localtime_r(&from_epochtime, &from_tm_local);
+    from_tm_local.tm_isdst = -1;
+    strncpy(timestr, asctime(&from_tm_local) + 11, 5);
+    timestr[5] = '-';
+
+    struct tm to_tm_local;
+    localtime_r(&to_epochtime, &to_tm_local);
+    to_tm_local.tm_isdst = -1;
+    strncpy(timestr + 6, asctime(&to_tm_local) + 11, 5);
+    timestr[11] = 0;
+
+    *timeStamp = from_epochtime;
+
+    char eventDateString[16];
+    getDateString(eventDateString, &from_tm_local, true);
+    *day = -1;
+
+    for (int daynum = 0; daynum < (int)getCalendarNumDays(); daynum++)
+    {
+        char dayDateString[16];
+        getDateStringOffsetDays(dayDateString, daynum, true);
+
+        if (strcmp(eventDateString, dayDateString) == 0)
+        {
+            *day = daynum;
+        }
+    }
+}
+
+//parseAllDayEvent as it was (less the logging) for a rule with no COUNT=/UNTIL= - stepping from DTSTART with mktime(),
+//months (or years, weeks or days) at a time
+static uint32_t libcParseRecurringAllDayEvent(char *dateStart, char *dateEnd, int recurTmField, int interval)
+{
+    time_t start = libcDayToEpoch(dateStart);
+    time_t end   = libcDayToEpoch(dateEnd);
+    uint32_t relevantDays = 0;
+
+    while (true)
+    {
+        int startInt = libcEpochToYYYYMMDD(start);
+
+        if (startInt > LibcLastDayYYYYMMDD)
+        {
+            break;
+        }
+        relevantDays += parseAllDayEventInstance(entries, &entriesNum, MAX_ENTRIES, startInt, libcEpochToYYYYMMDD(end));
+
+        struct tm startTm, endTm;
+        localtime_r(&start, &startTm);
+        localtime_r(&end, &endTm);
+        startTm.tm_isdst = endTm.tm_isdst = -1;
+
+        //recurTmField is the offset of the field of struct tm to add to
+        *(int *)((char *)&startTm + recurTmField) += interval;
+        *(int *)((char *)&endTm + recurTmField) += interval;
+        start = mktime(&startTm);
+        end   = mktime(&endTm);
+    }
+    return relevantDays;
+}
+
+typedef void getTimeStringFn_t(char *timestr, char *from, char *to, int8_t *day, time_t *timeStamp);
+
+typedef time_t timeToEpochFn_t(const char *str);
+typedef int epochToDateFn_t(time_t inputTime);
+
+//Times (with a Z for UTC, or local as with a TZID) or dates every 7 hours 13 mins from start,
+//going back to start after span secs
+static char *buildTimes(time_t start, time_t span, bool withZ, size_t strLen)
+{
+    char *times = (char *)malloc((size_t)BENCH_NUM_TIMES * strLen);
+    TEST_ASSERT_PTR_NOT_NULL(times);
+
+    for (uint32_t i = 0; i < BENCH_NUM_TIMES; i++)
+    {
+        struct tm timeTm;
+        time_t t = start + ((time_t)i * (7 * 3600 + 13 * 60)) % span;
+        gmtime_r(&t, &timeTm);
+        strftime(times + i * strLen, strLen, strLen > 9 ? (withZ ? "%Y%m%dT%H%M%SZ" : "%Y%m%dT%H%M%S") : "%Y%m%d", &timeTm);
+    }
+    return times;
+}
+
+static void benchTimes(const char *desc, timeToEpochFn_t *toEpoch, epochToDateFn_t *toDate,
+                       const char *times, size_t strLen, int64_t *pCheck)
+{
+    int64_t check = 0;
+    double start = test_utils_nowSecs();
+
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        for (uint32_t i = 0; i < BENCH_NUM_TIMES; i++)
+        {
+            check += toDate(toEpoch(times + i * strLen));
+        }
+    }
+    double secs = test_utils_nowSecs() - start;
+
+    printf("%-70s %8.1f ns per time\n", desc, secs * 1e9 / ((double)BENCH_NUM_TIMES * BENCH_REPEATS));
+    *pCheck = check;
+}
+
+static void compare(const char *desc, time_t start, time_t span, bool withZ, size_t strLen,
+                    timeToEpochFn_t *libcToEpoch, timeToEpochFn_t *toEpoch)
+{
+    char *times = buildTimes(start, span, withZ, strLen);
+    char libcDesc[80];
+    char newDesc[80];
+    int64_t libcCheck = 0;
+    int64_t newCheck = 0;
+
+    snprintf(libcDesc, sizeof(libcDesc), "%s: C library", desc);
+    snprintf(newDesc, sizeof(newDesc), "%s: day arithmetic + offset table", desc);
+
+    benchTimes(libcDesc, libcToEpoch, libcEpochToYYYYMMDD, times, strLen, &libcCheck);
+    benchTimes(newDesc, toEpoch, convertEpochTimeToYYYYMMDD, times, strLen, &newCheck);
+
+    //Times with a Z were taken to be local by the C library version - so they won't match
+    TEST_ASSERT(withZ || libcCheck == newCheck, "%s: %" PRId64 " vs %" PRId64, desc, libcCheck, newCheck);
+    free(times);
+}
+
+static void benchColumns(const char *desc, getTimeStringFn_t *getTimeStr, char *times, int64_t *pCheck)
+{
+    int64_t check = 0;
+    double start = test_utils_nowSecs();
+
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        for (uint32_t i = 0; i + 1 < BENCH_NUM_TIMES; i++)
+        {
+            char timeStr[16];
+            int8_t day;
+            time_t timeStamp;
+
+            getTimeStr(timeStr, times + i * 17, times + (i + 1) * 17, &day, &timeStamp);
+            check += day;
+        }
+    }
+    double secs = test_utils_nowSecs() - start;
+
+    printf("%-70s %8.1f ns per event\n", desc, secs * 1e9 / ((double)BENCH_NUM_TIMES * BENCH_REPEATS));
+    *pCheck = check;
+}
+
+//Events in the 6 weeks around the days shown put in columns - with 3 days and a month shown
+static void compareColumns(time_t calendarStart)
+{
+    char *times = buildTimes(calendarStart - (time_t)7 * 86400, (time_t)42 * 86400, true, 17);
+    uint32_t numDaysShown[] = { 3, 31 };
+
+    //Z times were local to the old code - in UTC they're the same
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    for (uint32_t n = 0; n < sizeof(numDaysShown)/sizeof(numDaysShown[0]); n++)
+    {
+        char libcDesc[80];
+        char newDesc[80];
+        int64_t libcCheck = 0;
+        int64_t newCheck = 0;
+
+        setCalendarRange(calendarStart, numDaysShown[n]);
+        LibcFirstDayYYYYMMDD = getCalendarFirstDayYYYYMMDD();
+
+        struct tm lastTm;
+        localtime_r(&calendarStart, &lastTm);
+        lastTm.tm_mday += numDaysShown[n];
+        lastTm.tm_isdst = -1;
+        mktime(&lastTm);
+        LibcLastDayYYYYMMDD = (lastTm.tm_year + 1900) * 10000 + (lastTm.tm_mon + 1) * 100 + lastTm.tm_mday;
+
+        snprintf(libcDesc, sizeof(libcDesc), "Put events in columns (%" PRIu32 " days): comparing dates", numDaysShown[n]);
+        snprintf(newDesc, sizeof(newDesc), "Put events in columns (%" PRIu32 " days): day start table", numDaysShown[n]);
+
+        benchColumns(libcDesc, libcGetTimeString, times, &libcCheck);
+        benchColumns(newDesc, getTimeString, times, &newCheck);
+        TEST_ASSERT(libcCheck == newCheck, "%" PRIu32 " days: %" PRId64 " vs %" PRId64, numDaysShown[n], libcCheck, newCheck);
+    }
+    free(times);
+}
+
+typedef struct {
+    const char *desc;
+    const char *recurRule;
+    int recurTmField;
+    int interval;
+} benchRecurrence_t;
+
+//All day events that started 10 years before the first day shown (with 3 days shown)
+static void compareRecurrences(time_t calendarStart)
+{
+    benchRecurrence_t recurs[] = {
+        {"Daily",            "FREQ=DAILY",            offsetof(struct tm, tm_mday), 1},
+        {"Weekly",           "FREQ=WEEKLY",           offsetof(struct tm, tm_mday), 7},
+        {"Alternate weeks",  "FREQ=WEEKLY;INTERVAL=2", offsetof(struct tm, tm_mday), 14},
+        {"Monthly",          "FREQ=MONTHLY",          offsetof(struct tm, tm_mon),  1},
+        {"Yearly",           "FREQ=YEARLY",           offsetof(struct tm, tm_year), 1},
+    };
+
+    setCalendarRange(calendarStart, 3);
+
+    struct tm lastTm;
+    localtime_r(&calendarStart, &lastTm);
+    lastTm.tm_mday += 3;
+    lastTm.tm_isdst = -1;
+    mktime(&lastTm);
+    LibcLastDayYYYYMMDD = (lastTm.tm_year + 1900) * 10000 + (lastTm.tm_mon + 1) * 100 + lastTm.tm_mday;
+
+    for (uint32_t r = 0; r < sizeof(recurs)/sizeof(recurs[0]); r++)
+    {
+        char dateStart[] = "20131026";
+        char dateEnd[]   = "20131027";
+        char recurRule[64];
+        uint32_t libcDays = 0;
+        uint32_t newDays = 0;
+
+        strcpy(recurRule, recurs[r].recurRule);
+
+        double start = test_utils_nowSecs();
+        for (uint32_t i = 0; i < BENCH_RECUR_REPEATS; i++)
+        {
+            libcDays += libcParseRecurringAllDayEvent(dateStart, dateEnd, recurs[r].recurTmField, recurs[r].interval);
+            resetEntries();
+        }
+        double libcSecs = test_utils_nowSecs() - start;
+
+        start = test_utils_nowSecs();
+        for (uint32_t i = 0; i < BENCH_RECUR_REPEATS; i++)
+        {
+            newDays += parseAllDayEvent(entries, &entriesNum, MAX_ENTRIES, dateStart, dateEnd, recurRule, NULL);
+            resetEntries();
+        }
+        double newSecs = test_utils_nowSecs() - start;
+
+        printf("%-16s event since 2013: stepping from DTSTART %10.1f ns, skipping ahead %8.1f ns per event\n",
+               recurs[r].desc, libcSecs * 1e9 / BENCH_RECUR_REPEATS, newSecs * 1e9 / BENCH_RECUR_REPEATS);
+        TEST_ASSERT(libcDays == newDays, "%s: %" PRIu32 " vs %" PRIu32, recurs[r].desc, libcDays, newDays);
+    }
+}
+
+int main(void)
+{
+    setenv("TZ", "GMT0BST,M3.5.0/1,M10.5.0", 1);
+    tzset();
+
+    time_t calendarStart = convertYYYYMMDDtoEpochTime("20231027");
+    setCalendarRange(calendarStart, 3);
+
+    time_t weekBefore = calendarStart - (time_t)7 * 86400;
+    time_t fiveYearsBefore = calendarStart - (time_t)5 * 365 * 86400;
+
+    compare("Local times in the fortnight around days shown", weekBefore, (time_t)14 * 86400, false, 17,
+                  libcTimeToEpoch, convertYYYYMMDDTHHMMSSZtoEpochTime);
+    compare("Dates in the fortnight around days shown", weekBefore, (time_t)14 * 86400, false, 9,
+                  libcDayToEpoch, convertYYYYMMDDtoEpochTime);
+    compare("UTC times over 10 years", fiveYearsBefore, (time_t)10 * 365 * 86400, true, 17,
+                  libcTimeToEpoch, convertYYYYMMDDTHHMMSSZtoEpochTime);
+    compare("Local times over 10 years", fiveYearsBefore, (time_t)10 * 365 * 86400, false, 17,
+                  libcTimeToEpoch, convertYYYYMMDDTHHMMSSZtoEpochTime);
+
+    compareRecurrences(calendarStart);
+    compareColumns(calendarStart);
+    return 0;
+}
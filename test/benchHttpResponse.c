@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "utils/test_utils.h"
+#include "utils/test_utils_bench.h"
+#include "utils/test_utils_replay.h"
+#include "HttpResponse.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//The whole receive + decode + parse path getData runs once it has sent the request, over
+//a multi-MB response read from a file and replayed over a loopback socket.
+//
+//By default the response is a generated gzipped, chunked calendar. To replay a real one
+//captured with openssl s_client (see README.md):
+//    bin/benchHttpResponse /tmp/openssl.caldata [pieceBytes [pieceDelayMicros]]
+
+#define BENCH_NUM_RELEVANT      50
+#define BENCH_NUM_OTHER      40000
+#define BENCH_WINDOW_BYTES  100000  //As Network::getData on the InkPlate
+#define BENCH_PIECE_BYTES     1460  //Default: the server sends a TCP segment at a time...
+#define BENCH_PIECE_DELAY_US     0  //...as fast as it can
+#define BENCH_MAX_RECV        5744  //lwIP default TCP window on the ESP32
+#define BENCH_REPEATS            3
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+
+//A gzipped, chunked response like Google sends when asked for gzip
+//The returned buffer needs to be freed after use
+static char *buildResponse(size_t *pResponseLen, size_t *pCalLen)
+{
+    char *cal = test_utils_buildCalendar(BENCH_NUM_RELEVANT, BENCH_NUM_OTHER, pCalLen);
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(cal, *pCalLen, &gzippedLen);
+    size_t bodyLen = 0;
+    char *body = test_utils_chunk(gzipped, gzippedLen, 8192, &bodyLen);
+
+    char *response = test_utils_buildResponse("Content-Type: text/calendar; charset=UTF-8\r\n"
+                                              "Content-Encoding: gzip\r\n"
+                                              "Transfer-Encoding: chunked\r\n",
+                                              body, bodyLen, pResponseLen);
+    free(body);
+    free(gzipped);
+    free(cal);
+    return response;
+}
+
+//Reads the headers and body from pSource and parses the calendar
+static void receiveCalendar(ByteSource_t *pSource, bool threaded, char *window, HttpBodyStats_t *pStats)
+{
+    Calendar_t benchCal = {};
+    CalendarParsingContext_t calParsingContext = { &benchCal };
+    HttpResponseInfo_t info;
+    HttpBodyConfig_t config = {};
+
+    config.parser             = parsePartialDataForEvents;
+    config.parsingContext     = &calParsingContext;
+    config.window             = window;
+    config.windowSize         = BENCH_WINDOW_BYTES;
+    config.threaded           = threaded;
+    config.firstByteTimeoutMs = 10000;
+    config.stallTimeoutMs     = 10000;
+    config.url                = "bench";
+
+    TEST_ASSERT_EQUAL(httpResponse_readHeaders(pSource, 10000, &info), INKY_HTTPRESP_RC_OK);
+    TEST_ASSERT_EQUAL(httpResponse_receiveBody(pSource, &info, &config, pStats), INKY_HTTPRESP_RC_OK);
+    finishCalendarParsing(&calParsingContext);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t responseLen = 0;
+    size_t calLen = 0;
+    char *response = NULL;
+    size_t pieceBytes = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : BENCH_PIECE_BYTES;
+    uint32_t pieceDelayMicros = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 10) : BENCH_PIECE_DELAY_US;
+
+    if (argc > 1)
+    {
+        response = test_utils_fileToBuffer(argv[1], &responseLen);
+        TEST_ASSERT_PTR_NOT_NULL(response);
+        setCalendarRange(time(NULL), 3);
+    }
+    else
+    {
+        response = buildResponse(&responseLen, &calLen);
+        setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+    }
+
+    //The file backend reads the response from a file (as captured)
+    char responsePath[] = "/tmp/benchHttpResponseXXXXXX";
+    int fd = mkstemp(responsePath);
+    TEST_ASSERT(fd >= 0, "mkstemp failed%s", "");
+    TEST_ASSERT_EQUAL((size_t)write(fd, response, responseLen), responseLen);
+    close(fd);
+
+    char *window = (char *)malloc(BENCH_WINDOW_BYTES);
+    HttpBodyStats_t stats;
+    char desc[100];
+    uint64_t decodedLen = 0;
+
+    for (uint32_t backend = 0; backend < 2; backend++)
+    {
+        for (uint32_t threaded = 0; threaded < 2; threaded++)
+        {
+            double secs = 0;
+
+            for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+            {
+                ByteSource_t source;
+                double start = test_utils_nowSecs();
+
+                if (backend == 0)
+                {
+                    ByteSourceFile_t file;
+                    TEST_ASSERT(byteSourceFile_open(&file, responsePath, &source), "open failed%s", "");
+                    receiveCalendar(&source, threaded, window, &stats);
+                    byteSourceFile_close(&file);
+                }
+                else
+                {
+                    test_utils_replayServer_t server = { response, responseLen, pieceBytes, pieceDelayMicros };
+                    test_utils_socketSource_t socket = { 0, BENCH_MAX_RECV };
+
+                    test_utils_replayServer_start(&server);
+                    test_utils_replayServer_request(&server, &socket, &source);
+                    receiveCalendar(&source, threaded, window, &stats);
+                    test_utils_replayServer_stop(&server);
+                    test_utils_socketSource_close(&socket);
+                }
+                secs += test_utils_nowSecs() - start;
+                decodedLen = stats.totalDecoded;
+
+                if (calLen > 0)
+                {
+                    TEST_ASSERT(stats.totalDecoded == calLen, "decoded %" PRIu64, stats.totalDecoded);
+                    TEST_ASSERT_EQUAL(getRelevantEventCount(), BENCH_NUM_RELEVANT);
+                }
+                resetEntries();
+                resetEventStats();
+            }
+            snprintf(desc, sizeof(desc), "%s, %s", (backend == 0) ? "File" : "Replayed over loopback",
+                                                   threaded ? "pipelined" : "taking turns");
+            test_utils_reportThroughput(desc, decodedLen * BENCH_REPEATS, secs);
+        }
+    }
+
+    printf("Response: %zu bytes, decoded: %" PRIu64 " bytes. Replayed %zu bytes at a time, %" PRIu32 " us apart\n",
+              responseLen, decodedLen, pieceBytes, pieceDelayMicros);
+    printf("CPUs online: %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+
+    unlink(responsePath);
+    free(window);
+    free(response);
+    return 0;
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "utils/test_utils.h"
+#include "utils/test_utils_bench.h"
+#include "LineScanner.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//Compares unfolding every line of a multi-MB calendar a byte at a time (as getUnfoldedLine
+//used to) with copying the runs between the line endings and escapes found by LineScanner
+//(unfoldValue - as the parser does for the fields it copies out), the SSE2 and word at a time
+//(SWAR, as on the InkPlate) scanners with a byte at a time loop, and reports how fast the
+//whole calendar is parsed - in one go and as it would be arriving in small pieces (the events cut
+//off at the end of each piece are carried on with, not gone through again)
+
+#define BENCH_NUM_EVENTS   20000
+#define BENCH_LINEBUF_MAX    500  //As INKYC_LINEBUF_MAX in Calendar.cpp
+#define BENCH_REPEATS          5
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+size_t unfoldValue(const char *value, size_t valueLen, char *dest, size_t destSize);
+
+#define BENCH_LINERC_TOO_LONG       1
+#define BENCH_LINERC_INCOMPLETE_SRC 2
+
+typedef const char *scanFn_t(const char *src);
+
+//getUnfoldedLine as it was (less the logging) - for comparison only
+static int32_t byteAtATimeUnfold(char **ppSrc, char *dest, size_t maxBytes)
+{
+    char *src = *ppSrc;
+    char *destcurpos = dest;
+    char *destendline = NULL;
+    char *srcendline  = NULL;
+    size_t maxNonNullBytes = maxBytes - 1;
+    int32_t linerc = 0;
+    bool gotCompleteLine = false;
+
+    while (*src != '\0' && linerc == 0 && !gotCompleteLine)
+    {
+        if ((size_t)(destcurpos - dest) >= maxNonNullBytes)
+        {
+            linerc = BENCH_LINERC_TOO_LONG;
+            break;
+        }
+        switch(src[0])
+        {
+            case '\\':
+                if (src[1] == 'n')
+                {
+                    *destcurpos++ = '\n';
+                    src += 2;
+                }
+                else if (src[1] == '\\' || src[1] == ';' || src[1] == ',')
+                {
+                    *destcurpos++ = src[1];
+                    src += 2;
+                }
+                else
+                {
+                    *destcurpos++ = *src++;
+                }
+                break;
+
+            case '\r':
+                src++;
+                break;
+
+            case '\n':
+                destendline = destcurpos;
+                srcendline = &(src[1]);
+
+                if (src[1] == '\0')
+                {
+                    linerc = BENCH_LINERC_INCOMPLETE_SRC;
+                }
+                else if (src[1] == ' ' || src[1] == '\t')
+                {
+                    src += 2;
+                }
+                else
+                {
+                    gotCompleteLine = true;
+                    *destcurpos = '\0';
+                    *ppSrc = &(src[1]);
+                }
+                break;
+
+            default:
+                *destcurpos++ = *src++;
+                break;
+        }
+    }
+
+    if (!gotCompleteLine)
+    {
+        if (linerc == BENCH_LINERC_TOO_LONG && destendline != NULL)
+        {
+            *destendline = '\0';
+            *ppSrc = srcendline;
+        }
+        else if (linerc == BENCH_LINERC_TOO_LONG)
+        {
+            while (*src != '\0' && *src != '\n')
+            {
+                src++;
+            }
+            *ppSrc = (*src == '\n') ? &(src[1]) : src;
+            *destcurpos = '\0';
+        }
+        else
+        {
+            *dest = '\0';
+            linerc = BENCH_LINERC_INCOMPLETE_SRC;
+        }
+    }
+    return linerc;
+}
+
+static const char *byteAtATimeFindSpecial(const char *src)
+{
+    while (*src != '\0' && *src != '\n' && *src != '\r' && *src != '\\')
+    {
+        src++;
+    }
+    return src;
+}
+
+//A calendar like Google's: long descriptions with escapes, folded at 75 octets
+static char *buildCalendar(size_t *pCalLen)
+{
+    const char *description = "DESCRIPTION:Join the meeting at https://meet.example.com/abc-defg-hij\\n\\n"
+                              "Or dial: (GB) +44 20 3873 9999 PIN: 123 456 789#\\nMore phone numbers: "
+                              "https://tel.meet/abc-defg-hij?pin=1234567890\\n\\nAgenda\\, in no particular "
+                              "order: budget\\; hiring\\; the office move\\; AOB";
+    size_t calSpace = (size_t)BENCH_NUM_EVENTS * 1024 + 1024;
+    char *cal = (char *)malloc(calSpace);
+    TEST_ASSERT_PTR_NOT_NULL(cal);
+
+    size_t calLen = sprintf(cal, "BEGIN:VCALENDAR\r\nVERSION:2.0\r\n");
+
+    for (uint32_t i = 0; i < BENCH_NUM_EVENTS; i++)
+    {
+        calLen += sprintf(cal + calLen, "BEGIN:VEVENT\r\n"
+                                        "DTSTART;TZID=Europe/London:20230724T093000\r\n"
+                                        "DTEND;TZID=Europe/London:20230724T100000\r\n"
+                                        "UID:event%" PRIu32 "@inkycal.test\r\n"
+                                        "SUMMARY:Weekly planning meeting %" PRIu32 "\r\n", i, i);
+
+        //Fold the description
+        size_t descLen = strlen(description);
+        for (size_t pos = 0; pos < descLen; pos += 74)
+        {
+            calLen += sprintf(cal + calLen, "%s%.74s\r\n", pos == 0 ? "" : " ", description + pos);
+        }
+        calLen += sprintf(cal + calLen, "LOCATION:Meeting room 2\r\nEND:VEVENT\r\n");
+    }
+    calLen += sprintf(cal + calLen, "END:VCALENDAR\r\n");
+
+    *pCalLen = calLen;
+    return cal;
+}
+
+static void benchByteAtATimeUnfold(char *cal, size_t calLen, uint64_t *pLines)
+{
+    char linebuf[BENCH_LINEBUF_MAX];
+    uint64_t lines = 0;
+    double start = test_utils_nowSecs();
+
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        char *pos = cal;
+
+        while (byteAtATimeUnfold(&pos, linebuf, sizeof(linebuf)) != BENCH_LINERC_INCOMPLETE_SRC)
+        {
+            lines++;
+        }
+    }
+    test_utils_reportThroughput("Unfold lines: byte at a time", (uint64_t)calLen * BENCH_REPEATS, test_utils_nowSecs() - start);
+    *pLines = lines;
+}
+
+//The parser finds where each (folded) line ends as it goes, so here the line starts are found
+//before timing - it's just the unfolding that's measured
+static void benchUnfoldValue(char *cal, size_t calLen, uint64_t *pLines)
+{
+    char linebuf[BENCH_LINEBUF_MAX];
+    char *pos = cal;
+    size_t maxLines = calLen / 8;
+    char **lineStarts = (char **)malloc(maxLines * sizeof(char *));
+    size_t numLines = 0;
+
+    TEST_ASSERT_PTR_NOT_NULL(lineStarts);
+    lineStarts[numLines] = pos;
+
+    while (numLines + 1 < maxLines && byteAtATimeUnfold(&pos, linebuf, sizeof(linebuf)) != BENCH_LINERC_INCOMPLETE_SRC)
+    {
+        lineStarts[++numLines] = pos;
+    }
+
+    uint64_t lines = 0;
+    double start = test_utils_nowSecs();
+
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        for (size_t l = 0; l < numLines; l++)
+        {
+            unfoldValue(lineStarts[l], lineStarts[l + 1] - lineStarts[l], linebuf, sizeof(linebuf));
+            lines++;
+        }
+    }
+    test_utils_reportThroughput("Unfold lines: unfoldValue (LineScanner)", (uint64_t)calLen * BENCH_REPEATS, test_utils_nowSecs() - start);
+    *pLines = lines;
+    free(lineStarts);
+}
+
+static void benchScan(const char *desc, scanFn_t *scan, const char *cal, size_t calLen, uint64_t *pFound)
+{
+    uint64_t found = 0;
+    double start = test_utils_nowSecs();
+
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        const char *pos = scan(cal);
+
+        while (*pos != '\0')
+        {
+            found++;
+            pos = scan(pos + 1);
+        }
+    }
+    test_utils_reportThroughput(desc, (uint64_t)calLen * BENCH_REPEATS, test_utils_nowSecs() - start);
+    *pFound = found;
+}
+
+//Parses the calendar as the receive window would with pieceSize bytes arriving at a time (the unparsed
+//data is moved to the start of the window before each piece is added)
+static void benchParseInPieces(const char *cal, size_t calLen, size_t pieceSize, CalendarParsingContext_t *pContext)
+{
+    char *window = (char *)malloc(calLen + 1);
+    TEST_ASSERT_PTR_NOT_NULL(window);
+
+    resetEventStats();
+    double start = test_utils_nowSecs();
+
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        size_t unparsedLen = 0;
+
+        for (size_t pos = 0; pos < calLen; pos += pieceSize)
+        {
+            size_t len = (calLen - pos < pieceSize) ? calLen - pos : pieceSize;
+
+            memcpy(window + unparsedLen, cal + pos, len);
+            window[unparsedLen + len] = '\0';
+
+            char *unparsed = parsePartialDataForEvents(window, pContext);
+            unparsedLen = window + unparsedLen + len - unparsed;
+            memmove(window, unparsed, unparsedLen);
+        }
+        finishCalendarParsing(pContext);
+    }
+    char desc[64];
+    snprintf(desc, sizeof(desc), "Parse calendar arriving %zu bytes at a time", pieceSize);
+    test_utils_reportThroughput(desc, (uint64_t)calLen * BENCH_REPEATS, test_utils_nowSecs() - start);
+    TEST_ASSERT(getTotalEventCount() == (uint64_t)BENCH_NUM_EVENTS * BENCH_REPEATS, "parsed %" PRIu64 " events", getTotalEventCount());
+
+    free(window);
+}
+
+int main(void)
+{
+    size_t calLen = 0;
+    char *cal = buildCalendar(&calLen);
+
+    printf("Calendar of %d events, %zu bytes\n", BENCH_NUM_EVENTS, calLen);
+
+    uint64_t oldLines = 0;
+    uint64_t newLines = 0;
+    benchByteAtATimeUnfold(cal, calLen, &oldLines);
+    benchUnfoldValue(cal, calLen, &newLines);
+    TEST_ASSERT(oldLines == newLines, "unfolded %" PRIu64 " lines vs %" PRIu64, oldLines, newLines);
+
+    uint64_t byteFound = 0;
+    uint64_t swarFound = 0;
+    uint64_t bestFound = 0;
+    benchScan("Find line ends/escapes: byte at a time", byteAtATimeFindSpecial, cal, calLen, &byteFound);
+    benchScan("Find line ends/escapes: SWAR (32 bit words)", lineScanner_findSpecialSwar, cal, calLen, &swarFound);
+    benchScan("Find line ends/escapes: lineScanner_findSpecial", lineScanner_findSpecial, cal, calLen, &bestFound);
+    TEST_ASSERT(byteFound == swarFound && byteFound == bestFound, "found %" PRIu64 " %" PRIu64 " %" PRIu64,
+                      byteFound, swarFound, bestFound);
+
+    //The whole parse (events are outside the range, so it's mostly finding fields)
+    Calendar_t benchCal = {};
+    CalendarParsingContext_t context = { &benchCal };
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    double start = test_utils_nowSecs();
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        parsePartialDataForEvents(cal, &context);
+        finishCalendarParsing(&context);
+    }
+    test_utils_reportThroughput("Parse whole calendar", (uint64_t)calLen * BENCH_REPEATS, test_utils_nowSecs() - start);
+    TEST_ASSERT(getTotalEventCount() == (uint64_t)BENCH_NUM_EVENTS * BENCH_REPEATS, "parsed %" PRIu64 " events", getTotalEventCount());
+
+    benchParseInPieces(cal, calLen, 1460, &context);
+    benchParseInPieces(cal, calLen, 64, &context);
+
+    free(cal);
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "utils/test_utils.h"
+#include "utils/test_utils_bench.h"
+#include "ReceivePipeline.h"
+#include "BodyDecoder.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//Compares receiving/decoding and parsing a multi-MB gzipped, chunked calendar taking turns
+//on one thread (as getData used to) with the pipelined mode that decodes on one thread whilst
+//parsing on another. Run both with data available immediately (so decoding is the only
+//work the producer does) and with data arriving over a simulated network link
+
+#define BENCH_NUM_RELEVANT      50
+#define BENCH_NUM_OTHER      40000
+#define BENCH_WINDOW_BYTES  100000  //\__ As Network::getData on the InkPlate
+#define BENCH_MIN_PARSE      50000  ///
+#define BENCH_BLOCK_BYTES     8192
+#define BENCH_NUM_BLOCKS         4
+#define BENCH_SEGMENT_BYTES   1460  //Data "arrives" a TCP segment at a time
+#define BENCH_TCP_WINDOW      5744  //lwIP default on the ESP32: the server stops sending when we've this much unread
+#define BENCH_REPEATS            5
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+
+typedef struct {
+    const char *body;        //gzipped + chunked
+    size_t bodyLen;
+    size_t pos;
+    double linkBytesPerSec;  //0 = all the data has already arrived
+    double arrived;          //Bytes that have arrived (read or not)
+    double lastArrivalTime;
+} benchSource_t;
+
+//bodyReadFn_t over the body in memory - if we're simulating a link only returns what
+//would have arrived by now. Like TCP, nothing more arrives once there is a window's worth unread
+static size_t readBenchSource(char *buf, size_t maxLen, void *readContext)
+{
+    benchSource_t *pSource = (benchSource_t *)readContext;
+    size_t available = pSource->bodyLen - pSource->pos;
+
+    if (pSource->linkBytesPerSec > 0)
+    {
+        double now = test_utils_nowSecs();
+        double windowEnd = (double)(pSource->pos + BENCH_TCP_WINDOW);
+
+        pSource->arrived += (now - pSource->lastArrivalTime) * pSource->linkBytesPerSec;
+        pSource->lastArrivalTime = now;
+
+        if (pSource->arrived > windowEnd)
+        {
+            pSource->arrived = windowEnd;
+        }
+        if (pSource->arrived < (double)pSource->bodyLen)
+        {
+            available = (size_t)pSource->arrived - pSource->pos;
+        }
+    }
+
+    if (available > maxLen)
+    {
+        available = maxLen;
+    }
+    if (available > BENCH_SEGMENT_BYTES)
+    {
+        available = BENCH_SEGMENT_BYTES;
+    }
+    memcpy(buf, pSource->body + pSource->pos, available);
+    pSource->pos += available;
+    return available;
+}
+
+typedef struct {
+    benchSource_t *pSource;
+    BodyDecoder_t *pBodyDecoder;
+} benchProducer_t;
+
+//pipelineProducerFn_t like getData's: fills the block as data arrives
+static int32_t fillBlockFromSource(char *block, size_t blockSize, size_t *pLen, void *producerContext)
+{
+    benchProducer_t *pProducer = (benchProducer_t *)producerContext;
+    int32_t rc = INKY_PIPELINE_RC_OK;
+    size_t len = 0;
+
+    while (len < blockSize && rc == INKY_PIPELINE_RC_OK)
+    {
+        size_t decodedLen = 0;
+        int32_t bodyrc = bodyDecoder_decode(pProducer->pBodyDecoder, readBenchSource, pProducer->pSource,
+                                            block + len, blockSize - len, &decodedLen);
+        len += decodedLen;
+
+        if (bodyrc == INKY_BODYDEC_RC_COMPLETE)
+        {
+            rc = INKY_PIPELINE_RC_COMPLETE;
+        }
+        else if (bodyrc != INKY_BODYDEC_RC_OK)
+        {
+            rc = bodyrc;
+        }
+        else if (decodedLen == 0)
+        {
+            usleep(100);
+        }
+    }
+    *pLen = len;
+    return rc;
+}
+
+//Chunked (in 8KB chunks) and optionally gzipped first
+//The returned buffer needs to be freed after use
+static char *encodeBody(const char *data, size_t dataLen, bool gzip, size_t *pBodyLen)
+{
+    if (!gzip)
+    {
+        return test_utils_chunk(data, dataLen, 8192, pBodyLen);
+    }
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(data, dataLen, &gzippedLen);
+    char *body = test_utils_chunk(gzipped, gzippedLen, 8192, pBodyLen);
+    free(gzipped);
+    return body;
+}
+
+//returns seconds taken
+static double runPipeline(const char *body, size_t bodyLen, bool gzipped, size_t calLen, char *window,
+                          bool threaded, double linkBytesPerSec, ReceivePipelineStats_t *pStats)
+{
+    double secs = 0;
+
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        Calendar_t benchCal = {};
+        CalendarParsingContext_t calParsingContext = { &benchCal };
+        benchSource_t source = { body, bodyLen, 0, linkBytesPerSec, 0, 0 };
+        BodyDecoder_t bodyDecoder;
+        benchProducer_t producer = { &source, &bodyDecoder };
+        ReceivePipelineConfig_t config = {};
+
+        TEST_ASSERT_EQUAL(bodyDecoder_init(&bodyDecoder, true, gzipped, INKY_BODYDEC_LENGTH_UNKNOWN), INKY_BODYDEC_RC_OK);
+
+        config.producer        = fillBlockFromSource;
+        config.producerContext = &producer;
+        config.parser          = parsePartialDataForEvents;
+        config.parsingContext  = &calParsingContext;
+        config.window          = window;
+        config.windowSize      = BENCH_WINDOW_BYTES;
+        config.blockSize       = BENCH_BLOCK_BYTES;
+        config.numBlocks       = BENCH_NUM_BLOCKS;
+        config.minParseBytes   = BENCH_MIN_PARSE;
+        config.threaded        = threaded;
+
+        double start = test_utils_nowSecs();
+        source.lastArrivalTime = start;
+        int32_t rc = receivePipeline_run(&config, pStats);
+        secs += test_utils_nowSecs() - start;
+
+        TEST_ASSERT_EQUAL(rc, INKY_PIPELINE_RC_OK);
+        TEST_ASSERT(bodyDecoder.totalDecoded == calLen, "decoded %" PRIu64, bodyDecoder.totalDecoded);
+        TEST_ASSERT_EQUAL(getRelevantEventCount(), BENCH_NUM_RELEVANT);
+
+        bodyDecoder_free(&bodyDecoder);
+        finishCalendarParsing(&calParsingContext);
+        resetEntries();
+        resetEventStats();
+    }
+    return secs;
+}
+
+int main(void)
+{
+    size_t calLen = 0;
+    char *cal = test_utils_buildCalendar(BENCH_NUM_RELEVANT, BENCH_NUM_OTHER, &calLen);
+    size_t plainLen = 0;
+    char *plain = encodeBody(cal, calLen, false, &plainLen);
+    size_t gzippedLen = 0;
+    char *gzipped = encodeBody(cal, calLen, true, &gzippedLen);
+    char *window = (char *)malloc(BENCH_WINDOW_BYTES);
+    ReceivePipelineStats_t stats;
+    char desc[100];
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    //Time the parser on its own so we can simulate a link about as fast as parsing
+    //(the worst case for taking turns)
+    double start = test_utils_nowSecs();
+    for (uint32_t r = 0; r < BENCH_REPEATS; r++)
+    {
+        Calendar_t benchCal = {};
+        CalendarParsingContext_t calParsingContext = { &benchCal };
+        char *calCopy = strdup(cal);
+        parsePartialDataForEvents(calCopy, &calParsingContext);
+        finishCalendarParsing(&calParsingContext);
+        free(calCopy);
+        resetEntries();
+        resetEventStats();
+    }
+    double parseSecs = test_utils_nowSecs() - start;
+
+    struct {
+        const char *desc;
+        const char *body;
+        size_t bodyLen;
+        bool gzipped;
+        double linkBytesPerSec;
+    } scenarios[] = {
+        { "gzipped, data already arrived",     gzipped, gzippedLen, true,  0 },
+        { "not compressed, link as fast as parsing", plain, plainLen, false, (double)plainLen * BENCH_REPEATS / parseSecs },
+        { "gzipped, link as fast as parsing",  gzipped, gzippedLen, true,  (double)gzippedLen * BENCH_REPEATS / parseSecs },
+    };
+    const uint32_t numScenarios = sizeof(scenarios)/sizeof(scenarios[0]);
+    double results[numScenarios][2];
+
+    for (uint32_t s = 0; s < numScenarios; s++)
+    {
+        for (uint32_t threaded = 0; threaded < 2; threaded++)
+        {
+            double secs = runPipeline(scenarios[s].body, scenarios[s].bodyLen, scenarios[s].gzipped, calLen, window,
+                                      threaded, scenarios[s].linkBytesPerSec, &stats);
+            results[s][threaded] = secs;
+            snprintf(desc, sizeof(desc), "%s, %s", threaded ? "Pipelined" : "Taking turns", scenarios[s].desc);
+            test_utils_reportThroughput(desc, (uint64_t)calLen * BENCH_REPEATS, secs);
+            printf("    (receiving waited for parser %" PRIu64 " ms, parser waited for data %" PRIu64 " ms in last run)\n",
+                         stats.producerWaitMicros / 1000, stats.parserWaitMicros / 1000);
+        }
+    }
+
+    test_utils_reportThroughput("Parsing alone", (uint64_t)calLen * BENCH_REPEATS, parseSecs);
+    printf("Calendar: %zu bytes, %zu bytes chunked, %zu bytes gzipped+chunked\n", calLen, plainLen, gzippedLen);
+    //With only one cpu the threads can't run at the same time: pipelining can then only
+    //hide the time spent waiting for data
+    printf("CPUs online: %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+    for (uint32_t s = 0; s < numScenarios; s++)
+    {
+        printf("Pipelined speedup, %s: %.2fx\n", scenarios[s].desc, results[s][0] / results[s][1]);
+    }
+
+    free(window);
+    free(gzipped);
+    free(plain);
+    free(cal);
+    return 0;
+}
@@ -14,7 +14,13 @@ endef
 define buildrecipe-basic-unittest
 	$(call eyecatcher, Build Unit Test:${notdir $@})
 	$(call ensure-output-dir, $@)
-	$(CC) -g -ggdb -O0 -o $@ $(IFLAGS) $^
+	$(CC) -g -ggdb -O0 -o $@ $(IFLAGS) $^ $(LDLIBS)
+endef
+
+define buildrecipe-basic-benchmark
+	$(call eyecatcher, Build Benchmark:${notdir $@})
+	$(call ensure-output-dir, $@)
+	$(CC) -g -O2 -o $@ $(IFLAGS) $^ $(LDLIBS)
 endef
 
 define  exec-basic-unittest
@@ -25,14 +31,37 @@ endef
 #Function: Build a unit test and add it to the list of tests to run
 #Parameter 1: Name of test executable
 #Parameter 2: (space separated) source files
+#Parameter 3: (optional) libraries to link with e.g. -lz
 define build-basic-unittest
 TEST-TARGETS += $(BINDIR)/$(strip $(1))
 
+$(BINDIR)/$(strip $(1)): LDLIBS = $3
+
 $(BINDIR)/$(strip $(1)): $2
 	$$(call buildrecipe-basic-unittest)
 
 EXEC-TEST-TARGETS += exec_$(strip $(1))
 
+exec_$(strip $(1)): $(BINDIR)/$(strip $(1))
+	$$(call exec-basic-unittest, $$<)
+
+.PHONY:: exec_$(strip $(1))
+endef
+
+#Function: Build a benchmark (optimised) and add it to the list of benchmarks to run
+#Parameter 1: Name of benchmark executable
+#Parameter 2: (space separated) source files
+#Parameter 3: (optional) libraries to link with e.g. -lz
+define build-basic-benchmark
+BENCH-TARGETS += $(BINDIR)/$(strip $(1))
+
+$(BINDIR)/$(strip $(1)): LDLIBS = $3
+
+$(BINDIR)/$(strip $(1)): $2
+	$$(call buildrecipe-basic-benchmark)
+
+EXEC-BENCH-TARGETS += exec_$(strip $(1))
+
 exec_$(strip $(1)): $(BINDIR)/$(strip $(1))
 	$$(call exec-basic-unittest, $$<)
 
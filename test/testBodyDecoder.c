@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "utils/test_utils.h"
+#include "BodyDecoder.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+
+//Inflates gzipped split into fragments at the given offset, with output space of outSpace
+//at a time, checks the result matches data
+static void checkInflateFragments(const char *data, size_t dataLen,
+                                  const char *gzipped, size_t gzippedLen,
+                                  size_t split, size_t outSpace)
+{
+    GzipDecoder_t decoder;
+    int32_t rc = gzipDecoder_init(&decoder);
+    TEST_ASSERT_EQUAL(rc, INKY_GZIP_RC_OK);
+
+    char *inflated = (char *)malloc(dataLen + outSpace);
+    size_t inflatedLen = 0;
+    size_t fragStart = 0;
+
+    for (uint32_t frag = 0; frag < 2; frag++)
+    {
+        size_t fragEnd = (frag == 0) ? split : gzippedLen;
+
+        //Keep calling whilst we consume input or produce output
+        while (1)
+        {
+            size_t inUsed = 0;
+            size_t outLen = 0;
+
+            rc = gzipDecoder_inflate(&decoder, gzipped + fragStart, fragEnd - fragStart, &inUsed,
+                                     inflated + inflatedLen, outSpace, &outLen);
+            TEST_ASSERT_NOT_EQUAL(rc, INKY_GZIP_RC_BADDATA);
+            fragStart += inUsed;
+            inflatedLen += outLen;
+
+            if (inUsed == 0 && outLen == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL(rc, INKY_GZIP_RC_COMPLETE);
+    TEST_ASSERT(inflatedLen == dataLen, "inflated %zu bytes, expected %zu", inflatedLen, dataLen);
+    TEST_ASSERT(memcmp(inflated, data, dataLen) == 0, "inflated data differs (%zu bytes)", dataLen);
+
+    gzipDecoder_free(&decoder);
+    free(inflated);
+}
+
+int testGzipSplitAtEveryOffset(void)
+{
+    char *data = test_utils_fileToString("resources/calfrag_simple");
+    TEST_ASSERT_PTR_NOT_NULL(data);
+    size_t dataLen = strlen(data);
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(data, dataLen, &gzippedLen);
+
+    for (size_t split = 0; split <= gzippedLen; split++)
+    {
+        checkInflateFragments(data, dataLen, gzipped, gzippedLen, split, 4096);
+        checkInflateFragments(data, dataLen, gzipped, gzippedLen, split, 7);
+    }
+
+    free(gzipped);
+    free(data);
+    return 0;
+}
+
+int testGzipBadData(void)
+{
+    char *data = test_utils_fileToString("resources/calfrag_simple");
+    TEST_ASSERT_PTR_NOT_NULL(data);
+    size_t dataLen = strlen(data);
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(data, dataLen, &gzippedLen);
+    char *out = (char *)malloc(dataLen + 1);
+
+    //Not gzip, corrupt CRC or length in trailer (the data itself inflates cleanly)
+    const char *notGzip = "BEGIN:VCALENDAR\r\n";
+    char *badCrc = (char *)malloc(gzippedLen);
+    memcpy(badCrc, gzipped, gzippedLen);
+    badCrc[gzippedLen - INKY_GZIP_TRAILER_BYTES] ^= 0x01;
+    gzipped[gzippedLen - 1] ^= 0x01;
+
+    struct {
+        const char *in;
+        size_t inLen;
+        size_t expectedOut;  //Only the trailer is wrong: all the data is inflated before we find out
+    } badInputs[] = {
+        { notGzip, strlen(notGzip), 0 },
+        { badCrc, gzippedLen, dataLen },
+        { gzipped, gzippedLen, dataLen },
+    };
+
+    for (uint32_t i = 0; i < sizeof(badInputs)/sizeof(badInputs[0]); i++)
+    {
+        GzipDecoder_t decoder;
+        int32_t rc = gzipDecoder_init(&decoder);
+        TEST_ASSERT_EQUAL(rc, INKY_GZIP_RC_OK);
+
+        size_t inUsed = 0;
+        size_t outLen = 0;
+        rc = gzipDecoder_inflate(&decoder, badInputs[i].in, badInputs[i].inLen, &inUsed, out, dataLen + 1, &outLen);
+        TEST_ASSERT_EQUAL(rc, INKY_GZIP_RC_BADDATA);
+        TEST_ASSERT(outLen == badInputs[i].expectedOut, "input %" PRIu32 ": inflated %zu bytes", i, outLen);
+
+        //Once failed, stays failed
+        rc = gzipDecoder_inflate(&decoder, badInputs[i].in, badInputs[i].inLen, &inUsed, out, dataLen + 1, &outLen);
+        TEST_ASSERT_EQUAL(rc, INKY_GZIP_RC_BADDATA);
+        gzipDecoder_free(&decoder);
+    }
+
+    free(out);
+    free(badCrc);
+    free(gzipped);
+    free(data);
+    return 0;
+}
+
+//Data after the body we're decoding. The server won't send the next response until we've sent the
+//next request so this can only happen if the server ignores the Content-Length it sent...
+//but we mustn't read it. A chunked body has no length so its end can only be found by reading it
+#define NEXT_RESPONSE "HTTP/1.1 304 Not Modified\r\n\r\n"
+
+typedef struct {
+    const char *stream;
+    size_t streamLen;
+    size_t pos;
+    size_t maxPiece;
+} memoryReadContext_t;
+
+//bodyReadFn_t over a stream in memory, giving random sized pieces
+static size_t readMemory(char *buf, size_t maxLen, void *readContext)
+{
+    memoryReadContext_t *pReadContext = (memoryReadContext_t *)readContext;
+    size_t len = rand() % (pReadContext->maxPiece + 1);
+
+    if (len > maxLen)
+    {
+        len = maxLen;
+    }
+    if (len > pReadContext->streamLen - pReadContext->pos)
+    {
+        len = pReadContext->streamLen - pReadContext->pos;
+    }
+    memcpy(buf, pReadContext->stream + pReadContext->pos, len);
+    pReadContext->pos += len;
+    return len;
+}
+
+//Whether the end of the body is marked by the chunked encoding or Content-Length, the decoder
+//must read all of the body (even after the end of the gzip data) but nothing after it
+int testBodyFraming(void)
+{
+    char *data = test_utils_fileToString("resources/calfrag_simple");
+    TEST_ASSERT_PTR_NOT_NULL(data);
+    size_t dataLen = strlen(data);
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(data, dataLen, &gzippedLen);
+    size_t chunkSizes[] = {100, 7, 1000};
+    size_t chunkedLen = 0;
+    char *chunked = test_utils_chunkSizes(data, dataLen, chunkSizes, 3, &chunkedLen);
+    size_t chunkedGzippedLen = 0;
+    char *chunkedGzipped = test_utils_chunkSizes(gzipped, gzippedLen, chunkSizes, 3, &chunkedGzippedLen);
+
+    struct {
+        const char *body;
+        size_t bodyLen;
+        bool chunked;
+        bool gzipped;
+    } bodies[] = {
+        { data,           dataLen,           false, false },
+        { gzipped,        gzippedLen,        false, true  },
+        { chunked,        chunkedLen,        true,  false },
+        { chunkedGzipped, chunkedGzippedLen, true,  true  },
+    };
+
+    char *stream = (char *)malloc(chunkedLen + strlen(NEXT_RESPONSE) + 1);
+    char *out = (char *)malloc(dataLen + 1);
+    srand(4321);
+
+    for (uint32_t i = 0; i < sizeof(bodies)/sizeof(bodies[0]); i++)
+    {
+        size_t streamLen = bodies[i].bodyLen;
+        memcpy(stream, bodies[i].body, bodies[i].bodyLen);
+
+        if (!bodies[i].chunked)
+        {
+            strcpy(stream + streamLen, NEXT_RESPONSE);
+            streamLen += strlen(NEXT_RESPONSE);
+        }
+
+        for (uint32_t iteration = 0; iteration < 20; iteration++)
+        {
+            memoryReadContext_t readContext = { stream, streamLen, 0,
+                                                (size_t)((iteration % 2 == 0) ? 5 : 2000) };
+            BodyDecoder_t bodyDecoder;
+            TEST_ASSERT_EQUAL(bodyDecoder_init(&bodyDecoder, bodies[i].chunked, bodies[i].gzipped, (int64_t)bodies[i].bodyLen),
+                              INKY_BODYDEC_RC_OK);
+            size_t outLen = 0;
+            int32_t rc = INKY_BODYDEC_RC_OK;
+
+            while (rc == INKY_BODYDEC_RC_OK)
+            {
+                size_t decodedLen = 0;
+                size_t outSpace = (dataLen - outLen < 300) ? dataLen - outLen + 1 : 300;
+                rc = bodyDecoder_decode(&bodyDecoder, readMemory, &readContext, out + outLen, outSpace, &decodedLen);
+                outLen += decodedLen;
+            }
+
+            TEST_ASSERT(rc == INKY_BODYDEC_RC_COMPLETE, "body %" PRIu32 " rc %d", i, rc);
+            TEST_ASSERT(bodyDecoder.complete, "body %" PRIu32 " not marked complete", i);
+            TEST_ASSERT(readContext.pos == bodies[i].bodyLen, "body %" PRIu32 ": read %zu bytes of %zu byte body",
+                                   i, readContext.pos, bodies[i].bodyLen);
+            TEST_ASSERT(outLen == dataLen && memcmp(out, data, dataLen) == 0, "body %" PRIu32 ": decoded %zu bytes", i, outLen);
+            bodyDecoder_free(&bodyDecoder);
+        }
+    }
+
+    free(out);
+    free(stream);
+    free(chunkedGzipped);
+    free(chunked);
+    free(gzipped);
+    free(data);
+    return 0;
+}
+
+//Stand-in for the calendar server: answers one request on a loopback socket with
+//a gzipped, chunked calendar written in small pieces
+typedef struct {
+    int listenfd;
+    const char *body;       //Already gzipped and chunked
+    size_t bodyLen;
+    bool sawAcceptGzip;     //Request included Accept-Encoding: gzip
+} standInServer_t;
+
+static void *standInServerThread(void *arg)
+{
+    standInServer_t *pServer = (standInServer_t *)arg;
+    int fd = accept(pServer->listenfd, NULL, NULL);
+    TEST_ASSERT(fd >= 0, "accept failed: %d", errno);
+
+    char request[2048];
+    size_t requestLen = 0;
+
+    while (requestLen < sizeof(request) - 1)
+    {
+        ssize_t got = recv(fd, request + requestLen, sizeof(request) - 1 - requestLen, 0);
+        TEST_ASSERT(got > 0, "recv of request failed: %zd", got);
+        requestLen += got;
+        request[requestLen] = '\0';
+
+        if (strstr(request, "\r\n\r\n") != NULL)
+        {
+            break;
+        }
+    }
+    pServer->sawAcceptGzip = (strcasestr(request, "\r\nAccept-Encoding: gzip") != NULL);
+
+    const char *headers = "HTTP/1.1 200 OK\r\n"
+                          "Content-Type: text/calendar\r\n"
+                          "Content-Encoding: gzip\r\n"
+                          "Transfer-Encoding: chunked\r\n"
+                          "\r\n";
+    TEST_ASSERT_EQUAL((size_t)send(fd, headers, strlen(headers), 0), strlen(headers));
+
+    //Send the body in odd sized pieces with pauses so the client sees partial data
+    size_t sendSizes[] = {1, 1400, 13, 4000, 700};
+    size_t sent = 0;
+    uint32_t sendNum = 0;
+
+    while (sent < pServer->bodyLen)
+    {
+        size_t sendLen = sendSizes[sendNum % 5];
+
+        if (sendLen > pServer->bodyLen - sent)
+        {
+            sendLen = pServer->bodyLen - sent;
+        }
+        ssize_t justSent = send(fd, pServer->body + sent, sendLen, 0);
+        TEST_ASSERT(justSent > 0, "send failed: %d", errno);
+        sent += justSent;
+        sendNum++;
+
+        if (sendNum % 50 == 0)
+        {
+            usleep(1000);
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+typedef struct {
+    int fd;
+    size_t maxRecv;  //Only read this much at a time, like a small tcp receive buffer
+    bool closed;
+} socketReadContext_t;
+
+//bodyReadFn_t that reads data that has already arrived on a socket (like getData's http stream)
+static size_t readSocket(char *buf, size_t maxLen, void *readContext)
+{
+    socketReadContext_t *pReadContext = (socketReadContext_t *)readContext;
+
+    if (maxLen > pReadContext->maxRecv)
+    {
+        maxLen = pReadContext->maxRecv;
+    }
+    ssize_t got = recv(pReadContext->fd, buf, maxLen, MSG_DONTWAIT);
+
+    if (got == 0)
+    {
+        pReadContext->closed = true;
+    }
+    else if (got < 0)
+    {
+        TEST_ASSERT(errno == EAGAIN || errno == EWOULDBLOCK, "recv failed: %d", errno);
+        got = 0;
+    }
+    return (size_t)got;
+}
+
+//Downloads the calendar from the stand-in server the way Network::getData does: receive
+//window in a buffer much smaller than the calendar, parsed whenever it's full
+int testGzippedChunkedFromServer(void)
+{
+    uint32_t numRelevant = 60;
+    uint32_t numOther = 10000;
+    size_t calLen = 0;
+    char *cal = test_utils_buildCalendar(numRelevant, numOther, &calLen);
+
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(cal, calLen, &gzippedLen);
+
+    size_t chunkSizes[] = {8192, 3, 1000, 1};
+    size_t bodyLen = 0;
+    char *body = test_utils_chunkSizes(gzipped, gzippedLen, chunkSizes, 4, &bodyLen);
+
+    test_log("Calendar is %zu bytes, %zu gzipped, %zu gzipped+chunked\n", calLen, gzippedLen, bodyLen);
+    TEST_ASSERT(gzippedLen * 5 < calLen, "calendar only compressed from %zu to %zu bytes", calLen, gzippedLen);
+
+    standInServer_t server = {};
+    server.body = body;
+    server.bodyLen = bodyLen;
+    server.listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(server.listenfd >= 0, "socket failed: %d", errno);
+
+    struct sockaddr_in addr = {};
+    socklen_t addrLen = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0; //Any free port
+
+    TEST_ASSERT_EQUAL(bind(server.listenfd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    TEST_ASSERT_EQUAL(listen(server.listenfd, 1), 0);
+    TEST_ASSERT_EQUAL(getsockname(server.listenfd, (struct sockaddr *)&addr, &addrLen), 0);
+
+    pthread_t serverThread;
+    TEST_ASSERT_EQUAL(pthread_create(&serverThread, NULL, standInServerThread, &server), 0);
+
+    socketReadContext_t readContext = {};
+    readContext.maxRecv = 1500;
+    readContext.fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_EQUAL(connect(readContext.fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+    const char *request = "GET /calendar.ics HTTP/1.1\r\n"
+                          "Host: 127.0.0.1\r\n"
+                          "Accept-Encoding: gzip\r\n"
+                          "\r\n";
+    TEST_ASSERT_EQUAL((size_t)send(readContext.fd, request, strlen(request), 0), strlen(request));
+
+    //Read the response headers a byte at a time so we don't read any of the body
+    char headers[2048];
+    size_t headersLen = 0;
+
+    while (headersLen < 4 || memcmp(headers + headersLen - 4, "\r\n\r\n", 4) != 0)
+    {
+        TEST_ASSERT(headersLen < sizeof(headers) - 1, "headers too long: %zu", headersLen);
+        TEST_ASSERT_EQUAL(recv(readContext.fd, headers + headersLen, 1, 0), 1);
+        headersLen++;
+    }
+    headers[headersLen] = '\0';
+
+    bool chunked = (strcasestr(headers, "\r\nTransfer-Encoding: chunked\r\n") != NULL);
+    bool gzipEncoded = (strcasestr(headers, "\r\nContent-Encoding: gzip\r\n") != NULL);
+    TEST_ASSERT(chunked && gzipEncoded, "Unexpected headers: %s", headers);
+
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    BodyDecoder_t bodyDecoder;
+    TEST_ASSERT_EQUAL(bodyDecoder_init(&bodyDecoder, chunked, gzipEncoded, INKY_BODYDEC_LENGTH_UNKNOWN), INKY_BODYDEC_RC_OK);
+
+    size_t maxbufsize = 16 * 1024;
+    char *databuf = (char *)malloc(maxbufsize);
+    size_t n = 0;
+    size_t parseStart = 0;
+    uint64_t totalParsed = 0;
+    int32_t rc = INKY_BODYDEC_RC_OK;
+
+    while ((!readContext.closed || bodyDecoder_hasPending(&bodyDecoder)) && rc == INKY_BODYDEC_RC_OK)
+    {
+        size_t spaceInBuf = (maxbufsize - 1) - n;
+
+        if (spaceInBuf == 0)
+        {
+            TEST_ASSERT(parseStart > 0, "window full of unparsed data (%zu bytes)", n);
+            memmove(databuf, databuf + parseStart, n - parseStart);
+            n -= parseStart;
+            parseStart = 0;
+            spaceInBuf = (maxbufsize - 1) - n;
+        }
+
+        size_t decodedLen = 0;
+        rc = bodyDecoder_decode(&bodyDecoder, readSocket, &readContext, databuf + n, spaceInBuf, &decodedLen);
+        TEST_ASSERT(rc >= INKY_BODYDEC_RC_OK, "bodyDecoder_decode rc %d", rc);
+        n += decodedLen;
+
+        if (n == maxbufsize - 1 || rc == INKY_BODYDEC_RC_COMPLETE)
+        {
+            databuf[n] = '\0';
+            char *unparsed = parsePartialDataForEvents(databuf + parseStart, &calParsingContext);
+            TEST_ASSERT_PTR_NOT_NULL(unparsed);
+            totalParsed += unparsed - (databuf + parseStart);
+            parseStart = unparsed - databuf;
+        }
+        else if (decodedLen == 0)
+        {
+            //Wait for more data
+            struct pollfd pfd = { readContext.fd, POLLIN, 0 };
+            poll(&pfd, 1, 100);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(rc, INKY_BODYDEC_RC_COMPLETE);
+    TEST_ASSERT(bodyDecoder.totalRaw == bodyLen, "read %" PRIu64 " bytes of body, expected %zu", bodyDecoder.totalRaw, bodyLen);
+    TEST_ASSERT(bodyDecoder.totalDecoded == calLen, "decoded %" PRIu64 " bytes, expected %zu", bodyDecoder.totalDecoded, calLen);
+    TEST_ASSERT(totalParsed + (n - parseStart) == calLen, "parsed %" PRIu64 " bytes", totalParsed);
+    TEST_ASSERT(server.sawAcceptGzip, "Request did not include Accept-Encoding: gzip%s", "");
+
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), numRelevant);
+    TEST_ASSERT_EQUAL(getTotalEventCount(), numRelevant + numOther);
+    TEST_ASSERT_STRINGS_EQUAL(entries[0].name, "Tickets available for Worthy Players panto?");
+
+    pthread_join(serverThread, NULL);
+    close(readContext.fd);
+    close(server.listenfd);
+
+    bodyDecoder_free(&bodyDecoder);
+    finishCalendarParsing(&calParsingContext);
+    resetEntries();
+    resetEventStats();
+    free(databuf);
+    free(body);
+    free(gzipped);
+    free(cal);
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testGzipSplitAtEveryOffset();
+
+    if(rc == 0)
+        rc = testGzipBadData();
+
+    if(rc == 0)
+        rc = testBodyFraming();
+
+    if(rc == 0)
+        rc = testGzippedChunkedFromServer();
+
+    return rc;
+}
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
 
 #include "utils/test_utils.h"
 #include "Calendar.h"
@@ -17,6 +20,9 @@ typedef struct {
 
 //In Calendar.cpp but not exposed in the headwer:
 time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+size_t unfoldValue(const char *value, size_t valueLen, char *dest, size_t destSize);
+uint32_t parseAllDayEvent(entry_t *pEvents, int *pEventIndex, int maxEvents, char *dateStart, char *dateEnd,
+                          char *recurRule, const struct occurrenceFilter *pFilter);
 
 int testCalFragments(void)
 {
@@ -30,6 +36,8 @@ int testCalFragments(void)
         {"20230901", "resources/calfrag_simpleallday", "All day event for small number of days that finshes before", 0, 1, NULL, NULL },
         {"20270401", "resources/calfrag_recurAlternateWeeks", "Event that occurs alternate weeks - this in the on week", 1, 1, "AltWeeks", NULL},   
         {"20230327", "resources/calfrag_recurAlternateWeeks", "Event that occurs alternate weeks - this in the off week", 0, 1, NULL, NULL},
+        {"20221106", "resources/calfrag_properties", "Properties with parameters (some quoted, containing ':')", 1, 1, "Choir practice", "Church hall"},
+        {"20221106", "resources/calfrag_components", "Components other than the event (in it and around it) skipped", 1, 1, "Tickets available for Worthy Players panto?", "Theatre"},
     };
 
     uint32_t numfrags = sizeof(frags)/sizeof(frags[0]);
@@ -60,12 +68,526 @@ int testCalFragments(void)
         free(calfragment);
         resetEntries();
         resetEventStats();
+        finishCalendarParsing(&calParsingContext);
         calParsingContext.calRelevantEvents = 0;
         calParsingContext.calEvents = 0;
     }
     return 0;
 }
 
+//Summary etc. are only filled in once an event is found to be relevant - check they get
+//to every day of an all day event, and that discarding it removes them all
+int testAllDayEveryDay(void)
+{
+    ProcessingRule_t discardHolidays[] = {
+        {INKYR_MATCH_CONTAINS, "holiday", INKYR_RESULT_DISCARD, 0},
+        {INKYR_MATCH_END, NULL, 0, 0},
+    };
+    ProcessingRule_t colourHolidays[] = {
+        {INKYR_MATCH_CONTAINS, "holiday", INKYR_RESULT_SETCOLOUR, INKY_EVENT_COLOUR_GREEN},
+        {INKYR_MATCH_END, NULL, 0, 0},
+    };
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char *calfragment = test_utils_fileToString("resources/calfrag_simpleallday");
+    TEST_ASSERT_PTR_NOT_NULL(calfragment);
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20230801"), 3);
+
+    testCal.EventRules = colourHolidays;
+    parsePartialDataForEvents(calfragment, &calParsingContext);
+    TEST_ASSERT_EQUAL(entriesNum, 3);
+
+    for (int i = 0; i < entriesNum; i++)
+    {
+        TEST_ASSERT_STRINGS_EQUAL(entries[i].name, "Summer Holidays");
+        TEST_ASSERT_EQUAL(entries[i].day, i);
+        TEST_ASSERT_EQUAL(entries[i].bgColour, INKY_EVENT_COLOUR_GREEN);
+    }
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 1);
+    TEST_ASSERT_EQUAL(getTotalEventCount(), 1);
+
+    //Throwing away what we parsed takes it back off the counts
+    removeFromEventStats(calParsingContext.calRelevantEvents, calParsingContext.calEvents);
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 0);
+    TEST_ASSERT_EQUAL(getTotalEventCount(), 0);
+
+    resetEntries();
+    resetEventStats();
+    finishCalendarParsing(&calParsingContext);
+
+    testCal.EventRules = discardHolidays;
+    parsePartialDataForEvents(calfragment, &calParsingContext);
+    TEST_ASSERT_EQUAL(entriesNum, 0);
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 0);
+    TEST_ASSERT_EQUAL(getTotalEventCount(), 1);
+
+    resetEntries();
+    resetEventStats();
+    finishCalendarParsing(&calParsingContext);
+    free(calfragment);
+    return 0;
+}
+
+//Only the last (incomplete) line of data with no events in it needs keeping
+int testNoEvents(void)
+{
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char data[] = "BEGIN:VCALENDAR\r\nBEGIN:VTIMEZONE\r\nTZID:Europe/London\r\nEND:VTIMEZONE\r\nBEGIN:VEV";
+
+    char *unparsed = parsePartialDataForEvents(data, &calParsingContext);
+
+    TEST_ASSERT_STRINGS_EQUAL(unparsed, "BEGIN:VEV");
+    TEST_ASSERT_EQUAL(getTotalEventCount(), 0);
+    finishCalendarParsing(&calParsingContext);
+    return 0;
+}
+
+typedef struct {
+    const char *value;     //As it is in the calendar (folded, escaped)
+    size_t destSize;
+    const char *expected;
+} unfoldedValue_t;
+
+int testUnfoldValue(void)
+{
+    unfoldedValue_t values[] = {
+        {"Panto", 100, "Panto"},
+        {"Pan\r\n to", 100, "Panto"},
+        {"Pan\n\tto", 100, "Panto"},
+        {"Pan\r\n \r\n to", 100, "Panto"},
+        {"a\\nb\\,c\\;d\\\\e\\xf", 100, "a\nb,c;d\\e\\xf"},
+        //Escape folded between the backslash and the n is left alone (as it was when lines were unfolded first)
+        {"a\\\r\n nb", 100, "a\\nb"},
+        //Fills dest exactly
+        {"Panto", 6, "Panto"},
+        //Truncated - including part way through a fold and just before an escape
+        {"Panto", 4, "Pan"},
+        {"Pan\r\n to", 4, "Pan"},
+        {"Pan\\,to", 4, "Pan"},
+        {"", 100, ""},
+    };
+
+    for (uint32_t i = 0; i < sizeof(values)/sizeof(values[0]); i++)
+    {
+        //Followed by the next line - which mustn't be unfolded
+        char src[100];
+        snprintf(src, sizeof(src), "%s\r\nUID:1\r\n", values[i].value);
+        char dest[100];
+
+        size_t destLen = unfoldValue(src, strlen(values[i].value), dest, values[i].destSize);
+
+        TEST_ASSERT(destLen == strlen(values[i].expected), "value %" PRIu32 " len %zu", i, destLen);
+        TEST_ASSERT_STRINGS_EQUAL(dest, values[i].expected);
+    }
+
+    //Long folded summary - more than the 500 chars a line was limited to when lines were unfolded first
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char *calfragment = test_utils_fileToString("resources/calfrag_longfolded");
+    TEST_ASSERT_PTR_NOT_NULL(calfragment);
+
+    resetEventStats();
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+    parsePartialDataForEvents(calfragment, &calParsingContext);
+
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 1);
+    TEST_ASSERT(strncmp(entries[0].name, "Tickets", 7) == 0, "summary %s", entries[0].name);
+    TEST_ASSERT_STRINGS_EQUAL(entries[0].location, "Theatre");
+    free(calfragment);
+    resetEntries();
+    resetEventStats();
+    finishCalendarParsing(&calParsingContext);
+    return 0;
+}
+
+typedef struct {
+    const char *dateStart;
+    const char *dateEnd;
+    const char *recurRule;
+    int unitDays;          //1 or 7 (or 0 for months)
+    int unitMonths;        //1 or 12 (or 0 for days)
+    int interval;
+    int count;             //0 if no COUNT=
+    const char *until;     //NULL if no UNTIL=
+} recurrence_t;
+
+static int32_t testDayNumber(int year, int month, int day)
+{
+    struct tm dayTm = {0};
+    dayTm.tm_year = year - 1900;
+    dayTm.tm_mon  = month - 1;
+    dayTm.tm_mday = day;
+    return (int32_t)(timegm(&dayTm) / 86400);
+}
+
+static int32_t testDayNumberYYYYMMDD(const char *yyyymmdd)
+{
+    int ymd = atoi(yyyymmdd);
+    return testDayNumber(ymd / 10000, (ymd / 100) % 100, ymd % 100);
+}
+
+//Days shown (first..first+numDays-1) that occurrences are on - stepping through every occurrence
+//from DTSTART (skipping ones on dates that don't exist e.g. the 31st of a short month)
+static uint32_t expandStepByStep(const recurrence_t *recur, int32_t firstDay, int32_t numDays)
+{
+    int year  = atoi(recur->dateStart) / 10000;
+    int month = (atoi(recur->dateStart) / 100) % 100;
+    int day   = atoi(recur->dateStart) % 100;
+    int32_t start = testDayNumberYYYYMMDD(recur->dateStart);
+    int32_t duration = testDayNumberYYYYMMDD(recur->dateEnd) - start;
+    int32_t until = recur->until ? testDayNumberYYYYMMDD(recur->until) : INT32_MAX;
+    uint32_t relevantDays = 0;
+    int occurrences = 0;
+
+    for (int k = 0; ; k++)
+    {
+        int32_t occStart;
+
+        if (recur->unitDays)
+        {
+            occStart = start + k * recur->interval * recur->unitDays;
+        }
+        else
+        {
+            int months = (month - 1) + k * recur->interval * recur->unitMonths;
+            int32_t monthStart = testDayNumber(year + months / 12, months % 12 + 1, 1);
+            int32_t nextMonthStart = testDayNumber(year + (months + 1) / 12, (months + 1) % 12 + 1, 1);
+
+            if (day > nextMonthStart - monthStart)
+            {
+                continue;
+            }
+            occStart = monthStart + day - 1;
+        }
+
+        if (occStart > until || occStart >= firstDay + numDays || (recur->count && occurrences == recur->count))
+        {
+            break;
+        }
+        occurrences++;
+
+        for (int32_t d = occStart; d < occStart + duration; d++)
+        {
+            if (d >= firstDay && d < firstDay + numDays)
+            {
+                relevantDays++;
+            }
+        }
+    }
+    return relevantDays;
+}
+
+//Recurring all day events are expanded from the first occurrence that could be on the days shown
+//(rather than from DTSTART) - check they're on the same days as stepping through every occurrence
+int testRecurrenceSkipAhead(void)
+{
+    recurrence_t recurs[] = {
+        {"20130305", "20130306", "FREQ=DAILY",                     1, 0, 1, 0, NULL},
+        {"20130305", "20130307", "FREQ=DAILY;INTERVAL=3",          1, 0, 3, 0, NULL},
+        {"20130305", "20130306", "FREQ=DAILY;COUNT=4000",          1, 0, 1, 4000, NULL},
+        {"20130305", "20130306", "FREQ=DAILY;UNTIL=20230601T000000Z", 1, 0, 1, 0, "20230601"},
+        {"20130301", "20130303", "FREQ=WEEKLY",                    7, 0, 1, 0, NULL},
+        {"20130301", "20130302", "FREQ=WEEKLY;WKST=MO;COUNT=500;INTERVAL=2", 7, 0, 2, 500, NULL},
+        {"20130301", "20130311", "FREQ=WEEKLY;INTERVAL=3;UNTIL=20240101", 7, 0, 3, 0, "20240101"},
+        {"20130115", "20130116", "FREQ=MONTHLY",                   0, 1, 1, 0, NULL},
+        {"20130131", "20130201", "FREQ=MONTHLY",                   0, 1, 1, 0, NULL},
+        {"20130130", "20130202", "FREQ=MONTHLY;COUNT=100",         0, 1, 1, 100, NULL},
+        {"20130331", "20130401", "FREQ=MONTHLY;INTERVAL=5;COUNT=20", 0, 1, 5, 20, NULL},
+        {"20130620", "20130905", "FREQ=YEARLY",                    0, 12, 1, 0, NULL},
+        {"20120229", "20120301", "FREQ=YEARLY",                    0, 12, 1, 0, NULL},
+        {"20120229", "20120301", "FREQ=YEARLY;COUNT=3",            0, 12, 1, 3, NULL},
+        {"20161225", "20161226", "FREQ=YEARLY;INTERVAL=2;UNTIL=20221225", 0, 12, 2, 0, "20221225"},
+    };
+    int32_t numDaysShown[] = { 3, 31 };
+
+    for (uint32_t r = 0; r < sizeof(recurs)/sizeof(recurs[0]); r++)
+    {
+        for (uint32_t n = 0; n < sizeof(numDaysShown)/sizeof(numDaysShown[0]); n++)
+        {
+            //Windows from before DTSTART to 14 years after
+            for (int32_t firstDay = testDayNumber(2012, 12, 1); firstDay < testDayNumber(2027, 1, 1); firstDay += 5)
+            {
+                time_t firstDaySecs = (time_t)firstDay * 86400;
+                struct tm firstTm;
+                char firstDayStr[16];
+
+                gmtime_r(&firstDaySecs, &firstTm);
+                strftime(firstDayStr, sizeof(firstDayStr), "%Y%m%d", &firstTm);
+                setCalendarRange(convertYYYYMMDDtoEpochTime(firstDayStr), numDaysShown[n]);
+
+                char dateStart[9], dateEnd[9], recurRule[64];
+                strcpy(dateStart, recurs[r].dateStart);
+                strcpy(dateEnd, recurs[r].dateEnd);
+                strcpy(recurRule, recurs[r].recurRule);
+
+                uint32_t relevantDays = parseAllDayEvent(entries, &entriesNum, MAX_ENTRIES, dateStart, dateEnd, recurRule, NULL);
+                uint32_t expected = expandStepByStep(&recurs[r], firstDay, numDaysShown[n]);
+
+                TEST_ASSERT(relevantDays == expected, "%s (%s) from %s for %" PRId32 " days: %" PRIu32 " days (expected %" PRIu32 ")",
+                            recurs[r].dateStart, recurs[r].recurRule, firstDayStr, numDaysShown[n], relevantDays, expected);
+                resetEntries();
+            }
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    int8_t day;
+    const char *time;
+} expectedEntry_t;
+
+typedef struct {
+    const char *calStartYYYYMMDD;
+    expectedEntry_t entries[4];    //ends with a NULL name
+} recurringWindow_t;
+
+//Timed (local and UTC) and all day recurring events with BYDAY/BYSETPOS and EXDATEs
+int testRecurringEvents(void)
+{
+    recurringWindow_t windows[] = {
+        //Thursday's choir practice is an EXDATE
+        {"20221108", {{"Choir practice", 0, "19:00-20:00"}, {"Book club", 0, "09:30-10:30"}, {NULL}}},
+        //So is the last weekday of November
+        {"20221129", {{"Choir practice", 0, "19:00-20:00"}, {"Choir practice", 2, "19:00-20:00"}, {NULL}}},
+        {"20221229", {{"Choir practice", 0, "19:00-20:00"}, {"Month end", 1, ""}, {NULL}}},
+        //Summer time - choir practice is 19:00 local time, book club 09:30 UTC
+        {"20230711", {{"Choir practice", 0, "19:00-20:00"}, {"Choir practice", 2, "19:00-20:00"},
+                      {"Book club", 0, "10:30-11:30"}, {NULL}}},
+    };
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char *calfragment = test_utils_fileToString("resources/calfrag_recurring");
+    TEST_ASSERT_PTR_NOT_NULL(calfragment);
+
+    setenv("TZ", "GMT0BST,M3.5.0/1,M10.5.0", 1);
+    tzset();
+
+    for (uint32_t w = 0; w < sizeof(windows)/sizeof(windows[0]); w++)
+    {
+        setCalendarRange(convertYYYYMMDDtoEpochTime(windows[w].calStartYYYYMMDD), 3);
+        parsePartialDataForEvents(calfragment, &calParsingContext);
+
+        int i;
+        for (i = 0; windows[w].entries[i].name != NULL; i++)
+        {
+            TEST_ASSERT(i < entriesNum, "%s: only %d entries", windows[w].calStartYYYYMMDD, entriesNum);
+            TEST_ASSERT_STRINGS_EQUAL(entries[i].name, windows[w].entries[i].name);
+            TEST_ASSERT_EQUAL(entries[i].day, windows[w].entries[i].day);
+            TEST_ASSERT_STRINGS_EQUAL(entries[i].time, windows[w].entries[i].time);
+        }
+        TEST_ASSERT_EQUAL(entriesNum, i);
+
+        resetEntries();
+        resetEventStats();
+        finishCalendarParsing(&calParsingContext);
+    }
+    free(calfragment);
+    return 0;
+}
+
+typedef struct {
+    const char *calStartYYYYMMDD;
+    uint32_t numDays;
+    expectedEntry_t entries[5];    //ends with a NULL name
+} overrideWindow_t;
+
+//Modified and cancelled occurrences (RECURRENCE-ID) before and after the recurring event in the calendar,
+//and more than one version (SEQUENCE) of one - they replace the occurrence rather than being shown as well
+int testOverrides(void)
+{
+    overrideWindow_t windows[] = {
+        //Moved (before the recurring event)
+        {"20230830", 3, {{"Mum visit (moved)", 1, "16:00-17:00"}, {NULL}}},
+        //Cancelled after the recurring event and before it
+        {"20230906", 3, {{NULL}}},
+        {"20230920", 3, {{NULL}}},
+        {"20230927", 3, {{"Mum visit", 1, "14:00-15:00"}, {NULL}}},
+        //Bins moved twice (the second time after the Mum visit before it in the entries was replaced)
+        {"20230911", 4, {{"Dentist", 0, "09:00-09:30"}, {"Bins (Wednesday)", 2, ""}, {NULL}}},
+        //Mum visit moved to Friday - then to later on Friday (an older version after that is ignored)
+        {"20230913", 3, {{"Mum visit (Friday later)", 2, "11:00-12:00"}, {"Bins (Wednesday)", 0, ""}, {NULL}}},
+    };
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char *calfragment = test_utils_fileToString("resources/calfrag_overrides");
+    TEST_ASSERT_PTR_NOT_NULL(calfragment);
+
+    setenv("TZ", "GMT0BST,M3.5.0/1,M10.5.0", 1);
+    tzset();
+
+    for (uint32_t w = 0; w < sizeof(windows)/sizeof(windows[0]); w++)
+    {
+        setCalendarRange(convertYYYYMMDDtoEpochTime(windows[w].calStartYYYYMMDD), windows[w].numDays);
+        parsePartialDataForEvents(calfragment, &calParsingContext);
+
+        int i;
+        for (i = 0; windows[w].entries[i].name != NULL; i++)
+        {
+            TEST_ASSERT(i < entriesNum, "%s: only %d entries", windows[w].calStartYYYYMMDD, entriesNum);
+            TEST_ASSERT_STRINGS_EQUAL(entries[i].name, windows[w].entries[i].name);
+            TEST_ASSERT_EQUAL(entries[i].day, windows[w].entries[i].day);
+            TEST_ASSERT_STRINGS_EQUAL(entries[i].time, windows[w].entries[i].time);
+        }
+        TEST_ASSERT(entriesNum == i, "%s: %d entries", windows[w].calStartYYYYMMDD, entriesNum);
+
+        resetEntries();
+        resetEventStats();
+        finishCalendarParsing(&calParsingContext);
+    }
+    free(calfragment);
+    return 0;
+}
+
+int testTimeZones(void)
+{
+    //Shown in London (the US and the UK change their clocks on different days)
+    overrideWindow_t windows[] = {
+        {"20230307", 3, {{"New York call", 1, "14:00-15:00"}, {NULL}}},
+        //US summer time, UK winter time (02:30 is skipped in New York - it's taken as EST), Tokyo is the day before
+        //and there's no VTIMEZONE for Mars (taken to be local time)
+        {"20230312", 4, {{"New York call", 3, "13:00-14:00"}, {"Tokyo breakfast", 2, "22:00-22:30"},
+                         {"When the clocks go forward", 0, "07:30-08:00"}, {"No VTIMEZONE", 2, "10:00-11:00"}, {NULL}}},
+        {"20230329", 3, {{"New York call", 0, "14:00-15:00"}, {NULL}}},
+        //UK winter time, US summer time and an event ending in a different time zone
+        {"20231101", 3, {{"New York call", 0, "13:00-14:00"}, {"UTC", 0, "12:00-13:00"}, {"Flight", 0, "23:00-01:00"}, {NULL}}},
+        //01:30 happens twice in New York - the first time (EDT) is used
+        {"20231105", 1, {{"When the clocks go back", 0, "05:30-07:30"}, {NULL}}},
+        {"20231108", 3, {{"New York call", 0, "14:00-15:00"}, {NULL}}},
+    };
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char *calfragment = test_utils_fileToString("resources/calfrag_timezones");
+    TEST_ASSERT_PTR_NOT_NULL(calfragment);
+
+    setenv("TZ", "GMT0BST,M3.5.0/1,M10.5.0", 1);
+    tzset();
+
+    for (uint32_t w = 0; w < sizeof(windows)/sizeof(windows[0]); w++)
+    {
+        setCalendarRange(convertYYYYMMDDtoEpochTime(windows[w].calStartYYYYMMDD), windows[w].numDays);
+        parsePartialDataForEvents(calfragment, &calParsingContext);
+
+        int i;
+        for (i = 0; windows[w].entries[i].name != NULL; i++)
+        {
+            TEST_ASSERT(i < entriesNum, "%s: only %d entries", windows[w].calStartYYYYMMDD, entriesNum);
+            TEST_ASSERT_STRINGS_EQUAL(entries[i].name, windows[w].entries[i].name);
+            TEST_ASSERT_EQUAL(entries[i].day, windows[w].entries[i].day);
+            TEST_ASSERT_STRINGS_EQUAL(entries[i].time, windows[w].entries[i].time);
+        }
+        TEST_ASSERT(entriesNum == i, "%s: %d entries", windows[w].calStartYYYYMMDD, entriesNum);
+
+        resetEntries();
+        resetEventStats();
+        finishCalendarParsing(&calParsingContext);
+    }
+    free(calfragment);
+    return 0;
+}
+
+typedef struct {
+    const char *path;
+    const char *calStartYYYYMMDD;
+    uint32_t numDays;
+} chunkedCalendar_t;
+
+//Parses a calendar as it would arrive in pieces of pieceSize bytes: as the receive window does, the unparsed
+//data is kept and the next piece added after it - moving it to the start of the buffer every other time
+static void parseInPieces(const char *calendar, size_t pieceSize, char *window, CalendarParsingContext_t *pContext)
+{
+    size_t calLen = strlen(calendar);
+    size_t parseStart = 0;
+    size_t n = 0;
+
+    for (size_t pos = 0, pieces = 0; pos < calLen; pieces++)
+    {
+        if (pieces % 2 == 1)
+        {
+            memmove(window, window + parseStart, n - parseStart);
+            n -= parseStart;
+            parseStart = 0;
+        }
+        size_t len = (calLen - pos < pieceSize) ? calLen - pos : pieceSize;
+
+        memcpy(window + n, calendar + pos, len);
+        n += len;
+        pos += len;
+        window[n] = '\0';
+
+        char *unparsed = parsePartialDataForEvents(window + parseStart, pContext);
+        parseStart = unparsed - window;
+    }
+}
+
+//However the calendar arrives (down to a byte at a time), events that don't all arrive at once are
+//carried on with when the rest does and give the same entries as parsing the calendar in one go
+int testChunkedParsing(void)
+{
+    chunkedCalendar_t calendars[] = {
+        {"resources/calfrag_longfolded",  "20221106", 3},
+        {"resources/calfrag_components",  "20221106", 3},
+        {"resources/calfrag_recurring",   "20221129", 3},
+        {"resources/calfrag_overrides",   "20230911", 4},
+        {"resources/calfrag_timezones",   "20230312", 4},
+    };
+    static entry_t expected[MAX_ENTRIES];
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+
+    setenv("TZ", "GMT0BST,M3.5.0/1,M10.5.0", 1);
+    tzset();
+
+    for (uint32_t c = 0; c < sizeof(calendars)/sizeof(calendars[0]); c++)
+    {
+        char *calendar = test_utils_fileToString(calendars[c].path);
+        TEST_ASSERT_PTR_NOT_NULL(calendar);
+        char *window = (char *)malloc(2 * strlen(calendar) + 1);
+        TEST_ASSERT_PTR_NOT_NULL(window);
+
+        setCalendarRange(convertYYYYMMDDtoEpochTime(calendars[c].calStartYYYYMMDD), calendars[c].numDays);
+        parsePartialDataForEvents(calendar, &calParsingContext);
+
+        int expectedNum = entriesNum;
+        uint64_t expectedEvents = calParsingContext.calEvents;
+        memcpy(expected, entries, sizeof(expected));
+        TEST_ASSERT(expectedNum > 0, "%s: no entries", calendars[c].path);
+
+        resetEntries();
+        resetEventStats();
+        finishCalendarParsing(&calParsingContext);
+        calParsingContext.calEvents = 0;
+
+        for (size_t pieceSize = 1; pieceSize <= 200; pieceSize++)
+        {
+            parseInPieces(calendar, pieceSize, window, &calParsingContext);
+
+            TEST_ASSERT(entriesNum == expectedNum, "%s in pieces of %zu: %d entries (expected %d)",
+                        calendars[c].path, pieceSize, entriesNum, expectedNum);
+            TEST_ASSERT(calParsingContext.calEvents == expectedEvents, "%s in pieces of %zu: %" PRIu64 " events",
+                        calendars[c].path, pieceSize, calParsingContext.calEvents);
+
+            for (int i = 0; i < expectedNum; i++)
+            {
+                TEST_ASSERT_STRINGS_EQUAL(entries[i].name, expected[i].name);
+                TEST_ASSERT_STRINGS_EQUAL(entries[i].location, expected[i].location);
+                TEST_ASSERT_STRINGS_EQUAL(entries[i].time, expected[i].time);
+                TEST_ASSERT_EQUAL(entries[i].day, expected[i].day);
+            }
+            resetEntries();
+            resetEventStats();
+            finishCalendarParsing(&calParsingContext);
+            calParsingContext.calEvents = 0;
+        }
+        free(window);
+        free(calendar);
+    }
+    return 0;
+}
+
 int main(void)
 {
     int rc = 0;
@@ -73,5 +595,29 @@ int main(void)
     if(rc == 0)
         rc = testCalFragments();
 
+    if(rc == 0)
+        rc = testUnfoldValue();
+
+    if(rc == 0)
+        rc = testNoEvents();
+
+    if(rc == 0)
+        rc = testAllDayEveryDay();
+
+    if(rc == 0)
+        rc = testRecurrenceSkipAhead();
+
+    if(rc == 0)
+        rc = testRecurringEvents();
+
+    if(rc == 0)
+        rc = testOverrides();
+
+    if(rc == 0)
+        rc = testTimeZones();
+
+    if(rc == 0)
+        rc = testChunkedParsing();
+
     return rc;
 }
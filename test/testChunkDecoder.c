@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "utils/test_utils.h"
+#include "ChunkDecoder.h"
+
+//Creates a chunked encoding of payload using chunks of (cycling) sizes from chunkSizes
+//Some chunk headers are written with extensions/upper case hex to check we cope with them
+//The returned buffer needs to be freed after use
+static char *encodeChunked(const char *payload, size_t payloadLen,
+                           const size_t *chunkSizes, size_t numChunkSizes, size_t *pEncodedLen)
+{
+    char *encoded = (char *)malloc(payloadLen * 2 + 1024);
+    TEST_ASSERT_PTR_NOT_NULL(encoded);
+
+    size_t inPos = 0;
+    size_t outPos = 0;
+    uint32_t chunkNum = 0;
+
+    while (inPos < payloadLen)
+    {
+        size_t chunkLen = chunkSizes[chunkNum % numChunkSizes];
+
+        if (chunkLen > payloadLen - inPos)
+        {
+            chunkLen = payloadLen - inPos;
+        }
+
+        if (chunkNum % 3 == 1)
+        {
+            outPos += sprintf(encoded + outPos, "%zX;name=value\r\n", chunkLen);
+        }
+        else
+        {
+            outPos += sprintf(encoded + outPos, "%zx\r\n", chunkLen);
+        }
+        memcpy(encoded + outPos, payload + inPos, chunkLen);
+        outPos += chunkLen;
+        inPos += chunkLen;
+        outPos += sprintf(encoded + outPos, "\r\n");
+        chunkNum++;
+    }
+    outPos += sprintf(encoded + outPos, "0\r\n\r\n");
+
+    *pEncodedLen = outPos;
+    return encoded;
+}
+
+//Decodes encoded split into fragments at the given offsets, checks the result matches payload
+static void checkDecodeFragments(const char *payload, size_t payloadLen,
+                                 const char *encoded, size_t encodedLen,
+                                 const size_t *splits, size_t numSplits)
+{
+    ChunkDecoder_t decoder;
+    chunkDecoder_init(&decoder);
+
+    char *fragbuf = (char *)malloc(encodedLen + 1);
+    char *decoded = (char *)malloc(encodedLen + 1);
+    size_t decodedLen = 0;
+    size_t fragStart = 0;
+    int32_t rc = INKY_CHUNKDEC_RC_OK;
+
+    for (size_t i = 0; i <= numSplits; i++)
+    {
+        size_t fragEnd = (i < numSplits) ? splits[i] : encodedLen;
+        size_t fragLen = fragEnd - fragStart;
+
+        TEST_ASSERT_NOT_EQUAL(rc, INKY_CHUNKDEC_RC_BADHEADER);
+
+        memcpy(fragbuf, encoded + fragStart, fragLen);
+
+        size_t payloadFragLen = 0;
+        rc = chunkDecoder_decode(&decoder, fragbuf, fragLen, &payloadFragLen);
+        TEST_ASSERT(payloadFragLen <= fragLen, "payload %zu frag %zu", payloadFragLen, fragLen);
+
+        memcpy(decoded + decodedLen, fragbuf, payloadFragLen);
+        decodedLen += payloadFragLen;
+        fragStart = fragEnd;
+    }
+
+    TEST_ASSERT_EQUAL(rc, INKY_CHUNKDEC_RC_COMPLETE);
+    TEST_ASSERT(decodedLen == payloadLen, "decoded %zu bytes, expected %zu", decodedLen, payloadLen);
+    TEST_ASSERT(memcmp(decoded, payload, payloadLen) == 0, "decoded data differs (%zu bytes)", payloadLen);
+    TEST_ASSERT(decoder.totalPayload == payloadLen, "decoder counted %" PRIu64 " bytes", decoder.totalPayload);
+
+    free(fragbuf);
+    free(decoded);
+}
+
+int testSplitAtEveryOffset(void)
+{
+    char *payload = test_utils_fileToString("resources/calfrag_simple");
+    TEST_ASSERT_PTR_NOT_NULL(payload);
+    size_t payloadLen = strlen(payload);
+
+    size_t chunkSizes[] = {100, 1, 37, 255, 16};
+    size_t encodedLen = 0;
+    char *encoded = encodeChunked(payload, payloadLen, chunkSizes, 5, &encodedLen);
+
+    //No split at all
+    checkDecodeFragments(payload, payloadLen, encoded, encodedLen, NULL, 0);
+
+    //Every position for a single split
+    for (size_t split = 0; split <= encodedLen; split++)
+    {
+        checkDecodeFragments(payload, payloadLen, encoded, encodedLen, &split, 1);
+    }
+
+    //Every pair of split positions (so every header is split in every way between 3 fragments)
+    for (size_t split1 = 0; split1 <= encodedLen; split1++)
+    {
+        for (size_t split2 = split1; split2 <= encodedLen; split2++)
+        {
+            size_t splits[2] = {split1, split2};
+            checkDecodeFragments(payload, payloadLen, encoded, encodedLen, splits, 2);
+        }
+    }
+
+    free(encoded);
+    free(payload);
+    return 0;
+}
+
+int testRandomFragments(void)
+{
+    //Random bytes (including \r, \n and hex digits) as payload
+    size_t payloadLen = 200000;
+    char *payload = (char *)malloc(payloadLen);
+    srand(1234);
+
+    for (size_t i = 0; i < payloadLen; i++)
+    {
+        payload[i] = (char)(rand() & 0xFF);
+    }
+
+    size_t chunkSizes[] = {8192, 3, 65536, 1, 500};
+    size_t encodedLen = 0;
+    char *encoded = encodeChunked(payload, payloadLen, chunkSizes, 5, &encodedLen);
+
+    size_t *splits = (size_t *)malloc(encodedLen * sizeof(size_t));
+
+    for (uint32_t iteration = 0; iteration < 50; iteration++)
+    {
+        size_t numSplits = 0;
+        size_t pos = 0;
+        size_t maxFrag = (iteration % 2 == 0) ? 16 : 3000;
+
+        while(1)
+        {
+            pos += rand() % maxFrag;
+            if (pos >= encodedLen)
+            {
+                break;
+            }
+            splits[numSplits++] = pos;
+        }
+        checkDecodeFragments(payload, payloadLen, encoded, encodedLen, splits, numSplits);
+    }
+
+    free(splits);
+    free(encoded);
+    free(payload);
+    return 0;
+}
+
+int testBadHeaders(void)
+{
+    const char *badBodies[] = {
+        "zz\r\nHello\r\n0\r\n\r\n",
+        "5\r\nHelloX\r\n0\r\n\r\n",
+        "10000000000000000\r\n",
+    };
+
+    for (uint32_t i = 0; i < sizeof(badBodies)/sizeof(badBodies[0]); i++)
+    {
+        ChunkDecoder_t decoder;
+        chunkDecoder_init(&decoder);
+
+        char *body = strdup(badBodies[i]);
+        size_t payloadLen = 0;
+        int32_t rc = chunkDecoder_decode(&decoder, body, strlen(body), &payloadLen);
+        TEST_ASSERT_EQUAL(rc, INKY_CHUNKDEC_RC_BADHEADER);
+
+        //Once failed, stays failed
+        rc = chunkDecoder_decode(&decoder, body, strlen(body), &payloadLen);
+        TEST_ASSERT_EQUAL(rc, INKY_CHUNKDEC_RC_BADHEADER);
+        free(body);
+    }
+    return 0;
+}
+
+//The body isn't complete until the empty line after the last chunk (and any trailers) has been read
+//- otherwise it'd be left unread on a connection we reuse for the next request
+int testTrailers(void)
+{
+    const char *bodies[] = {
+        "5\r\nHello\r\n0\r\n\r\n",
+        "5\r\nHello\r\n0\r\nExpires: Wed, 21 Oct 2015 07:28:00 GMT\r\nX-Other: 1\r\n\r\n",
+        "5\r\nHello\r\n0;ext=1\r\nX-Bare-LF: 1\n\n",
+    };
+
+    for (uint32_t i = 0; i < sizeof(bodies)/sizeof(bodies[0]); i++)
+    {
+        size_t bodyLen = strlen(bodies[i]);
+
+        //Feed it a byte at a time: only the final byte completes it
+        ChunkDecoder_t decoder;
+        chunkDecoder_init(&decoder);
+
+        for (size_t pos = 0; pos < bodyLen; pos++)
+        {
+            char c = bodies[i][pos];
+            size_t payloadLen = 0;
+            int32_t rc = chunkDecoder_decode(&decoder, &c, 1, &payloadLen);
+
+            if (pos < bodyLen - 1)
+            {
+                TEST_ASSERT(rc == INKY_CHUNKDEC_RC_OK, "body %" PRIu32 " rc %d at offset %zu", i, rc, pos);
+            }
+            else
+            {
+                TEST_ASSERT_EQUAL(rc, INKY_CHUNKDEC_RC_COMPLETE);
+            }
+        }
+        TEST_ASSERT(decoder.totalPayload == 5, "decoded %" PRIu64 " bytes", decoder.totalPayload);
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testSplitAtEveryOffset();
+
+    if(rc == 0)
+        rc = testRandomFragments();
+
+    if(rc == 0)
+        rc = testBadHeaders();
+
+    if(rc == 0)
+        rc = testTrailers();
+
+    return rc;
+}
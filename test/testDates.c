@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "utils/test_utils.h"
+#include "Calendar.h"
+
+//Checks the date arithmetic in Calendar.cpp gives the same answers as the C library (mktime(),
+//timegm(), localtime_r()) for every day (and, in a few timezones, every hour) from 2000 to 2200,
+//and that events go in the same columns as when the C library was used
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+time_t convertYYYYMMDDTHHMMSSZtoEpochTime(const char *strYYYYMMDDTHHMMSSZ);
+int convertEpochTimeToYYYYMMDD(time_t inputTime);
+int32_t daysFromCivil(int32_t year, uint32_t month, int32_t day);
+void civilFromDays(int32_t days, int32_t *pYear, uint32_t *pMonth, uint32_t *pDay);
+void getTimeString(char *timestr, char *from, char *to, int8_t *day, time_t *timeStamp);
+uint32_t parseAllDayEventInstance(entry_t *pEvents, int *pEventIndex, int maxEvents, int dateStartInt, int dateEndInt);
+
+#define TEST_SECS_PER_DAY  86400
+#define TEST_SECS_PER_HOUR  3600
+#define TEST_WINDOW_DAYS      30
+#define TEST_MAX_ENTRIES      70
+
+//POSIX TZ strings: the example in secrets.h, one behind UTC, one in the southern hemisphere
+//(clocks go forward at the end of the year) with a half hour offset, and UTC
+static const char *TestTimeZones[] = {
+    "GMT0BST,M3.5.0/1,M10.5.0",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "ACST-9:30ACDT,M10.1.0,M4.1.0/3",
+    "UTC0",
+};
+
+static void setTimeZone(const char *timeZone)
+{
+    setenv("TZ", timeZone, 1);
+    tzset();
+}
+
+static int tmToYYYYMMDD(const struct tm *pTm)
+{
+    return (pTm->tm_year + 1900) * 10000 + (pTm->tm_mon + 1) * 100 + pTm->tm_mday;
+}
+
+//Every day from 2000 to 2200 to days since 1970 and back
+int testCivilDays(void)
+{
+    struct tm dayTm = {0};
+    dayTm.tm_year = 2000 - 1900;
+    dayTm.tm_mday = 1;
+    time_t dayStart = timegm(&dayTm);
+
+    for (; dayStart < (time_t)7289654400LL; dayStart += TEST_SECS_PER_DAY) //2201-01-01
+    {
+        gmtime_r(&dayStart, &dayTm);
+
+        int32_t days = daysFromCivil(dayTm.tm_year + 1900, dayTm.tm_mon + 1, dayTm.tm_mday);
+        TEST_ASSERT(days == dayStart / TEST_SECS_PER_DAY, "%d: %" PRId32 " days", tmToYYYYMMDD(&dayTm), days);
+
+        int32_t year;
+        uint32_t month, day;
+        civilFromDays(days, &year, &month, &day);
+        TEST_ASSERT(   year == dayTm.tm_year + 1900 && month == (uint32_t)dayTm.tm_mon + 1
+                    && day == (uint32_t)dayTm.tm_mday, "%" PRId32 " days: %" PRId32 "-%" PRIu32 "-%" PRIu32,
+                          days, year, month, day);
+    }
+
+    //Days outside 1-31 are normalised, as mktime() does
+    TEST_ASSERT_EQUAL(daysFromCivil(2023, 2, 31), daysFromCivil(2023, 3, 3));
+    TEST_ASSERT_EQUAL(daysFromCivil(2024, 3, 0), daysFromCivil(2024, 2, 29));
+    TEST_ASSERT_EQUAL(daysFromCivil(1970, 1, 1), 0);
+    return 0;
+}
+
+//Times ending in Z are UTC whatever the timezone - a different time of day for each day
+int testUtcTimes(void)
+{
+    char timeStr[20];
+    uint32_t i = 0;
+
+    setTimeZone(TestTimeZones[0]);
+
+    for (time_t dayStart = (time_t)946684800; dayStart < (time_t)7289654400LL; dayStart += TEST_SECS_PER_DAY, i++)
+    {
+        struct tm utcTm;
+        time_t utcTime = dayStart + (i * 4373) % TEST_SECS_PER_DAY;
+        gmtime_r(&utcTime, &utcTm);
+        strftime(timeStr, sizeof(timeStr), "%Y%m%dT%H%M%SZ", &utcTm);
+
+        time_t converted = convertYYYYMMDDTHHMMSSZtoEpochTime(timeStr);
+        TEST_ASSERT(converted == utcTime, "%s: %lld expected %lld", timeStr, (long long)converted, (long long)utcTime);
+    }
+    return 0;
+}
+
+//For each timezone, sets ranges a month apart from 2000 to 2200 and checks every hour in them
+//(in local time and in UTC) converts as the C library does - including when the clocks change
+int testLocalTimes(void)
+{
+    char timeStr[20];
+
+    for (uint32_t tz = 0; tz < sizeof(TestTimeZones)/sizeof(TestTimeZones[0]); tz++)
+    {
+        setTimeZone(TestTimeZones[tz]);
+
+        for (time_t windowStart = (time_t)946684800; windowStart < (time_t)7289654400LL;
+                                          windowStart += TEST_WINDOW_DAYS * TEST_SECS_PER_DAY)
+        {
+            struct tm localTm;
+            time_t calendarStart = windowStart + TEST_SECS_PER_DAY / 2;
+
+            setCalendarRange(calendarStart, 3);
+            localtime_r(&calendarStart, &localTm);
+            TEST_ASSERT_EQUAL(getCalendarFirstDayYYYYMMDD(), tmToYYYYMMDD(&localTm));
+
+            //UTC -> local date
+            for (time_t utcTime = windowStart; utcTime < windowStart + TEST_WINDOW_DAYS * TEST_SECS_PER_DAY;
+                                              utcTime += TEST_SECS_PER_HOUR)
+            {
+                localtime_r(&utcTime, &localTm);
+                TEST_ASSERT(convertEpochTimeToYYYYMMDD(utcTime) == tmToYYYYMMDD(&localTm), "%s: %lld to %d expected %d",
+                                  TestTimeZones[tz], (long long)utcTime, convertEpochTimeToYYYYMMDD(utcTime), tmToYYYYMMDD(&localTm));
+            }
+
+            //Local time -> UTC (every half past and each midnight)
+            localtime_r(&windowStart, &localTm);
+            localTm.tm_hour = 0;
+            localTm.tm_min = 30;
+            localTm.tm_sec = 0;
+
+            for (uint32_t hour = 0; hour < TEST_WINDOW_DAYS * 24; hour++)
+            {
+                //Normalised with timegm() (not mktime()) so we get the times that don't exist when the clocks go forward
+                struct tm wallTm = localTm;
+                wallTm.tm_hour += hour;
+                timegm(&wallTm);
+                strftime(timeStr, sizeof(timeStr), "%Y%m%dT%H%M%S", &wallTm);
+
+                struct tm expectedTm = wallTm;
+                expectedTm.tm_isdst = -1;
+                time_t expected = mktime(&expectedTm);
+
+                time_t converted = convertYYYYMMDDTHHMMSSZtoEpochTime(timeStr);
+                TEST_ASSERT(converted == expected, "%s: %s to %lld expected %lld",
+                                  TestTimeZones[tz], timeStr, (long long)converted, (long long)expected);
+
+                if (wallTm.tm_hour == 0)
+                {
+                    struct tm midnightTm = wallTm;
+                    midnightTm.tm_min = 0;
+                    midnightTm.tm_isdst = -1;
+                    expected = mktime(&midnightTm);
+
+                    strftime(timeStr, sizeof(timeStr), "%Y%m%d", &wallTm);
+                    converted = convertYYYYMMDDtoEpochTime(timeStr);
+                    TEST_ASSERT(converted == expected, "%s: %s to %lld expected %lld",
+                                      TestTimeZones[tz], timeStr, (long long)converted, (long long)expected);
+                }
+            }
+        }
+    }
+    setTimeZone(TestTimeZones[3]);
+    return 0;
+}
+
+//Day daynum days after the first day shown (as the C library gives it, from the local time firstTm)
+static time_t libcDayStart(const struct tm *pFirstTm, int32_t daynum, int *pDayYYYYMMDD)
+{
+    struct tm dayTm = *pFirstTm;
+    dayTm.tm_mday += daynum;
+    dayTm.tm_hour = 0;
+    dayTm.tm_min = 0;
+    dayTm.tm_sec = 0;
+    dayTm.tm_isdst = -1;
+
+    time_t dayStart = mktime(&dayTm);
+    *pDayYYYYMMDD = tmToYYYYMMDD(&dayTm);
+    return dayStart;
+}
+
+//Timed and all day events are put in the column of the day they're on, as comparing their date
+//with each day's (as Calendar.cpp used to) does - when the clocks change and with a month shown
+int testColumns(void)
+{
+    const char *firstDays[] = { "20230324", "20231027", "20231230" };
+    uint32_t numDaysShown[] = { 3, 31 };
+    entry_t testEntries[TEST_MAX_ENTRIES];
+    char from[20];
+    char to[20];
+
+    setTimeZone(TestTimeZones[0]);
+
+    for (uint32_t f = 0; f < sizeof(firstDays)/sizeof(firstDays[0]); f++)
+    {
+        for (uint32_t n = 0; n < sizeof(numDaysShown)/sizeof(numDaysShown[0]); n++)
+        {
+            uint32_t numDays = numDaysShown[n];
+            time_t calendarStart = convertYYYYMMDDtoEpochTime(firstDays[f]) + 10 * TEST_SECS_PER_HOUR;
+            struct tm firstTm;
+            int dayInts[TEST_MAX_ENTRIES];
+            time_t dayStarts[TEST_MAX_ENTRIES];
+
+            setCalendarRange(calendarStart, numDays);
+            localtime_r(&calendarStart, &firstTm);
+
+            for (uint32_t d = 0; d < numDays; d++)
+            {
+                dayStarts[d] = libcDayStart(&firstTm, d, &dayInts[d]);
+            }
+
+            //An hour long event every half hour from 2 days before to 2 days after
+            for (time_t t = calendarStart - 2 * TEST_SECS_PER_DAY; t < calendarStart + (numDays + 2) * TEST_SECS_PER_DAY;
+                        t += TEST_SECS_PER_HOUR / 2)
+            {
+                struct tm fromTm, toTm;
+                time_t toTime = t + TEST_SECS_PER_HOUR;
+
+                gmtime_r(&t, &fromTm);
+                gmtime_r(&toTime, &toTm);
+                strftime(from, sizeof(from), "%Y%m%dT%H%M%SZ", &fromTm);
+                strftime(to, sizeof(to), "%Y%m%dT%H%M%SZ", &toTm);
+
+                localtime_r(&t, &fromTm);
+                localtime_r(&toTime, &toTm);
+                int expectedDay = -1;
+
+                for (uint32_t d = 0; d < numDays; d++)
+                {
+                    if (dayInts[d] == tmToYYYYMMDD(&fromTm))
+                    {
+                        expectedDay = d;
+                    }
+                }
+
+                char timeStr[16];
+                int8_t day;
+                time_t timeStamp = 0;
+                getTimeString(timeStr, from, to, &day, &timeStamp);
+                TEST_ASSERT(day == expectedDay, "%s: day %d expected %d", from, day, expectedDay);
+
+                if (day >= 0)
+                {
+                    char expectedTimeStr[16];
+                    strftime(expectedTimeStr, 6, "%H:%M", &fromTm);
+                    expectedTimeStr[5] = '-';
+                    strftime(expectedTimeStr + 6, 6, "%H:%M", &toTm);
+
+                    TEST_ASSERT_STRINGS_EQUAL(timeStr, expectedTimeStr);
+                    TEST_ASSERT_EQUAL(timeStamp, t);
+                }
+            }
+
+            //All day events of 1-4 days starting from 3 days before to the day after
+            for (int32_t startDay = -3; startDay <= (int32_t)numDays; startDay++)
+            {
+                for (int32_t length = 1; length <= 4; length++)
+                {
+                    int dateStartInt, dateEndInt;
+                    libcDayStart(&firstTm, startDay, &dateStartInt);
+                    libcDayStart(&firstTm, startDay + length, &dateEndInt);
+
+                    int eventIndex = 0;
+                    uint32_t relevantDays = parseAllDayEventInstance(testEntries, &eventIndex, TEST_MAX_ENTRIES,
+                                                                     dateStartInt, dateEndInt);
+                    uint32_t expectedDays = 0;
+
+                    for (uint32_t d = 0; d < numDays; d++)
+                    {
+                        if (dayInts[d] >= dateStartInt && dayInts[d] < dateEndInt)
+                        {
+                            TEST_ASSERT_EQUAL(testEntries[expectedDays].day, d);
+                            TEST_ASSERT_EQUAL(testEntries[expectedDays].timeStamp, dayStarts[d]);
+                            expectedDays++;
+                        }
+                    }
+                    TEST_ASSERT(relevantDays == expectedDays && eventIndex == (int)expectedDays,
+                                      "%d-%d: %" PRIu32 " days expected %" PRIu32, dateStartInt, dateEndInt, relevantDays, expectedDays);
+                }
+            }
+        }
+    }
+    setTimeZone(TestTimeZones[3]);
+    return 0;
+}
+
+int testBadTimes(void)
+{
+    TEST_ASSERT_EQUAL(convertYYYYMMDDTHHMMSSZtoEpochTime("20231027"), -1);
+    TEST_ASSERT_EQUAL(convertYYYYMMDDTHHMMSSZtoEpochTime("20231327T101010Z"), -1);
+    TEST_ASSERT_EQUAL(convertYYYYMMDDTHHMMSSZtoEpochTime(""), -1);
+    TEST_ASSERT_EQUAL(convertYYYYMMDDtoEpochTime("2023-10-27"), -1);
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testCivilDays();
+
+    if(rc == 0)
+        rc = testUtcTimes();
+
+    if(rc == 0)
+        rc = testLocalTimes();
+
+    if(rc == 0)
+        rc = testColumns();
+
+    if(rc == 0)
+        rc = testBadTimes();
+
+    return rc;
+}
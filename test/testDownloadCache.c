@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "utils/test_utils.h"
+#include "DownloadCache.h"
+#include "HttpResponse.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+
+#define TEST_WINDOW_BYTES (16 * 1024)
+#define TEST_MAXBYTES_VALIDATOR 72
+#define TEST_URL       "https://calendar.example.com/calendar/basic.ics"
+#define TEST_OTHER_URL "https://calendar.example.com/calendar/other.ics"
+
+//Receives a captured (chunked) response, as getData would, saving the calendar to saveFile
+static int32_t receiveCaptured(const char *responseFile, FILE *saveFile)
+{
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char *window = (char *)malloc(TEST_WINDOW_BYTES);
+    ByteSourceFile_t file;
+    ByteSource_t source;
+    HttpResponseInfo_t info;
+    HttpBodyStats_t stats;
+    HttpBodyConfig_t config = {};
+
+    config.parser             = parsePartialDataForEvents;
+    config.parsingContext     = &calParsingContext;
+    config.window             = window;
+    config.windowSize         = TEST_WINDOW_BYTES;
+    config.firstByteTimeoutMs = 5000;
+    config.stallTimeoutMs     = 5000;
+    config.url                = "test";
+    config.saveFile           = saveFile;
+
+    TEST_ASSERT(byteSourceFile_open(&file, responseFile, &source), "open failed%s", "");
+    int32_t rc = httpResponse_readHeaders(&source, 5000, &info);
+
+    if (rc == INKY_HTTPRESP_RC_OK)
+    {
+        rc = httpResponse_receiveBody(&source, &info, &config, &stats);
+    }
+    byteSourceFile_close(&file);
+    finishCalendarParsing(&calParsingContext);
+    free(window);
+    return rc;
+}
+
+static int32_t parseSaved(const char *url)
+{
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+
+    int32_t rc = downloadCache_parse(url, parsePartialDataForEvents, &calParsingContext, TEST_WINDOW_BYTES, NULL);
+
+    finishCalendarParsing(&calParsingContext);
+    return rc;
+}
+
+//Finds a file in basePath ending with suffix
+static bool findFile(const char *basePath, const char *suffix, char *path, size_t pathSize)
+{
+    DIR *dir = opendir(basePath);
+    struct dirent *pEntry;
+    size_t suffixLen = strlen(suffix);
+    bool found = false;
+
+    while (!found && (pEntry = readdir(dir)) != NULL)
+    {
+        size_t nameLen = strlen(pEntry->d_name);
+
+        if (nameLen > suffixLen && strcmp(pEntry->d_name + nameLen - suffixLen, suffix) == 0)
+        {
+            snprintf(path, pathSize, "%s/%s", basePath, pEntry->d_name);
+            found = true;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+int testSaveAndParse(const char *basePath)
+{
+    char etag[TEST_MAXBYTES_VALIDATOR];
+    char lastModified[TEST_MAXBYTES_VALIDATOR];
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    //Nothing saved yet
+    TEST_ASSERT(!downloadCache_getValidators(TEST_URL, etag, sizeof(etag), lastModified, sizeof(lastModified)),
+                      "found validators%s", "");
+    TEST_ASSERT_STRINGS_EQUAL(etag, "");
+    TEST_ASSERT_EQUAL(parseSaved(TEST_URL), INKY_DOWNLOADCACHE_RC_NOTSAVED);
+
+    FILE *saveFile = downloadCache_startSave(TEST_URL);
+    TEST_ASSERT(saveFile != NULL, "startSave failed%s", "");
+    TEST_ASSERT_EQUAL(receiveCaptured("resources/response_chunked", saveFile), INKY_HTTPRESP_RC_OK);
+    downloadCache_finishSave(TEST_URL, saveFile, true, "\"etag-1\"", "Sun, 06 Nov 2022 08:49:37 GMT");
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 1);
+    test_utils_resetCalendar();
+
+    TEST_ASSERT(downloadCache_getValidators(TEST_URL, etag, sizeof(etag), lastModified, sizeof(lastModified)),
+                      "no validators%s", "");
+    TEST_ASSERT_STRINGS_EQUAL(etag, "\"etag-1\"");
+    TEST_ASSERT_STRINGS_EQUAL(lastModified, "Sun, 06 Nov 2022 08:49:37 GMT");
+
+    //The saved copy is the calendar itself (dechunked)
+    char savedPath[300];
+    TEST_ASSERT(findFile(basePath, ".ics", savedPath, sizeof(savedPath)), "no saved file%s", "");
+    size_t savedLen = 0;
+    char *saved = test_utils_fileToBuffer(savedPath, &savedLen);
+    TEST_ASSERT(strncmp(saved, "BEGIN:VEVENT", 12) == 0, "saved copy starts: %.20s", saved);
+    TEST_ASSERT(strstr(saved, "\r\n0\r\n") == NULL, "saved copy is still chunked%s", "");
+    free(saved);
+
+    //Parsing it finds the same events
+    TEST_ASSERT_EQUAL(parseSaved(TEST_URL), INKY_HTTPRESP_RC_OK);
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 1);
+    TEST_ASSERT_STRINGS_EQUAL(entries[0].name, "Tickets available for Worthy Players panto?");
+    test_utils_resetCalendar();
+
+    //...and only for that url
+    TEST_ASSERT_EQUAL(parseSaved(TEST_OTHER_URL), INKY_DOWNLOADCACHE_RC_NOTSAVED);
+
+    //The stats are set even when we don't get as far as reading it (here: no memory for the window)
+    HttpBodyStats_t stats;
+    memset(&stats, 0xff, sizeof(stats));
+    int32_t rc = downloadCache_parse(TEST_URL, parsePartialDataForEvents, NULL, SIZE_MAX / 2, &stats);
+    TEST_ASSERT_EQUAL(rc, INKY_HTTPRESP_RC_NOMEM);
+    TEST_ASSERT(stats.totalRaw == 0 && stats.receiveMillis == 0 && !stats.complete,
+                      "stats not cleared: %" PRIu64 " bytes", stats.totalRaw);
+    memset(&stats, 0xff, sizeof(stats));
+    TEST_ASSERT_EQUAL(downloadCache_parse(TEST_OTHER_URL, parsePartialDataForEvents, NULL, TEST_WINDOW_BYTES, &stats),
+                      INKY_DOWNLOADCACHE_RC_NOTSAVED);
+    TEST_ASSERT(stats.totalRaw == 0, "stats not cleared: %" PRIu64 " bytes", stats.totalRaw);
+
+    //A failed download leaves the saved copy alone
+    saveFile = downloadCache_startSave(TEST_URL);
+    TEST_ASSERT(saveFile != NULL, "startSave failed%s", "");
+    fputs("BEGIN:VCALENDAR\r\nBEGIN:VEV", saveFile);
+    downloadCache_finishSave(TEST_URL, saveFile, false, "\"etag-2\"", "");
+
+    TEST_ASSERT(downloadCache_getValidators(TEST_URL, etag, sizeof(etag), lastModified, sizeof(lastModified)),
+                      "no validators%s", "");
+    TEST_ASSERT_STRINGS_EQUAL(etag, "\"etag-1\"");
+    TEST_ASSERT_EQUAL(parseSaved(TEST_URL), INKY_HTTPRESP_RC_OK);
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 1);
+    test_utils_resetCalendar();
+    return 0;
+}
+
+//A download that stops before the end of its body (as getData returns NETWORK_RC_INCOMPLETE for)
+//leaves the saved copy and its validators exactly as they were
+int testIncompleteReceive(const char *basePath)
+{
+    char dataPath[300];
+    char metaPath[300];
+    char truncatedPath[300];
+    size_t dataLen = 0;
+    size_t responseLen = 0;
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    //Saved by testSaveAndParse
+    TEST_ASSERT(findFile(basePath, ".ics", dataPath, sizeof(dataPath)), "no saved file%s", "");
+    TEST_ASSERT(findFile(basePath, ".val", metaPath, sizeof(metaPath)), "no metadata file%s", "");
+    char *dataBefore = test_utils_fileToBuffer(dataPath, &dataLen);
+    char *metaBefore = test_utils_fileToString(metaPath);
+
+    //The captured response without the end of its chunked encoding
+    char *response = test_utils_fileToBuffer("resources/response_chunked", &responseLen);
+    snprintf(truncatedPath, sizeof(truncatedPath), "%s/truncated.http", basePath);
+    FILE *truncated = fopen(truncatedPath, "wb");
+    TEST_ASSERT(truncated != NULL, "couldn't create %s", truncatedPath);
+    fwrite(response, 1, responseLen - 10, truncated);
+    fclose(truncated);
+    free(response);
+
+    FILE *saveFile = downloadCache_startSave(TEST_URL);
+    TEST_ASSERT(saveFile != NULL, "startSave failed%s", "");
+    int32_t rc = receiveCaptured(truncatedPath, saveFile);
+    downloadCache_finishSave(TEST_URL, saveFile, (rc == INKY_HTTPRESP_RC_OK), "\"etag-2\"", "");
+    remove(truncatedPath);
+    test_utils_resetCalendar();
+
+    TEST_ASSERT_EQUAL(rc, INKY_HTTPRESP_RC_INCOMPLETE);
+
+    size_t dataAfterLen = 0;
+    char *dataAfter = test_utils_fileToBuffer(dataPath, &dataAfterLen);
+    char *metaAfter = test_utils_fileToString(metaPath);
+    TEST_ASSERT(dataAfterLen == dataLen && memcmp(dataAfter, dataBefore, dataLen) == 0,
+                      "saved copy changed (%zu bytes, was %zu)", dataAfterLen, dataLen);
+    TEST_ASSERT(strcmp(metaAfter, metaBefore) == 0, "metadata changed: %s", metaAfter);
+    free(metaAfter);
+    free(dataAfter);
+    free(metaBefore);
+    free(dataBefore);
+
+    TEST_ASSERT_EQUAL(parseSaved(TEST_URL), INKY_HTTPRESP_RC_OK);
+    TEST_ASSERT_EQUAL(getRelevantEventCount(), 1);
+    test_utils_resetCalendar();
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+    char basePath[] = "/tmp/testDownloadCacheXXXXXX";
+
+    TEST_ASSERT(mkdtemp(basePath) != NULL, "mkdtemp failed%s", "");
+    TEST_ASSERT(downloadCache_begin(basePath), "begin failed%s", "");
+
+    if(rc == 0)
+        rc = testSaveAndParse(basePath);
+
+    if(rc == 0)
+        rc = testIncompleteReceive(basePath);
+
+    //Leave nothing behind
+    char path[300];
+
+    while (findFile(basePath, ".ics", path, sizeof(path)) || findFile(basePath, ".val", path, sizeof(path)))
+    {
+        remove(path);
+    }
+    rmdir(basePath);
+
+    return rc;
+}
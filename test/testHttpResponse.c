@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "utils/test_utils.h"
+#include "utils/test_utils_replay.h"
+#include "HttpResponse.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+
+#define TEST_WINDOW_BYTES (16 * 1024)
+
+//Reads the headers and body from pSource and parses the calendar
+static int32_t receiveCalendarWithTimeouts(ByteSource_t *pSource, bool threaded,
+                                           uint32_t firstByteTimeoutMs, uint32_t stallTimeoutMs,
+                                           HttpResponseInfo_t *pInfo, HttpBodyStats_t *pStats)
+{
+    Calendar_t testCal = {};
+    CalendarParsingContext_t calParsingContext = { &testCal };
+    char *window = (char *)malloc(TEST_WINDOW_BYTES);
+    HttpBodyConfig_t config = {};
+
+    config.parser             = parsePartialDataForEvents;
+    config.parsingContext     = &calParsingContext;
+    config.window             = window;
+    config.windowSize         = TEST_WINDOW_BYTES;
+    config.threaded           = threaded;
+    config.firstByteTimeoutMs = firstByteTimeoutMs;
+    config.stallTimeoutMs     = stallTimeoutMs;
+    config.url                = "test";
+
+    int32_t rc = httpResponse_readHeaders(pSource, 5000, pInfo);
+
+    if (rc == INKY_HTTPRESP_RC_OK)
+    {
+        rc = httpResponse_receiveBody(pSource, pInfo, &config, pStats);
+    }
+    finishCalendarParsing(&calParsingContext);
+    free(window);
+    return rc;
+}
+
+static int32_t receiveCalendar(ByteSource_t *pSource, bool threaded, HttpResponseInfo_t *pInfo, HttpBodyStats_t *pStats)
+{
+    return receiveCalendarWithTimeouts(pSource, threaded, 5000, 5000, pInfo, pStats);
+}
+
+//A response (headers and body) as captured with openssl s_client, read from a file
+int testCapturedFile(void)
+{
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    for (uint32_t threaded = 0; threaded < 2; threaded++)
+    {
+        ByteSourceFile_t file;
+        ByteSource_t source;
+        HttpResponseInfo_t info;
+        HttpBodyStats_t stats;
+
+        TEST_ASSERT(byteSourceFile_open(&file, "resources/response_chunked", &source), "open failed%s", "");
+        int32_t rc = receiveCalendar(&source, threaded, &info, &stats);
+        byteSourceFile_close(&file);
+
+        TEST_ASSERT_EQUAL(rc, INKY_HTTPRESP_RC_OK);
+        TEST_ASSERT_EQUAL(info.status, 200);
+        TEST_ASSERT(info.chunked && !info.gzipped, "chunked %d gzipped %d", info.chunked, info.gzipped);
+        TEST_ASSERT(stats.complete, "body not read to the end%s", "");
+        TEST_ASSERT(stats.chunks == 4, "read %" PRIu64 " chunks", stats.chunks);
+        TEST_ASSERT_EQUAL(getRelevantEventCount(), 1);
+        TEST_ASSERT_STRINGS_EQUAL(entries[0].name, "Tickets available for Worthy Players panto?");
+        test_utils_resetCalendar();
+    }
+    return 0;
+}
+
+int testBadHeaders(void)
+{
+    const char *badResponses[] = {
+        "",
+        "<html>Not http</html>\r\n\r\n",
+        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n",  //Ends in the headers
+    };
+
+    for (uint32_t i = 0; i < sizeof(badResponses)/sizeof(badResponses[0]); i++)
+    {
+        test_utils_replayServer_t server = { badResponses[i], strlen(badResponses[i]), 3, 0 };
+        test_utils_socketSource_t socket = {};
+        ByteSource_t source;
+        HttpResponseInfo_t info;
+
+        test_utils_replayServer_start(&server);
+        test_utils_replayServer_request(&server, &socket, &source);
+        int32_t rc = httpResponse_readHeaders(&source, 5000, &info);
+        test_utils_replayServer_stop(&server);
+        test_utils_socketSource_close(&socket);
+
+        TEST_ASSERT(rc == INKY_HTTPRESP_RC_BADHEADERS, "response %" PRIu32 " rc %d", i, rc);
+    }
+    return 0;
+}
+
+//Calendar served (in each encoding getData handles) by the replay server in small pieces
+int testReplayedEncodings(void)
+{
+    uint32_t numRelevant = 30;
+    uint32_t numOther = 3000;
+    size_t calLen = 0;
+    char *cal = test_utils_buildCalendar(numRelevant, numOther, &calLen);
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(cal, calLen, &gzippedLen);
+    size_t chunkedLen = 0;
+    char *chunked = test_utils_chunk(cal, calLen, 4000, &chunkedLen);
+    size_t chunkedGzippedLen = 0;
+    char *chunkedGzipped = test_utils_chunk(gzipped, gzippedLen, 1000, &chunkedGzippedLen);
+    char lengthHeader[80];
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    struct {
+        const char *headers;
+        const char *body;
+        size_t bodyLen;
+        bool closeEndsBody;  //No length was sent
+    } responses[] = {
+        { "Transfer-Encoding: chunked\r\nETag: \"v2\"\r\n", chunked, chunkedLen, false },
+        { "Transfer-Encoding: chunked\r\nContent-Encoding: gzip\r\nETag: \"v2\"\r\n", chunkedGzipped, chunkedGzippedLen, false },
+        { lengthHeader, gzipped, gzippedLen, false },
+        { "Connection: close\r\nETag: \"v2\"\r\n", cal, calLen, true },
+    };
+    snprintf(lengthHeader, sizeof(lengthHeader), "Content-Encoding: gzip\r\nContent-Length: %zu\r\nETag: \"v2\"\r\n", gzippedLen);
+
+    for (uint32_t i = 0; i < sizeof(responses)/sizeof(responses[0]); i++)
+    {
+        size_t responseLen = 0;
+        char *response = test_utils_buildResponse(responses[i].headers, responses[i].body, responses[i].bodyLen, &responseLen);
+
+        for (uint32_t threaded = 0; threaded < 2; threaded++)
+        {
+            test_utils_replayServer_t server = { response, responseLen, 1460, (uint32_t)(threaded ? 0 : 50) };
+            test_utils_socketSource_t socket = { 0, 1000 };
+            ByteSource_t source;
+            HttpResponseInfo_t info;
+            HttpBodyStats_t stats;
+            char etag[INKY_HTTPRESP_MAXBYTES_ETAG] = "\"v1\"";
+            char lastModified[INKY_HTTPRESP_MAXBYTES_LASTMODIFIED] = "";
+
+            test_utils_replayServer_start(&server);
+            test_utils_replayServer_request(&server, &socket, &source);
+            int32_t rc = receiveCalendar(&source, threaded, &info, &stats);
+            test_utils_replayServer_stop(&server);
+            test_utils_socketSource_close(&socket);
+
+            TEST_ASSERT(rc == INKY_HTTPRESP_RC_OK, "response %" PRIu32 " rc %d", i, rc);
+            bool gotValidators = httpResponse_getValidators(&info, rc, etag, lastModified);
+            TEST_ASSERT(gotValidators, "response %" PRIu32 " validators not returned", i);
+            TEST_ASSERT_STRINGS_EQUAL(etag, "\"v2\"");
+            TEST_ASSERT(server.sawRequest, "server didn't see request%s", "");
+            TEST_ASSERT(stats.totalRaw == responses[i].bodyLen, "response %" PRIu32 ": read %" PRIu64 " bytes of body",
+                                 i, stats.totalRaw);
+            TEST_ASSERT(stats.totalDecoded == calLen, "response %" PRIu32 ": decoded %" PRIu64 " bytes", i, stats.totalDecoded);
+            TEST_ASSERT(stats.complete != responses[i].closeEndsBody, "response %" PRIu32 " complete %d", i, stats.complete);
+            TEST_ASSERT_EQUAL(getRelevantEventCount(), numRelevant);
+            TEST_ASSERT_EQUAL(getTotalEventCount(), numRelevant + numOther);
+            test_utils_resetCalendar();
+        }
+        free(response);
+    }
+
+    free(chunkedGzipped);
+    free(chunked);
+    free(gzipped);
+    free(cal);
+    return 0;
+}
+
+//Connection closes (or the server stops sending) part way through a body that said how long it
+//was: it's an error and the response's validators mustn't be used for what we did get
+int testIncompleteBodies(void)
+{
+    size_t calLen = 0;
+    char *cal = test_utils_buildCalendar(5, 2000, &calLen);
+    size_t gzippedLen = 0;
+    char *gzipped = test_utils_gzip(cal, calLen, &gzippedLen);
+    size_t chunkedLen = 0;
+    char *chunked = test_utils_chunk(cal, calLen, 4000, &chunkedLen);
+    size_t chunkedGzippedLen = 0;
+    char *chunkedGzipped = test_utils_chunk(gzipped, gzippedLen, 1000, &chunkedGzippedLen);
+    const char *chunkedHeaders = "Transfer-Encoding: chunked\r\nETag: \"v2\"\r\n";
+    const char *chunkedGzipHeaders = "Transfer-Encoding: chunked\r\nContent-Encoding: gzip\r\nETag: \"v2\"\r\n";
+    char lengthHeader[80];
+    char gzipLengthHeader[80];
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+    snprintf(lengthHeader, sizeof(lengthHeader), "Content-Length: %zu\r\nETag: \"v2\"\r\n", calLen);
+    snprintf(gzipLengthHeader, sizeof(gzipLengthHeader),
+             "Content-Encoding: gzip\r\nContent-Length: %zu\r\nETag: \"v2\"\r\n", gzippedLen);
+
+    struct {
+        const char *headers;
+        const char *body;
+        size_t bodyLen;
+        size_t sentLen;       //Bytes of body sent before the connection closes...
+        bool stall;           //...or the server stops sending for longer than the stall timeout
+        int32_t expectedRc;
+    } responses[] = {
+        { chunkedHeaders, chunked, chunkedLen, chunkedLen / 2, false, INKY_HTTPRESP_RC_INCOMPLETE },
+        { chunkedHeaders, chunked, chunkedLen, chunkedLen - 5, false, INKY_HTTPRESP_RC_INCOMPLETE }, //Just the last chunk missing
+        { chunkedGzipHeaders, chunkedGzipped, chunkedGzippedLen, chunkedGzippedLen / 2, false, INKY_HTTPRESP_RC_INCOMPLETE },
+        { lengthHeader, cal, calLen, calLen / 2, false, INKY_HTTPRESP_RC_INCOMPLETE },
+        { gzipLengthHeader, gzipped, gzippedLen, gzippedLen / 2, false, INKY_HTTPRESP_RC_INCOMPLETE },
+        { chunkedHeaders, chunked, chunkedLen, chunkedLen / 2, true, INKY_HTTPRESP_RC_TIMEDOUT },
+    };
+
+    for (uint32_t i = 0; i < sizeof(responses)/sizeof(responses[0]); i++)
+    {
+        size_t responseLen = 0;
+        char *response = test_utils_buildResponse(responses[i].headers, responses[i].body,
+                                                  responses[i].stall ? responses[i].bodyLen : responses[i].sentLen,
+                                                  &responseLen);
+        size_t headersLen = (strstr(response, "\r\n\r\n") + 4) - response;
+
+        for (uint32_t threaded = 0; threaded < 2; threaded++)
+        {
+            test_utils_replayServer_t server = { response, responseLen, 1460, 0, 0, 0 };
+            test_utils_socketSource_t socket = {};
+            ByteSource_t source;
+            HttpResponseInfo_t info;
+            HttpBodyStats_t stats;
+            char etag[INKY_HTTPRESP_MAXBYTES_ETAG] = "\"v1\"";
+            char lastModified[INKY_HTTPRESP_MAXBYTES_LASTMODIFIED] = "Mon, 07 Nov 2022 10:00:00 GMT";
+
+            if (responses[i].stall)
+            {
+                server.stallAfter  = headersLen + responses[i].sentLen;
+                server.stallMicros = 400 * 1000;
+            }
+            test_utils_replayServer_start(&server);
+            test_utils_replayServer_request(&server, &socket, &source);
+            int32_t rc = receiveCalendarWithTimeouts(&source, threaded, 5000, 100, &info, &stats);
+            test_utils_replayServer_stop(&server);
+            test_utils_socketSource_close(&socket);
+
+            TEST_ASSERT(rc == responses[i].expectedRc, "response %" PRIu32 " rc %d", i, rc);
+            TEST_ASSERT(!stats.complete, "response %" PRIu32 " complete", i);
+            TEST_ASSERT_STRINGS_EQUAL(info.etag, "\"v2\"");
+            bool gotValidators = httpResponse_getValidators(&info, rc, etag, lastModified);
+            TEST_ASSERT(!gotValidators, "response %" PRIu32 " validators returned", i);
+            TEST_ASSERT_STRINGS_EQUAL(etag, "\"v1\"");
+            TEST_ASSERT_STRINGS_EQUAL(lastModified, "Mon, 07 Nov 2022 10:00:00 GMT");
+            test_utils_resetCalendar();
+        }
+        free(response);
+    }
+
+    free(chunkedGzipped);
+    free(chunked);
+    free(gzipped);
+    free(cal);
+    return 0;
+}
+
+//Server pauses part way through the response: we wait for it (recording the stall) unless
+//the pause is longer than the timeout
+int testTimeouts(void)
+{
+    size_t calLen = 0;
+    char *cal = test_utils_buildCalendar(5, 200, &calLen);
+    char lengthHeader[50];
+    snprintf(lengthHeader, sizeof(lengthHeader), "Content-Length: %zu\r\n", calLen);
+    size_t responseLen = 0;
+    char *response = test_utils_buildResponse(lengthHeader, cal, calLen, &responseLen);
+    size_t headersLen = (strstr(response, "\r\n\r\n") + 4) - response;
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    struct {
+        size_t stallAfter;
+        uint32_t firstByteTimeoutMs;
+        uint32_t stallTimeoutMs;
+        bool expectTimeout;
+    } cases[] = {
+        { headersLen + calLen / 2, 5000, 2000, false }, //Waits through the stall
+        { headersLen + calLen / 2, 5000,  100, true },  //Gives up on the stall
+        { headersLen,               100, 5000, true },  //Body never starts
+        { headersLen,              2000,  100, false }, //Slow to start but then flows
+    };
+
+    for (uint32_t i = 0; i < sizeof(cases)/sizeof(cases[0]); i++)
+    {
+        for (uint32_t threaded = 0; threaded < 2; threaded++)
+        {
+            test_utils_replayServer_t server = { response, responseLen, 1460, 0, cases[i].stallAfter, 400 * 1000 };
+            test_utils_socketSource_t socket = {};
+            ByteSource_t source;
+            HttpResponseInfo_t info;
+            HttpBodyStats_t stats;
+
+            test_utils_replayServer_start(&server);
+            test_utils_replayServer_request(&server, &socket, &source);
+            int32_t rc = receiveCalendarWithTimeouts(&source, threaded, cases[i].firstByteTimeoutMs,
+                                                     cases[i].stallTimeoutMs, &info, &stats);
+            test_utils_replayServer_stop(&server);
+            test_utils_socketSource_close(&socket);
+
+            int32_t expectedRc = cases[i].expectTimeout ? INKY_HTTPRESP_RC_TIMEDOUT : INKY_HTTPRESP_RC_OK;
+
+            TEST_ASSERT(rc == expectedRc, "case %" PRIu32 " rc %d", i, rc);
+            TEST_ASSERT(stats.timedOut == cases[i].expectTimeout, "case %" PRIu32 " timedOut %d", i, stats.timedOut);
+            TEST_ASSERT(stats.complete != cases[i].expectTimeout, "case %" PRIu32 " complete %d", i, stats.complete);
+
+            if (cases[i].expectTimeout)
+            {
+                TEST_ASSERT(stats.totalRaw < calLen, "case %" PRIu32 ": read %" PRIu64 " bytes", i, stats.totalRaw);
+            }
+            else if (cases[i].stallAfter > headersLen)
+            {
+                TEST_ASSERT(stats.longestStallMillis >= 300 && stats.stalls >= 1,
+                            "case %" PRIu32 ": longest stall %" PRIu64 " ms, %" PRIu64 " stalls",
+                            i, stats.longestStallMillis, stats.stalls);
+            }
+            else
+            {
+                TEST_ASSERT(stats.firstByteMillis >= 300 && stats.longestStallMillis < 300,
+                            "case %" PRIu32 ": first byte %" PRIu64 " ms, longest stall %" PRIu64 " ms",
+                            i, stats.firstByteMillis, stats.longestStallMillis);
+            }
+            test_utils_resetCalendar();
+        }
+    }
+
+    free(response);
+    free(cal);
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testCapturedFile();
+
+    if(rc == 0)
+        rc = testBadHeaders();
+
+    if(rc == 0)
+        rc = testReplayedEncodings();
+
+    if(rc == 0)
+        rc = testIncompleteBodies();
+
+    if(rc == 0)
+        rc = testTimeouts();
+
+    return rc;
+}
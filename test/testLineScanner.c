@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "utils/test_utils.h"
+#include "LineScanner.h"
+
+#define TEST_BUF_BYTES 256
+
+typedef const char *scanFn_t(const char *src);
+
+static const char *naiveFindSpecial(const char *src)
+{
+    while (*src != '\0' && *src != '\n' && *src != '\r' && *src != '\\')
+    {
+        src++;
+    }
+    return src;
+}
+
+static const char *naiveFindLineEnd(const char *src)
+{
+    while (*src != '\0' && *src != '\n')
+    {
+        src++;
+    }
+    return src;
+}
+
+//Checks scan against naive from every start offset (so every alignment) in str
+static int checkAllOffsets(const char *desc, scanFn_t *scan, scanFn_t *naive, const char *str)
+{
+    size_t len = strlen(str);
+
+    for (size_t start = 0; start <= len; start++)
+    {
+        const char *expected = naive(str + start);
+        const char *found    = scan(str + start);
+
+        TEST_ASSERT(found == expected, "%s: from offset %zu found offset %td expected %td",
+                          desc, start, found - str, expected - str);
+    }
+    return 0;
+}
+
+//One interesting char at every position in strings of every length, at every alignment
+int testSingleSpecial(void)
+{
+    const char specials[] = { '\n', '\r', '\\', 'X' }; //X - just the terminator
+    char *buf = (char *)malloc(TEST_BUF_BYTES + 16);
+
+    for (size_t align = 0; align < 16; align++)
+    {
+        char *str = buf + align;
+
+        for (size_t len = 1; len < 40; len++)
+        {
+            for (size_t pos = 0; pos < len; pos++)
+            {
+                for (size_t s = 0; s < sizeof(specials); s++)
+                {
+                    memset(str, 'a', len);
+                    str[len] = '\0';
+                    if (specials[s] != 'X')
+                    {
+                        str[pos] = specials[s];
+                    }
+                    int rc = checkAllOffsets("findSpecial", lineScanner_findSpecial, naiveFindSpecial, str);
+                    if (rc == 0) rc = checkAllOffsets("findSpecialSwar", lineScanner_findSpecialSwar, naiveFindSpecial, str);
+                    if (rc == 0) rc = checkAllOffsets("findLineEnd", lineScanner_findLineEnd, naiveFindLineEnd, str);
+                    if (rc != 0) return rc;
+                }
+            }
+        }
+    }
+    free(buf);
+    return 0;
+}
+
+//Bytes either side of the ones we look for (and top bit set bytes, as in UTF-8) don't match
+int testNearMisses(void)
+{
+    char str[TEST_BUF_BYTES];
+    size_t len = 0;
+
+    for (int c = 1; c < 256; c++)
+    {
+        if (c != '\n' && c != '\r' && c != '\\')
+        {
+            str[len++] = (char)c;
+        }
+    }
+    str[len] = '\0';
+
+    TEST_ASSERT(lineScanner_findSpecial(str) == str + len, "found %td", lineScanner_findSpecial(str) - str);
+    TEST_ASSERT(lineScanner_findSpecialSwar(str) == str + len, "found %td", lineScanner_findSpecialSwar(str) - str);
+
+    str[len - 3] = '\\';
+    TEST_ASSERT(lineScanner_findSpecialSwar(str) == str + len - 3, "found %td", lineScanner_findSpecialSwar(str) - str);
+    return 0;
+}
+
+int testRandomText(void)
+{
+    const char alphabet[] = "BEGIN:VEVENT\r\nDESCRIPTION:a\\nb\\,c\xc3\xa9\x80\xff ";
+    char str[TEST_BUF_BYTES];
+
+    srand(1);
+    for (uint32_t i = 0; i < 2000; i++)
+    {
+        size_t len = rand() % (TEST_BUF_BYTES - 1);
+
+        for (size_t j = 0; j < len; j++)
+        {
+            str[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        str[len] = '\0';
+
+        int rc = checkAllOffsets("findSpecial", lineScanner_findSpecial, naiveFindSpecial, str);
+        if (rc == 0) rc = checkAllOffsets("findSpecialSwar", lineScanner_findSpecialSwar, naiveFindSpecial, str);
+        if (rc == 0) rc = checkAllOffsets("findLineEnd", lineScanner_findLineEnd, naiveFindLineEnd, str);
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testSingleSpecial();
+
+    if(rc == 0)
+        rc = testNearMisses();
+
+    if(rc == 0)
+        rc = testRandomText();
+
+    return rc;
+}
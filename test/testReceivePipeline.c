@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "utils/test_utils.h"
+#include "ReceivePipeline.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//In Calendar.cpp but not exposed in the header:
+time_t convertYYYYMMDDtoEpochTime(const char *dayYYYYMMDD);
+
+//Produces data from memory in random sized pieces (like data arriving from the network)
+typedef struct {
+    const char *data;
+    size_t dataLen;
+    size_t pos;
+    size_t maxPiece;
+    int32_t failAt;      //If <0 return this rc...
+    size_t failAfter;    //...once we've produced this many bytes
+    uint32_t calls;
+} memoryProducer_t;
+
+static int32_t produceFromMemory(char *block, size_t blockSize, size_t *pLen, void *producerContext)
+{
+    memoryProducer_t *pProducer = (memoryProducer_t *)producerContext;
+    size_t len = 1 + (rand() % pProducer->maxPiece);
+
+    pProducer->calls++;
+
+    if (len > blockSize)
+    {
+        len = blockSize;
+    }
+    if (len > pProducer->dataLen - pProducer->pos)
+    {
+        len = pProducer->dataLen - pProducer->pos;
+    }
+    memcpy(block, pProducer->data + pProducer->pos, len);
+    pProducer->pos += len;
+    *pLen = len;
+
+    if (pProducer->failAt < 0 && pProducer->pos >= pProducer->failAfter)
+    {
+        return pProducer->failAt;
+    }
+    return (pProducer->pos == pProducer->dataLen) ? INKY_PIPELINE_RC_COMPLETE : INKY_PIPELINE_RC_OK;
+}
+
+//Parses with parsePartialDataForEvents but fails after a number of calls
+typedef struct {
+    CalendarParsingContext_t calParsingContext;
+    uint32_t callsBeforeFailing;
+} failingParser_t;
+
+static char *parseThenFail(char *data, void *context)
+{
+    failingParser_t *pParser = (failingParser_t *)context;
+
+    if (pParser->callsBeforeFailing == 0)
+    {
+        return NULL;
+    }
+    pParser->callsBeforeFailing--;
+    return parsePartialDataForEvents(data, &(pParser->calParsingContext));
+}
+
+static void initConfig(ReceivePipelineConfig_t *pConfig, memoryProducer_t *pProducer, void *parsingContext,
+                       char *window, size_t windowSize, bool threaded)
+{
+    memset(pConfig, 0, sizeof(ReceivePipelineConfig_t));
+    pConfig->producer        = produceFromMemory;
+    pConfig->producerContext = pProducer;
+    pConfig->parser          = parsePartialDataForEvents;
+    pConfig->parsingContext  = parsingContext;
+    pConfig->window          = window;
+    pConfig->windowSize      = windowSize;
+    pConfig->blockSize       = 1024;
+    pConfig->numBlocks       = 4;
+    pConfig->minParseBytes   = 3000;
+    pConfig->threaded        = threaded;
+}
+
+int testParseCalendar(void)
+{
+    uint32_t numRelevant = 40;
+    uint32_t numOther = 3000;
+    size_t calLen = 0;
+    char *cal = test_utils_buildCalendar(numRelevant, numOther, &calLen);
+
+    size_t windowSize = 8 * 1024;
+    char *window = (char *)malloc(windowSize);
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+    srand(5678);
+
+    for (uint32_t threaded = 0; threaded < 2; threaded++)
+    {
+        for (uint32_t i = 0; i < 10; i++)
+        {
+            Calendar_t testCal = {};
+            CalendarParsingContext_t calParsingContext = { &testCal };
+            memoryProducer_t producer = { cal, calLen, 0, (size_t)((i % 2 == 0) ? 50 : 5000), 0, 0, 0 };
+            ReceivePipelineConfig_t config;
+            ReceivePipelineStats_t stats;
+
+            initConfig(&config, &producer, &calParsingContext, window, windowSize, threaded);
+            int32_t rc = receivePipeline_run(&config, &stats);
+
+            TEST_ASSERT_EQUAL(rc, INKY_PIPELINE_RC_OK);
+            TEST_ASSERT(stats.totalProduced == calLen, "produced %" PRIu64 " bytes, expected %zu", stats.totalProduced, calLen);
+            TEST_ASSERT(stats.blocks == producer.calls, "consumed %" PRIu64 " blocks, produced %" PRIu32, stats.blocks, producer.calls);
+            TEST_ASSERT(stats.totalMoved > 0, "window of %zu bytes never compacted", windowSize);
+            TEST_ASSERT_EQUAL(getRelevantEventCount(), numRelevant);
+            TEST_ASSERT_EQUAL(getTotalEventCount(), numRelevant + numOther);
+            TEST_ASSERT_STRINGS_EQUAL(entries[0].name, "Tickets available for Worthy Players panto?");
+            finishCalendarParsing(&calParsingContext);
+            test_utils_resetCalendar();
+        }
+    }
+
+    free(window);
+    free(cal);
+    return 0;
+}
+
+int testFailures(void)
+{
+    size_t calLen = 0;
+    char *cal = test_utils_buildCalendar(10, 1000, &calLen);
+
+    size_t windowSize = 8 * 1024;
+    char *window = (char *)malloc(windowSize);
+
+    setCalendarRange(convertYYYYMMDDtoEpochTime("20221106"), 3);
+
+    for (uint32_t threaded = 0; threaded < 2; threaded++)
+    {
+        Calendar_t testCal = {};
+        ReceivePipelineConfig_t config;
+        ReceivePipelineStats_t stats;
+
+        //Producer fails part way through
+        {
+            CalendarParsingContext_t calParsingContext = { &testCal };
+            memoryProducer_t producer = { cal, calLen, 0, 500, -42, calLen / 2, 0 };
+
+            initConfig(&config, &producer, &calParsingContext, window, windowSize, threaded);
+            int32_t rc = receivePipeline_run(&config, &stats);
+
+            TEST_ASSERT_EQUAL(rc, INKY_PIPELINE_RC_PRODUCERFAIL);
+            TEST_ASSERT_EQUAL(stats.producerRc, -42);
+            finishCalendarParsing(&calParsingContext);
+            test_utils_resetCalendar();
+        }
+
+        //Parser fails: the producer should stop soon after
+        {
+            failingParser_t parser = { { &testCal }, 2 };
+            memoryProducer_t producer = { cal, calLen, 0, 100, 0, 0, 0 };
+
+            initConfig(&config, &producer, &parser, window, windowSize, threaded);
+            config.parser = parseThenFail;
+            int32_t rc = receivePipeline_run(&config, &stats);
+
+            TEST_ASSERT_EQUAL(rc, INKY_PIPELINE_RC_PARSEFAIL);
+            TEST_ASSERT_EQUAL(stats.parses, 3);
+            TEST_ASSERT(producer.pos < calLen, "producer carried on to the end (%zu bytes)", producer.pos);
+            finishCalendarParsing(&parser.calParsingContext);
+            test_utils_resetCalendar();
+        }
+
+        //An event doesn't fit in the window
+        {
+            CalendarParsingContext_t calParsingContext = { &testCal };
+            memoryProducer_t producer = { cal, calLen, 0, 100, 0, 0, 0 };
+
+            initConfig(&config, &producer, &calParsingContext, window, 64, threaded);
+            int32_t rc = receivePipeline_run(&config, &stats);
+
+            TEST_ASSERT_EQUAL(rc, INKY_PIPELINE_RC_BUFFULL);
+            finishCalendarParsing(&calParsingContext);
+            test_utils_resetCalendar();
+        }
+    }
+
+    free(window);
+    free(cal);
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testParseCalendar();
+
+    if(rc == 0)
+        rc = testFailures();
+
+    return rc;
+}
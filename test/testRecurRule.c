@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "utils/test_utils.h"
+#include "RecurRule.h"
+
+#define TEST_RECUR_MAX_DAYS 32
+
+typedef struct {
+    int32_t startYYYYMMDD;
+    const char *rule;
+    bool complete;                         //Expect no more occurrences (COUNT=/UNTIL=) after these
+    int32_t days[TEST_RECUR_MAX_DAYS];     //YYYYMMDD - ends with 0
+} recurExample_t;
+
+static int32_t dayFromYYYYMMDD(int32_t yyyymmdd)
+{
+    return daysFromCivil(yyyymmdd / 10000, (uint32_t)(yyyymmdd / 100) % 100, yyyymmdd % 100);
+}
+
+static int32_t yyyymmddFromDay(int32_t day)
+{
+    int32_t year;
+    uint32_t month, dayOfMonth;
+
+    civilFromDays(day, &year, &month, &dayOfMonth);
+    return year * 10000 + (int32_t)month * 100 + (int32_t)dayOfMonth;
+}
+
+//The examples in RFC 5545 3.8.5.3 (those that are in days, rather than hours etc.)
+int testRfcExamples(void)
+{
+    recurExample_t examples[] = {
+        {19970902, "FREQ=DAILY;COUNT=10", true,
+            {19970902, 19970903, 19970904, 19970905, 19970906, 19970907, 19970908, 19970909, 19970910, 19970911}},
+        {19970902, "FREQ=DAILY;INTERVAL=2", false,
+            {19970902, 19970904, 19970906, 19970908, 19970910, 19970912, 19970914}},
+        {19970902, "FREQ=DAILY;INTERVAL=10;COUNT=5", true,
+            {19970902, 19970912, 19970922, 19971002, 19971012}},
+        {19970902, "FREQ=WEEKLY;COUNT=10", true,
+            {19970902, 19970909, 19970916, 19970923, 19970930, 19971007, 19971014, 19971021, 19971028, 19971104}},
+        //The RFC's UNTIL=19971007T000000Z (and 19971224T000000Z below) is before the occurrence (at 09:00) on that day -
+        //times are up to the caller, here the UNTIL day is included
+        {19970902, "FREQ=WEEKLY;UNTIL=19971006;WKST=SU;BYDAY=TU,TH", true,
+            {19970902, 19970904, 19970909, 19970911, 19970916, 19970918, 19970923, 19970925, 19970930, 19971002}},
+        {19970901, "FREQ=WEEKLY;INTERVAL=2;UNTIL=19971223T000000Z;WKST=SU;BYDAY=MO,WE,FR", true,
+            {19970901, 19970903, 19970905, 19970915, 19970917, 19970919, 19970929, 19971001, 19971003, 19971013,
+             19971015, 19971017, 19971027, 19971029, 19971031, 19971110, 19971112, 19971114, 19971124, 19971126,
+             19971128, 19971208, 19971210, 19971212, 19971222}},
+        {19970805, "FREQ=WEEKLY;INTERVAL=2;COUNT=4;BYDAY=TU,SU;WKST=MO", true,
+            {19970805, 19970810, 19970819, 19970824}},
+        {19970805, "FREQ=WEEKLY;INTERVAL=2;COUNT=4;BYDAY=TU,SU;WKST=SU", true,
+            {19970805, 19970817, 19970819, 19970831}},
+        {19970905, "FREQ=MONTHLY;COUNT=10;BYDAY=1FR", true,
+            {19970905, 19971003, 19971107, 19971205, 19980102, 19980206, 19980306, 19980403, 19980501, 19980605}},
+        {19970907, "FREQ=MONTHLY;INTERVAL=2;COUNT=10;BYDAY=1SU,-1SU", true,
+            {19970907, 19970928, 19971102, 19971130, 19980104, 19980125, 19980301, 19980329, 19980503, 19980531}},
+        {19970922, "FREQ=MONTHLY;COUNT=6;BYDAY=-2MO", true,
+            {19970922, 19971020, 19971117, 19971222, 19980119, 19980216}},
+        {19970928, "FREQ=MONTHLY;BYMONTHDAY=-3", false,
+            {19970928, 19971029, 19971128, 19971229, 19980129, 19980226}},
+        {19970902, "FREQ=MONTHLY;COUNT=10;BYMONTHDAY=2,15", true,
+            {19970902, 19970915, 19971002, 19971015, 19971102, 19971115, 19971202, 19971215, 19980102, 19980115}},
+        {19970930, "FREQ=MONTHLY;COUNT=10;BYMONTHDAY=1,-1", true,
+            {19970930, 19971001, 19971031, 19971101, 19971130, 19971201, 19971231, 19980101, 19980131, 19980201}},
+        {19970910, "FREQ=MONTHLY;INTERVAL=18;COUNT=10;BYMONTHDAY=10,11,12,13,14,15", true,
+            {19970910, 19970911, 19970912, 19970913, 19970914, 19970915, 19990310, 19990311, 19990312, 19990313}},
+        {19970902, "FREQ=MONTHLY;INTERVAL=2;BYDAY=TU", false,
+            {19970902, 19970909, 19970916, 19970923, 19970930, 19971104, 19971111, 19971118, 19971125, 19980106}},
+        {19970610, "FREQ=YEARLY;COUNT=10;BYMONTH=6,7", true,
+            {19970610, 19970710, 19980610, 19980710, 19990610, 19990710, 20000610, 20000710, 20010610, 20010710}},
+        {19970519, "FREQ=YEARLY;BYDAY=20MO", false,
+            {19970519, 19980518, 19990517}},
+        {19970313, "FREQ=YEARLY;BYMONTH=3;BYDAY=TH", false,
+            {19970313, 19970320, 19970327, 19980305, 19980312, 19980319, 19980326, 19990304, 19990311, 19990318, 19990325}},
+        {19970902, "FREQ=MONTHLY;BYDAY=FR;BYMONTHDAY=13", false,
+            {19980213, 19980313, 19981113, 19990813, 20001013}},
+        {19970913, "FREQ=MONTHLY;BYDAY=SA;BYMONTHDAY=7,8,9,10,11,12,13", false,
+            {19970913, 19971011, 19971108, 19971213, 19980110, 19980207, 19980307, 19980411, 19980509, 19980613}},
+        {19961105, "FREQ=YEARLY;INTERVAL=4;BYMONTH=11;BYDAY=TU;BYMONTHDAY=2,3,4,5,6,7,8", false,
+            {19961105, 20001107, 20041102}},
+        {19970904, "FREQ=MONTHLY;COUNT=3;BYDAY=TU,WE,TH;BYSETPOS=3", true,
+            {19970904, 19971007, 19971106}},
+        {19970929, "FREQ=MONTHLY;BYDAY=MO,TU,WE,TH,FR;BYSETPOS=-2", false,
+            {19970929, 19971030, 19971127, 19971230, 19980129, 19980226, 19980330}},
+        {20070115, "FREQ=MONTHLY;BYMONTHDAY=15,30;COUNT=5", true,
+            {20070115, 20070130, 20070215, 20070315, 20070330}},
+        //Not from the RFC - dates some months/years don't have are skipped
+        {20130131, "FREQ=MONTHLY;COUNT=5", true,
+            {20130131, 20130331, 20130531, 20130731, 20130831}},
+        {20120229, "FREQ=YEARLY;UNTIL=20200301", true,
+            {20120229, 20160229, 20200229}},
+    };
+
+    for (uint32_t e = 0; e < sizeof(examples)/sizeof(examples[0]); e++)
+    {
+        recurRule_t rule;
+        recurIterator_t iter;
+        int32_t day;
+        uint32_t i;
+
+        bool compiled = compileRecurRule(examples[e].rule, strlen(examples[e].rule), &rule);
+        TEST_ASSERT(compiled, "compile %s", examples[e].rule);
+
+        int32_t startDay = dayFromYYYYMMDD(examples[e].startYYYYMMDD);
+        recurIterator_init(&iter, &rule, startDay, startDay, dayFromYYYYMMDD(21000101));
+
+        for (i = 0; examples[e].days[i] != 0; i++)
+        {
+            bool more = recurIterator_next(&iter, &day);
+            TEST_ASSERT(more, "%s: only %" PRIu32 " occurrences", examples[e].rule, i);
+            TEST_ASSERT(yyyymmddFromDay(day) == examples[e].days[i], "%s: occurrence %" PRIu32 " on %" PRId32 " (expected %" PRId32 ")",
+                        examples[e].rule, i, yyyymmddFromDay(day), examples[e].days[i]);
+        }
+
+        if (examples[e].complete)
+        {
+            bool more = recurIterator_next(&iter, &day);
+            TEST_ASSERT(!more, "%s: unexpected occurrence on %" PRId32, examples[e].rule, yyyymmddFromDay(day));
+        }
+    }
+    return 0;
+}
+
+//Iterating from a day years after DTSTART (skipping periods with day arithmetic) gives the same
+//occurrences from that day on as iterating through every occurrence from DTSTART
+int testSkipAhead(void)
+{
+    const char *rules[] = {
+        "FREQ=DAILY", "FREQ=DAILY;INTERVAL=3;COUNT=2000", "FREQ=DAILY;BYDAY=MO,FR;COUNT=900",
+        "FREQ=DAILY;BYMONTH=2;BYMONTHDAY=29", "FREQ=WEEKLY;INTERVAL=2;BYDAY=TU,SA;WKST=SU;COUNT=700",
+        "FREQ=WEEKLY;BYDAY=MO;BYMONTH=1,7", "FREQ=WEEKLY;BYDAY=WE,SU", "FREQ=MONTHLY;BYMONTHDAY=28,-1",
+        "FREQ=MONTHLY;COUNT=100", "FREQ=MONTHLY;INTERVAL=5;COUNT=25",
+        "FREQ=MONTHLY;BYDAY=-1FR;COUNT=120", "FREQ=MONTHLY;BYMONTHDAY=1,-1;INTERVAL=2;COUNT=100",
+        "FREQ=MONTHLY;BYDAY=MO,TU,WE,TH,FR;BYSETPOS=1,-1;COUNT=150", "FREQ=YEARLY;COUNT=12",
+        "FREQ=YEARLY;BYMONTH=2,8;BYDAY=2WE;UNTIL=20300101", "FREQ=YEARLY;BYDAY=-1SU",
+        "FREQ=YEARLY;BYMONTH=12;BYMONTHDAY=31",
+    };
+    int32_t starts[] = { 20100131, 20120229, 20130615 };
+
+    for (uint32_t r = 0; r < sizeof(rules)/sizeof(rules[0]); r++)
+    {
+        recurRule_t rule;
+        bool compiled = compileRecurRule(rules[r], strlen(rules[r]), &rule);
+        TEST_ASSERT(compiled, "compile %s", rules[r]);
+
+        for (uint32_t s = 0; s < sizeof(starts)/sizeof(starts[0]); s++)
+        {
+            int32_t startDay = dayFromYYYYMMDD(starts[s]);
+
+            for (int32_t firstDay = startDay - 40; firstDay < startDay + 20 * 366; firstDay += 97)
+            {
+                int32_t lastDay = firstDay + 45;
+                recurIterator_t fromStart, skipped;
+                int32_t dayFromStart = 0, daySkipped = 0;
+                bool moreFromStart, moreSkipped;
+
+                recurIterator_init(&fromStart, &rule, startDay, startDay, lastDay);
+                recurIterator_init(&skipped, &rule, startDay, firstDay, lastDay);
+
+                do
+                {
+                    do
+                    {
+                        moreFromStart = recurIterator_next(&fromStart, &dayFromStart);
+                    } while (moreFromStart && dayFromStart < firstDay);
+
+                    do
+                    {
+                        moreSkipped = recurIterator_next(&skipped, &daySkipped);
+                    } while (moreSkipped && daySkipped < firstDay);
+
+                    TEST_ASSERT(moreFromStart == moreSkipped && (!moreFromStart || dayFromStart == daySkipped),
+                                "%s from %" PRId32 " in window from %" PRId32 ": %d %" PRId32 " vs %d %" PRId32, rules[r], starts[s],
+                                yyyymmddFromDay(firstDay), moreFromStart, yyyymmddFromDay(dayFromStart), moreSkipped, yyyymmddFromDay(daySkipped));
+                } while (moreFromStart);
+            }
+        }
+    }
+    return 0;
+}
+
+int testBadRules(void)
+{
+    const char *rules[] = {
+        "", "FREQ=HOURLY", "FREQ=WEEKLY;INTERVAL=0", "FREQ=DAILY;COUNT=x", "FREQ=MONTHLY;BYDAY=XX",
+        "FREQ=MONTHLY;BYMONTHDAY=32", "FREQ=YEARLY;BYMONTH=13", "FREQ=DAILY;UNTIL=2023", "FREQ=WEEKLY;WKST",
+    };
+    recurRule_t rule;
+
+    for (uint32_t r = 0; r < sizeof(rules)/sizeof(rules[0]); r++)
+    {
+        bool compiled = compileRecurRule(rules[r], strlen(rules[r]), &rule);
+        TEST_ASSERT(!compiled, "compiled %s", rules[r]);
+    }
+
+    //Parts we don't support are ignored
+    const char *ignored = "FREQ=YEARLY;BYWEEKNO=20;BYDAY=MO";
+    bool compiled = compileRecurRule(ignored, strlen(ignored), &rule);
+    TEST_ASSERT(compiled, "compile %s", ignored);
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testRfcExamples();
+
+    if(rc == 0)
+        rc = testSkipAhead();
+
+    if(rc == 0)
+        rc = testBadRules();
+
+    return rc;
+}
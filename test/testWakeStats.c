@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "utils/test_utils.h"
+#include "WakeStats.h"
+
+#define TEST_CALENDAR_JSON "{\"index\":1,\"result\":\"downloaded\",\"rc\":0,\"reused\":true," \
+                           "\"dnsMs\":0,\"connectMs\":0,\"ttfbMs\":250,\"transferMs\":1500,\"totalMs\":1800," \
+                           "\"bytesReceived\":40000,\"bytesDecoded\":200000,\"bytesParsed\":200000," \
+                           "\"parses\":50,\"bytesMoved\":3000,\"peakUnparsed\":9000," \
+                           "\"longestStallMs\":300,\"eventsSeen\":120,\"eventsRelevant\":4}"
+
+static void addDownloadedCalendar(void)
+{
+    CalendarStats_t *pCalStats = wakeStats_addCalendar(1);
+    HttpBodyStats_t bodyStats = {};
+
+    pCalStats->result           = INKY_WAKESTATS_RESULT_DOWNLOADED;
+    pCalStats->rc               = 0;
+    pCalStats->reusedConnection = true;
+    pCalStats->ttfbMillis       = 250;
+    pCalStats->totalMillis      = 1800;
+    pCalStats->eventsSeen       = 120;
+    pCalStats->eventsRelevant   = 4;
+
+    bodyStats.receiveMillis         = 1500;
+    bodyStats.totalRaw              = 40000;
+    bodyStats.totalDecoded          = 200000;
+    bodyStats.longestStallMillis    = 300;
+    bodyStats.pipeline.totalParsed  = 200000;
+    bodyStats.pipeline.parses       = 50;
+    bodyStats.pipeline.totalMoved   = 3000;
+    bodyStats.pipeline.peakUnparsed = 9000;
+    wakeStats_addBody(pCalStats, &bodyStats);
+}
+
+int testJson(void)
+{
+    char buf[INKY_WAKESTATS_MAXBYTES_JSON];
+
+    wakeStats_reset();
+    wakeStats.wifiMillis = 900;
+    wakeStats.wifiFast   = true;
+    wakeStats.timeMillis = 5;
+
+    //No calendars
+    size_t len = wakeStats_toJson(buf, sizeof(buf), 3000, 0, 1, 0);
+    const char *expectedEmpty = "{\"wakeStats\":{\"wakeMs\":3000,\"wifiMs\":900,\"wifiFast\":true,\"timeMs\":5,"
+                                "\"warnings\":0,\"errors\":1,\"fatals\":0,\"calendarsNotRecorded\":0,\"calendars\":[]}}";
+    TEST_ASSERT_STRINGS_EQUAL(buf, expectedEmpty);
+    TEST_ASSERT_EQUAL(len, strlen(expectedEmpty));
+
+    addDownloadedCalendar();
+
+    CalendarStats_t *pCalStats = wakeStats_addCalendar(2);
+    pCalStats->result = INKY_WAKESTATS_RESULT_FAILED;
+    pCalStats->rc     = -1;
+
+    len = wakeStats_toJson(buf, sizeof(buf), 3000, 0, 1, 0);
+    const char *expected = "{\"wakeStats\":{\"wakeMs\":3000,\"wifiMs\":900,\"wifiFast\":true,\"timeMs\":5,"
+                           "\"warnings\":0,\"errors\":1,\"fatals\":0,\"calendarsNotRecorded\":0,\"calendars\":["
+                           TEST_CALENDAR_JSON ","
+                           "{\"index\":2,\"result\":\"failed\",\"rc\":-1,\"reused\":false,"
+                           "\"dnsMs\":0,\"connectMs\":0,\"ttfbMs\":0,\"transferMs\":0,\"totalMs\":0,"
+                           "\"bytesReceived\":0,\"bytesDecoded\":0,\"bytesParsed\":0,"
+                           "\"parses\":0,\"bytesMoved\":0,\"peakUnparsed\":0,"
+                           "\"longestStallMs\":0,\"eventsSeen\":0,\"eventsRelevant\":0}]}}";
+    TEST_ASSERT_STRINGS_EQUAL(buf, expected);
+    TEST_ASSERT_EQUAL(len, strlen(expected));
+
+    //Too small a buffer gives nothing rather than half a line
+    TEST_ASSERT_EQUAL(wakeStats_toJson(buf, strlen(expected), 3000, 0, 1, 0), 0);
+    TEST_ASSERT_STRINGS_EQUAL(buf, "");
+    TEST_ASSERT_EQUAL(wakeStats_toJson(buf, strlen(expected) + 1, 3000, 0, 1, 0), strlen(expected));
+    return 0;
+}
+
+int testFull(void)
+{
+    char buf[INKY_WAKESTATS_MAXBYTES_JSON];
+
+    wakeStats_reset();
+
+    for (uint32_t i = 0; i < INKY_WAKESTATS_MAX_CALENDARS; i++)
+    {
+        addDownloadedCalendar();
+    }
+    TEST_ASSERT(wakeStats_addCalendar(INKY_WAKESTATS_MAX_CALENDARS) == NULL, "recorded too many calendars%s", "");
+    TEST_ASSERT_EQUAL(wakeStats.calendarsNotRecorded, 1);
+
+    //Biggest realistic values still fit
+    for (uint32_t i = 0; i < INKY_WAKESTATS_MAX_CALENDARS; i++)
+    {
+        CalendarStats_t *pCalStats = &(wakeStats.calendars[i]);
+
+        pCalStats->rc                 = INT32_MIN;
+        pCalStats->dnsMillis          = UINT32_MAX;
+        pCalStats->connectMillis      = UINT32_MAX;
+        pCalStats->ttfbMillis         = UINT32_MAX;
+        pCalStats->transferMillis     = UINT32_MAX;
+        pCalStats->totalMillis        = UINT32_MAX;
+        pCalStats->bytesReceived      = UINT64_MAX;
+        pCalStats->bytesDecoded       = UINT64_MAX;
+        pCalStats->bytesParsed        = UINT64_MAX;
+        pCalStats->parses             = UINT64_MAX;
+        pCalStats->bytesMoved         = UINT64_MAX;
+        pCalStats->peakUnparsed       = UINT64_MAX;
+        pCalStats->longestStallMillis = UINT64_MAX;
+        pCalStats->eventsSeen         = UINT64_MAX;
+        pCalStats->eventsRelevant     = UINT64_MAX;
+    }
+    wakeStats.wifiMillis = UINT32_MAX;
+    wakeStats.timeMillis = UINT32_MAX;
+
+    size_t len = wakeStats_toJson(buf, sizeof(buf), UINT32_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX);
+    TEST_ASSERT(len > 0, "%d calendars don't fit in %d bytes", INKY_WAKESTATS_MAX_CALENDARS, INKY_WAKESTATS_MAXBYTES_JSON);
+    TEST_ASSERT(strchr(buf, '\n') == NULL, "not one line%s", "");
+    return 0;
+}
+
+int main(void)
+{
+    int rc = 0;
+
+    if(rc == 0)
+        rc = testJson();
+
+    if(rc == 0)
+        rc = testFull();
+
+    return rc;
+}
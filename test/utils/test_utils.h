@@ -1,9 +1,36 @@
 #ifndef TEST_UTILS_H
 #define TEST_UTILS_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 #include "test_utils_assert.h"
 
 //The returned buffer needs to be freed after use
 char *test_utils_fileToString(const char *filename);
 
+//As test_utils_fileToString() but for files that might contain '\0's
+//The returned buffer needs to be freed after use
+char *test_utils_fileToBuffer(const char *filename, size_t *pLength);
+
+//A calendar of numRelevant events on 20221107 and numOther all day events outside 20221106-20221108
+//The returned buffer needs to be freed after use
+char *test_utils_buildCalendar(uint32_t numRelevant, uint32_t numOther, size_t *pCalLen);
+
+//Clears the entries and event stats parsing a calendar left behind
+void test_utils_resetCalendar(void);
+
+//gzips data (with an original filename in the header, so decoders have to skip an optional header field)
+//The returned buffer needs to be freed after use
+char *test_utils_gzip(const char *data, size_t dataLen, size_t *pGzippedLen);
+
+//Transfer-Encoding: chunked encoding of data using chunks of (cycling) sizes from chunkSizes
+//The returned buffer needs to be freed after use
+char *test_utils_chunkSizes(const char *data, size_t dataLen,
+                            const size_t *chunkSizes, size_t numChunkSizes, size_t *pEncodedLen);
+
+//As test_utils_chunkSizes() with every chunk (but the last) chunkSize bytes
+//The returned buffer needs to be freed after use
+char *test_utils_chunk(const char *data, size_t dataLen, size_t chunkSize, size_t *pEncodedLen);
+
 #endif //TEST_UTILS_H
\ No newline at end of file
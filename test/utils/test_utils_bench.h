@@ -0,0 +1,23 @@
+#ifndef TEST_UTILS_BENCH_H
+#define TEST_UTILS_BENCH_H
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+//Monotonic time in seconds, for timing benchmarks
+static inline double test_utils_nowSecs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static inline void test_utils_reportThroughput(const char *what, uint64_t bytes, double secs)
+{
+    printf("%-50s %10.1f MB/s (%" PRIu64 " bytes in %.3f s)\n",
+             what, ((double)bytes / (1024.0 * 1024.0)) / secs, bytes, secs);
+}
+
+#endif //TEST_UTILS_BENCH_H
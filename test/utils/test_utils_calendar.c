@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <zlib.h>
+
+#include "test_utils.h"
+#include "Calendar.h"
+#include "entry.h"
+
+//A calendar of numRelevant events on 20221107 and numOther all day events outside 20221106-20221108
+//The returned buffer needs to be freed after use
+char *test_utils_buildCalendar(uint32_t numRelevant, uint32_t numOther, size_t *pCalLen)
+{
+    const char *relevantEvent = "BEGIN:VEVENT\r\n"
+                                "DTSTART:20221107T070000Z\r\n"
+                                "DTEND:20221107T080000Z\r\n"
+                                "UID:relevant%" PRIu32 "@inkycal.test\r\n"
+                                "SUMMARY:Tickets available for Worthy Players panto?\r\n"
+                                "BEGIN:VALARM\r\n"
+                                "ACTION:DISPLAY\r\n"
+                                "TRIGGER:-P0DT0H30M0S\r\n"
+                                "END:VALARM\r\n"
+                                "END:VEVENT\r\n";
+    const char *otherEvent    = "BEGIN:VEVENT\r\n"
+                                "DTSTART;VALUE=DATE:20230724\r\n"
+                                "DTEND;VALUE=DATE:20230901\r\n"
+                                "UID:other%" PRIu32 "@inkycal.test\r\n"
+                                "SUMMARY:Summer Holidays\r\n"
+                                "END:VEVENT\r\n";
+    uint32_t numEvents = numRelevant + numOther;
+    size_t calSpace = (size_t)numEvents * (strlen(relevantEvent) + 20) + 1024;
+    char *cal = (char *)malloc(calSpace);
+    TEST_ASSERT_PTR_NOT_NULL(cal);
+
+    size_t calLen = sprintf(cal, "BEGIN:VCALENDAR\r\nVERSION:2.0\r\n");
+
+    //Spread the relevant events through the calendar
+    for (uint32_t i = 0; i < numEvents; i++)
+    {
+        bool relevant = ((uint64_t)i * numRelevant / numEvents) != ((uint64_t)(i + 1) * numRelevant / numEvents);
+
+        calLen += sprintf(cal + calLen, relevant ? relevantEvent : otherEvent, i);
+    }
+    calLen += sprintf(cal + calLen, "END:VCALENDAR\r\n");
+
+    *pCalLen = calLen;
+    return cal;
+}
+
+void test_utils_resetCalendar(void)
+{
+    resetEntries();
+    resetEventStats();
+}
+
+//gzips data (with an original filename in the header, so decoders have to skip an optional header field)
+//The returned buffer needs to be freed after use
+char *test_utils_gzip(const char *data, size_t dataLen, size_t *pGzippedLen)
+{
+    z_stream stream = {};
+    gz_header header = {};
+
+    //+16: gzip format rather than zlib
+    int zrc = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY);
+    TEST_ASSERT_EQUAL(zrc, Z_OK);
+
+    size_t gzippedSpace = deflateBound(&stream, dataLen) + 1024;
+    char *gzipped = (char *)malloc(gzippedSpace);
+    TEST_ASSERT_PTR_NOT_NULL(gzipped);
+
+    header.name = (Bytef *)"calendar.ics";
+    deflateSetHeader(&stream, &header);
+
+    stream.next_in   = (Bytef *)data;
+    stream.avail_in  = (uInt)dataLen;
+    stream.next_out  = (Bytef *)gzipped;
+    stream.avail_out = (uInt)gzippedSpace;
+
+    zrc = deflate(&stream, Z_FINISH);
+    TEST_ASSERT_EQUAL(zrc, Z_STREAM_END);
+
+    *pGzippedLen = stream.total_out;
+    deflateEnd(&stream);
+    return gzipped;
+}
+
+//Transfer-Encoding: chunked encoding of data using chunks of (cycling) sizes from chunkSizes
+//The returned buffer needs to be freed after use
+char *test_utils_chunkSizes(const char *data, size_t dataLen,
+                            const size_t *chunkSizes, size_t numChunkSizes, size_t *pEncodedLen)
+{
+    size_t smallestChunk = chunkSizes[0];
+
+    for (size_t i = 1; i < numChunkSizes; i++)
+    {
+        if (chunkSizes[i] < smallestChunk)
+        {
+            smallestChunk = chunkSizes[i];
+        }
+    }
+    //Each chunk adds at most its size in hex and two CRLFs
+    char *encoded = (char *)malloc(dataLen + (dataLen / smallestChunk + 1) * 24 + 16);
+    TEST_ASSERT_PTR_NOT_NULL(encoded);
+
+    size_t inPos = 0;
+    size_t outPos = 0;
+    uint32_t chunkNum = 0;
+
+    while (inPos < dataLen)
+    {
+        size_t chunkLen = chunkSizes[chunkNum % numChunkSizes];
+
+        if (chunkLen > dataLen - inPos)
+        {
+            chunkLen = dataLen - inPos;
+        }
+        outPos += sprintf(encoded + outPos, "%zx\r\n", chunkLen);
+        memcpy(encoded + outPos, data + inPos, chunkLen);
+        outPos += chunkLen;
+        inPos += chunkLen;
+        outPos += sprintf(encoded + outPos, "\r\n");
+        chunkNum++;
+    }
+    outPos += sprintf(encoded + outPos, "0\r\n\r\n");
+
+    *pEncodedLen = outPos;
+    return encoded;
+}
+
+//As test_utils_chunkSizes() with every chunk (but the last) chunkSize bytes
+//The returned buffer needs to be freed after use
+char *test_utils_chunk(const char *data, size_t dataLen, size_t chunkSize, size_t *pEncodedLen)
+{
+    return test_utils_chunkSizes(data, dataLen, &chunkSize, 1, pEncodedLen);
+}
@@ -4,7 +4,7 @@
 #include "test_utils_assert.h"
 
 //The returned buffer needs to be freed after use
-char *test_utils_fileToString(const char *filename)
+char *test_utils_fileToBuffer(const char *filename, size_t *pLength)
 {
     char *buffer = NULL;
 
@@ -24,7 +24,18 @@ char *test_utils_fileToString(const char *filename)
             buffer[length] = '\0';
         }
         fclose(f);
+
+        if (pLength != NULL)
+        {
+            *pLength = (size_t)length;
+        }
     }
 
     return buffer;
 }
+
+//The returned buffer needs to be freed after use
+char *test_utils_fileToString(const char *filename)
+{
+    return test_utils_fileToBuffer(filename, NULL);
+}
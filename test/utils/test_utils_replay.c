@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "test_utils_assert.h"
+#include "test_utils_replay.h"
+
+static void *replayServerThread(void *arg)
+{
+    test_utils_replayServer_t *pServer = (test_utils_replayServer_t *)arg;
+    int fd = accept(pServer->listenfd, NULL, NULL);
+    TEST_ASSERT(fd >= 0, "accept failed: %d", errno);
+
+    char request[2048];
+    size_t requestLen = 0;
+
+    while (requestLen < sizeof(request) - 1)
+    {
+        ssize_t got = recv(fd, request + requestLen, sizeof(request) - 1 - requestLen, 0);
+        TEST_ASSERT(got > 0, "recv of request failed: %zd", got);
+        requestLen += got;
+        request[requestLen] = '\0';
+
+        if (strstr(request, "\r\n\r\n") != NULL)
+        {
+            pServer->sawRequest = true;
+            break;
+        }
+    }
+
+    size_t sent = 0;
+
+    while (sent < pServer->responseLen)
+    {
+        size_t sendLen = pServer->pieceSize;
+
+        if (sendLen > pServer->responseLen - sent)
+        {
+            sendLen = pServer->responseLen - sent;
+        }
+        if (pServer->stallMicros > 0 && sent < pServer->stallAfter && sendLen > pServer->stallAfter - sent)
+        {
+            sendLen = pServer->stallAfter - sent;
+        }
+        ssize_t justSent = send(fd, pServer->response + sent, sendLen, MSG_NOSIGNAL);
+        TEST_ASSERT(justSent > 0, "send failed: %d", errno);
+        sent += justSent;
+
+        if (pServer->stallMicros > 0 && sent == pServer->stallAfter)
+        {
+            usleep(pServer->stallMicros);
+        }
+
+        if (pServer->pieceDelayMicros > 0)
+        {
+            usleep(pServer->pieceDelayMicros);
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+void test_utils_replayServer_start(test_utils_replayServer_t *pServer)
+{
+    if (pServer->pieceSize == 0)
+    {
+        pServer->pieceSize = pServer->responseLen;
+    }
+    pServer->sawRequest = false;
+    pServer->listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(pServer->listenfd >= 0, "socket failed: %d", errno);
+
+    struct sockaddr_in addr = {};
+    socklen_t addrLen = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0; //Any free port
+
+    TEST_ASSERT_EQUAL(bind(pServer->listenfd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    TEST_ASSERT_EQUAL(listen(pServer->listenfd, 1), 0);
+    TEST_ASSERT_EQUAL(getsockname(pServer->listenfd, (struct sockaddr *)&addr, &addrLen), 0);
+    pServer->port = ntohs(addr.sin_port);
+
+    TEST_ASSERT_EQUAL(pthread_create(&(pServer->thread), NULL, replayServerThread, pServer), 0);
+}
+
+void test_utils_replayServer_stop(test_utils_replayServer_t *pServer)
+{
+    pthread_join(pServer->thread, NULL);
+    close(pServer->listenfd);
+}
+
+static size_t readSocket(char *buf, size_t maxLen, void *sourceContext)
+{
+    test_utils_socketSource_t *pSocket = (test_utils_socketSource_t *)sourceContext;
+
+    if (pSocket->maxRecv > 0 && maxLen > pSocket->maxRecv)
+    {
+        maxLen = pSocket->maxRecv;
+    }
+    ssize_t got = recv(pSocket->fd, buf, maxLen, MSG_DONTWAIT);
+
+    if (got == 0)
+    {
+        pSocket->closed = true;
+    }
+    else if (got < 0)
+    {
+        TEST_ASSERT(errno == EAGAIN || errno == EWOULDBLOCK, "recv failed: %d", errno);
+        got = 0;
+    }
+    return (size_t)got;
+}
+
+static bool socketEnded(void *sourceContext)
+{
+    test_utils_socketSource_t *pSocket = (test_utils_socketSource_t *)sourceContext;
+    return pSocket->closed;
+}
+
+static void waitForSocket(uint32_t maxWaitMs, void *sourceContext)
+{
+    test_utils_socketSource_t *pSocket = (test_utils_socketSource_t *)sourceContext;
+    struct pollfd pfd = { pSocket->fd, POLLIN, 0 };
+    poll(&pfd, 1, (int)maxWaitMs);
+}
+
+void test_utils_replayServer_request(test_utils_replayServer_t *pServer, test_utils_socketSource_t *pSocket,
+                                     ByteSource_t *pSource)
+{
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(pServer->port);
+
+    pSocket->closed = false;
+    pSocket->fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(pSocket->fd >= 0, "socket failed: %d", errno);
+    TEST_ASSERT_EQUAL(connect(pSocket->fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+    const char *request = "GET /calendar.ics HTTP/1.1\r\n"
+                          "Host: 127.0.0.1\r\n"
+                          "Accept-Encoding: gzip\r\n"
+                          "\r\n";
+    TEST_ASSERT_EQUAL((size_t)send(pSocket->fd, request, strlen(request), 0), strlen(request));
+
+    pSource->read    = readSocket;
+    pSource->ended   = socketEnded;
+    pSource->wait    = waitForSocket;
+    pSource->context = pSocket;
+}
+
+void test_utils_socketSource_close(test_utils_socketSource_t *pSocket)
+{
+    close(pSocket->fd);
+}
+
+char *test_utils_buildResponse(const char *headers, const char *body, size_t bodyLen, size_t *pResponseLen)
+{
+    const char *statusLine = "HTTP/1.1 200 OK\r\n";
+    size_t responseLen = strlen(statusLine) + strlen(headers) + 2 + bodyLen;
+    char *response = (char *)malloc(responseLen + 1);
+    TEST_ASSERT_PTR_NOT_NULL(response);
+
+    size_t pos = sprintf(response, "%s%s\r\n", statusLine, headers);
+    memcpy(response + pos, body, bodyLen);
+    response[responseLen] = '\0';
+
+    *pResponseLen = responseLen;
+    return response;
+}
@@ -0,0 +1,49 @@
+#ifndef TEST_UTILS_REPLAY_H
+#define TEST_UTILS_REPLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "ByteSource.h"
+
+//Stand-in for a calendar server on a loopback socket: answers one request by replaying a
+//captured response (status line, headers and body) - e.g. one saved with openssl s_client as
+//README.md shows - then closes the connection.
+//The response is sent pieceSize bytes at a time with a pause between pieces to simulate the network.
+typedef struct {
+    const char *response;
+    size_t responseLen;
+    size_t pieceSize;           //Send this many bytes at a time
+    uint32_t pieceDelayMicros;  //Pause this long after each piece (0 for none)
+    size_t stallAfter;          //Pause once after sending this many bytes...
+    uint32_t stallMicros;       //...for this long (0 for no pause)
+    //Set by test_utils_replayServer_start():
+    int listenfd;
+    uint16_t port;
+    pthread_t thread;
+    bool sawRequest;            //Read a complete request before replying
+} test_utils_replayServer_t;
+
+//Listens on a free loopback port and replies (on another thread) to the first connection
+void test_utils_replayServer_start(test_utils_replayServer_t *pServer);
+//Waits for the reply to have been sent
+void test_utils_replayServer_stop(test_utils_replayServer_t *pServer);
+
+//The client end of a connection as a ByteSource
+typedef struct {
+    int fd;
+    size_t maxRecv;  //Only read this much at a time, like a small tcp receive buffer (0 for no limit)
+    bool closed;     //Server closed the connection
+} test_utils_socketSource_t;
+
+//Connects to the server, sends a GET request and sets up pSource to read the response
+void test_utils_replayServer_request(test_utils_replayServer_t *pServer, test_utils_socketSource_t *pSocket,
+                                     ByteSource_t *pSource);
+void test_utils_socketSource_close(test_utils_socketSource_t *pSocket);
+
+//Builds a response with the given headers (each ending \r\n) and body
+//The returned buffer needs to be freed after use
+char *test_utils_buildResponse(const char *headers, const char *body, size_t bodyLen, size_t *pResponseLen);
+
+#endif //TEST_UTILS_REPLAY_H